@@ -10,12 +10,17 @@
  *
  */
 
+/// @brief En-tête de l'historique journalier /data.csv : noms des colonnes, la première étant la date
+#define ENTETE_HISTORIQUE "Date;Tmax;Tmin;Pression;Turbine"
+
 void init_file_system();
 String getStringValueFromJsonFile(String filePath, String tag1, String tag2, String tag3);
 int getIntValueFromJsonFile(String filePath, String tag1, String tag2, String tag3);
+float getFloatValueFromJsonFile(String filePath, String tag1, String tag2, String tag3);
 void saveDataToFile(float temperature_max, float temperature_min, float pression, int turbine);
 void readMeteoFileToSerial();
 void readFileToSerial(String filepath);
+String readFileToString(String filepath);
 void modifFileToSerial(String filepath);
 void delFileToSerial(String filepath);
 
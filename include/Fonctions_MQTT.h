@@ -16,12 +16,23 @@ void callback(char* topic, byte* message, unsigned int length) ;
 void publish_1();
 void publish_2();
 void publish_s1();
+void publish_s1_document();
+void construit_document_etat();
+uint32_t empreinte_document_etat();
+uint64_t horodatage_ms();
+void banc_encodage_MQTT();
+void banc_routeur(int nb_routes);
+void affiche_diagnostic_MQTT();
+void demande_publication();
 void publish_s2();
+void enregistre_routes_MQTT();
 void update_Subscribe1(String mqttSubscribe, char* topic, char* payload, unsigned int length);
 void update_Subscribe2(char* message, unsigned int length);
 void update_vannes();
 void mqtt_service_setup();
 void loop_MQTT();
+int socket_MQTT();
+bool MQTT_a_traiter();
 
 
 
@@ -10,9 +10,30 @@
  *
  */
 
+/**
+ * @struct Struct_Lot_Sorties
+ * @brief Lot de sorties appliqué d'un seul bloc, ou état combiné des sorties.
+ *
+ * Un bit de masque à 1 désigne une sortie du lot (bit i : sortie PCF8574 i, GPIO_OUT i+1, servo i, PWM i).
+ */
+struct Struct_Lot_Sorties {
+  uint8_t Masque_PCF8574_1 = 0;      ///< Sorties de l'extension PCF8574_1 du lot.
+  uint8_t Valeurs_PCF8574_1 = 0;     ///< Valeurs des sorties de l'extension PCF8574_1.
+  uint8_t Masque_GPIO_OUT = 0;       ///< Sorties GPIO_OUT du lot.
+  uint8_t Valeurs_GPIO_OUT = 0;      ///< Valeurs des sorties GPIO_OUT.
+  uint8_t Masque_Servo = 0;          ///< Servomoteurs du lot.
+  int Servo[4] = {0, 0, 0, 0};       ///< Angles des servomoteurs (0 à 180).
+  uint8_t Masque_PWM = 0;            ///< Sorties PWM du lot.
+  int PWM[4] = {0, 0, 0, 0};         ///< Rapports cycliques PWM (0 à 100 %).
+};
+
+void Sorties_verrouille();
+void Sorties_deverrouille();
+
 void Config_PCF8574_OUT_1();
 void PCF8574_OUT_1_maj();
 int PCF8574_OUT_1_out(int num_port, bool val);
+int PCF8574_OUT_1_ecrit();
 void ConfigGPIO(void);
 void GPIO_maj(void);
 int GPIO_OUT(int i, int val);
@@ -27,4 +48,10 @@ int ServoMoteur_OUT(int i, int val) ;
 
 void ConfigurePWM(void);
 int PWM_OUT(int i, int val);
+int PWM_OUT_F(int i, float val);
+bool PWM_active(int i);
+
+const char *Sorties_lot_verifie(const Struct_Lot_Sorties *lot);
+int Sorties_lot_applique(const Struct_Lot_Sorties *lot);
+void Sorties_etat(Struct_Lot_Sorties *etat);
  
\ No newline at end of file
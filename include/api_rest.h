@@ -0,0 +1,33 @@
+/**
+ * @file api_rest.h
+ * @brief Fonction de l'API REST JSON du serveur web.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la publication de l'état agrégé sur /api/state à partir d'un instantané sérialisé une fois par version,
+ * et la diffusion des groupes de canaux modifiés aux clients WebSocket de /ws
+ *
+ */
+
+/// @brief URL de l'état agrégé ; un groupe de canaux est servi sur /api/state/<groupe>
+#define URL_ETAT_API "/api/state"
+
+/// @brief Nombre maximal de groupes de canaux servis séparément
+#define NB_GROUPES_API 16
+
+/// @brief Attente maximale (ms) de la reconstruction de l'instantané par une réponse différée
+#define ATTENTE_INSTANTANE_API_MS 5000
+
+/// @brief URL du flux WebSocket des changements d'état
+#define URL_FLUX_WS "/ws"
+
+/// @brief Nombre maximal de clients WebSocket simultanés
+#define NB_CLIENTS_WS 8
+
+void ConfigAPI(void);
+void maj_instantane_API(int64_t lecture_us);
+void demande_instantane_API(void);
+void service_API(void);
+void affiche_diagnostic_API(void);
@@ -0,0 +1,139 @@
+/**
+ * @file client_mqtt.h
+ * @brief Fonction de client MQTT 3.1.1 / 5.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite le protocole MQTT sur une liaison déjà connectée (WiFiClient ou ClientTLS)
+ *
+ */
+
+/// @brief Niveau de protocole MQTT 3.1.1
+#define MQTT_VERSION_3_1_1 4
+
+/// @brief Niveau de protocole MQTT 5
+#define MQTT_VERSION_5 5
+
+/// @brief Nombre d'alias de topic mémorisés par connexion (limité par le Topic Alias Maximum du serveur)
+#define NB_ALIAS_MQTT 64
+
+/// @brief Taille maximale d'un topic aliasé ou d'un topic de réponse reçu (caractère nul compris)
+#define TAILLE_TOPIC_CLIENT_MQTT 64
+
+/// @brief Taille maximale d'une donnée de corrélation reçue
+#define TAILLE_CORRELATION_MQTT 32
+
+/// @brief Taille du tampon d'émission : en-tête fixe, topic et propriétés d'un paquet y sont regroupés avant l'envoi
+#define TAILLE_ENTETE_CLIENT_MQTT 256
+
+/// @brief Codes d'état du client (state()) ; un refus du serveur est le code de retour du CONNACK (> 0)
+enum Etat_Client_MQTT {
+  CLIENT_MQTT_DELAI_DEPASSE = -4,    ///< Pas de réponse du serveur dans le délai de maintien.
+  CLIENT_MQTT_PROTOCOLE = -3,        ///< Paquet invalide reçu.
+  CLIENT_MQTT_LIAISON_PERDUE = -2,   ///< Liaison fermée par le serveur ou le réseau.
+  CLIENT_MQTT_DECONNECTE = -1,       ///< Pas de session.
+  CLIENT_MQTT_CONNECTE = 0,          ///< Session ouverte.
+  CLIENT_MQTT_EN_COURS = 100         ///< CONNECT émis, CONNACK attendu.
+};
+
+/**
+ * @struct Struct_Proprietes_MQTT
+ * @brief Propriétés MQTT 5 de requête / réponse d'un paquet PUBLISH.
+ */
+struct Struct_Proprietes_MQTT {
+  const char *Topic_reponse = NULL;       ///< Response Topic (0x08), NULL si absent.
+  const uint8_t *Correlation = NULL;      ///< Correlation Data (0x09), NULL si absente.
+  uint16_t Taille_correlation = 0;        ///< Taille de la donnée de corrélation.
+};
+
+/// @brief Rappel d'un message reçu : topic terminé par un caractère nul, message et taille
+typedef void (*Rappel_MQTT)(char *topic, uint8_t *message, unsigned int taille);
+
+/**
+ * @class ClientMQTT
+ * @brief Client MQTT 3.1.1 ou 5 sur une liaison Client déjà connectée, sans attente bloquante.
+ *
+ * L'ouverture de session est découpée : demarre_session() émet le CONNECT, poursuit_session() lit le
+ * CONNACK sans attendre. La réception avance par morceaux à chaque loop(). En MQTT 5, les topics publiés
+ * reçoivent un alias (Topic Alias) dans la limite annoncée par le serveur : une publication suivante sur le
+ * même topic n'émet plus que l'alias. Les propriétés Response Topic / Correlation Data d'un message reçu
+ * sont lisibles pendant le rappel (proprietes_recues) et peuvent être jointes à une publication.
+ */
+class ClientMQTT {
+ public:
+  ClientMQTT(Client &liaison);
+  void setClient(Client &liaison);
+  void setCallback(Rappel_MQTT rappel);
+  bool setBufferSize(uint16_t taille);
+  void setKeepAlive(uint16_t secondes);
+  void setVersion(uint8_t version);
+
+  bool demarre_session(const char *id, const char *utilisateur, const char *mot_de_passe, const char *topic_testament, uint8_t qos_testament, bool testament_retenu, const char *message_testament, bool session_propre, uint32_t expiration_session_s);
+  int poursuit_session(void);
+  bool connected(void);
+  void disconnect(void);
+  int state(void);
+  uint8_t version(void);
+
+  bool subscribe(const char *topic, uint8_t qos = 0);
+  size_t taille_publish(const char *topic, size_t taille, const Struct_Proprietes_MQTT *proprietes, size_t *taille_topic = NULL);
+  bool publish(const char *topic, const char *message, bool retenu, const Struct_Proprietes_MQTT *proprietes = NULL);
+  bool beginPublish(const char *topic, size_t taille, bool retenu, const Struct_Proprietes_MQTT *proprietes = NULL);
+  size_t write(const uint8_t *tampon, size_t taille);
+  int endPublish(void);
+  bool loop(void);
+  const Struct_Proprietes_MQTT *proprietes_recues(void);
+  void affiche_diagnostic(void);
+
+  uint16_t Alias_max = 0;            ///< Alias utilisables sur la connexion (Topic Alias Maximum du serveur, borné à NB_ALIAS_MQTT).
+  uint16_t Nb_alias = 0;             ///< Alias attribués sur la connexion.
+  unsigned long Publications_alias = 0;  ///< Publications émises avec un topic vide et un alias.
+  unsigned long Octets_topics_evites = 0;  ///< Octets de topic non émis grâce aux alias.
+  unsigned long Octets_emis = 0;     ///< Octets émis sur la liaison.
+  unsigned long Paquets_ecartes = 0; ///< Paquets reçus plus grands que le tampon de réception.
+
+ private:
+  int alias_publish(const char *topic, bool *nouvel);
+  size_t taille_proprietes_publish(int alias, const Struct_Proprietes_MQTT *proprietes);
+  void ajoute(const uint8_t *octets, size_t taille);
+  void ajoute_octet(uint8_t octet);
+  void ajoute_16(uint16_t valeur);
+  void ajoute_32(uint32_t valeur);
+  void ajoute_longueur(uint32_t longueur);
+  void ajoute_chaine(const char *chaine, size_t taille);
+  bool emet_entete(void);
+  void recoit(void);
+  void traite_paquet(void);
+  void traite_connack(void);
+  void traite_publish(void);
+  void coupe(int etat);
+
+  Client *Liaison;                   ///< Liaison connectée au serveur.
+  Rappel_MQTT Rappel = NULL;         ///< Rappel des messages reçus.
+  uint8_t *Reception = NULL;         ///< Tampon de réception d'un paquet.
+  uint16_t Taille_reception = 0;     ///< Taille du tampon de réception.
+  uint8_t Entete[TAILLE_ENTETE_CLIENT_MQTT];  ///< Octets du paquet en cours d'émission, envoyés par blocs.
+  size_t Nb_entete = 0;              ///< Octets en attente dans Entete.
+  bool Erreur_emission = false;      ///< La liaison a refusé une partie du paquet en cours d'émission.
+  uint8_t Version = MQTT_VERSION_5;  ///< Niveau de protocole demandé.
+  int Etat = CLIENT_MQTT_DECONNECTE; ///< État (Etat_Client_MQTT) ou code de refus du CONNACK.
+  uint16_t Maintien_demande_s = 15;  ///< Intervalle de maintien (keep alive) demandé, en secondes.
+  uint16_t Maintien_s = 15;          ///< Intervalle de maintien de la session (Server Keep Alive en MQTT 5).
+  uint32_t Paquet_max_serveur = 0;   ///< Taille maximale d'un paquet accepté par le serveur, 0 si non annoncée.
+  uint16_t Id_paquet = 0;            ///< Dernier identifiant de paquet émis.
+  unsigned long Derniere_emission = 0;   ///< Instant (millis) du dernier paquet émis.
+  unsigned long Derniere_reception = 0;  ///< Instant (millis) du dernier paquet reçu.
+  bool Ping_en_cours = false;        ///< PINGREQ émis, PINGRESP attendu.
+  uint8_t Etape = 0;                 ///< Étape de réception : 0 en-tête fixe, 1 longueur restante, 2 contenu.
+  uint8_t Type_recu = 0;             ///< Premier octet du paquet en cours de réception.
+  uint32_t Restant = 0;              ///< Longueur restante du paquet en cours de réception.
+  uint32_t Lu = 0;                   ///< Octets du contenu déjà reçus.
+  uint32_t Multiplicateur = 1;       ///< Multiplicateur du décodage de la longueur restante.
+  char Topics_alias[NB_ALIAS_MQTT][TAILLE_TOPIC_CLIENT_MQTT];  ///< Topic de chaque alias (alias = index + 1).
+  uint32_t Empreintes_alias[NB_ALIAS_MQTT];  ///< Empreinte FNV-1a de chaque topic aliasé.
+  char Topic_reponse[TAILLE_TOPIC_CLIENT_MQTT];  ///< Response Topic du message en cours de rappel.
+  uint8_t Correlation[TAILLE_CORRELATION_MQTT];  ///< Correlation Data du message en cours de rappel.
+  Struct_Proprietes_MQTT Proprietes;  ///< Propriétés du message en cours de rappel.
+};
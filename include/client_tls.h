@@ -0,0 +1,41 @@
+/**
+ * @file client_tls.h
+ * @brief Fonction de client TLS avec reprise de session.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la connexion chiffrée au serveur MQTT, avec reprise de session TLS entre deux reconnexions
+ *
+ */
+
+/**
+ * @class ClientTLS
+ * @brief Client TLS (mbedTLS) sur une socket déjà connectée, utilisable par ClientMQTT.
+ *
+ * Contrairement à WiFiClientSecure, le client conserve la session TLS (identifiant ou ticket de session)
+ * d'une connexion à l'autre : une reconnexion après une coupure WiFi évite l'échange de clé complet.
+ * La poignée de main est menée pas à pas sans bloquer la boucle principale (voir poursuit_handshake).
+ */
+class ClientTLS : public Client {
+ public:
+  bool configure(const char *ca, const char *certificat, const char *cle, const char *nom_serveur, bool session_rtc);
+  int demarre(int fd, const char *hote);
+  int poursuit_handshake(void);
+  void affiche_diagnostic(void);
+  int fd(void);
+
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t octet) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override;
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override;
+};
@@ -0,0 +1,27 @@
+/**
+ * @file debit.h
+ * @brief Fonction de régulation du débit MQTT sortant.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la limitation du débit des publications par seau à jetons, par classe de trafic et par priorité
+ *
+ */
+
+/**
+ * @enum Classe_Debit
+ * @brief Classe de trafic sortant, de la plus prioritaire à la moins prioritaire.
+ */
+enum Classe_Debit {
+  CLASSE_ACK = 0,                    ///< Acquittements de commande.
+  CLASSE_EVENEMENT,                  ///< Changements d'état publiés sur détection de changement.
+  CLASSE_TELEMETRIE,                 ///< Rafraîchissement complet, document agrégé, rejeu de la file d'attente.
+  CLASSE_DIAGNOSTIC,                 ///< Publications de diagnostic (publish_1, publish_2).
+  NB_CLASSES_DEBIT
+};
+
+void ConfigDebit(void);
+bool Debit_autorise(int classe, unsigned long octets, bool *differe);
+void affiche_diagnostic_debit(void);
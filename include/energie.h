@@ -0,0 +1,17 @@
+/**
+ * @file energie.h
+ * @brief Fonction de gestion de l'énergie.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la mise en veille légère automatique et la variation de fréquence du CPU entre deux boucles
+ *
+ */
+
+void ConfigEnergie(void);
+void Energie_debut_boucle(void);
+void Energie_repos(unsigned long echeance_us);
+void Energie_reveille(void);
+void affiche_diagnostic_energie(void);
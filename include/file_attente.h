@@ -0,0 +1,35 @@
+/**
+ * @file file_attente.h
+ * @brief Fonction de file d'attente des messages MQTT en absence de connexion.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la mise en file des publications pendant une coupure (anneau en RAM débordant en flash)
+ *
+ */
+
+/// @brief Taille maximale d'un message mis en file
+#define TAILLE_MESSAGE_DIFFERE 2048
+
+/**
+ * @struct Struct_Entete_Differe
+ * @brief En-tête d'un message mis en file, suivi de Taille octets de message.
+ */
+struct Struct_Entete_Differe {
+  uint64_t Horodatage;               ///< Instant d'acquisition (ms UTC, ou ms depuis le démarrage sans NTP).
+  uint32_t Acquisition_ms;           ///< Instant d'acquisition en millis(), pour le calcul du retard de rejeu.
+  uint32_t Version_topics;           ///< Empreinte de la table des topics à la mise en file (Version_Topics_MQTT).
+  int16_t Topic;                     ///< Index du topic dans la table des topics de publication.
+  uint8_t Encodage;                  ///< Encodage du message (Encodage_MQTT).
+  uint8_t Ancien;                    ///< Message d'un démarrage précédent, Acquisition_ms non significatif (renseigné à la lecture).
+  uint16_t Taille;                   ///< Taille du message en octets.
+};
+
+void ConfigFileAttente(void);
+bool File_attente_ajoute(const Struct_Entete_Differe *entete, const uint8_t *donnees);
+bool File_attente_tete(Struct_Entete_Differe *entete, uint8_t *donnees);
+void File_attente_retire(void);
+int File_attente_profondeur(void);
+void affiche_diagnostic_file_attente(void);
@@ -28,6 +28,8 @@ extern bool EnableNTP;               ///< Activation du module NTP.
 extern bool EnableMQTT;              ///< Activation du module MQTT.
 extern bool EnableWEB;               ///< Activation du serveur web.
 
+extern bool EnableEnergie;           ///< Activation de la gestion d'énergie (veille légère).
+
 extern bool EnableImpulsion1;        ///< Activation de l'impulsion 1.
 extern bool EnableImpulsion2;        ///< Activation de l'impulsion 2.
 
@@ -0,0 +1,23 @@
+/**
+ * @file historique.h
+ * @brief Fonction d'export de l'historique stocké par le serveur web.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'export de /data.csv sur /api/history, en flux fragmenté avec des tampons de taille fixe
+ *
+ */
+
+/// @brief URL de l'export de l'historique
+#define URL_HISTORIQUE "/api/history"
+
+/// @brief Nombre maximal de colonnes de l'historique (date comprise)
+#define NB_COLONNES_HISTORIQUE 8
+
+/// @brief Nombre maximal d'exports simultanés (un fichier ouvert par export)
+#define NB_EXPORTS_HISTORIQUE 2
+
+void ConfigHistorique(void);
+void affiche_diagnostic_historique(void);
@@ -0,0 +1,27 @@
+/**
+ * @file planificateur.h
+ * @brief Fonction de planification des commandes de sortie.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'exécution différée des commandes de sortie sur un timer matériel
+ *
+ */
+
+/**
+ * @enum Type_Commande
+ * @brief Type de sortie visée par une commande.
+ */
+enum Type_Commande {
+  CMD_PCF8574_OUT_1 = 0,             ///< Sortie de l'extension PCF8574_1 (num 0 à 7).
+  CMD_GPIO_OUT = 1,                  ///< Sortie GPIO (num 1 à 8).
+  CMD_SERVO = 2,                     ///< Servomoteur (num 0 à 3).
+  CMD_PWM = 3                        ///< Sortie PWM (num 0 à 3).
+};
+
+void ConfigPlanificateur(void);
+int Execute_commande(int type, int num, int val);
+int Planifie_commande(int type, int num, int val, int64_t delai_us);
+void affiche_diagnostic_planificateur(void);
@@ -0,0 +1,50 @@
+/**
+ * @file pool_commandes.h
+ * @brief Fonction de réception des commandes MQTT dans un pool d'emplacements préalloués.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la copie des messages reçus dans des emplacements de taille fixe, transmis par index au traitement des commandes
+ *
+ */
+
+/// @brief Nombre d'emplacements du pool
+#define NB_EMPLACEMENTS_COMMANDE 8
+
+/// @brief Taille maximale du message d'une commande
+#define TAILLE_COMMANDE_MAX 512
+
+/// @brief Taille maximale du topic d'une commande (caractère nul compris)
+#define TAILLE_TOPIC_COMMANDE 64
+
+/// @brief Taille maximale de la Correlation Data (MQTT 5) d'une commande
+#define TAILLE_CORRELATION_COMMANDE 32
+
+/// @brief Taille du tampon de réception du client MQTT : un message plus grand que le pool, jusqu'à cette taille,
+/// atteint encore le rappel et y est rejeté avec un acquittement ; au-delà, le client MQTT l'écarte sans rappel
+#define TAILLE_TAMPON_RECEPTION_MQTT (4 * TAILLE_COMMANDE_MAX)
+
+/// @brief Résultat de Pool_commande_depose
+enum Depot_Commande {DEPOT_ACCEPTE, DEPOT_TROP_GRAND, DEPOT_POOL_PLEIN};
+
+/**
+ * @struct Struct_Emplacement_Commande
+ * @brief Message reçu, copié une seule fois depuis le tampon du client MQTT.
+ */
+struct Struct_Emplacement_Commande {
+  char Topic[TAILLE_TOPIC_COMMANDE];           ///< Topic du message.
+  char Message[TAILLE_COMMANDE_MAX + 1];       ///< Message, terminé par un caractère nul.
+  uint16_t Taille;                             ///< Taille du message en octets.
+  int64_t Reception_us;                        ///< Instant de réception (esp_timer).
+  char Topic_reponse[TAILLE_TOPIC_COMMANDE];   ///< Response Topic (MQTT 5), vide si absent.
+  uint8_t Correlation[TAILLE_CORRELATION_COMMANDE];  ///< Correlation Data (MQTT 5).
+  uint8_t Taille_correlation;                  ///< Taille de la Correlation Data, 0 si absente.
+};
+
+int Pool_commande_depose(const char *topic, const uint8_t *message, unsigned int taille, int64_t reception_us, const char *topic_reponse, const uint8_t *correlation, size_t taille_correlation);
+int Pool_commande_suivante(void);
+Struct_Emplacement_Commande *Pool_commande(int index);
+void Pool_commande_libere(int index);
+void affiche_diagnostic_pool_commandes(void);
@@ -0,0 +1,110 @@
+/**
+ * @file publication.h
+ * @brief Fonction de la table des canaux de publication MQTT.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la table des topics de publication et la détection de changement des canaux
+ *
+ */
+
+/// @brief Index des canaux de publication de publish_s1 (un canal = un topic)
+#define CANAL_PCF8574_OUT_1 0
+#define CANAL_GPIO_OUT      8
+#define CANAL_GPIO_IN       16
+#define CANAL_GPIO_ANA      24
+#define CANAL_PT100         32
+#define CANAL_SONDE         36
+#define CANAL_IMPULSION     40
+#define CANAL_TELEMETRE     42
+#define CANAL_METEO         43
+#define CANAL_USER          44
+#define NB_CANAUX_MQTT      60
+
+/**
+ * @enum Famille_Canal
+ * @brief Famille de canaux partageant la même bande morte.
+ */
+enum Famille_Canal {
+  FAMILLE_TOR = 0,                   ///< Canaux tout ou rien (PCF8574, GPIO_OUT, GPIO_IN) : bande morte nulle.
+  FAMILLE_GPIO_ANA,                  ///< Entrées analogiques.
+  FAMILLE_PT100,                     ///< Sondes PT100.
+  FAMILLE_SONDE,                     ///< Sondes.
+  FAMILLE_IMPULSION,                 ///< Compteurs d'impulsion.
+  FAMILLE_TELEMETRE,                 ///< Télémètre.
+  FAMILLE_METEO,                     ///< Données météo.
+  FAMILLE_USER,                      ///< Variables utilisateur.
+  NB_FAMILLES
+};
+
+/**
+ * @struct Struct_Bande_Morte
+ * @brief Bande morte d'une famille de canaux : un changement est publié s'il dépasse max(Abs, Rel x |valeur publiée|).
+ */
+struct Struct_Bande_Morte {
+  float Abs = 0;                     ///< Bande morte absolue.
+  float Rel = 0;                     ///< Bande morte relative (0.01 = 1 %).
+};
+
+/**
+ * @struct Struct_Canal_MQTT
+ * @brief Dernières valeurs publiées d'un canal.
+ */
+struct Struct_Canal_MQTT {
+  bool Publie = false;               ///< Le canal a déjà été publié depuis le démarrage.
+  bool Differe = false;              ///< Le dernier message du canal a été refusé par la régulation de débit.
+  float Valeur[6];                   ///< Dernières valeurs publiées.
+};
+
+/// @brief Index du topic du document agrégé dans la table des topics
+#define TOPIC_ETAT          NB_CANAUX_MQTT
+/// @brief Index du topic des acquittements de commande
+#define TOPIC_ACK           (NB_CANAUX_MQTT+1)
+/// @brief Index du topic de présence (message de naissance "online" et testament "offline", retenus)
+#define TOPIC_STATUT        (NB_CANAUX_MQTT+2)
+/// @brief Index du topic des réponses aux requêtes sans topic de réponse
+#define TOPIC_REPONSE       (NB_CANAUX_MQTT+3)
+#define NB_TOPICS_MQTT      (NB_CANAUX_MQTT+4)
+
+/// @brief Taille maximale d'un topic de publication (caractère nul compris)
+#define TAILLE_TOPIC_MQTT   64
+
+/// @brief Taille du tampon d'écriture entre le sérialiseur et le client MQTT
+#define TAILLE_TAMPON_FLUX  256
+
+/// @brief Sortie d'un écrivain de flux : écrit taille octets et retourne le nombre d'octets acceptés
+typedef size_t (*Sortie_Flux)(void *contexte, const uint8_t *tampon, size_t taille);
+
+/**
+ * @class Ecrivain_Flux
+ * @brief Écrivain à tampon fixe placé entre le sérialiseur ArduinoJson et le client MQTT.
+ *
+ * Le sérialiseur écrit octet par octet : sans tampon, chaque octet part dans un appel d'écriture de la
+ * socket (et dans un enregistrement TLS). Les octets sont regroupés par blocs de TAILLE_TAMPON_FLUX.
+ * Après une écriture incomplète de la sortie, plus aucun octet n'est accepté.
+ */
+class Ecrivain_Flux {
+ public:
+  Ecrivain_Flux(Sortie_Flux sortie, void *contexte);
+  size_t write(uint8_t octet);
+  size_t write(const uint8_t *tampon, size_t taille);
+  bool vide();
+
+  size_t Transmis = 0;               ///< Octets acceptés par la sortie.
+  bool Erreur = false;               ///< La sortie a refusé une partie d'un bloc.
+
+ private:
+  bool envoie(const uint8_t *tampon, size_t taille);
+
+  Sortie_Flux Sortie;                ///< Fonction d'écriture de la sortie.
+  void *Contexte;                    ///< Argument de la fonction d'écriture (client MQTT).
+  uint8_t Tampon[TAILLE_TAMPON_FLUX];  ///< Octets en attente d'écriture.
+  size_t Nb = 0;                     ///< Nombre d'octets en attente.
+};
+
+int Topics_MQTT_construit(const char *prefixe);
+bool canal_modifie(int canal, const float *val, int nb, int famille);
+void memorise_canal(int canal, const float *val, int nb);
+unsigned long taille_paquet_publish(size_t taille_topic, size_t taille_message);
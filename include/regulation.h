@@ -0,0 +1,40 @@
+/**
+ * @file regulation.h
+ * @brief Fonction de régulation de pression.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la régulation PID de la pression de ligne par une pompe à vitesse variable sur une sortie PWM
+ *
+ */
+
+/**
+ * @struct Struct_PID
+ * @brief État et paramètres d'un correcteur PID.
+ *
+ * Le calcul (PID_calcul) n'utilise aucune fonction matérielle et peut être exécuté sur un PC
+ * contre un modèle simulé de pompe.
+ */
+struct Struct_PID {
+  float Kp = 0;                      ///< Gain proportionnel.
+  float Ki = 0;                      ///< Gain intégral (par seconde).
+  float Kd = 0;                      ///< Gain dérivé (en secondes).
+  float Consigne = 0;                ///< Consigne de pression.
+  float Sortie_min = 0;              ///< Sortie minimale (% PWM).
+  float Sortie_max = 100;            ///< Sortie maximale (% PWM).
+  float Integrale = 0;               ///< Terme intégral accumulé.
+  float Mesure_prec = 0;             ///< Mesure du pas précédent (dérivée sur la mesure).
+  bool Premier = true;               ///< Premier pas de calcul depuis la remise à zéro.
+};
+
+float PID_calcul(Struct_PID *pid, float mesure, float dt);
+void PID_raz(Struct_PID *pid);
+
+void ConfigRegulation(void);
+void Regulation_consigne(float consigne);
+void Regulation_gains(float kp, float ki, float kd);
+bool Regulation_voie_reservee(int voie);
+void affiche_diagnostic_regulation(void);
+void affiche_trace_regulation(void);
@@ -1,10 +1,14 @@
 void setup_wifi();
 void test_connect_wifi(void);
+bool WiFi_connecte(void);
+void affiche_diagnostic_wifi(void);
 
 void setup_web();
 void setup_temps();
+void synchronise_temps();
 
 
 void maj_temps();
+uint64_t temps_epoch_ms(void);
 void ConfigReseau();
 
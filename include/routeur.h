@@ -0,0 +1,50 @@
+/**
+ * @file routeur.h
+ * @brief Fonction de routage des commandes MQTT.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'aiguillage des commandes reçues vers leur gestionnaire, par table de hachage sur le suffixe du topic
+ *
+ */
+
+/// @brief Taille maximale d'un suffixe de route (caractère nul compris)
+#define TAILLE_SUFFIXE_ROUTE 32
+
+/// @brief Commande décodée transmise au gestionnaire (définie par le module appelant)
+struct Struct_Commande;
+
+/// @brief Gestionnaire d'une route
+typedef void (*Gestionnaire_Commande)(Struct_Commande &cmd);
+
+/**
+ * @struct Struct_Route
+ * @brief Entrée de la table de routage.
+ */
+struct Struct_Route {
+  char Suffixe[TAILLE_SUFFIXE_ROUTE];  ///< Suffixe du topic après "<mqttSubscribe1>/".
+  uint32_t Hash = 0;                   ///< Empreinte FNV-1a du suffixe.
+  Gestionnaire_Commande Gestionnaire = NULL; ///< Gestionnaire, NULL si l'entrée est libre.
+  int Voie = 0;                        ///< Argument transmis au gestionnaire (numéro de voie).
+  int Format = 0;                      ///< Format du corps, décodé en champs typés avant l'appel du gestionnaire (défini par le module appelant).
+};
+
+/**
+ * @struct Struct_Routeur
+ * @brief Table de hachage à adressage ouvert (sondage linéaire) des routes.
+ *
+ * La capacité est une puissance de 2 et le taux de remplissage est limité à 3/4 : une recherche
+ * coûte un hachage du suffixe et quelques comparaisons, quel que soit le nombre de routes.
+ */
+struct Struct_Routeur {
+  Struct_Route *Table = NULL;          ///< Table des entrées.
+  int Capacite = 0;                    ///< Nombre d'entrées (puissance de 2).
+  int Nb = 0;                          ///< Nombre de routes enregistrées.
+};
+
+uint32_t Routeur_hash(const char *suffixe);
+void Routeur_init(Struct_Routeur *routeur, Struct_Route *table, int capacite);
+int Routeur_ajoute(Struct_Routeur *routeur, const char *suffixe, Gestionnaire_Commande gestionnaire, int voie, int format);
+const Struct_Route *Routeur_cherche(const Struct_Routeur *routeur, const char *suffixe);
@@ -18,6 +18,7 @@
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
 #include "capteurs.h"
+#include "File_System.h"
 #include "global.h"
 
 
@@ -114,6 +115,39 @@ int getIntValueFromJsonFile(String filePath, String tag1, String tag2, String ta
   return atoi(a.c_str());
 }
 
+/**
+ * @fn float getFloatValueFromJsonFile(String filePath, String tag1, String tag2, String tag3)
+ * @brief Lecture d'une valeur de type flottant depuis un fichier JSON
+ * 
+ * @param filePath Chemin du fichier JSON
+ * @param tag1 Tag de niveau 1 dans la structure JSON
+ * @param tag2 Tag de niveau 2 dans la structure JSON
+ * @param tag3 Tag de niveau 3 dans la structure JSON
+ * 
+ * @return Valeur de la clé spécifiée dans le fichier JSON
+ */
+float getFloatValueFromJsonFile(String filePath, String tag1, String tag2, String tag3) {
+  File file = SPIFFS.open(filePath, "r");
+  if (!file) {
+    Serial.println("Erreur lors de l'ouverture du fichier");
+    return 0;
+  }
+
+  size_t size = file.size();
+  std::unique_ptr<char[]> buf(new char[size]);
+  file.readBytes(buf.get(), size);
+  file.close();
+
+  DynamicJsonDocument doc(8192);
+  DeserializationError error = deserializeJson(doc, buf.get());
+  if (error) {
+    Serial.println("Erreur lors de la désérialisation du fichier JSON");
+    return 0;
+  }
+  String a = doc[tag1][tag2][tag3].as<String>();
+  return atof(a.c_str());
+}
+
 /**
  * @fn void saveDataToFile(float temperature_max, float temperature_min, float pression, int turbine)
  * @brief Sauvegarde des données dans un fichier CSV
@@ -129,17 +163,16 @@ void saveDataToFile(float temperature_max, float temperature_min, float pression
     
     File file = SPIFFS.open("/data.csv", "a");
     if (!file) {
-        // Le fichier n'existe pas, essayez de le créer
+        Serial.println("Failed to create the file");
+        return;
+    }
+    // Le mode "a" crée le fichier s'il n'existe pas : l'en-tête est écrit sur un fichier vide
+    if (file.size() == 0) {
         Serial.println("Création du fichier data.cvs");
-        file = SPIFFS.open("/data.csv", "w");
-        file.printf("Date;Tmax;Tmin;Pression;Turbine\n");
-        if (!file) {
-            Serial.println("Failed to create the file");
-            return;
-        }
+        file.printf("%s\n", ENTETE_HISTORIQUE);
     }
     
-    file.printf("%s;%.2f;%.2f;%.2f;%d\n", currentDayStr, temperature_max, temperature_min, pression);
+    file.printf("%s;%.2f;%.2f;%.2f;%d\n", currentDayStr.c_str(), temperature_max, temperature_min, pression, turbine);
     file.close();
 }
 
@@ -194,6 +227,25 @@ void readFileToSerial(String filepath) {
   file.close();
 }
 
+/**
+ * @fn String readFileToString(String filepath)
+ * @brief Lecture du contenu complet d'un fichier (certificat PEM par exemple)
+ * 
+ * @param filepath Chemin du fichier à lire
+ * 
+ * @return Contenu du fichier, vide si le fichier n'existe pas
+ */
+String readFileToString(String filepath) {
+  File file = SPIFFS.open(filepath, "r");
+  if (!file) {
+    Serial.println("Impossible d'ouvrir le fichier " + filepath);
+    return String();
+  }
+  String contenu = file.readString();
+  file.close();
+  return contenu;
+}
+
 /**
  * @fn void modifFileToSerial(String filepath)
  * @brief Modification d'une ligne spécifique dans un fichier
@@ -10,8 +10,9 @@
  *
  */
 
-#include <PubSubClient.h>
 #include <WiFi.h>
+#include "lwip/sockets.h"
+#include "lwip/dns.h"
 #include <ESPAsyncWebServer.h>
 #include "ArduinoJson.h"
 #include "Fonctions_MQTT.h"
@@ -19,6 +20,16 @@
 #include "reseau_serveur.h"
 #include "File_System.h"
 #include "GPIO.h"
+#include "planificateur.h"
+#include "regulation.h"
+#include "routeur.h"
+#include "file_attente.h"
+#include "debit.h"
+#include "client_tls.h"
+#include "client_mqtt.h"
+#include "pool_commandes.h"
+#include "publication.h"
+#include "api_rest.h"
 #include "global.h"
 
 
@@ -32,21 +43,36 @@
  */
 WiFiClient espClient;
 
-// Déclaration de l'objet PubSubClient pour la communication MQTT
+// Déclaration de l'objet ClientMQTT pour la communication MQTT
 /**
- * @var PubSubClient client(espClient)
- * @brief Objet PubSubClient pour la communication MQTT.
+ * @var ClientMQTT client(espClient)
+ * @brief Objet ClientMQTT pour la communication MQTT (3.1.1 ou 5 selon MQTT_version).
  *
  * Cet objet est utilisé pour la communication avec le serveur MQTT.
  * Il utilise un client WiFi (espClient) pour établir la connexion MQTT.
  */
-PubSubClient client(espClient);
+ClientMQTT client(espClient);
+
+/**
+ * @var ClientTLS Client_TLS
+ * @brief Client TLS utilisé à la place d'espClient quand MQTT_TLS est activé.
+ *
+ * La session TLS est conservée entre deux reconnexions pour éviter un nouvel échange de clé.
+ */
+ClientTLS Client_TLS;
+
+/**
+ * @var bool EnableTLS
+ * @brief Connexion chiffrée au serveur MQTT.
+ */
+bool EnableTLS = false;
 
 /**
  * @var String mqtt_server
  * @brief Adresse IP ou nom de domaine du serveur MQTT.
  *
  * Cette variable stocke l'adresse du serveur MQTT avec lequel l'appareil ESP32 doit se connecter.
+ * Avec plusieurs serveurs configurés, c'est le serveur actif de Tab_Serveurs_MQTT.
  */
 String mqtt_server;
 
@@ -79,6 +105,8 @@ String mqttPassword;
  * @brief Identifiant du client MQTT.
  *
  * Cette variable stocke l'identifiant du client MQTT utilisé lors de la connexion au serveur MQTT.
+ * La session est persistante (voir demarre_session_MQTT) : l'identifiant doit rester le même d'une
+ * connexion et d'un démarrage à l'autre. À défaut de MQTT_client, il est dérivé de l'adresse MAC.
  */
 String mqttClient;
 
@@ -170,432 +198,2596 @@ unsigned long lastValPortUpdate[] = {0, 0, 0, 0, 0, 0, 0, 0};
  */
 long timeOut[] = {60, 60, 60, 60, 60, 60, 60, 60};
 
-extern Struct_GPIO Telemetre;
-extern Struct_GPIO Tab_PT100[4];
-extern Struct_GPIO Tab_Sonde[4];
-extern Struct_GPIO Tab_GPIO_OUT[8];
-extern Struct_GPIO Tab_GPIO_IN[8];
-extern Struct_GPIO Tab_GPIO_ANA[8];
-extern Struct_IMP Tab_Impulsion[2];
+extern Struct_Canal_MQTT Tab_Canal_MQTT[NB_CANAUX_MQTT];
+extern Struct_Bande_Morte Tab_Bande_Morte[NB_FAMILLES];
+extern char Tab_Topics_MQTT[NB_TOPICS_MQTT][TAILLE_TOPIC_MQTT];
+extern uint32_t Version_Topics_MQTT;
 
 /**
- * @fn void mqtt_service_setup()
- * @brief Configuration du service MQTT.
- *
- * Initialise et configure la connexion au serveur MQTT ainsi que les topics MQTT.
+ * @var const char *Nom_Famille[]
+ * @brief Préfixe des clés de bande morte dans MQTT.json (MQTT/Bande_morte/<nom>_abs et <nom>_rel).
  */
-void mqtt_service_setup(){
-  if(!EnableMQTT){return;}
-   Serial.println();
-   Serial.println(F("============================================================================================"));
-   Serial.println("Initialisation du serveur MQTT");
-   Serial.println(F("============================================================================================")); 
-
-   mqtt_server = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_serveur");
-   mqtt_port = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_port");
-   mqttUser = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_user");
-   mqttPassword = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_password");
-   mqttClient = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_client");
-   mqttSubscribe1 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_subscribe_1");
-   mqttSubscribe1_full = mqttSubscribe1+"/#";
-   mqttPublish_s1_ext_out = mqttSubscribe1+"_ext_out/#";
-   mqttPublish_s1_meteo = mqttSubscribe1+"_meteo";
-   mqttSubscribe2 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_subscribe_2");
-   mqttPublish_s2 = mqttSubscribe2+"_out/#";
-   mqttPublish1 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_publish_1");
-   mqttPublish2 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_publish_2");
-   
-  client.setServer(mqtt_server.c_str(), (uint16_t)mqtt_port);
-  client.setCallback(callback);
-
-  reconnect();
-}
+const char *Nom_Famille[NB_FAMILLES] = {"TOR", "GPIO_ANA", "PT100", "Sonde", "Impulsion", "Telemetre", "Meteo", "User"};
 
 /**
- * @fn void reconnect()
- * @brief Fonction de reconnexion au serveur MQTT.
- *
- * Cette fonction tente de se reconnecter au serveur MQTT en cas de déconnexion.
+ * @var int periodeRafraichissement
+ * @brief Période de republication complète de tous les canaux, en secondes.
  */
-void reconnect() {
-  if(!EnableMQTT){return;}
-  while (!client.connected()) {
-    Serial.print("Tentative de connexion au serveur MQTT " + mqtt_server + ":" + mqtt_port + " ...");
-    if (client.connect(mqttClient.c_str())) {
-      Serial.println("> Connecté au client " + mqttClient);
-
-      client.subscribe(mqttSubscribe1_full.c_str());
-      Serial.println("Souscription au canal " + mqttSubscribe1_full);
-
-      client.subscribe(mqttSubscribe2.c_str());
-      Serial.println("Souscription au canal " + mqttSubscribe2);
-
-    } else {
-      Serial.print("échec, code d'erreur = ");
-      Serial.print(client.state());
-      Serial.println("réessayer dans 5 secondes");
-      delay(5000);
-    }
-  }
-}
+int periodeRafraichissement = 300;
 
 /**
- * @fn void callback(char *topic, byte *payload, unsigned int length)
- * @brief Fonction de rappel appelée lorsqu'un message MQTT est reçu.
- *
- * @param topic Topic MQTT sur lequel le message a été reçu.
- * @param payload Données du message.
- * @param length Longueur des données du message.
+ * @var unsigned long dernierRafraichissement
+ * @brief Instant (millis) du dernier rafraîchissement complet, 0 tant qu'aucun n'a eu lieu.
  */
-void callback(char* topic, byte* payload, unsigned int length) {
-  if(!EnableMQTT){return;}
-
-  Serial.print("Message reçu sur le topic: ");
-  Serial.println(topic);
-  
-  char message[length + 1];
-  memcpy(message, payload, length);
-  message[length] = '\0';
-
-  Serial.print("Message reçu : ");
-  Serial.println(message);
-
-  update_Subscribe1(mqttSubscribe1.c_str(), topic, (char*)payload, length);
-}
+unsigned long dernierRafraichissement = 0;
 
 /**
- * @fn void publish_1()
- * @brief Fonction de publication de données sur le canal 1 MQTT.
- *
- * Cette fonction construit et publie un message MQTT avec des données factices.
+ * @var volatile bool Publication_demandee
+ * @brief Une sortie a changé : les changements sont publiés au prochain passage dans loop_MQTT().
  */
-void publish_1() {
-  if(!EnableMQTT){return;}
-  // Construction du message MQTT
-  char messageBuffer[200];
-  DynamicJsonDocument jsonDoc(200); // Ajustez la taille en fonction de vos besoins
-
-  jsonDoc["variable1"] = 0;
-  jsonDoc["variable2"] = 0;
-  jsonDoc["variable3"] = 0;
-
-  serializeJson(jsonDoc, messageBuffer);
-
-  // Publication
-  client.publish(mqttPublish1.c_str(), messageBuffer);
-}
+volatile bool Publication_demandee = false;
 
 /**
- * @fn void publish_2()
- * @brief Fonction de publication de données sur le canal 2 MQTT.
- *
- * Cette fonction construit et publie un message MQTT avec des données factices.
+ * @var bool modeDocument
+ * @brief Mode de publication agrégé : un seul document JSON par cycle au lieu d'un topic par valeur.
  */
-void publish_2() {
-  if(!EnableMQTT){return;}
-  // Construction du message MQTT
-  char messageBuffer[200];
-  DynamicJsonDocument jsonDoc(200); // Ajustez la taille en fonction de vos besoins
-
-  jsonDoc["variable1"] = 0;
-  jsonDoc["variable2"] = 0;
-  jsonDoc["variable3"] = 0;
-
-  serializeJson(jsonDoc, messageBuffer);
+bool modeDocument = false;
 
-  // Publication
-  client.publish(mqttPublish2.c_str(), messageBuffer);
-}
+/**
+ * @enum Encodage_MQTT
+ * @brief Encodage des messages publiés et des commandes reçues.
+ */
+enum Encodage_MQTT {
+  ENCODAGE_JSON = 0,                 ///< Texte JSON.
+  ENCODAGE_MSGPACK                   ///< MessagePack binaire (même structure que le JSON).
+};
 
 /**
- * @fn void publish_s1()
- * @brief Fonction de publication des variables de l'ESP sur le canal 1 MQTT.
- * Cette fonction publie les données suivantes ;
- * - La 8 voies de l'extention PCF8574 sur    _out/PCF8574_OUT_1_
- * - La valeur des 8 GPIO OUT sur             _out/GPIO_OUT_x/Valeur
- * - La valeur des 8 GPIO IN sur              _out/GPIO_IN_x/Valeur
- * - La valeur des 8 GPIO ANA sur             _out/GPIO_ANA_x/Valeur
- * - La valeur des 4 PT100 sur                _out/PT100_x/Valeur
- * - La valeur des 4 Sondes sur               _out/Sonde_x/Valeur
- * - La valeur des 2 capteurs d'impulsion sur _out/Impulsion_x/{Cumul,Imp_par_sec,Imp_par_min}
- * - La valeur du télémètre sur               _out/Telemetre/Valeur
- * - Les valeurs des données météo   sur      _out/Telemetre/{temperature,temperature max,temperature min,pressure,humidity}
- * - La valeur des User sur                   _out/User/{INT,LONG,FLOAT}
- * 
- * @param void
- * @return void
+ * @var int Encodage_Famille[]
+ * @brief Encodage de publication par famille de canaux, lu dans MQTT.json (MQTT/Encodage/<famille>).
  */
-void publish_s1() {
-  if(!EnableMQTT){return;}
+int Encodage_Famille[NB_FAMILLES];
 
-  DEBUG_PRINT_MQTT("Fonction publish_s1");
+/**
+ * @var int Encodage_Etat
+ * @brief Encodage du document agrégé (MQTT/Encodage/Etat).
+ */
+int Encodage_Etat = ENCODAGE_JSON;
 
-  char messageBuffer[400];
-  DynamicJsonDocument jsonDoc(512); // Ajustez la taille en fonction de vos besoins
-  String Adress_Publication;
+/**
+ * @var int Encodage_Publish_1
+ * @brief Encodage des messages de publish_1 (MQTT/Encodage/Publish_1).
+ */
+int Encodage_Publish_1 = ENCODAGE_JSON;
 
-  /// @brief Construction du message MQTT vers PCF8574_OUT_1_x (x compris entre 1 et 8)
-  for(int i=0; i<7; i++){
-    /// @brief Ajoutez des données au JSON
-    jsonDoc["port_status"] = Tab_PCF8574_OUT_1[i];
+/**
+ * @var const char *Cle_Voie[]
+ * @brief Clés JSON des numéros de voie ("1" à "16"), en chaînes constantes non copiées par ArduinoJson.
+ */
+const char *Cle_Voie[16] = {"1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16"};
 
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @var const char *Cle_Index[]
+ * @brief Clés JSON des index de servomoteur et de PWM ("0" à "3"), numérotés comme num_servo et num_pwm.
+ */
+const char *Cle_Index[4] = {"0", "1", "2", "3"};
 
-    /// @brief Publication du message sur le topic _out/PCF8574_OUT_1_x (x compris entre 1 et 8)
-    Adress_Publication = mqttSubscribe1+"_out/PCF8574_OUT_1_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @var uint32_t sequenceDocument
+ * @brief Numéro de séquence du dernier document agrégé publié sur MQTT (voir publish_s1_document).
+ */
+uint32_t sequenceDocument = 0;
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @var StaticJsonDocument docEtat
+ * @brief Document agrégé, alloué statiquement pour ne pas solliciter le tas à chaque cycle.
+ */
+StaticJsonDocument<4096> docEtat;
 
-    jsonDoc.clear();
-  } 
+/**
+ * @var uint32_t Empreinte_Etat
+ * @brief Empreinte des valeurs du dernier document agrégé retenu (hors numéro de séquence et horodatage).
+ */
+uint32_t Empreinte_Etat = 0;
 
-  /// @brief  Balayage des sorties GPIO digital
-  for(int i=0; i<7; i++){
-    jsonDoc["Valeur"] = Tab_GPIO_OUT[i].Valeur;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @var bool Republication_complete
+ * @brief Republication retenue de tout l'état demandée après une (re)connexion.
+ */
+bool Republication_complete = false;
 
-    /// @brief  Publication du message sur le topic _out/GPIO_OUT_x (x compris entre 1 et 8)
-    Adress_Publication = mqttSubscribe1+"_out/GPIO_OUT_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @class Empreinte_FNV
+ * @brief Sortie de sérialisation calculant l'empreinte FNV-1a des octets écrits, sans tampon.
+ */
+class Empreinte_FNV : public Print {
+ public:
+  uint32_t Valeur = 2166136261UL;
+  using Print::write;
+  size_t write(uint8_t octet) override {
+    Valeur ^= octet;
+    Valeur *= 16777619UL;
+    return 1;
+  }
+};
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @struct Struct_Stat_MQTT
+ * @brief Compteurs de trafic de publication, pour comparer les modes topic et document.
+ */
+struct Struct_Stat_MQTT {
+  unsigned long Messages_cycle = 0;  ///< Messages publiés au dernier cycle.
+  unsigned long Octets_cycle = 0;    ///< Octets de paquets PUBLISH émis au dernier cycle.
+  unsigned long Octets_topics_cycle = 0;  ///< Dont octets de topics au dernier cycle.
+  unsigned long Messages_total = 0;  ///< Messages publiés depuis le démarrage.
+  unsigned long Octets_total = 0;    ///< Octets émis depuis le démarrage.
+  unsigned long Octets_max = 0;      ///< Taille du plus grand paquet PUBLISH.
+  unsigned long Cycles = 0;          ///< Nombre de cycles de publication.
+  unsigned long Echecs = 0;          ///< Publications interrompues (déconnexion pendant l'envoi).
+  uint32_t Tas_publication_max = 0;  ///< Plus forte consommation de tas d'une publication (tas libre avant l'en-tête moins tas libre après le dernier octet).
+  uint32_t Pile_libre_min = 0;       ///< Plus petite marge de pile de la tâche de publication (octets).
+};
+
+Struct_Stat_MQTT Stat_MQTT;
 
-    jsonDoc.clear();
-  }
+/**
+ * @enum Etat_Connexion_MQTT
+ * @brief État de la machine de connexion au serveur MQTT.
+ */
+enum Etat_Connexion_MQTT {
+  MQTT_ATTENTE = 0,                  ///< Déconnecté, attente de la prochaine tentative.
+  MQTT_RESOLUTION_DNS,               ///< Résolution DNS du serveur en cours.
+  MQTT_CONNEXION_TCP,                ///< Connexion TCP non bloquante en cours.
+  MQTT_HANDSHAKE_TLS,                ///< Poignée de main TLS non bloquante en cours.
+  MQTT_SESSION,                      ///< CONNECT émis, CONNACK attendu.
+  MQTT_CONNECTE                      ///< Connecté au serveur.
+};
 
-   /// @brief  Balayage des entrées GPIO digital
-  for(int i=0; i<7; i++){
-    jsonDoc["Valeur"] = Tab_GPIO_IN[i].Valeur;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @struct Struct_Connexion_MQTT
+ * @brief Paramètres, état et compteurs de la connexion au serveur MQTT.
+ */
+struct Struct_Connexion_MQTT {
+  unsigned long Attente_min_ms = 1000;    ///< Attente avant la première nouvelle tentative.
+  unsigned long Attente_max_ms = 60000;   ///< Attente maximale entre deux tentatives.
+  unsigned long Timeout_ms = 3000;        ///< Durée maximale de la résolution DNS puis de la connexion TCP.
+  unsigned long Timeout_TLS_ms = 10000;   ///< Durée maximale de la poignée de main TLS.
+  unsigned long Timeout_session_ms = 5000;  ///< Durée maximale d'attente du CONNACK.
+  uint32_t Expiration_session_s = 86400;  ///< Conservation de la session par le serveur après une coupure (MQTT 5).
+  int Etat = MQTT_ATTENTE;                ///< État courant (Etat_Connexion_MQTT).
+  int Socket = -1;                        ///< Socket de la connexion TCP en cours.
+  unsigned long Attente_ms = 0;           ///< Attente courante (doublée à chaque échec).
+  unsigned long Prochaine_tentative = 0;  ///< Instant (millis) de la prochaine tentative.
+  unsigned long Debut_tentative = 0;      ///< Instant (millis) du début de la tentative en cours.
+  unsigned long Debut_coupure = 0;        ///< Instant (millis) de la perte de connexion.
+  unsigned long Tentatives = 0;           ///< Tentatives de connexion.
+  unsigned long Connexions = 0;           ///< Connexions réussies.
+  unsigned long Coupures = 0;             ///< Pertes de connexion.
+  unsigned long Coupure_cumul_ms = 0;     ///< Durée cumulée des coupures.
+  unsigned long Coupure_max_ms = 0;       ///< Durée de la plus longue coupure.
+};
+
+Struct_Connexion_MQTT Connexion_MQTT;
 
-    /// @brief  Publication du message sur le topic _out/GPIO_IN_x (x compris entre 1 et 8)
-    Adress_Publication = mqttSubscribe1+"_out/GPIO_IN_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @struct Struct_Rejeu
+ * @brief Paramètres et compteurs du rejeu de la file d'attente après une coupure.
+ */
+struct Struct_Rejeu {
+  int Par_seconde = 10;              ///< Nombre maximal de messages rejoués par seconde.
+  unsigned long Debut_fenetre = 0;   ///< Début (millis) de la fenêtre d'une seconde en cours.
+  int Nb_fenetre = 0;                ///< Messages rejoués dans la fenêtre en cours.
+  unsigned long Rejoues = 0;         ///< Messages rejoués depuis le démarrage.
+  unsigned long Retard_ms = 0;       ///< Retard du dernier message rejoué sur son acquisition.
+  unsigned long Retard_max_ms = 0;   ///< Retard maximal d'un message rejoué.
+  unsigned long Obsoletes = 0;       ///< Messages écartés : table des topics modifiée depuis leur mise en file.
+  bool Tete_differee = false;        ///< Le message en tête de file a déjà été refusé par la régulation de débit.
+};
+
+Struct_Rejeu Rejeu;
+
+/// @brief Nombre maximal de serveurs MQTT (le serveur préféré MQTT_serveur puis les serveurs de secours)
+#define NB_SERVEURS_MQTT 4
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @struct Struct_Serveur_MQTT
+ * @brief Serveur MQTT de la liste ordonnée et son état de santé.
+ */
+struct Struct_Serveur_MQTT {
+  String Hote;                            ///< Adresse IP ou nom de domaine.
+  int Port = 1883;                        ///< Port.
+  unsigned long Echecs_consecutifs = 0;   ///< Tentatives échouées depuis la dernière connexion réussie.
+  unsigned long Echecs = 0;               ///< Tentatives échouées depuis le démarrage.
+  unsigned long Connexions = 0;           ///< Connexions réussies.
+  unsigned long Derniere_connexion = 0;   ///< Instant (millis) de la dernière connexion réussie.
+  IPAddress Ip;                           ///< Dernière adresse résolue, reprise si le DNS ne répond pas.
+};
+
+Struct_Serveur_MQTT Tab_Serveurs_MQTT[NB_SERVEURS_MQTT];
+int Nb_Serveurs_MQTT = 1;
+int Serveur_actif = 0;
 
-    jsonDoc.clear();
-  } 
+/**
+ * @struct Struct_Bascule_MQTT
+ * @brief Surveillance du serveur préféré et mesure des bascules entre serveurs.
+ */
+struct Struct_Bascule_MQTT {
+  unsigned long Retour_periode_ms = 30000;  ///< Période de sondage du serveur préféré depuis un serveur de secours.
+  int Retour_sondes = 3;                    ///< Sondes réussies consécutives avant de revenir au serveur préféré.
+  int Sonde = -1;                           ///< Socket de la sonde TCP en cours.
+  bool Resolution = false;                  ///< Résolution DNS de la sonde en cours.
+  unsigned long Debut_sonde = 0;            ///< Instant (millis) du lancement de la sonde en cours.
+  unsigned long Prochaine_sonde = 0;        ///< Instant (millis) de la prochaine sonde.
+  int Sondes_ok = 0;                        ///< Sondes réussies consécutives.
+  int Serveur_precedent = 0;                ///< Serveur connecté avant la perte de connexion ou le retour.
+  unsigned long Debut_bascule = 0;          ///< Instant (millis) de la perte du serveur ou de la décision de retour.
+  unsigned long Bascules = 0;               ///< Connexions établies sur un autre serveur que le précédent.
+  unsigned long Retours = 0;                ///< Retours volontaires au serveur préféré.
+  unsigned long Bascule_ms = 0;             ///< Durée de la dernière bascule (perte -> souscriptions rétablies).
+  unsigned long Bascule_max_ms = 0;         ///< Durée maximale d'une bascule.
+};
+
+Struct_Bascule_MQTT Bascule_MQTT;
+
+/// @brief État d'une résolution DNS lancée par lance_resolution_dns
+enum Etat_Resolution_DNS {
+  DNS_ECHEC = -1,                    ///< Nom inconnu ou pas de réponse du serveur DNS.
+  DNS_EN_COURS = 0,                  ///< Requête DNS en cours.
+  DNS_RESOLU = 1                     ///< Adresse disponible.
+};
 
-  /// @brief  Balayage des entrées GPIO Analog
-  for(int i=0; i<7; i++){
-    jsonDoc["Valeur"] = Tab_GPIO_ANA[i].Valeur;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @struct Struct_Resolution_DNS
+ * @brief Résolution DNS non bloquante d'un serveur MQTT (dns_gethostbyname de lwIP).
+ *
+ * Le résultat est écrit par le rappel de lwIP, dans la tâche TCP/IP : Etat n'est passé à DNS_RESOLU
+ * ou DNS_ECHEC qu'après l'écriture de l'adresse.
+ */
+struct Struct_Resolution_DNS {
+  char Hote[64];                     ///< Nom en cours de résolution (un rappel pour un autre nom est ignoré).
+  volatile uint32_t Ip = 0;          ///< Adresse résolue (ordre réseau).
+  volatile int Etat = DNS_ECHEC;     ///< État (Etat_Resolution_DNS).
+};
 
-    /// @brief  Publication du message sur le topic _out/GPIO_ANA_x (x compris entre 1 et 8)
-    Adress_Publication = mqttSubscribe1+"_out/GPIO_ANA_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+Struct_Resolution_DNS Resolution_connexion;
+Struct_Resolution_DNS Resolution_sonde;
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @var uint8_t Tampon_differe[]
+ * @brief Tampon de sérialisation d'un message mis en file ou rejoué.
+ */
+uint8_t Tampon_differe[TAILLE_MESSAGE_DIFFERE];
 
-    jsonDoc.clear();
-  } 
+/// @brief Taille maximale d'un identifiant de commande mémorisé
+#define TAILLE_ID_COMMANDE 24
 
+/// @brief Taille maximale du nom de groupe d'une requête d'état
+#define TAILLE_GROUPE_REQUETE 24
 
-  /// @brief  Balayage des PT100
-  for(int i=0; i<4; i++){
-    jsonDoc["Valeur"] = Tab_PT100[i].Valeur;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @enum Format_Commande
+ * @brief Format du corps d'une route, décodé en champs typés de Struct_Commande avant l'appel du gestionnaire.
+ */
+enum Format_Commande {
+  FORMAT_VIDE = 0,                   ///< Aucun champ propre à la route.
+  FORMAT_PCF8574,                    ///< {"val_port": 0|1}, la sortie est la voie de la route.
+  FORMAT_GPIO_OUT,                   ///< {"num_port": n, "val_port": v}.
+  FORMAT_SERVO,                      ///< {"num_servo": n, "val_servo": v}.
+  FORMAT_PWM,                        ///< {"num_pwm": n, "val_pwm": v}.
+  FORMAT_REGULATION,                 ///< {"consigne": c, "Kp": p, "Ki": i, "Kd": d}, champs optionnels.
+  FORMAT_LOT,                        ///< Lot de sorties (voir commande_Lot).
+  FORMAT_REQUETE                     ///< {"groupe": "GPIO_OUT"}, champ optionnel.
+};
 
-    /// @brief  Publication du message sur le topic _out/PT100_x (x compris entre 1 et 4)
-    Adress_Publication = mqttSubscribe1+"_out/PT100_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @struct Struct_Commande
+ * @brief Commande reçue, décodée une seule fois en champs typés avant l'appel du gestionnaire de sa route.
+ */
+struct Struct_Commande {
+  int Voie = 0;                      ///< Argument de la route (numéro de voie).
+  int Num = 0;                       ///< Numéro de sortie ("num_port", "num_servo", "num_pwm", voie de la route pour PCF8574_OUT_1_x).
+  int Val = 0;                       ///< Valeur demandée ("val_port", "val_servo", "val_pwm").
+  float Consigne = NAN;              ///< Consigne de régulation, NAN si absente.
+  float Kp = NAN;                    ///< Gain proportionnel, NAN si absent (gain conservé).
+  float Ki = NAN;                    ///< Gain intégral, NAN si absent.
+  float Kd = NAN;                    ///< Gain dérivé, NAN si absent.
+  Struct_Lot_Sorties Lot;            ///< Sorties d'une commande Lot.
+  char Groupe[TAILLE_GROUPE_REQUETE] = "";  ///< Groupe demandé par une requête d'état, vide pour le document complet.
+  char Id[TAILLE_ID_COMMANDE] = "";  ///< Identifiant optionnel ("id"), vide si absent.
+  bool Planifiee = false;            ///< La commande porte un champ "delai" ou "at".
+  int64_t Delai_us = 0;              ///< Délai avant exécution en µs si la commande est planifiée.
+  int Encodage = ENCODAGE_JSON;      ///< Encodage de la commande, repris pour l'acquittement.
+  int64_t Reception_us = 0;          ///< Instant de réception (esp_timer).
+  int64_t Application_us = 0;        ///< Instant d'application ou de planification (esp_timer).
+  int Resultat = -1;                 ///< 1 appliquée, 0 refusée, -1 non renseigné par le gestionnaire.
+  int Valeur = 0;                    ///< Valeur appliquée à la sortie.
+  bool Repondue = false;             ///< Le gestionnaire a déjà publié sa réponse (requête) : pas d'acquittement.
+  const char *Erreur = NULL;         ///< Motif du refus renseigné par le gestionnaire, repris dans l'acquittement.
+};
+
+/// @brief Nombre d'identifiants de commande mémorisés pour la déduplication
+#define NB_ID_COMMANDE 16
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @struct Struct_Id_Commande
+ * @brief Identifiant d'une commande déjà exécutée et son résultat.
+ */
+struct Struct_Id_Commande {
+  char Id[TAILLE_ID_COMMANDE];       ///< Identifiant de la commande ("id").
+  uint32_t Usage;                    ///< Rang de dernière utilisation (0 : entrée libre).
+  int Resultat;                      ///< Résultat de l'exécution.
+  int Valeur;                        ///< Valeur appliquée.
+};
 
-    jsonDoc.clear();
-  } 
+/// @brief Marque de validité de la fenêtre de déduplication en mémoire RTC
+#define MAGIQUE_ID_COMMANDE 0x49443143UL
 
-    /// @brief  Balayage des Sondes
-  for(int i=0; i<4; i++){
-    jsonDoc["Valeur"] = Tab_Sonde[i].Valeur;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @var Struct_Id_Commande Tab_Id_Commande[]
+ * @brief Derniers identifiants de commande exécutés (remplacement du moins récemment utilisé).
+ *
+ * Une commande QoS 1 peut être redélivrée par le serveur : une commande déjà vue n'est pas
+ * réexécutée, son acquittement est renvoyé avec le résultat d'origine. La table est en mémoire RTC
+ * non initialisée : elle survit à un redémarrage logiciel, un chien de garde ou une veille profonde,
+ * pendant lesquels le serveur conserve la session persistante. Elle est perdue à une coupure
+ * d'alimentation : une commande redélivrée après une coupure d'alimentation est réappliquée.
+ */
+RTC_NOINIT_ATTR Struct_Id_Commande Tab_Id_Commande[NB_ID_COMMANDE];
 
-    /// @brief  Publication du message sur le topic _out/Sonde_x (x compris entre 1 et 4)
-    Adress_Publication = mqttSubscribe1+"_out/Sonde_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/// @brief Compteur de rang d'utilisation des identifiants
+RTC_NOINIT_ATTR uint32_t Usage_Id_Commande;
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/// @brief MAGIQUE_ID_COMMANDE si Tab_Id_Commande est valide
+RTC_NOINIT_ATTR uint32_t Magique_Id_Commande;
 
-    jsonDoc.clear();
-  } 
+/// @brief Instant de réception (esp_timer) du message en cours de traitement
+int64_t Reception_commande_us = 0;
 
-    /// @brief  Balayage des Impulsions
-  for(int i=0; i<2; i++){
-    jsonDoc["Cumul"] = Tab_Impulsion[i].Valeur_Cumul;
-    jsonDoc["Imp_par_sec"] = Tab_Impulsion[i].Valeur_ps;
-    jsonDoc["Imp_par_min"] = Tab_Impulsion[i].Valeur_pmin;
-    serializeJson(jsonDoc, messageBuffer);
+/**
+ * @struct Struct_Reponse
+ * @brief Topic de réponse et donnée de corrélation de la commande en cours de traitement.
+ *
+ * Propriétés MQTT 5 Response Topic / Correlation Data de la commande, conservées dans son emplacement du pool :
+ * l'acquittement, ou la réponse d'une requête, est publié sur ce topic avec la même Correlation Data.
+ * En MQTT 3.1.1, la commande n'a pas de propriétés : l'acquittement part sur _out/Ack.
+ */
+struct Struct_Reponse {
+  char Topic[TAILLE_TOPIC_MQTT];     ///< Topic de réponse, vide pour _out/Ack.
+  uint8_t Correlation[TAILLE_CORRELATION_MQTT];  ///< Donnée de corrélation (binaire).
+  uint16_t Taille_correlation;       ///< Taille de la donnée de corrélation, 0 si absente.
+  bool Etat_sorties;                 ///< Joindre l'état combiné des sorties à l'acquittement (commande Lot).
+};
 
-    /// @brief  Publication du message sur le topic _out/Impulsion_x (x compris entre 1 et 2)
-    Adress_Publication = mqttSubscribe1+"_out/Impulsion_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+Struct_Reponse Reponse_commande;
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/// @brief Nombre d'acquittements conservés lorsque la régulation de débit les refuse
+#define NB_ACK_DIFFERES 4
 
-    jsonDoc.clear();
-  } 
+/// @brief Taille maximale d'un acquittement conservé
+#define TAILLE_ACK_DIFFERE 384
 
-  /// @brief  Balayage du Télémetre
-  jsonDoc["Valeur"] = Telemetre.Valeur;
-  serializeJson(jsonDoc, messageBuffer);
+/**
+ * @struct Struct_Ack_Differe
+ * @brief Acquittement sérialisé, en attente de jetons de la classe Ack.
+ */
+struct Struct_Ack_Differe {
+  char Topic[TAILLE_TOPIC_MQTT];     ///< Topic de l'acquittement (_out/Ack ou topic de réponse).
+  uint8_t Correlation[TAILLE_CORRELATION_MQTT];  ///< Correlation Data de la commande acquittée.
+  uint16_t Taille_correlation;       ///< Taille de la donnée de corrélation, 0 si absente.
+  uint16_t Taille;                   ///< Taille du message.
+  uint8_t Message[TAILLE_ACK_DIFFERE];  ///< Message dans l'encodage de la commande.
+};
 
-  /// @brief  Publication du message sur le topic _out/Telemetre
-  Adress_Publication = mqttSubscribe1+"_out/Telemetre";
-  client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @struct Struct_File_Ack
+ * @brief File des acquittements refusés par la régulation de débit, réémis dans l'ordre.
+ */
+struct Struct_File_Ack {
+  Struct_Ack_Differe Tab[NB_ACK_DIFFERES];  ///< Acquittements en attente.
+  int Tete = 0;                      ///< Position du plus ancien acquittement.
+  int Nb = 0;                        ///< Acquittements en attente.
+  unsigned long Differes = 0;        ///< Acquittements mis en attente.
+  unsigned long Reemis = 0;          ///< Acquittements réémis depuis la file.
+  unsigned long Perdus = 0;          ///< Acquittements perdus (file pleine ou acquittement trop grand).
+};
 
-  jsonDoc.clear();
-  
-  /// @brief  Publication des informations météo 
-  jsonDoc["temperature_1"] = Temperature(0);
-  jsonDoc["temperature_2"] = Temperature(1);
-  jsonDoc["temperature_max"] = Temperature_max();
-  jsonDoc["temperature_min"] = Temperature_min();
-  jsonDoc["pressure"] = Pression();
-  jsonDoc["humidity"] = Humidite();
+Struct_File_Ack File_Ack;
 
-  serializeJson(jsonDoc, messageBuffer);
+/// @brief Nombre d'entrées de la table de routage (puissance de 2, remplie au plus aux 3/4)
+#define NB_ENTREES_ROUTEUR 64
 
-  /// @brief  Publication du message sur le topic _out/Meteo
-  Adress_Publication = mqttSubscribe1+"_out/Meteo";
-  client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @var Struct_Route Table_Routes_MQTT[]
+ * @brief Table de hachage des routes de commande.
+ */
+Struct_Route Table_Routes_MQTT[NB_ENTREES_ROUTEUR];
 
-  DEBUG_PRINT_MQTT(Adress_Publication);
-  DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @var Struct_Routeur Routeur_MQTT
+ * @brief Routeur des commandes reçues sur <mqttSubscribe1>/#.
+ */
+Struct_Routeur Routeur_MQTT;
 
-  jsonDoc.clear();
+/**
+ * @struct Struct_Stat_Routeur
+ * @brief Compteurs d'aiguillage des commandes.
+ */
+struct Struct_Stat_Routeur {
+  unsigned long Routees = 0;         ///< Commandes aiguillées vers un gestionnaire.
+  unsigned long Inconnues = 0;       ///< Topics sans route.
+  unsigned long Erreurs = 0;         ///< Commandes non décodables.
+  unsigned long Recherches = 0;      ///< Recherches dans la table de routage.
+  unsigned long Doublons = 0;        ///< Commandes redélivrées non réappliquées.
+  uint64_t Cycles_cumul = 0;         ///< Cycles processeur cumulés de recherche de route.
+  uint32_t Cycles_max = 0;           ///< Cycles processeur de la recherche de route la plus longue.
+};
+
+Struct_Stat_Routeur Stat_Routeur;
 
-  /// @brief  Balayage des User
-  for(int i=0; i<16; i++){
-    jsonDoc["INT"] = Tab_Info_USER[i].Val_INT;
-    jsonDoc["LONG"] = Tab_Info_USER[i].Val_LONG;
-    jsonDoc["FLOAT"] = Tab_Info_USER[i].Val_FLOAT;
-    serializeJson(jsonDoc, messageBuffer);
+extern Struct_GPIO Telemetre;
+extern Struct_GPIO Tab_PT100[4];
+extern Struct_GPIO Tab_Sonde[4];
+extern Struct_GPIO Tab_GPIO_OUT[8];
+extern Struct_GPIO Tab_GPIO_IN[8];
+extern Struct_GPIO Tab_GPIO_ANA[8];
+extern Struct_IMP Tab_Impulsion[2];
 
-    /// @brief  Publication du message sur le topic _out/User_x (x compris entre 1 et 16)
-    Adress_Publication = mqttSubscribe1+"_out/User_"+(i+1);
-    client.publish(Adress_Publication.c_str(), messageBuffer);
+/**
+ * @fn int lit_encodage(const char *cle)
+ * @brief Lecture d'un encodage de publication dans MQTT.json (MQTT/Encodage/<cle>).
+ *
+ * @param cle Nom de la famille ou du flux ("GPIO_ANA", "Etat", "Publish_1"...).
+ * @return ENCODAGE_MSGPACK si la valeur est "msgpack", ENCODAGE_JSON sinon.
+ */
+int lit_encodage(const char *cle) {
+  String valeur = getStringValueFromJsonFile("/MQTT.json", "MQTT", "Encodage", cle);
+  return (valeur == "msgpack") ? ENCODAGE_MSGPACK : ENCODAGE_JSON;
+}
 
-    DEBUG_PRINT_MQTT(Adress_Publication);
-    DEBUG_PRINT_MQTT(messageBuffer);
+/**
+ * @fn size_t mesure_message(JsonDocument &jsonDoc, int encodage)
+ * @brief Taille du message sérialisé dans l'encodage demandé.
+ */
+size_t mesure_message(JsonDocument &jsonDoc, int encodage) {
+  return (encodage == ENCODAGE_MSGPACK) ? measureMsgPack(jsonDoc) : measureJson(jsonDoc);
+}
 
-    jsonDoc.clear();
-  } 
+/**
+ * @fn size_t serialise_message(JsonDocument &jsonDoc, int encodage, char *tampon, size_t taille)
+ * @brief Sérialise un document dans l'encodage demandé.
+ *
+ * @return Nombre d'octets écrits (sans le caractère nul terminal en JSON).
+ */
+size_t serialise_message(JsonDocument &jsonDoc, int encodage, char *tampon, size_t taille) {
+  if (encodage == ENCODAGE_MSGPACK) {
+    return serializeMsgPack(jsonDoc, tampon, taille);
+  }
+  return serializeJson(jsonDoc, tampon, taille);
 }
 
 /**
- * @fn void update_Subscribe1(String mqttSubscribe, char *topic, char *payload, unsigned int length)
- * @brief Mise à jour des données en fonction du message MQTT reçu sur le canal 1.
+ * @fn DeserializationError decode_commande(JsonDocument &jsonDoc, const char *payload, unsigned int length)
+ * @brief Décode une commande reçue en JSON ou en MessagePack.
  *
- * Cette fonction analyse le topic et le payload du message MQTT reçu sur le canal 1,
- * puis met à jour les données en conséquence.
+ * L'encodage est reconnu sur le premier octet : une commande est toujours un objet,
+ * '{' en JSON, fixmap (0x80 à 0x8F) ou map16/map32 (0xDE, 0xDF) en MessagePack.
  *
- * @param mqttSubscribe Topic principal du canal MQTT.
- * @param topic Topic du message MQTT reçu.
+ * @param jsonDoc Document de destination.
  * @param payload Données du message MQTT.
- * @param length Longueur des données du message MQTT.
+ * @param length Longueur des données.
+ * @return Résultat de la désérialisation.
  */
-void update_Subscribe1(String mqttSubscribe, char* topic, char* payload, unsigned int length) {
-  if(!EnableMQTT){return;}
-  char topicBuffer[300];
-  char message[length + 1];
-  memcpy(message, payload, length);
-  message[length] = '\0';
-
-  Serial.println(message);
-
-  //Recherche de la voie pour un topic voie
-  for (int i = 0; i < 8; i++) {
-    
-    //Pour un topic PCF8574_OUT
-    sprintf(topicBuffer, "%s/PCF8574_OUT_1_%d",mqttSubscribe, i + 1);
-    Serial.println(topicBuffer);
-    if (strcmp(topic, topicBuffer) == 0) {
-
-      StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de votre message JSON
-      DeserializationError error = deserializeJson(jsonDoc, message);
-        if (error) {
-          Serial.print("Erreur lors de la désérialisation JSON: ");
-          Serial.println(error.c_str());
-          return;
-        }
-      
-      bool valPort = jsonDoc["val_port"];
- 
-      if (valPort) {
-        Serial.println("PCF8574_OUT_1_" + String(i) + " = TRUE!!!");
-        PCF8574_OUT_1_out(i, true);
-      }
-      else{
-        Serial.println("PCF8574_OUT_1_" + String(i) + " = LOW!!!");
-        PCF8574_OUT_1_out(i, false);
-      }
-      break;
+DeserializationError decode_commande(JsonDocument &jsonDoc, const char *payload, unsigned int length) {
+  if (length > 0) {
+    uint8_t premier = (uint8_t)payload[0];
+    if ((premier & 0xF0) == 0x80 || premier == 0xDE || premier == 0xDF) {
+      return deserializeMsgPack(jsonDoc, payload, length);
     }
   }
+  return deserializeJson(jsonDoc, payload, length);
+}
 
-  //Pour un topic GPIO_OUT
-  sprintf(topicBuffer, "%s/GPIO_OUT",mqttSubscribe);
-  Serial.println(topicBuffer);
-    if (strcmp(topic, topicBuffer) == 0) {
-      StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de votre message JSON
-      DeserializationError error = deserializeJson(jsonDoc, message);
-        if (error) {
-          Serial.print("Erreur lors de la désérialisation JSON: ");
-          Serial.println(error.c_str());
-          return;
-        }
-      
-      uint8_t ValPort = jsonDoc["val_port"]; 
-      uint8_t NumPort = jsonDoc["num_port"];
-      Serial.println("Changement Etat de Sortie Bit " + String(NumPort) + " Valeur : " + String(ValPort)) ;
-      GPIO_OUT(NumPort, ValPort);
-    }
-
-  //Pour un topic ServoMoteur
-  sprintf(topicBuffer, "%s/ServoMoteur",mqttSubscribe);
-  Serial.println(topicBuffer);
-    if (strcmp(topic, topicBuffer) == 0) {
-      StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de votre message JSON
-      DeserializationError error = deserializeJson(jsonDoc, message);
-        if (error) {
-          Serial.print("Erreur lors de la désérialisation JSON: ");
-          Serial.println(error.c_str());
-          return;
-        }
-      
-      uint8_t ValPort = jsonDoc["val_servo"]; 
-      uint8_t NumPort = jsonDoc["num_servo"];
-      Serial.println("Changement Etat de Sortie servo " + String(NumPort) + " Valeur : " + String(ValPort)) ;
-      ServoMoteur_OUT(NumPort, ValPort);
+/**
+ * @fn size_t capacite_commande(int encodage, unsigned int length)
+ * @brief Capacité du document de décodage d'une commande, majorée d'après la taille du message.
+ *
+ * Chaque valeur occupe une entrée du document et au moins un octet du message en MessagePack, deux en JSON
+ * (valeur et séparateur). Les chaînes sont copiées dans le document : elles n'excèdent pas la taille du message.
+ */
+size_t capacite_commande(int encodage, unsigned int length) {
+  size_t valeurs = (encodage == ENCODAGE_MSGPACK) ? length : length / 2 + 1;
+  return JSON_OBJECT_SIZE(valeurs) + length;
+}
+
+/**
+ * @fn void construit_topics_MQTT()
+ * @brief Construit une fois pour toutes la table des topics de publication de publish_s1.
+ */
+void construit_topics_MQTT() {
+  int tronques = Topics_MQTT_construit(mqttSubscribe1.c_str());
+  if (tronques > 0) {
+    Serial.printf("%d topics tronqués à %d caractères : préfixe %s trop long\n", tronques, TAILLE_TOPIC_MQTT - 1, mqttSubscribe1.c_str());
+  }
+}
+
+/**
+ * @fn void selectionne_serveur_MQTT(int index)
+ * @brief Choix du serveur de la prochaine tentative de connexion.
+ *
+ * @param index Rang du serveur dans Tab_Serveurs_MQTT (0 : serveur préféré).
+ */
+void selectionne_serveur_MQTT(int index) {
+  Serveur_actif = index;
+  mqtt_server = Tab_Serveurs_MQTT[index].Hote;
+  mqtt_port = Tab_Serveurs_MQTT[index].Port;
+}
+
+/**
+ * @fn void lit_serveurs_MQTT()
+ * @brief Lecture de la liste ordonnée des serveurs MQTT.
+ *
+ * Le serveur préféré est MQTT_serveur / MQTT_port, suivi des serveurs de secours du bloc MQTT/Serveurs
+ * (Serveur_1 / Port_1 ... Serveur_3 / Port_3, une adresse vide désactive l'entrée).
+ */
+void lit_serveurs_MQTT() {
+  Tab_Serveurs_MQTT[0].Hote = mqtt_server;
+  Tab_Serveurs_MQTT[0].Port = mqtt_port;
+  Nb_Serveurs_MQTT = 1;
+  for (int i = 1; i < NB_SERVEURS_MQTT; i++) {
+    String hote = getStringValueFromJsonFile("/MQTT.json", "MQTT", "Serveurs", "Serveur_" + String(i));
+    if (hote == "" || hote == "null") {continue;}
+    int port = getIntValueFromJsonFile("/MQTT.json", "MQTT", "Serveurs", "Port_" + String(i));
+    Tab_Serveurs_MQTT[Nb_Serveurs_MQTT].Hote = hote;
+    Tab_Serveurs_MQTT[Nb_Serveurs_MQTT].Port = (port > 0) ? port : mqtt_port;
+    Nb_Serveurs_MQTT++;
+  }
+  unsigned long valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_retour_periode_ms");
+  if (valeur > 0) {Bascule_MQTT.Retour_periode_ms = valeur;}
+  int sondes = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_retour_sondes");
+  if (sondes > 0) {Bascule_MQTT.Retour_sondes = sondes;}
+  for (int i = 0; i < Nb_Serveurs_MQTT; i++) {
+    Serial.printf("   Serveur %d : %s:%d%s\n", i, Tab_Serveurs_MQTT[i].Hote.c_str(), Tab_Serveurs_MQTT[i].Port, i == 0 ? " (préféré)" : "");
+  }
+}
+
+/**
+ * @fn void init_id_commande()
+ * @brief Reprise de la fenêtre de déduplication conservée en mémoire RTC, ou remise à zéro après une mise sous tension.
+ */
+void init_id_commande() {
+  if (Magique_Id_Commande == MAGIQUE_ID_COMMANDE) {
+    for (int i = 0; i < NB_ID_COMMANDE; i++) {Tab_Id_Commande[i].Id[TAILLE_ID_COMMANDE - 1] = '\0';}
+    return;
+  }
+  memset(Tab_Id_Commande, 0, sizeof(Tab_Id_Commande));
+  Usage_Id_Commande = 0;
+  Magique_Id_Commande = MAGIQUE_ID_COMMANDE;
+}
+
+/**
+ * @fn void mqtt_service_setup()
+ * @brief Configuration du service MQTT.
+ *
+ * Initialise et configure la connexion au serveur MQTT ainsi que les topics MQTT.
+ */
+void mqtt_service_setup(){
+  if(!EnableMQTT){return;}
+   Serial.println();
+   Serial.println(F("============================================================================================"));
+   Serial.println("Initialisation du serveur MQTT");
+   Serial.println(F("============================================================================================")); 
+
+   mqtt_server = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_serveur");
+   mqtt_port = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_port");
+   lit_serveurs_MQTT();
+   mqttUser = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_user");
+   mqttPassword = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_password");
+   mqttClient = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_client");
+   if (mqttClient.length() == 0) {
+     char id[32];
+     snprintf(id, sizeof(id), "ESP32_Irrigation_%012llx", (unsigned long long)ESP.getEfuseMac());
+     mqttClient = id;
+   }
+   init_id_commande();
+   mqttSubscribe1 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_subscribe_1");
+   mqttSubscribe1_full = mqttSubscribe1+"/#";
+   mqttPublish_s1_ext_out = mqttSubscribe1+"_ext_out/#";
+   mqttPublish_s1_meteo = mqttSubscribe1+"_meteo";
+   mqttSubscribe2 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_subscribe_2");
+   mqttPublish_s2 = mqttSubscribe2+"_out/#";
+   mqttPublish1 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_publish_1");
+   mqttPublish2 = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_publish_2");
+
+   /// @brief Publication sur changement : bandes mortes et période de rafraîchissement complet
+   periodeRafraichissement = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_periode_rafraichissement");
+   if (periodeRafraichissement <= 0) {periodeRafraichissement = 300;}
+   for (int f = FAMILLE_GPIO_ANA; f < NB_FAMILLES; f++) {
+     Tab_Bande_Morte[f].Abs = getFloatValueFromJsonFile("/MQTT.json", "MQTT", "Bande_morte", String(Nom_Famille[f]) + "_abs");
+     Tab_Bande_Morte[f].Rel = getFloatValueFromJsonFile("/MQTT.json", "MQTT", "Bande_morte", String(Nom_Famille[f]) + "_rel");
+   }
+   Serial.printf("   Rafraichissement complet toutes les %d s\n", periodeRafraichissement);
+
+   /// @brief Mode de publication : "topic" (un topic par valeur) ou "document" (un document agrégé)
+   modeDocument = (getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_mode_publication") == "document");
+   for (int f = 0; f < NB_FAMILLES; f++) {
+     Encodage_Famille[f] = lit_encodage(Nom_Famille[f]);
+   }
+   Encodage_Etat = lit_encodage("Etat");
+   Encodage_Publish_1 = lit_encodage("Publish_1");
+
+   construit_topics_MQTT();
+   enregistre_routes_MQTT();
+
+   /// @brief Reconnexion : attente exponentielle entre Attente_min et Attente_max, durée maximale d'une tentative
+   unsigned long valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_reconnexion_min_ms");
+   if (valeur > 0) {Connexion_MQTT.Attente_min_ms = valeur;}
+   valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_reconnexion_max_ms");
+   if (valeur > 0) {Connexion_MQTT.Attente_max_ms = valeur;}
+   valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_timeout_connexion_ms");
+   if (valeur > 0) {Connexion_MQTT.Timeout_ms = valeur;}
+   valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_timeout_ms");
+   if (valeur > 0) {Connexion_MQTT.Timeout_TLS_ms = valeur;}
+   valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_timeout_session_ms");
+   if (valeur > 0) {Connexion_MQTT.Timeout_session_ms = valeur;}
+
+   /// @brief Protocole : MQTT 5 (alias de topic, propriétés de réponse) par défaut, "3.1.1" pour un serveur ancien
+   client.setVersion((getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_version") == "3.1.1") ? MQTT_VERSION_3_1_1 : MQTT_VERSION_5);
+   valeur = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_expiration_session_s");
+   if (valeur > 0) {Connexion_MQTT.Expiration_session_s = valeur;}
+   Serial.printf("   Protocole MQTT %s\n", client.version() == MQTT_VERSION_5 ? "5" : "3.1.1");
+   Connexion_MQTT.Attente_ms = Connexion_MQTT.Attente_min_ms;
+
+   /// @brief File d'attente des publications pendant une coupure et cadence de rejeu
+   ConfigFileAttente();
+   ConfigDebit();
+   int par_seconde = getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_rejeu_par_seconde");
+   if (par_seconde > 0) {Rejeu.Par_seconde = par_seconde;}
+   Connexion_MQTT.Prochaine_tentative = millis();
+   Serial.println(modeDocument ? "   Publication en document agrégé sur " + String(Tab_Topics_MQTT[TOPIC_ETAT]) : String("   Publication un topic par valeur"));
+   
+  /// @brief TLS : certificats lus sur le SPIFFS, session conservée entre les reconnexions (et en mémoire RTC si demandé)
+  EnableTLS = (getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS") == "true");
+  if (EnableTLS) {
+    String ca = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_CA");
+    String certificat = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_certificat");
+    String cle = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_cle");
+    String nom_serveur = getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_nom_serveur");
+    bool session_rtc = (getStringValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_TLS_session_RTC") == "true");
+    if (nom_serveur == "null") {nom_serveur = "";}
+    String pem_ca = (ca != "") ? readFileToString(ca) : String();
+    String pem_certificat = (certificat != "") ? readFileToString(certificat) : String();
+    String pem_cle = (cle != "") ? readFileToString(cle) : String();
+    if (Client_TLS.configure(pem_ca.c_str(), pem_certificat.c_str(), pem_cle.c_str(), nom_serveur.c_str(), session_rtc)) {
+      client.setClient(Client_TLS);
+      Serial.println("   TLS actif, serveur " + (nom_serveur != "" ? nom_serveur : mqtt_server) + (session_rtc ? ", session conservée en mémoire RTC" : ""));
+    }
+    else {
+      EnableTLS = false;
+      Serial.println("   Configuration TLS invalide : connexion au serveur MQTT desactivee");
+      EnableMQTT = false;
+      return;
+    }
+  }
+
+  selectionne_serveur_MQTT(0);
+  client.setCallback(callback);
+  /// @brief Tampon de réception plus grand que le pool : une commande trop grande atteint le rappel, où elle est comptée et refusée
+  client.setBufferSize(TAILLE_TAMPON_RECEPTION_MQTT);
+
+  reconnect();
+}
+
+/**
+ * @fn void abonnements_MQTT()
+ * @brief Souscription aux topics de commande après une connexion au serveur MQTT.
+ */
+void abonnements_MQTT() {
+  /// @brief Commandes en QoS 1 : le serveur redélivre une commande non acquittée
+  client.subscribe(mqttSubscribe1_full.c_str(), 1);
+  Serial.println("Souscription au canal " + mqttSubscribe1_full + " (QoS 1)");
+
+  client.subscribe(mqttSubscribe2.c_str());
+  Serial.println("Souscription au canal " + mqttSubscribe2);
+}
+
+/**
+ * @fn void programme_tentative_MQTT()
+ * @brief Programme la prochaine tentative de connexion avec une attente exponentielle aléatoire.
+ *
+ * L'attente double à chaque échec jusqu'à Attente_max_ms. La tentative est tirée entre la moitié
+ * et la totalité de l'attente pour que plusieurs passerelles ne se reconnectent pas en même temps
+ * après une coupure du serveur.
+ */
+void programme_tentative_MQTT() {
+  unsigned long attente = Connexion_MQTT.Attente_ms;
+  Connexion_MQTT.Prochaine_tentative = millis() + attente / 2 + random(attente / 2 + 1);
+  Connexion_MQTT.Attente_ms = attente * 2;
+  if (Connexion_MQTT.Attente_ms > Connexion_MQTT.Attente_max_ms) {Connexion_MQTT.Attente_ms = Connexion_MQTT.Attente_max_ms;}
+  Connexion_MQTT.Etat = MQTT_ATTENTE;
+}
+
+/**
+ * @fn void echec_tentative_MQTT()
+ * @brief Comptabilise l'échec d'une tentative et choisit le serveur de la suivante.
+ *
+ * Avec plusieurs serveurs, la tentative suivante vise immédiatement le serveur suivant de la liste :
+ * une coupure du serveur actif ne coûte que le délai borné de la tentative (Timeout_ms).
+ * L'attente exponentielle n'est appliquée qu'après un tour complet de la liste sans succès.
+ */
+void echec_tentative_MQTT() {
+  Tab_Serveurs_MQTT[Serveur_actif].Echecs++;
+  Tab_Serveurs_MQTT[Serveur_actif].Echecs_consecutifs++;
+  if (Nb_Serveurs_MQTT > 1) {
+    int suivant = (Serveur_actif + 1) % Nb_Serveurs_MQTT;
+    selectionne_serveur_MQTT(suivant);
+    if (suivant != Bascule_MQTT.Serveur_precedent) {
+      Connexion_MQTT.Prochaine_tentative = millis();
+      Connexion_MQTT.Etat = MQTT_ATTENTE;
+      return;
+    }
+  }
+  programme_tentative_MQTT();
+}
+
+/**
+ * @fn void abandonne_tentative_MQTT()
+ * @brief Fermeture de la socket d'une tentative échouée et programmation de la suivante.
+ */
+void abandonne_tentative_MQTT() {
+  if (Connexion_MQTT.Socket >= 0) {
+    close(Connexion_MQTT.Socket);
+    Connexion_MQTT.Socket = -1;
+  }
+  echec_tentative_MQTT();
+}
+
+/**
+ * @fn void resolution_dns_terminee(const char *nom, const ip_addr_t *ip, void *argument)
+ * @brief Rappel de lwIP à la fin d'une requête DNS (tâche TCP/IP).
+ */
+void resolution_dns_terminee(const char *nom, const ip_addr_t *ip, void *argument) {
+  Struct_Resolution_DNS *resolution = (Struct_Resolution_DNS*)argument;
+  /// @brief Requête abandonnée puis remplacée par celle d'un autre nom : le résultat ne la concerne pas
+  if (resolution->Etat != DNS_EN_COURS || strcmp(nom, resolution->Hote) != 0) {return;}
+  if (ip == NULL) {
+    resolution->Etat = DNS_ECHEC;
+    return;
+  }
+  resolution->Ip = ip4_addr_get_u32(ip_2_ip4(ip));
+  resolution->Etat = DNS_RESOLU;
+}
+
+/**
+ * @fn int lance_resolution_dns(Struct_Resolution_DNS &resolution, const String &hote)
+ * @brief Lance sans attendre la résolution d'un nom de serveur.
+ *
+ * Une adresse IP écrite en clair, ou un nom présent dans le cache DNS de lwIP, est résolu immédiatement.
+ * Sinon la requête part et son résultat se lit avec resolution.Etat aux passages suivants.
+ *
+ * @return L'état de la résolution (Etat_Resolution_DNS).
+ */
+int lance_resolution_dns(Struct_Resolution_DNS &resolution, const String &hote) {
+  IPAddress ip;
+  if (ip.fromString(hote)) {
+    resolution.Ip = (uint32_t)ip;
+    resolution.Etat = DNS_RESOLU;
+    return DNS_RESOLU;
+  }
+  if (hote.length() >= sizeof(resolution.Hote)) {
+    resolution.Etat = DNS_ECHEC;
+    return DNS_ECHEC;
+  }
+  ip_addr_t adresse;
+  strcpy(resolution.Hote, hote.c_str());
+  resolution.Etat = DNS_EN_COURS;
+  err_t erreur = dns_gethostbyname(resolution.Hote, &adresse, resolution_dns_terminee, &resolution);
+  if (erreur == ERR_OK) {
+    resolution.Ip = ip4_addr_get_u32(ip_2_ip4(&adresse));
+    resolution.Etat = DNS_RESOLU;
+  }
+  else if (erreur != ERR_INPROGRESS) {
+    resolution.Etat = DNS_ECHEC;
+  }
+  return resolution.Etat;
+}
+
+/**
+ * @fn int ouvre_socket_tcp(IPAddress ip, int port)
+ * @brief Ouvre une socket non bloquante et lance la connexion TCP vers un serveur.
+ *
+ * @return La socket, -1 si la connexion n'a pas pu être lancée.
+ */
+int ouvre_socket_tcp(IPAddress ip, int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {return -1;}
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+  struct sockaddr_in adresse;
+  memset(&adresse, 0, sizeof(adresse));
+  adresse.sin_family = AF_INET;
+  adresse.sin_addr.s_addr = (uint32_t)ip;
+  adresse.sin_port = htons((uint16_t)port);
+  if (connect(fd, (struct sockaddr*)&adresse, sizeof(adresse)) < 0 && errno != EINPROGRESS) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @fn bool demarre_connexion_tcp(IPAddress ip)
+ * @brief Lance la connexion TCP vers le serveur MQTT actif.
+ *
+ * @return false si la connexion n'a pas pu être lancée.
+ */
+bool demarre_connexion_tcp(IPAddress ip) {
+  Connexion_MQTT.Socket = ouvre_socket_tcp(ip, mqtt_port);
+  if (Connexion_MQTT.Socket < 0) {return false;}
+  Connexion_MQTT.Etat = MQTT_CONNEXION_TCP;
+  return true;
+}
+
+/**
+ * @fn bool poursuit_resolution_MQTT()
+ * @brief Suite de la résolution DNS du serveur actif : lancement de la connexion TCP dès que l'adresse est connue.
+ *
+ * Si le DNS ne répond pas dans Timeout_ms ou ne connaît pas le nom, la dernière adresse résolue du serveur
+ * est reprise : une panne du serveur DNS n'empêche pas de retrouver un serveur MQTT déjà joint.
+ *
+ * @return false si la tentative a échoué.
+ */
+bool poursuit_resolution_MQTT() {
+  Struct_Serveur_MQTT &serveur = Tab_Serveurs_MQTT[Serveur_actif];
+  int etat = Resolution_connexion.Etat;
+  if (etat == DNS_EN_COURS) {
+    if (millis() - Connexion_MQTT.Debut_tentative < Connexion_MQTT.Timeout_ms) {return true;}
+    Resolution_connexion.Etat = DNS_ECHEC;
+    etat = DNS_ECHEC;
+  }
+  if (etat == DNS_RESOLU) {
+    serveur.Ip = IPAddress(Resolution_connexion.Ip);
+  }
+  else if ((uint32_t)serveur.Ip == 0) {
+    Serial.println("échec, nom de serveur non résolu");
+    return false;
+  }
+  else {
+    Serial.println("DNS sans réponse, dernière adresse connue " + serveur.Ip.toString());
+  }
+  return demarre_connexion_tcp(serveur.Ip);
+}
+
+/**
+ * @fn int teste_connexion_tcp(int fd)
+ * @brief Teste sans attendre l'avancement d'une connexion TCP en cours.
+ *
+ * @return 1 si la connexion est établie, 0 si elle est en cours, -1 si elle a échoué.
+ */
+int teste_connexion_tcp(int fd) {
+  fd_set ecriture;
+  struct timeval zero = {0, 0};
+  FD_ZERO(&ecriture);
+  FD_SET(fd, &ecriture);
+  if (select(fd + 1, NULL, &ecriture, NULL, &zero) <= 0) {
+    return 0;
+  }
+  int erreur = 0;
+  socklen_t taille = sizeof(erreur);
+  getsockopt(fd, SOL_SOCKET, SO_ERROR, &erreur, &taille);
+  return (erreur == 0) ? 1 : -1;
+}
+
+/**
+ * @fn void sonde_serveur_prefere()
+ * @brief Surveillance du serveur préféré pendant la connexion à un serveur de secours.
+ *
+ * Une connexion TCP de sonde est lancée toutes les Retour_periode_ms. Après Retour_sondes sondes
+ * réussies consécutives, le serveur préféré est jugé rétabli : la session de secours est fermée
+ * et la connexion est rouverte sur le serveur préféré (les publications sont mises en file entre-temps).
+ */
+void sonde_serveur_prefere() {
+  if (Serveur_actif == 0) {return;}
+  unsigned long maintenant = millis();
+
+  if (Bascule_MQTT.Sonde < 0) {
+    if (!Bascule_MQTT.Resolution) {
+      if ((long)(maintenant - Bascule_MQTT.Prochaine_sonde) < 0) {return;}
+      Bascule_MQTT.Prochaine_sonde = maintenant + Bascule_MQTT.Retour_periode_ms;
+      Bascule_MQTT.Debut_sonde = maintenant;
+      Bascule_MQTT.Resolution = true;
+      lance_resolution_dns(Resolution_sonde, Tab_Serveurs_MQTT[0].Hote);
+    }
+    /// @brief La sonde passe par la même résolution DNS non bloquante que la connexion
+    int etat = Resolution_sonde.Etat;
+    if (etat == DNS_EN_COURS) {
+      if (maintenant - Bascule_MQTT.Debut_sonde < Connexion_MQTT.Timeout_ms) {return;}
+      Resolution_sonde.Etat = DNS_ECHEC;
+      etat = DNS_ECHEC;
+    }
+    Bascule_MQTT.Resolution = false;
+    if (etat == DNS_RESOLU) {
+      Bascule_MQTT.Sonde = ouvre_socket_tcp(IPAddress(Resolution_sonde.Ip), Tab_Serveurs_MQTT[0].Port);
+    }
+    if (Bascule_MQTT.Sonde < 0) {Bascule_MQTT.Sondes_ok = 0;}
+    return;
+  }
+
+  int resultat = teste_connexion_tcp(Bascule_MQTT.Sonde);
+  if (resultat == 0 && maintenant - Bascule_MQTT.Debut_sonde < Connexion_MQTT.Timeout_ms) {return;}
+  close(Bascule_MQTT.Sonde);
+  Bascule_MQTT.Sonde = -1;
+  if (resultat <= 0) {
+    Bascule_MQTT.Sondes_ok = 0;
+    return;
+  }
+  Bascule_MQTT.Sondes_ok++;
+  if (Bascule_MQTT.Sondes_ok < Bascule_MQTT.Retour_sondes) {return;}
+
+  Serial.println("Serveur MQTT préféré rétabli, retour sur " + Tab_Serveurs_MQTT[0].Hote);
+  Bascule_MQTT.Sondes_ok = 0;
+  Bascule_MQTT.Retours++;
+  Bascule_MQTT.Serveur_precedent = Serveur_actif;
+  Bascule_MQTT.Debut_bascule = maintenant;
+  client.disconnect();
+  selectionne_serveur_MQTT(0);
+  Connexion_MQTT.Attente_ms = Connexion_MQTT.Attente_min_ms;
+  Connexion_MQTT.Prochaine_tentative = maintenant;
+  Connexion_MQTT.Etat = MQTT_ATTENTE;
+}
+
+void compte_publication(size_t taille_paquet, size_t taille_topic);
+bool publie_flux(const char *topic, JsonDocument &jsonDoc, int encodage, bool retenu, int classe, bool *differe, const Struct_Proprietes_MQTT *proprietes);
+
+/**
+ * @fn void echec_session_MQTT()
+ * @brief Fermeture de la liaison après un refus ou une absence de CONNACK, et programmation de la tentative suivante.
+ */
+void echec_session_MQTT() {
+  Serial.print("échec, code d'erreur = ");
+  Serial.println(client.state());
+  if (EnableTLS) {Client_TLS.stop();}
+  else {espClient.stop();}
+  echec_tentative_MQTT();
+}
+
+/**
+ * @fn void demarre_session_MQTT()
+ * @brief Émission du CONNECT sur la liaison établie ; le CONNACK est attendu dans l'état MQTT_SESSION.
+ */
+void demarre_session_MQTT() {
+  /// @brief Testament retenu : le serveur publie "offline" sur _out/Statut si la passerelle disparaît sans se déconnecter.
+  /// Session persistante (clean start à 0) : le serveur conserve les abonnements et les commandes QoS 1
+  /// reçues pendant une coupure, et redélivre celles qui n'ont pas été acquittées (voir Tab_Id_Commande).
+  /// En MQTT 5, la session n'est conservée que pendant Expiration_session_s (Session Expiry Interval).
+  const char *utilisateur = (mqttUser.length() > 0) ? mqttUser.c_str() : NULL;
+  const char *mot_de_passe = (mqttPassword.length() > 0) ? mqttPassword.c_str() : NULL;
+  if (!client.demarre_session(mqttClient.c_str(), utilisateur, mot_de_passe, Tab_Topics_MQTT[TOPIC_STATUT], 1, true, "offline", false, Connexion_MQTT.Expiration_session_s)) {
+    echec_session_MQTT();
+    return;
+  }
+  Connexion_MQTT.Debut_tentative = millis();
+  Connexion_MQTT.Etat = MQTT_SESSION;
+}
+
+/**
+ * @fn void session_ouverte_MQTT()
+ * @brief CONNACK accepté : comptage de la connexion, souscriptions et message de naissance.
+ */
+void session_ouverte_MQTT() {
+  Serial.println("> Connecté au client " + mqttClient + " sur " + mqtt_server);
+  Connexion_MQTT.Connexions++;
+  Tab_Serveurs_MQTT[Serveur_actif].Connexions++;
+  Tab_Serveurs_MQTT[Serveur_actif].Echecs_consecutifs = 0;
+  Tab_Serveurs_MQTT[Serveur_actif].Derniere_connexion = millis();
+  if (Connexion_MQTT.Debut_coupure != 0) {
+    unsigned long coupure = millis() - Connexion_MQTT.Debut_coupure;
+    Connexion_MQTT.Coupure_cumul_ms += coupure;
+    if (coupure > Connexion_MQTT.Coupure_max_ms) {Connexion_MQTT.Coupure_max_ms = coupure;}
+    Connexion_MQTT.Debut_coupure = 0;
+  }
+  Connexion_MQTT.Etat = MQTT_CONNECTE;
+  abonnements_MQTT();
+
+  /// @brief Message de naissance retenu, puis republication retenue de tout l'état au prochain passage dans loop_MQTT()
+  size_t octets_topic;
+  size_t paquet = client.taille_publish(Tab_Topics_MQTT[TOPIC_STATUT], 6, NULL, &octets_topic);
+  if (client.publish(Tab_Topics_MQTT[TOPIC_STATUT], "online", true)) {
+    compte_publication(paquet, octets_topic);
+  }
+  Republication_complete = true;
+
+  /// @brief Durée de bascule : de la perte du serveur précédent aux souscriptions rétablies sur le nouveau
+  if (Bascule_MQTT.Debut_bascule != 0 && Serveur_actif != Bascule_MQTT.Serveur_precedent) {
+    Bascule_MQTT.Bascules++;
+    Bascule_MQTT.Bascule_ms = millis() - Bascule_MQTT.Debut_bascule;
+    if (Bascule_MQTT.Bascule_ms > Bascule_MQTT.Bascule_max_ms) {Bascule_MQTT.Bascule_max_ms = Bascule_MQTT.Bascule_ms;}
+    Serial.printf("Bascule du serveur %d au serveur %d en %lu ms\n", Bascule_MQTT.Serveur_precedent, Serveur_actif, Bascule_MQTT.Bascule_ms);
+  }
+  Bascule_MQTT.Debut_bascule = 0;
+  Bascule_MQTT.Serveur_precedent = Serveur_actif;
+  Bascule_MQTT.Sondes_ok = 0;
+  Bascule_MQTT.Prochaine_sonde = millis() + Bascule_MQTT.Retour_periode_ms;
+}
+
+/**
+ * @fn void reconnect()
+ * @brief Gestion non bloquante de la connexion au serveur MQTT.
+ *
+ * Machine d'état appelée à chaque passage dans loop_MQTT() :
+ * - MQTT_ATTENTE : attente de l'échéance de la prochaine tentative, sans bloquer la boucle ;
+ * - MQTT_RESOLUTION_DNS : résolution du nom du serveur par dns_gethostbyname, sans attendre la réponse ;
+ * - MQTT_CONNEXION_TCP : connexion TCP non bloquante, abandonnée après Timeout_ms (résolution DNS comprise) ;
+ *   une fois la socket connectée, le CONNECT est émis ;
+ * - MQTT_HANDSHAKE_TLS : si MQTT_TLS est activé, poignée de main TLS pas à pas, abandonnée après Timeout_TLS_ms,
+ *   avant l'émission du CONNECT ;
+ * - MQTT_SESSION : lecture du CONNACK à chaque passage, abandonnée après Timeout_session_ms ;
+ * - MQTT_CONNECTE : surveillance de la perte de connexion.
+ * Une coupure du serveur ne gèle donc plus la lecture des capteurs, les fonctions utilisateur ni la liaison série.
+ */
+void reconnect() {
+  if(!EnableMQTT){return;}
+  unsigned long maintenant = millis();
+
+  switch (Connexion_MQTT.Etat) {
+    case MQTT_CONNECTE:
+      if (client.connected()) {return;}
+      Serial.println("Connexion au serveur MQTT perdue");
+      Connexion_MQTT.Coupures++;
+      Connexion_MQTT.Debut_coupure = maintenant;
+      Bascule_MQTT.Debut_bascule = maintenant;
+      if (Bascule_MQTT.Sonde >= 0) {
+        close(Bascule_MQTT.Sonde);
+        Bascule_MQTT.Sonde = -1;
+      }
+      Bascule_MQTT.Resolution = false;
+      Connexion_MQTT.Attente_ms = Connexion_MQTT.Attente_min_ms;
+      Connexion_MQTT.Prochaine_tentative = maintenant;
+      Connexion_MQTT.Etat = MQTT_ATTENTE;
+      break;
+
+    case MQTT_ATTENTE:
+      if ((long)(maintenant - Connexion_MQTT.Prochaine_tentative) < 0) {return;}
+      if (WiFi.status() != WL_CONNECTED) {
+        programme_tentative_MQTT();
+        return;
+      }
+      Connexion_MQTT.Tentatives++;
+      Serial.println("Tentative de connexion au serveur MQTT " + mqtt_server + ":" + mqtt_port + " ...");
+      Connexion_MQTT.Debut_tentative = maintenant;
+      Connexion_MQTT.Etat = MQTT_RESOLUTION_DNS;
+      lance_resolution_dns(Resolution_connexion, mqtt_server);
+      if (!poursuit_resolution_MQTT()) {abandonne_tentative_MQTT();}
+      break;
+
+    case MQTT_RESOLUTION_DNS:
+      if (!poursuit_resolution_MQTT()) {abandonne_tentative_MQTT();}
+      break;
+
+    case MQTT_CONNEXION_TCP: {
+      int resultat = teste_connexion_tcp(Connexion_MQTT.Socket);
+      if (resultat == 0) {
+        if (maintenant - Connexion_MQTT.Debut_tentative >= Connexion_MQTT.Timeout_ms) {
+          Serial.println("échec, délai de connexion dépassé");
+          abandonne_tentative_MQTT();
+        }
+        return;
+      }
+      if (resultat < 0) {
+        Serial.println("échec, serveur injoignable");
+        abandonne_tentative_MQTT();
+        return;
+      }
+
+      int fd = Connexion_MQTT.Socket;
+      Connexion_MQTT.Socket = -1;
+      if (EnableTLS) {
+        /// @brief Socket connectée : la poignée de main TLS avance ensuite à chaque passage sans bloquer
+        if (!Client_TLS.demarre(fd, mqtt_server.c_str())) {
+          echec_tentative_MQTT();
+          return;
+        }
+        Connexion_MQTT.Debut_tentative = maintenant;
+        Connexion_MQTT.Etat = MQTT_HANDSHAKE_TLS;
+        return;
+      }
+
+      /// @brief Socket connectée : elle est confiée au client WiFi et reste non bloquante (WiFiClient lit avec
+      /// MSG_DONTWAIT et borne l'attente d'écriture par select), le client MQTT n'ouvre alors que la session
+      espClient = WiFiClient(fd);
+      demarre_session_MQTT();
+      break;
+    }
+
+    case MQTT_HANDSHAKE_TLS: {
+      int resultat = Client_TLS.poursuit_handshake();
+      if (resultat == 0) {
+        if (maintenant - Connexion_MQTT.Debut_tentative >= Connexion_MQTT.Timeout_TLS_ms) {
+          Serial.println("échec, délai de poignée de main TLS dépassé");
+          Client_TLS.stop();
+          echec_tentative_MQTT();
+        }
+        return;
+      }
+      if (resultat < 0) {
+        Serial.println("échec de la poignée de main TLS");
+        echec_tentative_MQTT();
+        return;
+      }
+      demarre_session_MQTT();
+      break;
+    }
+
+    case MQTT_SESSION: {
+      int resultat = client.poursuit_session();
+      if (resultat == 0) {
+        if (maintenant - Connexion_MQTT.Debut_tentative >= Connexion_MQTT.Timeout_session_ms) {
+          Serial.println("échec, CONNACK non reçu");
+          client.disconnect();
+          echec_session_MQTT();
+        }
+        return;
+      }
+      if (resultat < 0) {
+        echec_session_MQTT();
+        return;
+      }
+      session_ouverte_MQTT();
+      break;
+    }
+
+    default:
+      Connexion_MQTT.Etat = MQTT_ATTENTE;
+      break;
+  }
+}
+
+void differe_acquittement(const char *topic, JsonDocument &jsonDoc, int encodage, const Struct_Proprietes_MQTT *proprietes);
+
+/**
+ * @fn bool topic_reponse_valide(const char *topic)
+ * @brief Contrôle du topic de réponse (Response Topic) d'une commande.
+ *
+ * Un topic de réponse trop long, contenant un joker, ou situé sous les topics de commande de la passerelle
+ * (la réponse serait reçue comme une commande) est ignoré : la réponse part alors sur _out/Ack.
+ */
+bool topic_reponse_valide(const char *topic) {
+  return topic != NULL && topic[0] != '\0' && strlen(topic) < TAILLE_TOPIC_MQTT && strpbrk(topic, "+#") == NULL
+      && !(strncmp(topic, mqttSubscribe1.c_str(), mqttSubscribe1.length()) == 0 && topic[mqttSubscribe1.length()] == '/')
+      && mqttSubscribe2 != topic;
+}
+
+/**
+ * @fn void rejette_commande(const char *topic, const byte *payload, unsigned int length, const char *motif)
+ * @brief Acquittement de refus d'une commande rejetée à la réception, avant tout décodage.
+ *
+ * Appelé depuis le rappel du client MQTT, dont le tampon contient encore le message : l'acquittement est
+ * sérialisé dans la file des acquittements en attente, puis émis par reemet_acquittements() au retour de
+ * client.loop(). Il part sur le topic de réponse de la commande (sinon _out/Ack) avec sa Correlation Data,
+ * dans l'encodage de la commande, avec "rejete": 1 et le motif.
+ */
+void rejette_commande(const char *topic, const byte *payload, unsigned int length, const char *motif) {
+  size_t taille_base = mqttSubscribe1.length();
+  const char *suffixe = topic;
+  if (strncmp(topic, mqttSubscribe1.c_str(), taille_base) == 0 && topic[taille_base] == '/') {suffixe = topic + taille_base + 1;}
+  StaticJsonDocument<256> jsonDoc;
+  jsonDoc["cmd"] = suffixe;
+  jsonDoc["ok"] = 0;
+  jsonDoc["rejete"] = 1;
+  jsonDoc["erreur"] = motif;
+  const Struct_Proprietes_MQTT *proprietes = client.proprietes_recues();
+  const char *topic_reponse = topic_reponse_valide(proprietes->Topic_reponse) ? proprietes->Topic_reponse : Tab_Topics_MQTT[TOPIC_ACK];
+  differe_acquittement(topic_reponse, jsonDoc, (length > 0 && payload[0] >= 0x80) ? ENCODAGE_MSGPACK : ENCODAGE_JSON, proprietes);
+}
+
+/**
+ * @fn void callback(char *topic, byte *payload, unsigned int length)
+ * @brief Fonction de rappel appelée lorsqu'un message MQTT est reçu.
+ *
+ * Le message est copié une seule fois dans un emplacement du pool de commandes, avec ses propriétés MQTT 5
+ * Response Topic / Correlation Data, puis le rappel rend la main : la commande est exécutée par traite_commandes().
+ * Un message trop grand ou reçu pool plein est rejeté, compté et acquitté en refus (voir rejette_commande).
+ *
+ * @param topic Topic MQTT sur lequel le message a été reçu.
+ * @param payload Données du message.
+ * @param length Longueur des données du message.
+ */
+void callback(char* topic, byte* payload, unsigned int length) {
+  if(!EnableMQTT){return;}
+  const Struct_Proprietes_MQTT *proprietes = client.proprietes_recues();
+  int depot = Pool_commande_depose(topic, payload, length, esp_timer_get_time(), proprietes->Topic_reponse, proprietes->Correlation, proprietes->Taille_correlation);
+  if (depot != DEPOT_ACCEPTE) {
+    rejette_commande(topic, payload, length, (depot == DEPOT_TROP_GRAND) ? "commande trop grande" : "pool plein");
+  }
+}
+
+/**
+ * @fn void lit_reponse(const Struct_Emplacement_Commande *emplacement)
+ * @brief Topic de réponse et Correlation Data de la commande à exécuter, repris de son emplacement du pool.
+ */
+void lit_reponse(const Struct_Emplacement_Commande *emplacement) {
+  Reponse_commande.Topic[0] = '\0';
+  if (topic_reponse_valide(emplacement->Topic_reponse)) {strcpy(Reponse_commande.Topic, emplacement->Topic_reponse);}
+  Reponse_commande.Taille_correlation = emplacement->Taille_correlation;
+  memcpy(Reponse_commande.Correlation, emplacement->Correlation, emplacement->Taille_correlation);
+}
+
+/**
+ * @fn void traite_commandes()
+ * @brief Exécution, dans l'ordre de réception, des commandes déposées dans le pool par callback().
+ */
+void traite_commandes() {
+  int index;
+  while ((index = Pool_commande_suivante()) >= 0) {
+    Struct_Emplacement_Commande *emplacement = Pool_commande(index);
+    DEBUG_PRINT_MQTT(String("Message reçu sur le topic ") + emplacement->Topic);
+    DEBUG_PRINT_MQTT(emplacement->Message);
+    Reception_commande_us = emplacement->Reception_us;
+    lit_reponse(emplacement);
+    update_Subscribe1(mqttSubscribe1, emplacement->Topic, emplacement->Message, emplacement->Taille);
+    Reponse_commande.Topic[0] = '\0';
+    Reponse_commande.Taille_correlation = 0;
+    Pool_commande_libere(index);
+  }
+}
+
+/**
+ * @fn void publish_1()
+ * @brief Fonction de publication de données sur le canal 1 MQTT.
+ *
+ * Cette fonction construit et publie un message MQTT avec des données factices.
+ */
+void publish_1() {
+  if(!EnableMQTT){return;}
+  if(!client.connected()){return;}
+  // Construction du message MQTT
+  StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de vos besoins
+
+  jsonDoc["variable1"] = 0;
+  jsonDoc["variable2"] = 0;
+  jsonDoc["variable3"] = 0;
+
+  // Publication
+  publie_flux(mqttPublish1.c_str(), jsonDoc, Encodage_Publish_1, false, CLASSE_DIAGNOSTIC, NULL, NULL);
+}
+
+/**
+ * @fn void publish_2()
+ * @brief Fonction de publication de données sur le canal 2 MQTT.
+ *
+ * Cette fonction construit et publie un message MQTT avec des données factices.
+ */
+void publish_2() {
+  if(!EnableMQTT){return;}
+  if(!client.connected()){return;}
+  // Construction du message MQTT
+  StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de vos besoins
+
+  jsonDoc["variable1"] = 0;
+  jsonDoc["variable2"] = 0;
+  jsonDoc["variable3"] = 0;
+
+  // Publication
+  publie_flux(mqttPublish2.c_str(), jsonDoc, ENCODAGE_JSON, false, CLASSE_DIAGNOSTIC, NULL, NULL);
+}
+
+/**
+ * @fn bool canal_a_publier(int canal, const float *val, int nb, int famille, bool complet)
+ * @brief Détection de changement d'un canal de publication.
+ *
+ * Un canal est publié si l'une de ses valeurs s'écarte de la dernière valeur publiée de plus que
+ * la bande morte de sa famille : max(absolue, relative x |dernière valeur|). Les canaux tout ou rien
+ * ont une bande morte nulle, tout changement est donc publié.
+ *
+ * @param canal Index du canal (CANAL_xxx + voie).
+ * @param val Valeurs courantes du canal.
+ * @param nb Nombre de valeurs.
+ * @param famille Famille de bande morte (FAMILLE_xxx).
+ * @param complet Rafraîchissement complet : publication sans comparaison.
+ * @return true si le canal doit être publié.
+ */
+bool canal_a_publier(int canal, const float *val, int nb, int famille, bool complet) {
+  return complet || canal_modifie(canal, val, nb, famille);
+}
+
+/**
+ * @fn void compte_publication(size_t taille_paquet, size_t taille_topic)
+ * @brief Mise à jour des compteurs de trafic après une publication.
+ *
+ * @param taille_paquet Taille du paquet PUBLISH émis (voir ClientMQTT::taille_publish).
+ * @param taille_topic Octets de topic émis : 0 pour une publication par alias.
+ */
+void compte_publication(size_t taille_paquet, size_t taille_topic) {
+  unsigned long octets = taille_paquet;
+  Stat_MQTT.Messages_cycle++;
+  Stat_MQTT.Octets_cycle += octets;
+  Stat_MQTT.Octets_topics_cycle += taille_topic;
+  Stat_MQTT.Messages_total++;
+  Stat_MQTT.Octets_total += octets;
+  if (octets > Stat_MQTT.Octets_max) {Stat_MQTT.Octets_max = octets;}
+}
+
+/**
+ * @fn size_t ecrit_client_MQTT(void *contexte, const uint8_t *tampon, size_t taille)
+ * @brief Sortie de l'écrivain de flux : écriture d'un bloc dans le paquet PUBLISH en cours.
+ */
+size_t ecrit_client_MQTT(void *contexte, const uint8_t *tampon, size_t taille) {
+  return ((ClientMQTT *)contexte)->write(tampon, taille);
+}
+
+/**
+ * @fn void interrompt_publication()
+ * @brief Fermeture de la session après un paquet PUBLISH incomplet.
+ *
+ * Le serveur lirait la suite du flux comme le reste du paquet : la session est fermée, et la machine de
+ * connexion en rouvre une nouvelle.
+ */
+void interrompt_publication() {
+  Stat_MQTT.Echecs++;
+  if (client.connected()) {client.disconnect();}
+}
+
+/**
+ * @fn bool publie_flux(const char *topic, JsonDocument &jsonDoc, int encodage, bool retenu, int classe, bool *differe, const Struct_Proprietes_MQTT *proprietes)
+ * @brief Publie un document en sérialisant directement dans la socket du client MQTT.
+ *
+ * La longueur du message est calculée à l'avance (measureJson / measureMsgPack) pour écrire
+ * l'en-tête du paquet PUBLISH, puis le sérialiseur écrit le message au fil de l'eau via
+ * beginPublish / write / endPublish, par blocs de TAILLE_TAMPON_FLUX (voir Ecrivain_Flux). Aucune copie
+ * complète du message n'est faite en RAM : la taille n'est plus limitée par un tampon local ni par le tampon
+ * du client MQTT. Un paquet transmis en partie ferme la session (voir interrompt_publication).
+ * La régulation de débit et les compteurs reçoivent la taille exacte du paquet sur la liaison, alias de topic compris.
+ *
+ * @param topic Topic de publication.
+ * @param jsonDoc Document à publier.
+ * @param encodage Encodage du message (Encodage_MQTT).
+ * @param retenu Message retenu par le serveur.
+ * @param classe Classe de trafic pour la régulation de débit (Classe_Debit).
+ * @param differe Indicateur de refus du message par la régulation de débit (voir Debit_autorise), NULL pour un message ponctuel.
+ * @param proprietes Correlation Data de la commande à laquelle le message répond, NULL si aucune.
+ * @return true si le message a été entièrement transmis, false s'il a été refusé par la régulation de débit ou interrompu.
+ */
+bool publie_flux(const char *topic, JsonDocument &jsonDoc, int encodage, bool retenu, int classe, bool *differe, const Struct_Proprietes_MQTT *proprietes) {
+  size_t taille = mesure_message(jsonDoc, encodage);
+  size_t octets_topic;
+  size_t paquet = client.taille_publish(topic, taille, proprietes, &octets_topic);
+  if (!Debit_autorise(classe, paquet, differe)) {
+    return false;
+  }
+  uint32_t tas_avant = ESP.getFreeHeap();
+  if (!client.beginPublish(topic, taille, retenu, proprietes)) {
+    interrompt_publication();
+    return false;
+  }
+  Ecrivain_Flux flux(ecrit_client_MQTT, &client);
+  size_t ecrit = (encodage == ENCODAGE_MSGPACK) ? serializeMsgPack(jsonDoc, flux) : serializeJson(jsonDoc, flux);
+  bool complet = flux.vide() && ecrit == taille && flux.Transmis == taille;
+
+  /// @brief Consommation de tas de la publication : tampons de la pile TCP encore occupés par le paquet
+  uint32_t tas_apres = ESP.getFreeHeap();
+  if (tas_avant > tas_apres && tas_avant - tas_apres > Stat_MQTT.Tas_publication_max) {Stat_MQTT.Tas_publication_max = tas_avant - tas_apres;}
+
+  client.endPublish();
+  if (!complet) {
+    interrompt_publication();
+    return false;
+  }
+  compte_publication(paquet, octets_topic);
+
+  uint32_t pile = uxTaskGetStackHighWaterMark(NULL);
+  if (Stat_MQTT.Pile_libre_min == 0 || pile < Stat_MQTT.Pile_libre_min) {Stat_MQTT.Pile_libre_min = pile;}
+
+  DEBUG_PRINT_MQTT(topic);
+  DEBUG_PRINT_MQTT(String(encodage == ENCODAGE_MSGPACK ? "MessagePack " : "JSON ") + String(taille) + " octets");
+  return true;
+}
+
+/**
+ * @fn uint64_t horodatage_ms()
+ * @brief Horodatage d'acquisition : ms UTC si NTP est disponible, sinon ms depuis le démarrage.
+ */
+uint64_t horodatage_ms() {
+  uint64_t horodatage = temps_epoch_ms();
+  if (horodatage == 0) {horodatage = millis();}
+  return horodatage;
+}
+
+/**
+ * @fn bool met_en_file(int index_topic, JsonDocument &jsonDoc, int encodage)
+ * @brief Mise en file d'un message pendant une coupure, avec son horodatage d'acquisition.
+ *
+ * Le champ "ts" est ajouté au message s'il n'en porte pas déjà un : au rejeu, le serveur
+ * reçoit l'instant d'acquisition et non l'instant de publication.
+ */
+bool met_en_file(int index_topic, JsonDocument &jsonDoc, int encodage) {
+  Struct_Entete_Differe entete;
+  entete.Horodatage = horodatage_ms();
+  entete.Acquisition_ms = millis();
+  entete.Version_topics = Version_Topics_MQTT;
+  entete.Topic = index_topic;
+  entete.Encodage = encodage;
+  entete.Ancien = 0;
+  if (!jsonDoc.containsKey("ts")) {jsonDoc["ts"] = entete.Horodatage;}
+
+  size_t taille = mesure_message(jsonDoc, encodage);
+  if (taille > TAILLE_MESSAGE_DIFFERE) {
+    Serial.println("Message trop grand pour la file d'attente");
+    return false;
+  }
+  entete.Taille = serialise_message(jsonDoc, encodage, (char*)Tampon_differe, sizeof(Tampon_differe));
+  return File_attente_ajoute(&entete, Tampon_differe);
+}
+
+/**
+ * @fn bool publie_message(int index_topic, JsonDocument &jsonDoc, bool retenu, int encodage, int classe, bool *differe)
+ * @brief Publie un document en flux (voir publie_flux), ou le met en file pendant une coupure, puis vide le document.
+ *
+ * @param index_topic Index du topic dans Tab_Topics_MQTT.
+ * @param classe Classe de trafic pour la régulation de débit (Classe_Debit).
+ * @param differe Indicateur de refus du message par la régulation de débit, NULL pour un message ponctuel.
+ * @return true si le message a été publié ou mis en file.
+ */
+bool publie_message(int index_topic, JsonDocument &jsonDoc, bool retenu, int encodage, int classe, bool *differe) {
+  bool ok;
+  if (client.connected()) {
+    ok = publie_flux(Tab_Topics_MQTT[index_topic], jsonDoc, encodage, retenu, classe, differe, NULL);
+  }
+  else {
+    ok = met_en_file(index_topic, jsonDoc, encodage);
+  }
+  jsonDoc.clear();
+  return ok;
+}
+
+/**
+ * @fn void publie_canal(int canal, JsonDocument &jsonDoc, bool complet, int famille, const float *val, int nb)
+ * @brief Publie le message d'un canal de publish_s1 et mémorise ses valeurs s'il a été émis.
+ *
+ * Un changement est publié en classe évènement, un rafraîchissement complet en classe télémétrie.
+ * Seul un changement (ou la republication qui suit une connexion) est retenu par le serveur :
+ * le rafraîchissement périodique d'une valeur inchangée ne réécrit pas le message retenu.
+ * Un message refusé par la régulation de débit est différé : le canal est republié au cycle suivant,
+ * et le refus n'est compté qu'une fois jusqu'à l'émission du canal (Struct_Canal_MQTT::Differe).
+ */
+void publie_canal(int canal, JsonDocument &jsonDoc, bool complet, int famille, const float *val, int nb) {
+  bool retenu = Republication_complete || canal_modifie(canal, val, nb, famille);
+  if (publie_message(canal, jsonDoc, retenu, Encodage_Famille[famille], complet ? CLASSE_TELEMETRIE : CLASSE_EVENEMENT, &Tab_Canal_MQTT[canal].Differe)) {
+    memorise_canal(canal, val, nb);
+  }
+  else {
+    Tab_Canal_MQTT[canal].Publie = false;
+  }
+}
+
+/**
+ * @fn void rejoue_file_attente()
+ * @brief Rejeu dans l'ordre des messages mis en file pendant une coupure.
+ *
+ * Un message au plus est rejoué par passage dans loop_MQTT(), dans la limite de Rejeu.Par_seconde :
+ * le trafic courant, publié directement, n'attend pas la fin du rejeu. Les messages rejoués ne sont
+ * pas retenus pour ne pas remplacer l'état courant par un état ancien. Un message dont l'index de topic
+ * a été enregistré avec une autre table des topics (préfixe modifié, microprogramme différent) est écarté.
+ */
+void rejoue_file_attente() {
+  unsigned long maintenant = millis();
+  if (maintenant - Rejeu.Debut_fenetre >= 1000) {
+    Rejeu.Debut_fenetre = maintenant;
+    Rejeu.Nb_fenetre = 0;
+  }
+  if (Rejeu.Nb_fenetre >= Rejeu.Par_seconde) {return;}
+
+  Struct_Entete_Differe entete;
+  if (!File_attente_tete(&entete, Tampon_differe)) {return;}
+  if (entete.Topic < 0 || entete.Topic >= NB_TOPICS_MQTT || entete.Version_topics != Version_Topics_MQTT) {
+    Rejeu.Obsoletes++;
+    Rejeu.Tete_differee = false;
+    File_attente_retire();
+    return;
+  }
+
+  const char *topic = Tab_Topics_MQTT[entete.Topic];
+  size_t octets_topic;
+  size_t paquet = client.taille_publish(topic, entete.Taille, NULL, &octets_topic);
+  if (!Debit_autorise(CLASSE_TELEMETRIE, paquet, &Rejeu.Tete_differee)) {return;}
+  if (!client.beginPublish(topic, entete.Taille, false)) {
+    interrompt_publication();
+    return;
+  }
+  size_t ecrit = client.write(Tampon_differe, entete.Taille);
+  client.endPublish();
+  if (ecrit != entete.Taille) {
+    // Le message reste en tête de file et sera rejoué sur la session suivante
+    interrompt_publication();
+    return;
+  }
+  compte_publication(paquet, octets_topic);
+  File_attente_retire();
+
+  Rejeu.Nb_fenetre++;
+  Rejeu.Rejoues++;
+  if (!entete.Ancien) {
+    Rejeu.Retard_ms = maintenant - entete.Acquisition_ms;
+    if (Rejeu.Retard_ms > Rejeu.Retard_max_ms) {Rejeu.Retard_max_ms = Rejeu.Retard_ms;}
+  }
+}
+
+/**
+ * @fn void demande_publication()
+ * @brief Demande une publication des changements au prochain passage dans loop_MQTT().
+ *
+ * Appelée à chaque changement d'une sortie, pour qu'un changement de vanne soit publié
+ * sans attendre la fin de la période de boucle, sur MQTT comme sur le flux WebSocket.
+ */
+void demande_publication() {
+  Publication_demandee = true;
+  demande_instantane_API();
+}
+
+/**
+ * @fn void publish_s1_document()
+ * @brief Publication de tous les canaux activés dans un seul document JSON sur _out/Etat.
+ *
+ * Le document est regroupé par type de canal et porte un numéro de séquence et un horodatage
+ * (ms UTC si NTP est disponible, sinon ms depuis le démarrage). Il est sérialisé directement
+ * dans la socket (voir publie_flux).
+ */
+void publish_s1_document() {
+  construit_document_etat();
+
+  /// @brief Document retenu seulement si une valeur a changé depuis le dernier document retenu
+  uint32_t empreinte = empreinte_document_etat();
+  bool retenu = Republication_complete || (empreinte != Empreinte_Etat);
+
+  /// @brief Seule la publication consomme un numéro de séquence : l'API REST et le banc reconstruisent docEtat sans le modifier
+  docEtat["seq"] = ++sequenceDocument;
+
+  /// @brief Document transmis en flux : ni tampon intermédiaire ni agrandissement du tampon du client
+  if (publie_message(TOPIC_ETAT, docEtat, retenu, Encodage_Etat, CLASSE_TELEMETRIE, NULL) && retenu) {
+    Empreinte_Etat = empreinte;
+  }
+}
+
+/**
+ * @fn uint32_t empreinte_document_etat()
+ * @brief Empreinte FNV-1a des valeurs de docEtat, hors numéro de séquence et horodatage.
+ *
+ * Deux documents de même empreinte décrivent le même état : elle sert de version de l'état
+ * (publication retenue, ETag de l'API REST).
+ */
+uint32_t empreinte_document_etat() {
+  Empreinte_FNV empreinte;
+  for (JsonPair p : docEtat.as<JsonObject>()) {
+    if (p.key() == "seq" || p.key() == "ts") {continue;}
+    empreinte.write(p.key().c_str());
+    serializeMsgPack(p.value(), empreinte);
+  }
+  return empreinte.Valeur;
+}
+
+/**
+ * @fn void remplit_document_etat(JsonDocument &doc)
+ * @brief Ajout à doc des valeurs de tous les canaux activés, regroupées par type de canal.
+ *
+ * Le document n'est pas vidé et ne reçoit ni numéro de séquence ni horodatage : c'est à l'appelant
+ * de les poser (docEtat pour la publication, document de réponse de la route Requete).
+ */
+void remplit_document_etat(JsonDocument &doc) {
+  if (EnablePFC8574_1) {
+    JsonArray pcf = doc.createNestedArray("PCF8574_OUT_1");
+    for (int i = 0; i < 8; i++) {pcf.add(Tab_PCF8574_OUT_1[i] ? 1 : 0);}
+  }
+
+  JsonObject gpio_out = doc.createNestedObject("GPIO_OUT");
+  JsonObject gpio_in = doc.createNestedObject("GPIO_IN");
+  JsonObject gpio_ana = doc.createNestedObject("GPIO_ANA");
+  for (int i = 0; i < 8; i++) {
+    if (Tab_GPIO_OUT[i].Enable) {gpio_out[Cle_Voie[i]] = Tab_GPIO_OUT[i].Valeur;}
+    if (Tab_GPIO_IN[i].Enable) {gpio_in[Cle_Voie[i]] = Tab_GPIO_IN[i].Valeur;}
+    if (Tab_GPIO_ANA[i].Enable) {gpio_ana[Cle_Voie[i]] = Tab_GPIO_ANA[i].Valeur;}
+  }
+
+  JsonObject pt100 = doc.createNestedObject("PT100");
+  JsonObject sonde = doc.createNestedObject("Sonde");
+  for (int i = 0; i < 4; i++) {
+    if (Tab_PT100[i].Enable) {pt100[Cle_Voie[i]] = Tab_PT100[i].Valeur;}
+    if (Tab_Sonde[i].Enable) {sonde[Cle_Voie[i]] = Tab_Sonde[i].Valeur;}
+  }
+
+  JsonObject impulsion = doc.createNestedObject("Impulsion");
+  for (int i = 0; i < 2; i++) {
+    if (!Tab_Impulsion[i].Enable) {continue;}
+    JsonObject imp = impulsion.createNestedObject(Cle_Voie[i]);
+    imp["Cumul"] = Tab_Impulsion[i].Valeur_Cumul;
+    imp["Imp_par_sec"] = Tab_Impulsion[i].Valeur_ps;
+    imp["Imp_par_min"] = Tab_Impulsion[i].Valeur_pmin;
+  }
+
+  if (EnableTelemetre) {doc["Telemetre"] = Telemetre.Valeur;}
+
+  if (EnableBME280 || EnableBMP280) {
+    JsonObject meteo = doc.createNestedObject("Meteo");
+    meteo["temperature_1"] = Temperature(0);
+    meteo["temperature_2"] = Temperature(1);
+    meteo["temperature_max"] = Temperature_max();
+    meteo["temperature_min"] = Temperature_min();
+    meteo["pressure"] = Pression();
+    meteo["humidity"] = Humidite();
+  }
+
+  JsonArray user = doc.createNestedArray("User");
+  for (int i = 0; i < 16; i++) {
+    JsonArray u = user.createNestedArray();
+    u.add(Tab_Info_USER[i].Val_INT);
+    u.add(Tab_Info_USER[i].Val_LONG);
+    u.add(Tab_Info_USER[i].Val_FLOAT);
+  }
+}
+
+/**
+ * @fn void construit_document_etat()
+ * @brief Construction du document agrégé de tous les canaux activés dans docEtat.
+ *
+ * "seq" reçoit le numéro du dernier document publié : la construction ne consomme pas de numéro,
+ * publish_s1_document numérote le document qu'elle publie.
+ */
+void construit_document_etat() {
+  docEtat.clear();
+  docEtat["seq"] = sequenceDocument;
+  docEtat["ts"] = horodatage_ms();
+  remplit_document_etat(docEtat);
+
+  if (docEtat.overflowed()) {
+    Serial.println("Document agrégé tronqué : capacité de docEtat insuffisante");
+  }
+}
+
+/**
+ * @fn unsigned long cycles_en_ns(uint32_t cycles)
+ * @brief Conversion d'une durée mesurée au compteur de cycles du processeur en ns.
+ */
+unsigned long cycles_en_ns(uint32_t cycles) {
+  return (unsigned long)((uint64_t)cycles * 1000 / ESP.getCpuFreqMHz());
+}
+
+/**
+ * @fn void affiche_diagnostic_MQTT()
+ * @brief Affiche les compteurs de trafic de publication (par message et par cycle).
+ */
+void affiche_diagnostic_MQTT() {
+  if(!EnableMQTT){return;}
+  unsigned long moyenne_message = 0;
+  unsigned long moyenne_cycle = 0;
+  if (Stat_MQTT.Messages_total > 0) {moyenne_message = Stat_MQTT.Octets_total / Stat_MQTT.Messages_total;}
+  if (Stat_MQTT.Cycles > 0) {moyenne_cycle = Stat_MQTT.Octets_total / Stat_MQTT.Cycles;}
+  Serial.println("MQTT :");
+  Serial.printf("   Mode : %s, cycles : %lu\n", modeDocument ? "document" : "topic", Stat_MQTT.Cycles);
+  Serial.printf("   Dernier cycle : %lu messages, %lu octets\n", Stat_MQTT.Messages_cycle, Stat_MQTT.Octets_cycle);
+  Serial.printf("   Moyenne : %lu octets/message, %lu octets/cycle, max %lu octets/message\n", moyenne_message, moyenne_cycle, Stat_MQTT.Octets_max);
+  Serial.printf("   Topics : %lu octets au dernier cycle\n", Stat_MQTT.Octets_topics_cycle);
+  Serial.printf("   Publications interrompues : %lu\n", Stat_MQTT.Echecs);
+  Serial.printf("   Tas consomme max par publication : %u octets, marge de pile min : %u octets\n", Stat_MQTT.Tas_publication_max, Stat_MQTT.Pile_libre_min);
+  unsigned long coupure = Connexion_MQTT.Coupure_cumul_ms;
+  if (Connexion_MQTT.Debut_coupure != 0) {coupure += millis() - Connexion_MQTT.Debut_coupure;}
+  Serial.printf("   Connexion : %s, %lu tentatives, %lu connexions, %lu coupures\n", Connexion_MQTT.Etat == MQTT_CONNECTE ? "etablie" : "coupee", Connexion_MQTT.Tentatives, Connexion_MQTT.Connexions, Connexion_MQTT.Coupures);
+  Serial.printf("   Coupures : %lu ms au total, %lu ms au plus long, prochaine attente %lu ms\n", coupure, Connexion_MQTT.Coupure_max_ms, Connexion_MQTT.Attente_ms);
+  Serial.printf("   Rejeu : %lu messages, %d/s max, retard dernier %lu ms, max %lu ms, %lu obsoletes ecartes\n", Rejeu.Rejoues, Rejeu.Par_seconde, Rejeu.Retard_ms, Rejeu.Retard_max_ms, Rejeu.Obsoletes);
+  uint32_t cycles_moyens = 0;
+  if (Stat_Routeur.Recherches > 0) {cycles_moyens = (uint32_t)(Stat_Routeur.Cycles_cumul / Stat_Routeur.Recherches);}
+  Serial.printf("   Commandes : %lu routees, %lu sans route, %lu en erreur, %lu doublons\n", Stat_Routeur.Routees, Stat_Routeur.Inconnues, Stat_Routeur.Erreurs, Stat_Routeur.Doublons);
+  Serial.printf("   Acquittements differes : %lu (reemis %lu, perdus %lu), %d en attente\n", File_Ack.Differes, File_Ack.Reemis, File_Ack.Perdus, File_Ack.Nb);
+  Serial.printf("   Aiguillage : %d routes, latence moyenne %lu ns (%lu cycles), max %lu ns\n", Routeur_MQTT.Nb, cycles_en_ns(cycles_moyens), (unsigned long)cycles_moyens, cycles_en_ns(Stat_Routeur.Cycles_max));
+  if (Nb_Serveurs_MQTT > 1) {
+    Serial.printf("   Bascules : %lu (dont %lu retours au serveur préféré), derniere %lu ms, max %lu ms\n", Bascule_MQTT.Bascules, Bascule_MQTT.Retours, Bascule_MQTT.Bascule_ms, Bascule_MQTT.Bascule_max_ms);
+    for (int i = 0; i < Nb_Serveurs_MQTT; i++) {
+      Serial.printf("   %c Serveur %d %s:%d : %lu connexions, %lu echecs (%lu consecutifs)\n", i == Serveur_actif ? '*' : ' ', i, Tab_Serveurs_MQTT[i].Hote.c_str(), Tab_Serveurs_MQTT[i].Port, Tab_Serveurs_MQTT[i].Connexions, Tab_Serveurs_MQTT[i].Echecs, Tab_Serveurs_MQTT[i].Echecs_consecutifs);
+    }
+  }
+  client.affiche_diagnostic();
+  if (EnableTLS) {Client_TLS.affiche_diagnostic();}
+}
+
+/**
+ * @fn void mesure_encodage(JsonDocument &source, int encodage, JsonDocument &decode, size_t *taille, unsigned long *t_code, unsigned long *t_decode)
+ * @brief Mesure la taille et le temps moyen (en µs) d'encodage et de décodage d'un document.
+ */
+void mesure_encodage(JsonDocument &source, int encodage, JsonDocument &decode, size_t *taille, unsigned long *t_code, unsigned long *t_decode) {
+  const int nb_iterations = 100;
+  size_t capacite = mesure_message(source, encodage) + 1;
+  std::unique_ptr<char[]> tampon(new char[capacite]);
+  unsigned long debut = micros();
+  for (int n = 0; n < nb_iterations; n++) {
+    *taille = serialise_message(source, encodage, tampon.get(), capacite);
+  }
+  *t_code = (micros() - debut) / nb_iterations;
+
+  debut = micros();
+  for (int n = 0; n < nb_iterations; n++) {
+    decode_commande(decode, tampon.get(), *taille);
+  }
+  *t_decode = (micros() - debut) / nb_iterations;
+}
+
+/**
+ * @fn void banc_encodage_MQTT()
+ * @brief Comparaison JSON / MessagePack sur les messages réellement publiés.
+ *
+ * Mesure la taille et le coût CPU d'encodage et de décodage d'un message à une valeur
+ * (mode topic) et du document agrégé (mode document), à partir des valeurs courantes des canaux.
+ */
+void banc_encodage_MQTT() {
+  if(!EnableMQTT){return;}
+  const char *Nom_Encodage[2] = {"JSON", "MessagePack"};
+  DynamicJsonDocument decode(4096);
+  StaticJsonDocument<64> valeur;
+  size_t taille;
+  unsigned long t_code, t_decode;
+
+  valeur["Valeur"] = Tab_GPIO_ANA[0].Valeur;
+  construit_document_etat();
+
+  Serial.println("Banc d'encodage MQTT :");
+  for (int e = ENCODAGE_JSON; e <= ENCODAGE_MSGPACK; e++) {
+    mesure_encodage(valeur, e, decode, &taille, &t_code, &t_decode);
+    Serial.printf("   %-11s valeur   : %4u octets (paquet %lu), codage %lu us, decodage %lu us\n", Nom_Encodage[e], (unsigned)taille, taille_paquet_publish(strlen(Tab_Topics_MQTT[CANAL_GPIO_ANA]), taille), t_code, t_decode);
+    mesure_encodage(docEtat, e, decode, &taille, &t_code, &t_decode);
+    Serial.printf("   %-11s document : %4u octets (paquet %lu), codage %lu us, decodage %lu us\n", Nom_Encodage[e], (unsigned)taille, taille_paquet_publish(strlen(Tab_Topics_MQTT[TOPIC_ETAT]), taille), t_code, t_decode);
+  }
+}
+
+/**
+ * @fn void banc_routeur_gestionnaire(Struct_Commande &cmd)
+ * @brief Gestionnaire vide des routes du banc de mesure.
+ */
+void banc_routeur_gestionnaire(Struct_Commande &cmd) {
+}
+
+/**
+ * @fn void banc_routeur(int nb_routes)
+ * @brief Mesure du temps d'aiguillage avec un grand nombre de routes.
+ *
+ * Un routeur temporaire est rempli de nb_routes routes synthétiques. Le temps moyen de recherche
+ * est comparé à celui d'un balayage séquentiel avec strcmp (méthode de l'ancien update_Subscribe1),
+ * pour la première et la dernière route enregistrée. Une recherche dure moins d'une µs : elle est
+ * répétée nb_recherches fois et mesurée au compteur de cycles du processeur.
+ */
+void banc_routeur(int nb_routes) {
+  const int nb_recherches = 10000;
+  int capacite = 1;
+  while (3 * capacite < 4 * nb_routes + 4) {capacite <<= 1;}
+
+  Struct_Route *table = new Struct_Route[capacite];
+  char (*suffixes)[TAILLE_SUFFIXE_ROUTE] = new char[nb_routes][TAILLE_SUFFIXE_ROUTE];
+  Struct_Routeur routeur;
+  Routeur_init(&routeur, table, capacite);
+  for (int i = 0; i < nb_routes; i++) {
+    snprintf(suffixes[i], TAILLE_SUFFIXE_ROUTE, "Canal_%d/Commande", i + 1);
+    Routeur_ajoute(&routeur, suffixes[i], banc_routeur_gestionnaire, i, FORMAT_VIDE);
+  }
+
+  Serial.printf("Banc du routeur : %d routes, table de %d entrees\n", routeur.Nb, capacite);
+  const int cibles[2] = {0, nb_routes - 1};
+  for (int c = 0; c < 2; c++) {
+    const char *cible = suffixes[cibles[c]];
+    volatile int trouve = 0;
+
+    uint32_t debut = ESP.getCycleCount();
+    for (int n = 0; n < nb_recherches; n++) {
+      if (Routeur_cherche(&routeur, cible) != NULL) {trouve++;}
+    }
+    uint32_t c_hash = ESP.getCycleCount() - debut;
+
+    debut = ESP.getCycleCount();
+    for (int n = 0; n < nb_recherches; n++) {
+      for (int i = 0; i < nb_routes; i++) {
+        if (strcmp(suffixes[i], cible) == 0) {trouve++; break;}
+      }
+    }
+    uint32_t c_lineaire = ESP.getCycleCount() - debut;
+
+    Serial.printf("   Route %d : table de hachage %lu cycles (%lu ns), balayage %lu cycles (%lu ns)\n", cibles[c] + 1,
+                  (unsigned long)(c_hash / nb_recherches), cycles_en_ns(c_hash / nb_recherches),
+                  (unsigned long)(c_lineaire / nb_recherches), cycles_en_ns(c_lineaire / nb_recherches));
+  }
+
+  delete[] suffixes;
+  delete[] table;
+}
+
+/**
+ * @fn void publish_s1()
+ * @brief Fonction de publication des variables de l'ESP sur le canal 1 MQTT.
+ * Cette fonction publie les données suivantes ;
+ * - La 8 voies de l'extention PCF8574 sur    _out/PCF8574_OUT_1_
+ * - La valeur des 8 GPIO OUT sur             _out/GPIO_OUT_x/Valeur
+ * - La valeur des 8 GPIO IN sur              _out/GPIO_IN_x/Valeur
+ * - La valeur des 8 GPIO ANA sur             _out/GPIO_ANA_x/Valeur
+ * - La valeur des 4 PT100 sur                _out/PT100_x/Valeur
+ * - La valeur des 4 Sondes sur               _out/Sonde_x/Valeur
+ * - La valeur des 2 capteurs d'impulsion sur _out/Impulsion_x/{Cumul,Imp_par_sec,Imp_par_min}
+ * - La valeur du télémètre sur               _out/Telemetre/Valeur
+ * - Les valeurs des données météo   sur      _out/Telemetre/{temperature,temperature max,temperature min,pressure,humidity}
+ * - La valeur des User sur                   _out/User/{INT,LONG,FLOAT}
+ *
+ * En mode document, tous les canaux sont publiés dans un seul message (voir publish_s1_document).
+ * Seuls les canaux activés sont publiés, et seulement lorsque leur valeur a changé (voir canal_a_publier).
+ * Tous les canaux activés sont republiés à la période de rafraîchissement (MQTT_periode_rafraichissement,
+ * en secondes). Seuls les changements sont retenus par le serveur, et tout l'état est republié en message
+ * retenu après chaque connexion : un tableau de bord qui s'abonne reçoit immédiatement l'état courant.
+ * Pendant une coupure, les messages sont mis en file et rejoués après la reconnexion (voir rejoue_file_attente).
+ * 
+ * @param void
+ * @return void
+ */
+void publish_s1() {
+  if(!EnableMQTT){return;}
+
+  DEBUG_PRINT_MQTT("Fonction publish_s1");
+
+  Stat_MQTT.Cycles++;
+  Stat_MQTT.Messages_cycle = 0;
+  Stat_MQTT.Octets_cycle = 0;
+  Stat_MQTT.Octets_topics_cycle = 0;
+
+  if (modeDocument) {
+    publish_s1_document();
+    Republication_complete = false;
+    return;
+  }
+
+  StaticJsonDocument<256> jsonDoc;
+  float val[6];
+
+  /// @brief Rafraîchissement complet à la période configurée, et republication complète retenue après une connexion
+  bool complet = (millis() - dernierRafraichissement >= (unsigned long)periodeRafraichissement * 1000UL) || (dernierRafraichissement == 0) || Republication_complete;
+  if (complet) {
+    dernierRafraichissement = millis();
+    if (dernierRafraichissement == 0) {dernierRafraichissement = 1;}
+  }
+
+  /// @brief Construction du message MQTT vers PCF8574_OUT_1_x (x compris entre 1 et 8)
+  for(int i=0; i<8 && EnablePFC8574_1; i++){
+    val[0] = Tab_PCF8574_OUT_1[i];
+    if (!canal_a_publier(CANAL_PCF8574_OUT_1+i, val, 1, FAMILLE_TOR, complet)) {continue;}
+    jsonDoc["port_status"] = Tab_PCF8574_OUT_1[i];
+
+    /// @brief Publication du message sur le topic _out/PCF8574_OUT_1_x (x compris entre 1 et 8)
+    publie_canal(CANAL_PCF8574_OUT_1+i, jsonDoc, complet, FAMILLE_TOR, val, 1);
+  } 
+
+  /// @brief  Balayage des sorties GPIO digital
+  for(int i=0; i<8; i++){
+    if (!Tab_GPIO_OUT[i].Enable) {continue;}
+    val[0] = Tab_GPIO_OUT[i].Valeur;
+    if (!canal_a_publier(CANAL_GPIO_OUT+i, val, 1, FAMILLE_TOR, complet)) {continue;}
+    jsonDoc["Valeur"] = Tab_GPIO_OUT[i].Valeur;
+
+    /// @brief  Publication du message sur le topic _out/GPIO_OUT_x (x compris entre 1 et 8)
+    publie_canal(CANAL_GPIO_OUT+i, jsonDoc, complet, FAMILLE_TOR, val, 1);
+  }
+
+   /// @brief  Balayage des entrées GPIO digital
+  for(int i=0; i<8; i++){
+    if (!Tab_GPIO_IN[i].Enable) {continue;}
+    val[0] = Tab_GPIO_IN[i].Valeur;
+    if (!canal_a_publier(CANAL_GPIO_IN+i, val, 1, FAMILLE_TOR, complet)) {continue;}
+    jsonDoc["Valeur"] = Tab_GPIO_IN[i].Valeur;
+
+    /// @brief  Publication du message sur le topic _out/GPIO_IN_x (x compris entre 1 et 8)
+    publie_canal(CANAL_GPIO_IN+i, jsonDoc, complet, FAMILLE_TOR, val, 1);
+  } 
+
+  /// @brief  Balayage des entrées GPIO Analog
+  for(int i=0; i<8; i++){
+    if (!Tab_GPIO_ANA[i].Enable) {continue;}
+    val[0] = Tab_GPIO_ANA[i].Valeur;
+    if (!canal_a_publier(CANAL_GPIO_ANA+i, val, 1, FAMILLE_GPIO_ANA, complet)) {continue;}
+    jsonDoc["Valeur"] = Tab_GPIO_ANA[i].Valeur;
+
+    /// @brief  Publication du message sur le topic _out/GPIO_ANA_x (x compris entre 1 et 8)
+    publie_canal(CANAL_GPIO_ANA+i, jsonDoc, complet, FAMILLE_GPIO_ANA, val, 1);
+  } 
+
+
+  /// @brief  Balayage des PT100
+  for(int i=0; i<4; i++){
+    if (!Tab_PT100[i].Enable) {continue;}
+    val[0] = Tab_PT100[i].Valeur;
+    if (!canal_a_publier(CANAL_PT100+i, val, 1, FAMILLE_PT100, complet)) {continue;}
+    jsonDoc["Valeur"] = Tab_PT100[i].Valeur;
+
+    /// @brief  Publication du message sur le topic _out/PT100_x (x compris entre 1 et 4)
+    publie_canal(CANAL_PT100+i, jsonDoc, complet, FAMILLE_PT100, val, 1);
+  } 
+
+    /// @brief  Balayage des Sondes
+  for(int i=0; i<4; i++){
+    if (!Tab_Sonde[i].Enable) {continue;}
+    val[0] = Tab_Sonde[i].Valeur;
+    if (!canal_a_publier(CANAL_SONDE+i, val, 1, FAMILLE_SONDE, complet)) {continue;}
+    jsonDoc["Valeur"] = Tab_Sonde[i].Valeur;
+
+    /// @brief  Publication du message sur le topic _out/Sonde_x (x compris entre 1 et 4)
+    publie_canal(CANAL_SONDE+i, jsonDoc, complet, FAMILLE_SONDE, val, 1);
+  } 
+
+    /// @brief  Balayage des Impulsions
+  for(int i=0; i<2; i++){
+    if (!Tab_Impulsion[i].Enable) {continue;}
+    val[0] = Tab_Impulsion[i].Valeur_Cumul;
+    val[1] = Tab_Impulsion[i].Valeur_ps;
+    val[2] = Tab_Impulsion[i].Valeur_pmin;
+    if (!canal_a_publier(CANAL_IMPULSION+i, val, 3, FAMILLE_IMPULSION, complet)) {continue;}
+    jsonDoc["Cumul"] = Tab_Impulsion[i].Valeur_Cumul;
+    jsonDoc["Imp_par_sec"] = Tab_Impulsion[i].Valeur_ps;
+    jsonDoc["Imp_par_min"] = Tab_Impulsion[i].Valeur_pmin;
+
+    /// @brief  Publication du message sur le topic _out/Impulsion_x (x compris entre 1 et 2)
+    publie_canal(CANAL_IMPULSION+i, jsonDoc, complet, FAMILLE_IMPULSION, val, 3);
+  } 
+
+  /// @brief  Balayage du Télémetre
+  val[0] = Telemetre.Valeur;
+  if (EnableTelemetre && canal_a_publier(CANAL_TELEMETRE, val, 1, FAMILLE_TELEMETRE, complet)) {
+    jsonDoc["Valeur"] = Telemetre.Valeur;
+
+    /// @brief  Publication du message sur le topic _out/Telemetre
+    publie_canal(CANAL_TELEMETRE, jsonDoc, complet, FAMILLE_TELEMETRE, val, 1);
+  }
+  
+  /// @brief  Publication des informations météo 
+  val[0] = Temperature(0);
+  val[1] = Temperature(1);
+  val[2] = Temperature_max();
+  val[3] = Temperature_min();
+  val[4] = Pression();
+  val[5] = Humidite();
+  if ((EnableBME280 || EnableBMP280) && canal_a_publier(CANAL_METEO, val, 6, FAMILLE_METEO, complet)) {
+    jsonDoc["temperature_1"] = val[0];
+    jsonDoc["temperature_2"] = val[1];
+    jsonDoc["temperature_max"] = val[2];
+    jsonDoc["temperature_min"] = val[3];
+    jsonDoc["pressure"] = val[4];
+    jsonDoc["humidity"] = val[5];
+
+    /// @brief  Publication du message sur le topic _out/Meteo
+    publie_canal(CANAL_METEO, jsonDoc, complet, FAMILLE_METEO, val, 6);
+  }
+
+  /// @brief  Balayage des User
+  for(int i=0; i<16; i++){
+    val[0] = Tab_Info_USER[i].Val_INT;
+    val[1] = Tab_Info_USER[i].Val_LONG;
+    val[2] = Tab_Info_USER[i].Val_FLOAT;
+    if (!canal_a_publier(CANAL_USER+i, val, 3, FAMILLE_USER, complet)) {continue;}
+    jsonDoc["INT"] = Tab_Info_USER[i].Val_INT;
+    jsonDoc["LONG"] = Tab_Info_USER[i].Val_LONG;
+    jsonDoc["FLOAT"] = Tab_Info_USER[i].Val_FLOAT;
+
+    /// @brief  Publication du message sur le topic _out/User_x (x compris entre 1 et 16)
+    publie_canal(CANAL_USER+i, jsonDoc, complet, FAMILLE_USER, val, 3);
+  } 
+  Republication_complete = false;
+}
+
+/**
+ * @fn int applique_commande(Struct_Commande &cmd, int type, int num, int val)
+ * @brief Applique une commande de sortie reçue en MQTT, immédiatement ou à l'instant demandé.
+ *
+ * Une commande peut porter un champ optionnel "delai" (en ms) ou "at" (instant UTC en ms depuis l'époque,
+ * nécessite NTP). Elle est alors confiée au planificateur et exécutée sur le timer matériel.
+ *
+ * @param cmd Commande décodée.
+ * @param type Type de sortie (Type_Commande).
+ * @param num Numéro de la sortie.
+ * @param val Valeur à appliquer.
+ * @return 1 si la commande a été appliquée ou planifiée, 0 sinon.
+ */
+int applique_commande(Struct_Commande &cmd, int type, int num, int val) {
+  cmd.Valeur = val;
+  if (!cmd.Planifiee) {
+    cmd.Resultat = Execute_commande(type, num, val);
+    cmd.Application_us = esp_timer_get_time();
+    return cmd.Resultat;
+  }
+
+  cmd.Resultat = Planifie_commande(type, num, val, cmd.Delai_us);
+  cmd.Application_us = esp_timer_get_time();
+  if (cmd.Resultat == 0) {
+    Serial.println("File du planificateur pleine, commande ignorée");
+    return 0;
+  }
+  DEBUG_PRINT_MQTT("Commande planifiée dans " + String((long)(cmd.Delai_us / 1000)) + " ms");
+  return 1;
+}
+
+/**
+ * @fn Struct_Id_Commande *cherche_id_commande(const char *id)
+ * @brief Recherche un identifiant de commande déjà exécuté.
+ *
+ * @return L'entrée de l'identifiant, ou NULL s'il n'a pas été vu.
+ */
+Struct_Id_Commande *cherche_id_commande(const char *id) {
+  for (int i = 0; i < NB_ID_COMMANDE; i++) {
+    if (Tab_Id_Commande[i].Usage != 0 && strcmp(Tab_Id_Commande[i].Id, id) == 0) {
+      Tab_Id_Commande[i].Usage = ++Usage_Id_Commande;
+      return &Tab_Id_Commande[i];
     }
+  }
+  return NULL;
+}
 
-  //Pour un topic PWM
-  sprintf(topicBuffer, "%s/PWM",mqttSubscribe);
-  Serial.println(topicBuffer);
-    if (strcmp(topic, topicBuffer) == 0) {
-      StaticJsonDocument<200> jsonDoc; // Ajustez la taille en fonction de votre message JSON
-      DeserializationError error = deserializeJson(jsonDoc, message);
-        if (error) {
-          Serial.print("Erreur lors de la désérialisation JSON: ");
-          Serial.println(error.c_str());
-          return;
-        }
-      
-      uint8_t ValPort = jsonDoc["val_servo"]; 
-      uint8_t NumPort = jsonDoc["num_servo"];
-      Serial.println("Changement Etat de Sortie servo " + String(NumPort) + " Valeur : " + String(ValPort)) ;
-      PWM_OUT(NumPort, ValPort);
+/**
+ * @fn void memorise_id_commande(const char *id, int resultat, int valeur)
+ * @brief Mémorise un identifiant de commande exécuté, à la place du moins récemment utilisé.
+ */
+void memorise_id_commande(const char *id, int resultat, int valeur) {
+  int ancien = 0;
+  for (int i = 1; i < NB_ID_COMMANDE; i++) {
+    if (Tab_Id_Commande[i].Usage < Tab_Id_Commande[ancien].Usage) {ancien = i;}
+  }
+  strncpy(Tab_Id_Commande[ancien].Id, id, TAILLE_ID_COMMANDE - 1);
+  Tab_Id_Commande[ancien].Id[TAILLE_ID_COMMANDE - 1] = '\0';
+  Tab_Id_Commande[ancien].Usage = ++Usage_Id_Commande;
+  Tab_Id_Commande[ancien].Resultat = resultat;
+  Tab_Id_Commande[ancien].Valeur = valeur;
+}
+
+/**
+ * @fn void ajoute_etat_sorties(JsonObject etat)
+ * @brief État combiné des sorties activées : octets PCF8574_OUT_1 et GPIO_OUT (bit i : sortie i / i+1), angles et PWM par index.
+ */
+void ajoute_etat_sorties(JsonObject etat) {
+  Struct_Lot_Sorties sorties;
+  Sorties_etat(&sorties);
+  if (sorties.Masque_PCF8574_1) {etat["PCF8574_OUT_1"] = sorties.Valeurs_PCF8574_1;}
+  etat["GPIO_OUT"] = sorties.Valeurs_GPIO_OUT;
+  JsonObject servo = etat.createNestedObject("Servo");
+  JsonObject pwm = etat.createNestedObject("PWM");
+  for (int i = 0; i < 4; i++) {
+    if (sorties.Masque_Servo & (1 << i)) {servo[Cle_Index[i]] = sorties.Servo[i];}
+    if (sorties.Masque_PWM & (1 << i)) {pwm[Cle_Index[i]] = sorties.PWM[i];}
+  }
+}
+
+/**
+ * @fn void differe_acquittement(const char *topic, JsonDocument &jsonDoc, int encodage, const Struct_Proprietes_MQTT *proprietes)
+ * @brief Conserve un acquittement non émis (régulation de débit, publication interrompue) pour le réémettre,
+ * avec la Correlation Data de la commande.
+ */
+void differe_acquittement(const char *topic, JsonDocument &jsonDoc, int encodage, const Struct_Proprietes_MQTT *proprietes) {
+  if (File_Ack.Nb >= NB_ACK_DIFFERES || mesure_message(jsonDoc, encodage) > TAILLE_ACK_DIFFERE) {
+    File_Ack.Perdus++;
+    return;
+  }
+  Struct_Ack_Differe *ack = &File_Ack.Tab[(File_Ack.Tete + File_Ack.Nb) % NB_ACK_DIFFERES];
+  strcpy(ack->Topic, topic);
+  ack->Taille_correlation = 0;
+  if (proprietes != NULL && proprietes->Correlation != NULL) {
+    ack->Taille_correlation = proprietes->Taille_correlation;
+    memcpy(ack->Correlation, proprietes->Correlation, proprietes->Taille_correlation);
+  }
+  ack->Taille = serialise_message(jsonDoc, encodage, (char*)ack->Message, sizeof(ack->Message));
+  File_Ack.Nb++;
+  File_Ack.Differes++;
+}
+
+/**
+ * @fn void reemet_acquittements()
+ * @brief Réémission dans l'ordre des acquittements en attente, dans la limite des jetons de la classe Ack.
+ */
+void reemet_acquittements() {
+  while (File_Ack.Nb > 0) {
+    Struct_Ack_Differe *ack = &File_Ack.Tab[File_Ack.Tete];
+    Struct_Proprietes_MQTT proprietes;
+    proprietes.Correlation = ack->Correlation;
+    proprietes.Taille_correlation = ack->Taille_correlation;
+    // Le refus de l'acquittement a été compté à sa mise en attente
+    bool differe = true;
+    size_t octets_topic;
+    size_t paquet = client.taille_publish(ack->Topic, ack->Taille, &proprietes, &octets_topic);
+    if (!Debit_autorise(CLASSE_ACK, paquet, &differe)) {return;}
+    if (!client.beginPublish(ack->Topic, ack->Taille, false, &proprietes)) {
+      interrompt_publication();
+      return;
+    }
+    size_t ecrit = client.write(ack->Message, ack->Taille);
+    client.endPublish();
+    if (ecrit != ack->Taille) {
+      interrompt_publication();
+      return;
+    }
+    compte_publication(paquet, octets_topic);
+    File_Ack.Tete = (File_Ack.Tete + 1) % NB_ACK_DIFFERES;
+    File_Ack.Nb--;
+    File_Ack.Reemis++;
+  }
+}
+
+/**
+ * @fn const Struct_Proprietes_MQTT *proprietes_reponse()
+ * @brief Propriétés de la réponse à la commande en cours : sa Correlation Data, NULL si elle n'en porte pas.
+ */
+const Struct_Proprietes_MQTT *proprietes_reponse() {
+  static Struct_Proprietes_MQTT proprietes;
+  if (Reponse_commande.Taille_correlation == 0) {return NULL;}
+  proprietes.Correlation = Reponse_commande.Correlation;
+  proprietes.Taille_correlation = Reponse_commande.Taille_correlation;
+  return &proprietes;
+}
+
+/**
+ * @fn void acquitte_commande(const char *suffixe, const char *id, int encodage, int resultat, int valeur, long latence_us, bool doublon, const char *erreur)
+ * @brief Publie l'acquittement d'une commande sur _out/Ack, ou sur le topic de réponse de la commande.
+ *
+ * L'acquittement porte la Correlation Data de la commande (propriété MQTT 5), et reprend dans le message
+ * l'identifiant de la commande, l'état appliqué et la latence entre la réception
+ * du message et l'application sur la sortie : le serveur en déduit le temps d'aller-retour de bout en bout.
+ * Un acquittement qui ne peut pas être émis est mis en attente, derrière ceux qui attendent déjà.
+ *
+ * @param suffixe Route de la commande (suffixe du topic).
+ * @param id Identifiant de la commande, chaîne vide si absent.
+ * @param encodage Encodage de l'acquittement (celui de la commande).
+ * @param resultat 1 si la commande a été appliquée ou planifiée.
+ * @param valeur Valeur appliquée.
+ * @param latence_us Latence réception / application en µs (-1 si non applicable).
+ * @param doublon Commande déjà exécutée, non réappliquée.
+ * @param erreur Motif du refus, NULL si aucun.
+ */
+void acquitte_commande(const char *suffixe, const char *id, int encodage, int resultat, int valeur, long latence_us, bool doublon, const char *erreur) {
+  StaticJsonDocument<512> jsonDoc;
+  if (id[0] != '\0') {jsonDoc["id"] = id;}
+  jsonDoc["cmd"] = suffixe;
+  jsonDoc["ok"] = resultat;
+  jsonDoc["val"] = valeur;
+  if (latence_us >= 0) {jsonDoc["latence_us"] = latence_us;}
+  if (doublon) {jsonDoc["doublon"] = 1;}
+  if (erreur != NULL) {jsonDoc["erreur"] = erreur;}
+  if (Reponse_commande.Etat_sorties) {ajoute_etat_sorties(jsonDoc.createNestedObject("etat"));}
+
+  /// @brief Un acquittement refusé par la régulation de débit n'est pas perdu : il est réémis dans l'ordre (voir reemet_acquittements)
+  const char *topic = (Reponse_commande.Topic[0] != '\0') ? Reponse_commande.Topic : Tab_Topics_MQTT[TOPIC_ACK];
+  const Struct_Proprietes_MQTT *proprietes = proprietes_reponse();
+  if (File_Ack.Nb > 0 || !publie_flux(topic, jsonDoc, encodage, false, CLASSE_ACK, NULL, proprietes)) {
+    differe_acquittement(topic, jsonDoc, encodage, proprietes);
+  }
+}
+
+/**
+ * @fn void lit_id_commande(JsonDocument &jsonDoc, Struct_Commande &cmd)
+ * @brief Lecture de l'identifiant optionnel "id" (chaîne ou nombre) d'une commande.
+ */
+void lit_id_commande(JsonDocument &jsonDoc, Struct_Commande &cmd) {
+  if (!jsonDoc.containsKey("id")) {return;}
+  if (jsonDoc["id"].is<const char*>()) {
+    strncpy(cmd.Id, jsonDoc["id"].as<const char*>(), TAILLE_ID_COMMANDE - 1);
+    cmd.Id[TAILLE_ID_COMMANDE - 1] = '\0';
+  }
+  else {
+    snprintf(cmd.Id, sizeof(cmd.Id), "%lld", jsonDoc["id"].as<long long>());
+  }
+}
+
+/**
+ * @fn bool decode_planification(JsonDocument &jsonDoc, Struct_Commande &cmd)
+ * @brief Décodage des champs de planification "delai" (ms) et "at" (ms UTC depuis l'époque).
+ *
+ * @return false si la commande est planifiée à un instant absolu alors que l'heure n'est pas synchronisée.
+ */
+bool decode_planification(JsonDocument &jsonDoc, Struct_Commande &cmd) {
+  if (jsonDoc.containsKey("delai")) {
+    cmd.Planifiee = true;
+    cmd.Delai_us = jsonDoc["delai"].as<int64_t>() * 1000;
+  }
+  else if (jsonDoc.containsKey("at")) {
+    uint64_t maintenant = temps_epoch_ms();
+    if (maintenant == 0) {
+      Serial.println("Heure non synchronisée, commande planifiée ignorée");
+      return false;
+    }
+    cmd.Planifiee = true;
+    cmd.Delai_us = (jsonDoc["at"].as<int64_t>() - (int64_t)maintenant) * 1000;
+  }
+  return true;
+}
+
+/**
+ * @fn void commande_PCF8574(Struct_Commande &cmd)
+ * @brief Gestionnaire du topic PCF8574_OUT_1_x : {"val_port": 0|1}.
+ */
+void commande_PCF8574(Struct_Commande &cmd) {
+  bool valPort = cmd.Val != 0;
+  Serial.println("PCF8574_OUT_1_" + String(cmd.Num) + (valPort ? " = TRUE!!!" : " = LOW!!!"));
+  applique_commande(cmd, CMD_PCF8574_OUT_1, cmd.Num, valPort);
+}
+
+/**
+ * @fn void commande_GPIO_OUT(Struct_Commande &cmd)
+ * @brief Gestionnaire du topic GPIO_OUT : {"num_port": n, "val_port": v}.
+ */
+void commande_GPIO_OUT(Struct_Commande &cmd) {
+  Serial.println("Changement Etat de Sortie Bit " + String(cmd.Num) + " Valeur : " + String(cmd.Val));
+  applique_commande(cmd, CMD_GPIO_OUT, cmd.Num, cmd.Val);
+}
+
+/**
+ * @fn void commande_ServoMoteur(Struct_Commande &cmd)
+ * @brief Gestionnaire du topic ServoMoteur : {"num_servo": n, "val_servo": v}.
+ */
+void commande_ServoMoteur(Struct_Commande &cmd) {
+  Serial.println("Changement Etat de Sortie servo " + String(cmd.Num) + " Valeur : " + String(cmd.Val));
+  applique_commande(cmd, CMD_SERVO, cmd.Num, cmd.Val);
+}
+
+/**
+ * @fn void commande_PWM(Struct_Commande &cmd)
+ * @brief Gestionnaire du topic PWM : {"num_pwm": n, "val_pwm": v}.
+ */
+void commande_PWM(Struct_Commande &cmd) {
+  Serial.println("Changement Etat de Sortie PWM " + String(cmd.Num) + " Valeur : " + String(cmd.Val));
+  if (Regulation_voie_reservee(cmd.Num)) {
+    cmd.Erreur = "PWM pilotée par la régulation";
+    cmd.Resultat = 0;
+    return;
+  }
+  applique_commande(cmd, CMD_PWM, cmd.Num, cmd.Val);
+}
+
+/**
+ * @fn void commande_Regulation(Struct_Commande &cmd)
+ * @brief Gestionnaire du topic Regulation : {"consigne": c} et/ou {"Kp": p, "Ki": i, "Kd": d}.
+ */
+void commande_Regulation(Struct_Commande &cmd) {
+  if (!isnan(cmd.Kp) || !isnan(cmd.Ki) || !isnan(cmd.Kd)) {
+    // Les gains absents de la commande (NAN) sont conservés
+    Regulation_gains(cmd.Kp, cmd.Ki, cmd.Kd);
+  }
+  if (!isnan(cmd.Consigne)) {
+    Serial.println("Changement de consigne de regulation : " + String(cmd.Consigne));
+    Regulation_consigne(cmd.Consigne);
+  }
+}
+
+/**
+ * @fn void lit_masque_lot(JsonVariant groupe, uint8_t *masque, uint8_t *valeurs)
+ * @brief Lecture d'un groupe de sorties tout ou rien d'un lot : {"masque": m, "valeurs": v}.
+ */
+void lit_masque_lot(JsonVariant groupe, uint8_t *masque, uint8_t *valeurs) {
+  if (groupe.isNull()) {return;}
+  *masque = groupe["masque"].as<uint8_t>();
+  *valeurs = groupe["valeurs"].as<uint8_t>();
+}
+
+/**
+ * @fn void lit_index_lot(JsonVariant groupe, uint8_t *masque, int *valeurs)
+ * @brief Lecture d'un groupe de sorties par index d'un lot : {"<index>": valeur, ...}.
+ *
+ * Un index hors de 0..3 (ou non numérique) est reporté dans le masque pour que la vérification du lot le refuse.
+ */
+void lit_index_lot(JsonVariant groupe, uint8_t *masque, int *valeurs) {
+  if (groupe.isNull()) {return;}
+  for (JsonPair p : groupe.as<JsonObject>()) {
+    const char *cle = p.key().c_str();
+    int i = (cle[0] >= '0' && cle[0] <= '7' && cle[1] == '\0') ? cle[0] - '0' : 7;
+    *masque |= (1 << i);
+    if (i < 4) {valeurs[i] = p.value().as<int>();}
+  }
+}
+
+/**
+ * @fn void commande_Lot(Struct_Commande &cmd)
+ * @brief Commande groupée de sorties, vérifiée puis appliquée d'un seul bloc.
+ *
+ * {"PCF8574_OUT_1": {"masque": 15, "valeurs": 5}, "GPIO_OUT": {"masque": 3, "valeurs": 1}, "Servo": {"0": 90}, "PWM": {"1": 50}}
+ * Le lot est refusé en entier si une sortie est invalide. Les vannes d'une même extension changent
+ * d'état dans la même écriture I2C (voir Sorties_lot_applique). L'acquittement unique porte l'état
+ * combiné des sorties après application.
+ */
+void commande_Lot(Struct_Commande &cmd) {
+  const Struct_Lot_Sorties &lot = cmd.Lot;
+  Reponse_commande.Etat_sorties = true;
+  cmd.Application_us = esp_timer_get_time();
+
+  cmd.Erreur = Sorties_lot_verifie(&lot);
+  if (cmd.Erreur == NULL && cmd.Planifiee) {cmd.Erreur = "lot non planifiable";}
+  if (cmd.Erreur != NULL) {
+    cmd.Resultat = 0;
+    return;
+  }
+  cmd.Resultat = Sorties_lot_applique(&lot);
+  cmd.Application_us = esp_timer_get_time();
+  cmd.Valeur = __builtin_popcount(lot.Masque_PCF8574_1) + __builtin_popcount(lot.Masque_GPIO_OUT) + __builtin_popcount(lot.Masque_Servo) + __builtin_popcount(lot.Masque_PWM);
+  demande_publication();
+}
+
+/**
+ * @fn void commande_Requete(Struct_Commande &cmd)
+ * @brief Requête d'état : répond avec le document agrégé, ou un seul de ses groupes ("groupe": "GPIO_OUT" par exemple).
+ *
+ * La réponse est publiée sur le topic de réponse de la requête (sinon _out/Reponse), avec sa Correlation Data,
+ * dans l'encodage de la requête. Elle remplace l'acquittement. Elle est construite dans son propre document :
+ * docEtat et le numéro de séquence de la publication périodique ne sont pas touchés ("seq" est celui
+ * du dernier document agrégé publié).
+ */
+void commande_Requete(Struct_Commande &cmd) {
+  const char *groupe = (cmd.Groupe[0] != '\0') ? cmd.Groupe : NULL;
+  const char *topic = (Reponse_commande.Topic[0] != '\0') ? Reponse_commande.Topic : Tab_Topics_MQTT[TOPIC_REPONSE];
+  DynamicJsonDocument etat(docEtat.capacity());
+  if (etat.capacity() == 0) {
+    cmd.Resultat = 0;
+    return;
+  }
+  etat["seq"] = sequenceDocument;
+  etat["ts"] = horodatage_ms();
+  remplit_document_etat(etat);
+  cmd.Application_us = esp_timer_get_time();
+
+  if (groupe != NULL && !etat.containsKey(groupe)) {
+    cmd.Resultat = 0;
+    return;
+  }
+  bool ok;
+  if (groupe != NULL) {
+    StaticJsonDocument<1024> reponse;
+    reponse["seq"] = etat["seq"];
+    reponse["ts"] = etat["ts"];
+    reponse[groupe] = etat[groupe];
+    ok = publie_flux(topic, reponse, cmd.Encodage, false, CLASSE_ACK, NULL, proprietes_reponse());
+  }
+  else {
+    ok = publie_flux(topic, etat, cmd.Encodage, false, CLASSE_ACK, NULL, proprietes_reponse());
+  }
+  cmd.Resultat = ok ? 1 : 0;
+  cmd.Repondue = ok;
+}
+
+/**
+ * @fn void commande_Statistiques(Struct_Commande &cmd)
+ * @brief Requête des compteurs de publication, de connexion et de routage (ceux du diagnostic #D).
+ *
+ * Le banc d'intégration (tools/banc_mqtt.py) relève ces compteurs au début et à la fin d'une mesure
+ * et en déduit les octets par cycle côté ESP, les échecs de publication et la durée des coupures.
+ * La réponse suit le même chemin que celle de la route Requete.
+ */
+void commande_Statistiques(Struct_Commande &cmd) {
+  const char *topic = (Reponse_commande.Topic[0] != '\0') ? Reponse_commande.Topic : Tab_Topics_MQTT[TOPIC_REPONSE];
+  cmd.Application_us = esp_timer_get_time();
+
+  StaticJsonDocument<1024> reponse;
+  JsonObject publication = reponse.createNestedObject("publication");
+  publication["cycles"] = Stat_MQTT.Cycles;
+  publication["messages_cycle"] = Stat_MQTT.Messages_cycle;
+  publication["octets_cycle"] = Stat_MQTT.Octets_cycle;
+  publication["octets_topics_cycle"] = Stat_MQTT.Octets_topics_cycle;
+  publication["messages"] = Stat_MQTT.Messages_total;
+  publication["octets"] = Stat_MQTT.Octets_total;
+  publication["octets_max"] = Stat_MQTT.Octets_max;
+  publication["echecs"] = Stat_MQTT.Echecs;
+  publication["tas_publication_max"] = Stat_MQTT.Tas_publication_max;
+  publication["pile_libre_min"] = Stat_MQTT.Pile_libre_min;
+  publication["alias"] = client.Nb_alias;
+  publication["alias_max"] = client.Alias_max;
+  publication["octets_topics_evites"] = client.Octets_topics_evites;
+  JsonObject connexion = reponse.createNestedObject("connexion");
+  connexion["tentatives"] = Connexion_MQTT.Tentatives;
+  connexion["connexions"] = Connexion_MQTT.Connexions;
+  connexion["coupures"] = Connexion_MQTT.Coupures;
+  connexion["coupure_cumul_ms"] = Connexion_MQTT.Coupure_cumul_ms;
+  connexion["coupure_max_ms"] = Connexion_MQTT.Coupure_max_ms;
+  connexion["bascules"] = Bascule_MQTT.Bascules;
+  connexion["bascule_max_ms"] = Bascule_MQTT.Bascule_max_ms;
+  connexion["file_attente"] = File_attente_profondeur();
+  connexion["rejoues"] = Rejeu.Rejoues;
+  connexion["rejeu_retard_max_ms"] = Rejeu.Retard_max_ms;
+  JsonObject routeur = reponse.createNestedObject("routeur");
+  routeur["routees"] = Stat_Routeur.Routees;
+  routeur["inconnues"] = Stat_Routeur.Inconnues;
+  routeur["erreurs"] = Stat_Routeur.Erreurs;
+  routeur["doublons"] = Stat_Routeur.Doublons;
+  routeur["acks_differes"] = File_Ack.Differes;
+  routeur["acks_perdus"] = File_Ack.Perdus;
+  routeur["latence_max_ns"] = cycles_en_ns(Stat_Routeur.Cycles_max);
+  reponse["tas_libre"] = ESP.getFreeHeap();
+
+  bool ok = publie_flux(topic, reponse, cmd.Encodage, false, CLASSE_ACK, NULL, proprietes_reponse());
+  cmd.Resultat = ok ? 1 : 0;
+  cmd.Repondue = ok;
+}
+
+/**
+ * @fn bool lit_entier(JsonVariantConst champ, int *valeur)
+ * @brief Lecture d'un champ entier (nombre ou booléen) d'une commande.
+ *
+ * @return false si le champ est absent ou non numérique.
+ */
+bool lit_entier(JsonVariantConst champ, int *valeur) {
+  if (!champ.is<float>() && !champ.is<bool>()) {return false;}
+  *valeur = champ.as<int>();
+  return true;
+}
+
+/**
+ * @fn bool lit_reel(JsonVariantConst champ, float *valeur)
+ * @brief Lecture d'un champ réel optionnel d'une commande : la valeur reste inchangée (NAN) si le champ est absent.
+ *
+ * @return false si le champ est présent mais non numérique.
+ */
+bool lit_reel(JsonVariantConst champ, float *valeur) {
+  if (champ.isNull()) {return true;}
+  if (!champ.is<float>()) {return false;}
+  *valeur = champ.as<float>();
+  return true;
+}
+
+/**
+ * @fn const char *decode_sortie(JsonDocument &corps, const char *cle_num, const char *cle_val, Struct_Commande &cmd)
+ * @brief Décodage du numéro et de la valeur d'une commande de sortie.
+ *
+ * @return NULL si la commande est valide, sinon le motif du refus.
+ */
+const char *decode_sortie(JsonDocument &corps, const char *cle_num, const char *cle_val, Struct_Commande &cmd) {
+  if (cle_num != NULL && !lit_entier(corps[cle_num], &cmd.Num)) {return "numero de sortie absent";}
+  if (!lit_entier(corps[cle_val], &cmd.Val)) {return "valeur absente";}
+  return NULL;
+}
+
+/**
+ * @fn const char *decode_corps(int format, JsonDocument &corps, Struct_Commande &cmd)
+ * @brief Décodage du corps d'une commande en champs typés, selon le format de sa route.
+ *
+ * Les gestionnaires ne lisent que les champs de Struct_Commande : une commande mal formée est refusée
+ * ici, avant tout effet sur les sorties.
+ *
+ * @param format Format du corps (Format_Commande).
+ * @param corps Document décodé (JSON ou MessagePack).
+ * @param cmd Commande à compléter.
+ * @return NULL si la commande est valide, sinon le motif du refus.
+ */
+const char *decode_corps(int format, JsonDocument &corps, Struct_Commande &cmd) {
+  switch (format) {
+    case FORMAT_PCF8574:
+      cmd.Num = cmd.Voie;
+      return decode_sortie(corps, NULL, "val_port", cmd);
+    case FORMAT_GPIO_OUT:
+      return decode_sortie(corps, "num_port", "val_port", cmd);
+    case FORMAT_SERVO:
+      return decode_sortie(corps, "num_servo", "val_servo", cmd);
+    case FORMAT_PWM:
+      return decode_sortie(corps, "num_pwm", "val_pwm", cmd);
+    case FORMAT_REGULATION:
+      if (!lit_reel(corps["consigne"], &cmd.Consigne) || !lit_reel(corps["Kp"], &cmd.Kp)
+          || !lit_reel(corps["Ki"], &cmd.Ki) || !lit_reel(corps["Kd"], &cmd.Kd)) {
+        return "valeur non numerique";
+      }
+      return NULL;
+    case FORMAT_LOT:
+      lit_masque_lot(corps["PCF8574_OUT_1"], &cmd.Lot.Masque_PCF8574_1, &cmd.Lot.Valeurs_PCF8574_1);
+      lit_masque_lot(corps["GPIO_OUT"], &cmd.Lot.Masque_GPIO_OUT, &cmd.Lot.Valeurs_GPIO_OUT);
+      lit_index_lot(corps["Servo"], &cmd.Lot.Masque_Servo, cmd.Lot.Servo);
+      lit_index_lot(corps["PWM"], &cmd.Lot.Masque_PWM, cmd.Lot.PWM);
+      return NULL;
+    case FORMAT_REQUETE:
+      if (!corps.containsKey("groupe")) {return NULL;}
+      if (!corps["groupe"].is<const char*>() || strlen(corps["groupe"].as<const char*>()) >= TAILLE_GROUPE_REQUETE) {return "groupe invalide";}
+      strcpy(cmd.Groupe, corps["groupe"].as<const char*>());
+      return NULL;
+  }
+  return NULL;
+}
+
+/**
+ * @fn void ajoute_route(const char *suffixe, Gestionnaire_Commande gestionnaire, int voie, int format)
+ * @brief Enregistre une route de commande et signale un échec d'enregistrement.
+ */
+void ajoute_route(const char *suffixe, Gestionnaire_Commande gestionnaire, int voie, int format) {
+  if (!Routeur_ajoute(&Routeur_MQTT, suffixe, gestionnaire, voie, format)) {
+    Serial.print("Route non enregistrée : ");
+    Serial.println(suffixe);
+  }
+}
+
+/**
+ * @fn void enregistre_routes_MQTT()
+ * @brief Enregistrement des routes de commande, par suffixe du topic après "<mqttSubscribe1>/".
+ */
+void enregistre_routes_MQTT() {
+  char suffixe[TAILLE_SUFFIXE_ROUTE];
+  Routeur_init(&Routeur_MQTT, Table_Routes_MQTT, NB_ENTREES_ROUTEUR);
+  for (int i = 0; i < 8; i++) {
+    snprintf(suffixe, sizeof(suffixe), "PCF8574_OUT_1_%d", i + 1);
+    ajoute_route(suffixe, commande_PCF8574, i, FORMAT_PCF8574);
+  }
+  ajoute_route("GPIO_OUT", commande_GPIO_OUT, 0, FORMAT_GPIO_OUT);
+  ajoute_route("ServoMoteur", commande_ServoMoteur, 0, FORMAT_SERVO);
+  ajoute_route("PWM", commande_PWM, 0, FORMAT_PWM);
+  ajoute_route("Regulation", commande_Regulation, 0, FORMAT_REGULATION);
+  ajoute_route("Requete", commande_Requete, 0, FORMAT_REQUETE);
+  ajoute_route("Lot", commande_Lot, 0, FORMAT_LOT);
+  ajoute_route("Statistiques", commande_Statistiques, 0, FORMAT_VIDE);
+  Serial.printf("   %d routes de commande enregistrées\n", Routeur_MQTT.Nb);
+}
+
+/**
+ * @fn void update_Subscribe1(String mqttSubscribe, char *topic, char *payload, unsigned int length)
+ * @brief Mise à jour des données en fonction du message MQTT reçu sur le canal 1.
+ *
+ * Le suffixe du topic après "<mqttSubscribe>/" est recherché dans la table de routage, puis le message
+ * est décodé une seule fois, selon le format de la route, en une commande typée transmise au gestionnaire.
+ * La recherche dure moins d'une µs : elle est mesurée au compteur de cycles du processeur.
+ *
+ * @param mqttSubscribe Topic principal du canal MQTT.
+ * @param topic Topic du message MQTT reçu.
+ * @param payload Données du message MQTT.
+ * @param length Longueur des données du message MQTT.
+ */
+void update_Subscribe1(String mqttSubscribe, char* topic, char* payload, unsigned int length) {
+  if(!EnableMQTT){return;}
+
+  size_t taille_base = mqttSubscribe.length();
+  if (strncmp(topic, mqttSubscribe.c_str(), taille_base) != 0 || topic[taille_base] != '/') {
+    Stat_Routeur.Inconnues++;
+    return;
+  }
+
+  uint32_t debut = ESP.getCycleCount();
+  const Struct_Route *route = Routeur_cherche(&Routeur_MQTT, topic + taille_base + 1);
+  uint32_t cycles = ESP.getCycleCount() - debut;
+  Stat_Routeur.Recherches++;
+  Stat_Routeur.Cycles_cumul += cycles;
+  if (cycles > Stat_Routeur.Cycles_max) {Stat_Routeur.Cycles_max = cycles;}
+
+  if (route == NULL) {
+    Stat_Routeur.Inconnues++;
+    return;
+  }
+
+  Reponse_commande.Etat_sorties = false;
+  Struct_Commande cmd;
+  cmd.Voie = route->Voie;
+  cmd.Reception_us = Reception_commande_us;
+  cmd.Encodage = (length > 0 && (uint8_t)payload[0] >= 0x80) ? ENCODAGE_MSGPACK : ENCODAGE_JSON;
+
+  DynamicJsonDocument jsonDoc(capacite_commande(cmd.Encodage, length));
+  DeserializationError error = decode_commande(jsonDoc, payload, length);
+  if (error) {
+    Stat_Routeur.Erreurs++;
+    Serial.print("Erreur lors du décodage de la commande : ");
+    Serial.println(error.c_str());
+    acquitte_commande(route->Suffixe, "", cmd.Encodage, 0, 0, -1, false, error.c_str());
+    return;
+  }
+
+  /// @brief Identifiant optionnel : une commande redélivrée n'est pas réappliquée
+  lit_id_commande(jsonDoc, cmd);
+  if (cmd.Id[0] != '\0') {
+    Struct_Id_Commande *deja = cherche_id_commande(cmd.Id);
+    if (deja != NULL) {
+      Stat_Routeur.Doublons++;
+      acquitte_commande(route->Suffixe, cmd.Id, cmd.Encodage, deja->Resultat, deja->Valeur, -1, true, NULL);
+      return;
     }
+  }
+
+  if (!decode_planification(jsonDoc, cmd)) {
+    Stat_Routeur.Erreurs++;
+    acquitte_commande(route->Suffixe, cmd.Id, cmd.Encodage, 0, 0, -1, false, "heure non synchronisee");
+    return;
+  }
+  const char *erreur = decode_corps(route->Format, jsonDoc, cmd);
+  if (erreur != NULL) {
+    Stat_Routeur.Erreurs++;
+    acquitte_commande(route->Suffixe, cmd.Id, cmd.Encodage, 0, 0, -1, false, erreur);
+    return;
+  }
+  Stat_Routeur.Routees++;
+  route->Gestionnaire(cmd);
 
+  /// @brief Gestionnaire sans sortie (consigne, gains) : la commande est appliquée à son retour
+  if (cmd.Resultat < 0) {
+    cmd.Resultat = 1;
+    cmd.Application_us = esp_timer_get_time();
+  }
+  if (cmd.Id[0] != '\0') {memorise_id_commande(cmd.Id, cmd.Resultat, cmd.Valeur);}
+  if (cmd.Repondue) {return;}
+  acquitte_commande(route->Suffixe, cmd.Id, cmd.Encodage, cmd.Resultat, cmd.Valeur, (long)(cmd.Application_us - cmd.Reception_us), false, cmd.Erreur);
 }
 
 /**
@@ -620,10 +2812,40 @@ void update_Subscribe2(char* message, unsigned int length) {
  */
 void loop_MQTT(){
   if(!EnableMQTT){return;}
-  if (!client.connected()) {
-    reconnect();
-  }
+  reconnect();
+  if (Connexion_MQTT.Etat != MQTT_CONNECTE) {return;}
   client.loop();
+  reemet_acquittements();
+  traite_commandes();
+  rejoue_file_attente();
+  sonde_serveur_prefere();
+
+  /// @brief Publication immédiate des sorties modifiées par une commande, ou de tout l'état après une connexion
+  if (Publication_demandee || Republication_complete) {
+    Publication_demandee = false;
+    publish_s1();
+  }
+}
+
+/**
+ * @fn int socket_MQTT()
+ * @brief Socket de la session MQTT établie, surveillée par Energie_repos pendant l'attente de boucle.
+ * @return La socket, -1 hors session établie.
+ */
+int socket_MQTT(){
+  if (!EnableMQTT || Connexion_MQTT.Etat != MQTT_CONNECTE) {return -1;}
+  return EnableTLS ? Client_TLS.fd() : espClient.fd();
+}
+
+/**
+ * @fn bool MQTT_a_traiter()
+ * @brief Indique si loop_MQTT a du travail sans attendre la socket : octets déjà lus par le client WiFi
+ * ou déchiffrés par TLS, que select() ne signale pas, ou publication demandée.
+ */
+bool MQTT_a_traiter(){
+  if (!EnableMQTT || Connexion_MQTT.Etat != MQTT_CONNECTE) {return false;}
+  if (Publication_demandee || Republication_complete) {return true;}
+  return EnableTLS ? Client_TLS.available() > 0 : espClient.available() > 0;
 }
 
 
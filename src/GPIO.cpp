@@ -13,8 +13,12 @@
 #include <PCF8574.h>
 #include <ESP32Servo.h>
 #include <ESP32PWM.h>
+#include "soc/gpio_reg.h"
+#include "soc/soc.h"
 #include "File_System.h"
+#include "GPIO.h"
 #include "global.h"
+#include "regulation.h"
 
 
 // Déclaration des broches pour l'extension de port parallèle I2C PCF8574
@@ -69,6 +73,32 @@ int Periode=1000;
 // Déclaration de l'objet PCF8574
 PCF8574 pcf8574(PCF8574_ADDRESS);
 
+/**
+ * @var SemaphoreHandle_t Sorties_mutex
+ * @brief Verrou des sorties, partagé par la boucle principale, la tâche du planificateur et celle de la régulation.
+ *
+ * Mutex récursif : un lot (Sorties_lot_applique) le garde pendant qu'il appelle ServoMoteur_OUT et PWM_OUT.
+ * L'héritage de priorité du mutex évite qu'une tâche de priorité haute attende une boucle préemptée.
+ * Les transactions I2C sont en plus sérialisées par le verrou interne de Wire.
+ */
+SemaphoreHandle_t Sorties_mutex = xSemaphoreCreateRecursiveMutex();
+
+/**
+ * @fn Sorties_verrouille()
+ * @brief Prise du verrou des sorties (tableaux de sortie, écriture I2C et registres GPIO).
+ */
+void Sorties_verrouille(){
+  xSemaphoreTakeRecursive(Sorties_mutex, portMAX_DELAY);
+}
+
+/**
+ * @fn Sorties_deverrouille()
+ * @brief Libération du verrou des sorties.
+ */
+void Sorties_deverrouille(){
+  xSemaphoreGiveRecursive(Sorties_mutex);
+}
+
 /**
  * @fn Config_PCF8574_OUT_1()
  * @brief Configuration de la première extension PCF8574 en sortie.
@@ -110,9 +140,31 @@ void Config_PCF8574_OUT_1(){
  * en fonction du tableau de sortie.
  */
 void PCF8574_OUT_1_maj(){ 
-  for(int i=0;i<8;i++){
-    pcf8574.digitalWrite(i, !Tab_PCF8574_OUT_1[i]);
-  }
+  Sorties_verrouille();
+  PCF8574_OUT_1_ecrit();
+  Sorties_deverrouille();
+}
+
+/**
+ * @fn PCF8574_OUT_1_ecrit()
+ * @brief Écriture des 8 sorties de la première extension PCF8574 en une seule transaction I2C.
+ *
+ * Les 8 niveaux sont construits depuis le tableau de sortie (sorties actives à l'état bas) et écrits par
+ * digitalWriteAll : la bibliothèque garde ainsi son état tamponné des sorties à jour, pour une écriture
+ * broche par broche ultérieure. Toutes les écritures passent par cette fonction : l'octet envoyé reflète
+ * toujours l'ensemble du tableau. L'appelant tient le verrou des sorties.
+ */
+int PCF8574_OUT_1_ecrit(){
+  PCF8574::DigitalInput niveaux;
+  niveaux.p0=Tab_PCF8574_OUT_1[0] ? LOW : HIGH;
+  niveaux.p1=Tab_PCF8574_OUT_1[1] ? LOW : HIGH;
+  niveaux.p2=Tab_PCF8574_OUT_1[2] ? LOW : HIGH;
+  niveaux.p3=Tab_PCF8574_OUT_1[3] ? LOW : HIGH;
+  niveaux.p4=Tab_PCF8574_OUT_1[4] ? LOW : HIGH;
+  niveaux.p5=Tab_PCF8574_OUT_1[5] ? LOW : HIGH;
+  niveaux.p6=Tab_PCF8574_OUT_1[6] ? LOW : HIGH;
+  niveaux.p7=Tab_PCF8574_OUT_1[7] ? LOW : HIGH;
+  return pcf8574.digitalWriteAll(niveaux) ? 1 : 0;
 }
 
 /**
@@ -126,9 +178,10 @@ void PCF8574_OUT_1_maj(){
  * @param val Valeur de sortie
  */
 int PCF8574_OUT_1_out(int num_port, bool val){ 
-
+  Sorties_verrouille();
   Tab_PCF8574_OUT_1[num_port]=val;
-  pcf8574.digitalWrite(num_port, !Tab_PCF8574_OUT_1[num_port]);
+  PCF8574_OUT_1_ecrit();
+  Sorties_deverrouille();
   return 1;
 }
 
@@ -251,14 +304,15 @@ void GPIO_maj(void){
 int GPIO_OUT(int i, int val){
 
   i--;
+  int ok=0;
+  Sorties_verrouille();
   Tab_GPIO_OUT[i].Valeur=val;
   if(Tab_GPIO_OUT[i].Enable){
     digitalWrite(Tab_GPIO_OUT[i].PIN, Tab_GPIO_OUT[i].Valeur);
-    return 1;
-  }
-  else{
-    return 0;
+    ok=1;
   }
+  Sorties_deverrouille();
+  return ok;
 }
 
 /**
@@ -377,10 +431,12 @@ void ServoMoteur_Desactive(int i) {
 int ServoMoteur_OUT(int i, int val) {
 
     if (i >= 0 && i < 4 && Tab_ServoMoteur[i].Enable) {
+        Sorties_verrouille();
         servo[i].write(val);
         if (!servo[i].attached()) {
             servo[i].attach(Tab_ServoMoteur[i].PIN_OUT, Tab_ServoMoteur[i].Angle_min, Tab_ServoMoteur[i].Angle_max);
         }
+        Sorties_deverrouille();
         return 1;
     }
     else{
@@ -411,13 +467,14 @@ void ConfigurePWM() {
         Tab_PWM[i].DutyCycle = 0;
         Tab_PWM[i].PIN_OUT = 0;
 
-        if (getStringValueFromJsonFile("/config.json", "PWM", config_json, "enabled") == "true") {
+        if (getStringValueFromJsonFile("/config.json", "PWM", config_json, "Enable") == "true") {
             Tab_PWM[i].Enabled = true;
-            Tab_PWM[i].Frequence = getIntValueFromJsonFile("/config.json", "PWM", config_json, "Frequency");
+            Tab_PWM[i].Frequence = getIntValueFromJsonFile("/config.json", "PWM", config_json, "Frequence");
             Tab_PWM[i].DutyCycle = getIntValueFromJsonFile("/config.json", "PWM", config_json, "DutyCycle");
             Tab_PWM[i].Resolution = getIntValueFromJsonFile("/config.json", "PWM", config_json, "Resolution");
             Tab_PWM[i].PIN_OUT = getIntValueFromJsonFile("/config.json", "PWM", config_json, "PIN_OUT");
-            
+            if (Tab_PWM[i].Resolution == 0) {Tab_PWM[i].Resolution = 8;}
+            Serial.printf("     Voie %d sur PIN %d, %lu Hz, %d bits\n", i, Tab_PWM[i].PIN_OUT, (unsigned long)Tab_PWM[i].Frequence, Tab_PWM[i].Resolution);
 
             // Initialisation du PWM
             //pinMode(ledPin, OUTPUT);
@@ -425,6 +482,7 @@ void ConfigurePWM() {
             // Initialiser la bibliothèque ESP32PWM
             ledcSetup(i, Tab_PWM[i].Frequence, Tab_PWM[i].Resolution);
             ledcAttachPin(Tab_PWM[i].PIN_OUT, i);
+            PWM_OUT(i, Tab_PWM[i].DutyCycle);
         }
     }
 }
@@ -441,10 +499,156 @@ void ConfigurePWM() {
  */
 int PWM_OUT(int i, int val) {
     if (i >= 0 && i < 4 && Tab_PWM[i].Enabled) {
-        ledcWrite(i, Tab_PWM[i].DutyCycle);
+        return PWM_OUT_F(i, val);
+    }
+    else{
+      return 0;
+    }
+}
+
+/**
+ * @fn PWM_active(int i)
+ * @brief Indique si une voie PWM est activée dans la configuration.
+ *
+ * @param i Index du PWM (0 à 3)
+ */
+bool PWM_active(int i) {
+    return i >= 0 && i < 4 && Tab_PWM[i].Enabled;
+}
+
+/**
+ * @fn PWM_OUT_F(int i, float val)
+ * @brief Définit le cycle de service d'une sortie PWM avec la pleine résolution du canal.
+ *
+ * Cette fonction est utilisée par la régulation, qui a besoin d'une consigne plus fine que le pourcent.
+ *
+ * @param i Index du PWM (0 à 3)
+ * @param val Nouveau cycle de service en pourcentage (entre 0.0 et 100.0)
+ */
+int PWM_OUT_F(int i, float val) {
+    if (i >= 0 && i < 4 && Tab_PWM[i].Enabled) {
+        if (val < 0) {val = 0;}
+        if (val > 100) {val = 100;}
+        Sorties_verrouille();
+        Tab_PWM[i].DutyCycle = (uint32_t)(val + 0.5);
+        uint32_t max = (1UL << Tab_PWM[i].Resolution) - 1;
+        ledcWrite(i, (uint32_t)(val * max / 100.0 + 0.5));
+        Sorties_deverrouille();
         return 1;
     }
     else{
       return 0;
     }
-}
\ No newline at end of file
+}
+/**
+ * @fn Sorties_lot_verifie(const Struct_Lot_Sorties *lot)
+ * @brief Vérification d'un lot de sorties dans son ensemble, avant toute application.
+ *
+ * @param lot Lot de sorties
+ * @return NULL si le lot est valide, sinon le motif du refus
+ */
+const char *Sorties_lot_verifie(const Struct_Lot_Sorties *lot){
+  if(lot->Masque_PCF8574_1==0 && lot->Masque_GPIO_OUT==0 && lot->Masque_Servo==0 && lot->Masque_PWM==0){return "lot vide";}
+  if(lot->Masque_PCF8574_1!=0 && !EnablePFC8574_1){return "PCF8574_OUT_1 non active";}
+  for(int i=0;i<8;i++){
+    if((lot->Masque_GPIO_OUT & (1<<i)) && !Tab_GPIO_OUT[i].Enable){return "GPIO_OUT non active";}
+  }
+  for(int i=0;i<4;i++){
+    if(lot->Masque_Servo & (1<<i)){
+      if(!Tab_ServoMoteur[i].Enable){return "servo non active";}
+      if(lot->Servo[i]<0 || lot->Servo[i]>180){return "angle de servo hors limites";}
+    }
+    if(lot->Masque_PWM & (1<<i)){
+      if(!Tab_PWM[i].Enabled){return "PWM non active";}
+      if(Regulation_voie_reservee(i)){return "PWM pilotée par la régulation";}
+      if(lot->PWM[i]<0 || lot->PWM[i]>100){return "PWM hors limites";}
+    }
+  }
+  if((lot->Masque_Servo | lot->Masque_PWM) & 0xF0){return "voie inexistante";}
+  return NULL;
+}
+
+/**
+ * @fn Sorties_lot_applique(const Struct_Lot_Sorties *lot)
+ * @brief Application d'un lot de sorties vérifié.
+ *
+ * Les sorties de l'extension PCF8574 changent en une seule écriture I2C, les sorties GPIO_OUT par une écriture
+ * des registres de mise à 1 et de mise à 0 (W1TS / W1TC, une paire par banc de broches 0-31 / 32-39) : les
+ * autres broches du banc ne sont ni lues ni réécrites, une écriture concurrente n'est donc pas perdue. Les
+ * servomoteurs et PWM sont ensuite positionnés voie par voie.
+ *
+ * @param lot Lot de sorties, vérifié par Sorties_lot_verifie
+ * @return 1 si le lot a été appliqué
+ */
+int Sorties_lot_applique(const Struct_Lot_Sorties *lot){
+  int ok=1;
+  Sorties_verrouille();
+
+  if(lot->Masque_PCF8574_1!=0){
+    for(int i=0;i<8;i++){
+      if(lot->Masque_PCF8574_1 & (1<<i)){Tab_PCF8574_OUT_1[i]=(lot->Valeurs_PCF8574_1>>i)&1;}
+    }
+    ok&=PCF8574_OUT_1_ecrit();
+  }
+
+  if(lot->Masque_GPIO_OUT!=0){
+    uint32_t masque[2]={0, 0};
+    uint32_t valeurs[2]={0, 0};
+    for(int i=0;i<8;i++){
+      if(!(lot->Masque_GPIO_OUT & (1<<i))){continue;}
+      int val=(lot->Valeurs_GPIO_OUT>>i)&1;
+      int pin=Tab_GPIO_OUT[i].PIN;
+      Tab_GPIO_OUT[i].Valeur=val;
+      masque[pin/32]|=(1UL<<(pin%32));
+      if(val){valeurs[pin/32]|=(1UL<<(pin%32));}
+    }
+    if(masque[0]){
+      REG_WRITE(GPIO_OUT_W1TS_REG, valeurs[0]);
+      REG_WRITE(GPIO_OUT_W1TC_REG, masque[0] & ~valeurs[0]);
+    }
+    if(masque[1]){
+      REG_WRITE(GPIO_OUT1_W1TS_REG, valeurs[1]);
+      REG_WRITE(GPIO_OUT1_W1TC_REG, masque[1] & ~valeurs[1]);
+    }
+  }
+
+  for(int i=0;i<4;i++){
+    if(lot->Masque_Servo & (1<<i)){ok&=ServoMoteur_OUT(i, lot->Servo[i]);}
+    if(lot->Masque_PWM & (1<<i)){ok&=PWM_OUT(i, lot->PWM[i]);}
+  }
+  Sorties_deverrouille();
+  return ok;
+}
+
+/**
+ * @fn Sorties_etat(Struct_Lot_Sorties *etat)
+ * @brief État combiné de toutes les sorties activées, dans le format d'un lot.
+ *
+ * @param etat État des sorties (masques : sorties activées)
+ */
+void Sorties_etat(Struct_Lot_Sorties *etat){
+  *etat=Struct_Lot_Sorties();
+  Sorties_verrouille();
+  if(EnablePFC8574_1){
+    etat->Masque_PCF8574_1=0xFF;
+    for(int i=0;i<8;i++){
+      if(Tab_PCF8574_OUT_1[i]){etat->Valeurs_PCF8574_1|=(1<<i);}
+    }
+  }
+  for(int i=0;i<8;i++){
+    if(!Tab_GPIO_OUT[i].Enable){continue;}
+    etat->Masque_GPIO_OUT|=(1<<i);
+    if(Tab_GPIO_OUT[i].Valeur){etat->Valeurs_GPIO_OUT|=(1<<i);}
+  }
+  for(int i=0;i<4;i++){
+    if(Tab_ServoMoteur[i].Enable){
+      etat->Masque_Servo|=(1<<i);
+      etat->Servo[i]=servo[i].read();
+    }
+    if(Tab_PWM[i].Enabled){
+      etat->Masque_PWM|=(1<<i);
+      etat->PWM[i]=Tab_PWM[i].DutyCycle;
+    }
+  }
+  Sorties_deverrouille();
+}
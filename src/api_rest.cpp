@@ -0,0 +1,683 @@
+/**
+ * @file api_rest.cpp
+ * @brief Fonction de l'API REST JSON du serveur web.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'API REST : l'état agrégé (document docEtat de l'interface MQTT) est sérialisé en JSON
+ * une seule fois par version dans un instantané, avec chacun de ses groupes de canaux. Les requêtes
+ * /api/state et /api/state/<groupe> sont servies depuis cet instantané, sans sérialisation ni copie,
+ * tant que l'état ne change pas. L'ETag de chaque réponse est l'empreinte de son contenu : une requête
+ * If-None-Match sur l'état courant reçoit 304 sans corps.
+ *
+ * L'instantané est construit dans la boucle principale et lu par la tâche du serveur web asynchrone :
+ * chaque réponse garde une référence (std::shared_ptr) sur l'instantané qu'elle envoie, libéré après
+ * la dernière réponse qui l'utilise. Sans requête ni client WebSocket depuis Veille_ms, l'état n'est plus
+ * reconstruit : l'instantané est en veille. La requête suivante réveille la boucle (Energie_reveille) et sa
+ * réponse est différée jusqu'à la reconstruction de l'instantané au tick suivant (voir repond_differee_API).
+ *
+ * Le flux WebSocket /ws pousse aux clients connectés les seuls groupes dont l'ETag a changé, à chaque
+ * nouvel instantané : à chaque période de la boucle pour les mesures, et dès le tick suivant pour un
+ * changement de sortie (demande_instantane_API). Chaque client a sa propre file d'envoi (celle
+ * d'AsyncWebSocket, limitée à WS_MAX_QUEUED_MESSAGES) : tant qu'elle est pleine, les groupes modifiés
+ * s'accumulent dans un masque et seront envoyés en un seul message, dans leur dernière version, quand la
+ * file se sera vidée. Un client en retard plus longtemps que Retard_max_ms est déconnecté. Aucun envoi ne
+ * bloque la boucle principale ni les autres clients. La boucle ne désigne les clients que par leur
+ * identifiant : un client libéré entre-temps par la tâche du serveur web n'est jamais déréférencé.
+ *
+ */
+
+#include <Arduino.h>
+#include <ESPAsyncWebServer.h>
+#include <ArduinoJson.h>
+#include <memory>
+#include "Fonctions_MQTT.h"
+#include "File_System.h"
+#include "api_rest.h"
+#include "energie.h"
+#include "global.h"
+
+extern AsyncWebServer server;
+extern StaticJsonDocument<4096> docEtat;
+
+/**
+ * @var bool EnableAPI
+ * @brief Activation de l'API REST (clé RESEAU/WEB/API de config.json).
+ */
+bool EnableAPI = true;
+
+/**
+ * @struct Struct_Groupe_API
+ * @brief Groupe de canaux de l'instantané (GPIO_OUT, Meteo...), servi sur /api/state/<groupe>.
+ */
+struct Struct_Groupe_API {
+  char Nom[24];                      ///< Nom du groupe (clé de docEtat).
+  size_t Debut = 0;                  ///< Position du JSON du groupe dans Donnees.
+  size_t Taille = 0;                 ///< Taille du JSON du groupe.
+  char ETag[12];                     ///< Empreinte du JSON du groupe, entre guillemets.
+};
+
+/**
+ * @struct Struct_Instantane_API
+ * @brief État agrégé sérialisé une fois : document complet puis groupes, dans un seul bloc.
+ */
+struct Struct_Instantane_API {
+  char *Donnees = NULL;              ///< JSON du document complet suivi des JSON des groupes.
+  size_t Taille_document = 0;        ///< Taille du JSON du document complet (en tête de Donnees).
+  uint32_t Version = 0;              ///< Empreinte des valeurs de l'état (empreinte_document_etat).
+  uint32_t Sequence = 0;             ///< Numéro de séquence ("seq") du document.
+  uint64_t Horodatage = 0;           ///< Horodatage ("ts") du document.
+  int64_t Changement_us = 0;         ///< Instant (esp_timer) du plus ancien changement contenu : lecture des capteurs ou changement de sortie.
+  char ETag[12];                     ///< ETag du document complet.
+  Struct_Groupe_API Groupes[NB_GROUPES_API];  ///< Groupes de canaux.
+  int Nb_groupes = 0;                ///< Nombre de groupes.
+  ~Struct_Instantane_API() {free(Donnees);}
+};
+
+/**
+ * @var std::shared_ptr<Struct_Instantane_API> Instantane_API
+ * @brief Instantané courant, remplacé à chaque nouvelle version de l'état.
+ */
+std::shared_ptr<Struct_Instantane_API> Instantane_API;
+
+/**
+ * @var portMUX_TYPE API_mux
+ * @brief Verrou d'échange de l'instantané entre la boucle principale et la tâche du serveur web.
+ */
+portMUX_TYPE API_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @struct Struct_Stat_API
+ * @brief Compteurs de l'API REST.
+ */
+struct Struct_Stat_API {
+  unsigned long Requetes = 0;        ///< Requêtes servies (200 et 304).
+  unsigned long Non_modifiees = 0;   ///< Réponses 304.
+  unsigned long Inconnues = 0;       ///< Groupes inconnus (404).
+  unsigned long Versions = 0;        ///< Instantanés construits.
+  unsigned long Serialisation_us = 0;      ///< Durée de construction du dernier instantané.
+  unsigned long Serialisation_max_us = 0;  ///< Durée maximale de construction d'un instantané.
+  size_t Taille = 0;                 ///< Taille du dernier instantané.
+  long En_cours_max = 0;             ///< Plus grand nombre de réponses simultanées sur un même instantané.
+  uint32_t Tas_libre_min = UINT32_MAX;     ///< Plus bas niveau de tas libre observé à la réception d'une requête.
+  unsigned long Veilles = 0;         ///< Périodes de boucle sans reconstruction de l'état, l'API n'étant pas utilisée.
+  unsigned long Differees = 0;       ///< Réponses différées jusqu'à la reconstruction de l'instantané (absent ou en veille).
+  unsigned long Abandonnees = 0;     ///< Réponses différées terminées sans corps, l'instantané n'ayant pas été reconstruit à temps.
+};
+
+Struct_Stat_API Stat_API;
+
+/**
+ * @struct Struct_Veille_API
+ * @brief Utilisation de l'API : l'état n'est reconstruit que si un client s'en est servi récemment.
+ */
+struct Struct_Veille_API {
+  unsigned long Veille_ms = 60000;   ///< Durée sans requête ni client WebSocket avant la mise en veille.
+  volatile unsigned long Derniere_requete = 0;  ///< Instant (millis) de la dernière requête ou connexion WebSocket.
+  volatile bool En_veille = false;   ///< L'instantané n'est plus tenu à jour.
+  volatile bool Demande = false;     ///< Reconstruction demandée pour le prochain tick de la boucle (service_API).
+  int64_t Changement_us = 0;         ///< Instant (esp_timer) du premier changement signalé depuis la dernière reconstruction, 0 si aucun.
+};
+
+Struct_Veille_API Veille_API;
+
+/**
+ * @var AsyncWebSocket Flux_WS
+ * @brief Flux WebSocket des changements d'état.
+ */
+AsyncWebSocket Flux_WS(URL_FLUX_WS);
+
+/**
+ * @var bool EnableWS
+ * @brief Activation du flux WebSocket (clé RESEAU/WEB/WS de config.json).
+ */
+bool EnableWS = true;
+
+/**
+ * @struct Struct_Client_WS
+ * @brief Client WebSocket et groupes modifiés qui lui restent à envoyer.
+ */
+struct Struct_Client_WS {
+  uint32_t Id = 0;                   ///< Identifiant AsyncWebSocket du client, 0 si l'emplacement est libre.
+  uint32_t En_attente = 0;           ///< Masque des groupes modifiés non encore envoyés (bit i : groupe i de l'instantané).
+  unsigned long Debut_retard = 0;    ///< Instant (millis) depuis lequel la file du client est trop longue, 0 sinon.
+};
+
+Struct_Client_WS Clients_WS[NB_CLIENTS_WS];
+
+/**
+ * @struct Struct_Flux_WS
+ * @brief Paramètres et compteurs du flux WebSocket.
+ */
+struct Struct_Flux_WS {
+  int Clients_max = 4;               ///< Clients simultanés acceptés (au plus NB_CLIENTS_WS).
+  unsigned long Retard_max_ms = 10000;     ///< Durée maximale d'un client en retard avant déconnexion.
+  unsigned long Connexions = 0;      ///< Clients acceptés.
+  unsigned long Refus = 0;           ///< Clients refusés (tous les emplacements occupés).
+  unsigned long Lents = 0;           ///< Clients déconnectés pour retard.
+  unsigned long Messages = 0;        ///< Messages mis en file.
+  unsigned long Octets = 0;          ///< Octets mis en file.
+  unsigned long Regroupements = 0;   ///< Envois différés faute de place dans la file d'un client.
+  int Clients = 0;                   ///< Clients connectés.
+  int Clients_simultanes_max = 0;    ///< Plus grand nombre de clients simultanés.
+  unsigned long Latence_us = 0;      ///< Dernier délai changement d'état -> mise en file.
+  unsigned long Latence_max_us = 0;  ///< Délai maximal changement d'état -> mise en file.
+};
+
+Struct_Flux_WS Flux;
+
+/**
+ * @fn void etag_octets(const char *donnees, size_t taille, char *etag)
+ * @brief ETag (empreinte FNV-1a entre guillemets) d'un bloc JSON.
+ */
+void etag_octets(const char *donnees, size_t taille, char *etag) {
+  uint32_t valeur = 2166136261UL;
+  for (size_t i = 0; i < taille; i++) {
+    valeur ^= (uint8_t)donnees[i];
+    valeur *= 16777619UL;
+  }
+  snprintf(etag, 12, "\"%08lx\"", (unsigned long)valeur);
+}
+
+/**
+ * @fn bool etag_correspond(const String &liste, const char *etag)
+ * @brief Comparaison d'un ETag à un en-tête If-None-Match : "*", ou liste d'ETags séparés par des virgules.
+ *
+ * La comparaison est faible, comme le demande If-None-Match : un préfixe W/ est ignoré.
+ */
+bool etag_correspond(const String &liste, const char *etag) {
+  const char *p = liste.c_str();
+  size_t taille = strlen(etag);
+  while (*p != '\0') {
+    while (*p == ' ' || *p == '\t' || *p == ',') {p++;}
+    if (*p == '*') {return true;}
+    if (strncmp(p, "W/", 2) == 0) {p += 2;}
+    const char *fin = p;
+    while (*fin != '\0' && *fin != ',') {fin++;}
+    const char *dernier = fin;
+    while (dernier > p && (dernier[-1] == ' ' || dernier[-1] == '\t')) {dernier--;}
+    if ((size_t)(dernier - p) == taille && strncmp(p, etag, taille) == 0) {return true;}
+    p = fin;
+  }
+  return false;
+}
+
+/**
+ * @fn std::shared_ptr<Struct_Instantane_API> prend_instantane_API()
+ * @brief Référence sur l'instantané courant, prise sous verrou.
+ */
+std::shared_ptr<Struct_Instantane_API> prend_instantane_API(void) {
+  std::shared_ptr<Struct_Instantane_API> instantane;
+  portENTER_CRITICAL(&API_mux);
+  instantane = Instantane_API;
+  portEXIT_CRITICAL(&API_mux);
+  return instantane;
+}
+
+/**
+ * @fn void marque_changements_WS(const Struct_Instantane_API *ancien, const Struct_Instantane_API *nouveau)
+ * @brief Ajoute les groupes dont l'ETag a changé aux groupes en attente de chaque client WebSocket.
+ */
+void marque_changements_WS(const Struct_Instantane_API *ancien, const Struct_Instantane_API *nouveau) {
+  uint32_t masque = 0;
+  for (int i = 0; i < nouveau->Nb_groupes; i++) {
+    // Un groupe déplacé (canal activé ou désactivé) est renvoyé comme un groupe modifié
+    if (ancien == NULL || i >= ancien->Nb_groupes || strcmp(ancien->Groupes[i].Nom, nouveau->Groupes[i].Nom) != 0
+        || strcmp(ancien->Groupes[i].ETag, nouveau->Groupes[i].ETag) != 0) {
+      masque |= (1UL << i);
+    }
+  }
+  if (masque == 0) {return;}
+  portENTER_CRITICAL(&API_mux);
+  for (int i = 0; i < NB_CLIENTS_WS; i++) {
+    if (Clients_WS[i].Id != 0) {Clients_WS[i].En_attente |= masque;}
+  }
+  portEXIT_CRITICAL(&API_mux);
+}
+
+/**
+ * @fn size_t construit_message_WS(const Struct_Instantane_API *instantane, uint32_t masque, char *tampon, size_t taille_max)
+ * @brief Message des groupes du masque : {"seq": n, "ts": t, "<groupe>": {...}, ...}, recopiés depuis l'instantané.
+ *
+ * @return Taille du message, 0 s'il ne tient pas dans le tampon.
+ */
+size_t construit_message_WS(const Struct_Instantane_API *instantane, uint32_t masque, char *tampon, size_t taille_max) {
+  int n = snprintf(tampon, taille_max, "{\"seq\":%lu,\"ts\":%llu", (unsigned long)instantane->Sequence, (unsigned long long)instantane->Horodatage);
+  size_t position = (n > 0) ? n : taille_max;
+  for (int i = 0; i < instantane->Nb_groupes; i++) {
+    if (!(masque & (1UL << i))) {continue;}
+    const Struct_Groupe_API *groupe = &instantane->Groupes[i];
+    size_t nom = strlen(groupe->Nom);
+    if (position + nom + groupe->Taille + 5 >= taille_max) {return 0;}
+    tampon[position++] = ',';
+    tampon[position++] = '"';
+    memcpy(tampon + position, groupe->Nom, nom);
+    position += nom;
+    tampon[position++] = '"';
+    tampon[position++] = ':';
+    memcpy(tampon + position, instantane->Donnees + groupe->Debut, groupe->Taille);
+    position += groupe->Taille;
+  }
+  if (position + 1 >= taille_max) {return 0;}
+  tampon[position++] = '}';
+  return position;
+}
+
+/**
+ * @fn void envoie_WS(const Struct_Instantane_API *instantane)
+ * @brief Envoi des groupes en attente aux clients WebSocket dont la file d'envoi a de la place ; appelée à chaque boucle.
+ *
+ * Les clients ayant les mêmes groupes en attente (le cas courant) reçoivent le même message, construit une fois.
+ */
+void envoie_WS(const Struct_Instantane_API *instantane) {
+  std::unique_ptr<char[]> tampon;
+  size_t taille_tampon = instantane->Taille_document + 32;
+  uint32_t masque_message = 0;
+  size_t taille_message = 0;
+  unsigned long maintenant = millis();
+
+  for (int i = 0; i < NB_CLIENTS_WS; i++) {
+    portENTER_CRITICAL(&API_mux);
+    uint32_t id = Clients_WS[i].Id;
+    uint32_t masque = Clients_WS[i].En_attente;
+    portEXIT_CRITICAL(&API_mux);
+    if (id == 0 || masque == 0) {continue;}
+
+    if (!Flux_WS.availableForWrite(id)) {
+      if (Clients_WS[i].Debut_retard == 0) {
+        Clients_WS[i].Debut_retard = maintenant | 1;
+        Flux.Regroupements++;
+      }
+      else if (maintenant - Clients_WS[i].Debut_retard > Flux.Retard_max_ms) {
+        Flux.Lents++;
+        Flux_WS.close(id);
+      }
+      continue;
+    }
+
+    if (masque != masque_message || !tampon) {
+      if (!tampon) {tampon.reset(new char[taille_tampon]);}
+      masque_message = masque;
+      taille_message = construit_message_WS(instantane, masque, tampon.get(), taille_tampon);
+    }
+    if (taille_message == 0) {continue;}
+    Flux_WS.text(id, tampon.get(), taille_message);
+    Clients_WS[i].Debut_retard = 0;
+    portENTER_CRITICAL(&API_mux);
+    if (Clients_WS[i].Id == id) {Clients_WS[i].En_attente &= ~masque;}
+    portEXIT_CRITICAL(&API_mux);
+
+    Flux.Messages++;
+    Flux.Octets += taille_message;
+    Flux.Latence_us = esp_timer_get_time() - instantane->Changement_us;
+    if (Flux.Latence_us > Flux.Latence_max_us) {Flux.Latence_max_us = Flux.Latence_us;}
+  }
+}
+
+/**
+ * @fn void evenement_WS(AsyncWebSocket *serveur, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
+ * @brief Évènements du flux WebSocket (tâche du serveur web).
+ *
+ * Un nouveau client reçoit tout l'état au premier envoi. Un message texte numérique ("ping" du banc
+ * tools/banc_ws.py) est renvoyé avec l'horodatage de l'ESP, pour estimer l'écart d'horloge et la latence de bout en bout.
+ */
+void evenement_WS(AsyncWebSocket *serveur, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
+  switch (type) {
+    case WS_EVT_CONNECT: {
+      int libre = -1;
+      portENTER_CRITICAL(&API_mux);
+      for (int i = 0; i < Flux.Clients_max && libre < 0; i++) {
+        if (Clients_WS[i].Id == 0) {libre = i;}
+      }
+      if (libre >= 0) {
+        Veille_API.Derniere_requete = millis();
+        Veille_API.Demande = true;
+        Clients_WS[libre].Id = client->id();
+        Clients_WS[libre].En_attente = UINT32_MAX;
+        Clients_WS[libre].Debut_retard = 0;
+        Flux.Clients++;
+        if (Flux.Clients > Flux.Clients_simultanes_max) {Flux.Clients_simultanes_max = Flux.Clients;}
+      }
+      portEXIT_CRITICAL(&API_mux);
+      if (libre < 0) {
+        Flux.Refus++;
+        client->close();
+        return;
+      }
+      Flux.Connexions++;
+      break;
+    }
+
+    case WS_EVT_DISCONNECT:
+      portENTER_CRITICAL(&API_mux);
+      for (int i = 0; i < NB_CLIENTS_WS; i++) {
+        if (Clients_WS[i].Id == client->id()) {
+          Clients_WS[i].Id = 0;
+          Clients_WS[i].En_attente = 0;
+          Flux.Clients--;
+        }
+      }
+      portEXIT_CRITICAL(&API_mux);
+      break;
+
+    case WS_EVT_DATA: {
+      AwsFrameInfo *info = (AwsFrameInfo*)arg;
+      if (!info->final || info->index != 0 || info->len != len || info->opcode != WS_TEXT || len == 0 || len > 20) {return;}
+      char reponse[64];
+      size_t n = 0;
+      for (size_t i = 0; i < len && data[i] >= '0' && data[i] <= '9'; i++) {n++;}
+      if (n != len) {return;}
+      snprintf(reponse, sizeof(reponse), "{\"pong\":%.*s,\"ts\":%llu}", (int)len, (const char*)data, (unsigned long long)horodatage_ms());
+      client->text(reponse);
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+/**
+ * @fn void nouvel_instantane_API(uint32_t version, int64_t changement)
+ * @brief Sérialise docEtat dans un nouvel instantané, le substitue au précédent et marque les groupes modifiés pour le flux WebSocket.
+ */
+void nouvel_instantane_API(uint32_t version, int64_t changement) {
+  int64_t debut = esp_timer_get_time();
+  std::shared_ptr<Struct_Instantane_API> instantane = std::make_shared<Struct_Instantane_API>();
+  size_t taille = measureJson(docEtat);
+  for (JsonPair p : docEtat.as<JsonObject>()) {taille += measureJson(p.value());}
+  instantane->Donnees = (char*)malloc(taille + 1);
+  if (instantane->Donnees == NULL) {
+    Serial.println("API : mémoire insuffisante pour l'instantané");
+    return;
+  }
+
+  instantane->Version = version;
+  instantane->Sequence = docEtat["seq"];
+  instantane->Horodatage = docEtat["ts"];
+  instantane->Changement_us = changement;
+  instantane->Taille_document = serializeJson(docEtat, instantane->Donnees, taille + 1);
+  etag_octets(instantane->Donnees, instantane->Taille_document, instantane->ETag);
+  size_t position = instantane->Taille_document;
+  for (JsonPair p : docEtat.as<JsonObject>()) {
+    if (p.key() == "seq" || p.key() == "ts" || instantane->Nb_groupes >= NB_GROUPES_API) {continue;}
+    Struct_Groupe_API *groupe = &instantane->Groupes[instantane->Nb_groupes++];
+    strncpy(groupe->Nom, p.key().c_str(), sizeof(groupe->Nom) - 1);
+    groupe->Nom[sizeof(groupe->Nom) - 1] = '\0';
+    groupe->Debut = position;
+    groupe->Taille = serializeJson(p.value(), instantane->Donnees + position, taille + 1 - position);
+    etag_octets(instantane->Donnees + position, groupe->Taille, groupe->ETag);
+    position += groupe->Taille;
+  }
+
+  Stat_API.Versions++;
+  Stat_API.Taille = position;
+  Stat_API.Serialisation_us = esp_timer_get_time() - debut;
+  if (Stat_API.Serialisation_us > Stat_API.Serialisation_max_us) {Stat_API.Serialisation_max_us = Stat_API.Serialisation_us;}
+
+  // L'ancien instantané est libéré hors section critique, à la sortie de la fonction (ou après sa dernière réponse)
+  portENTER_CRITICAL(&API_mux);
+  Instantane_API.swap(instantane);
+  portEXIT_CRITICAL(&API_mux);
+  if (EnableWS) {marque_changements_WS(instantane.get(), Instantane_API.get());}
+}
+
+/**
+ * @fn void actualise_instantane_API(int64_t changement)
+ * @brief Reconstruit l'instantané si l'état a changé depuis le précédent.
+ *
+ * L'instantané précédent reste valide pour les réponses en cours d'envoi.
+ *
+ * @param changement Instant (esp_timer) des valeurs lues, remplacé par celui du premier changement signalé s'il est antérieur
+ */
+void actualise_instantane_API(int64_t changement) {
+  if (Veille_API.Changement_us != 0 && Veille_API.Changement_us < changement) {changement = Veille_API.Changement_us;}
+  Veille_API.Changement_us = 0;
+  construit_document_etat();
+  uint32_t version = empreinte_document_etat();
+  if (!Instantane_API || Instantane_API->Version != version) {nouvel_instantane_API(version, changement);}
+  Veille_API.En_veille = false;
+}
+
+/**
+ * @fn void maj_instantane_API(int64_t lecture_us)
+ * @brief Tient l'instantané à jour et sert le flux WebSocket ; appelée à chaque période de la boucle principale.
+ *
+ * Sans requête ni client WebSocket depuis Veille_ms, le document agrégé n'est pas reconstruit.
+ *
+ * @param lecture_us Instant (esp_timer) du début de la lecture des capteurs de cette période
+ */
+void maj_instantane_API(int64_t lecture_us) {
+  if (!EnableWEB || !EnableAPI) {return;}
+  if (Flux.Clients == 0 && millis() - Veille_API.Derniere_requete >= Veille_API.Veille_ms) {
+    Veille_API.En_veille = true;
+    Stat_API.Veilles++;
+    return;
+  }
+  actualise_instantane_API(lecture_us);
+  if (EnableWS && Instantane_API) {envoie_WS(Instantane_API.get());}
+}
+
+/**
+ * @fn void demande_instantane_API()
+ * @brief Signale un changement de sortie : l'instantané est reconstruit et poussé aux clients WebSocket au tick suivant.
+ */
+void demande_instantane_API(void) {
+  if (!EnableWEB || !EnableAPI || Veille_API.En_veille) {return;}
+  if (Veille_API.Changement_us == 0) {Veille_API.Changement_us = esp_timer_get_time();}
+  Veille_API.Demande = true;
+}
+
+/**
+ * @fn void service_API()
+ * @brief Reconstruction demandée par un changement de sortie ou par une requête sur l'instantané en veille,
+ * dont la réponse différée est envoyée ensuite ; appelée à chaque tick de la boucle.
+ */
+void service_API(void) {
+  if (!EnableWEB || !EnableAPI || !Veille_API.Demande) {return;}
+  Veille_API.Demande = false;
+  actualise_instantane_API(esp_timer_get_time());
+  if (EnableWS && Instantane_API) {envoie_WS(Instantane_API.get());}
+}
+
+/**
+ * @fn int groupe_API(const Struct_Instantane_API *instantane, const String &url)
+ * @brief Groupe désigné par l'URL /api/state/<groupe>.
+ * @return Index du groupe dans l'instantané, -1 pour le document complet, NB_GROUPES_API si le groupe est inconnu.
+ */
+int groupe_API(const Struct_Instantane_API *instantane, const String &url) {
+  if (url.length() <= strlen(URL_ETAT_API) + 1) {return -1;}
+  const char *nom = url.c_str() + strlen(URL_ETAT_API) + 1;
+  for (int i = 0; i < instantane->Nb_groupes; i++) {
+    if (strcmp(instantane->Groupes[i].Nom, nom) == 0) {return i;}
+  }
+  return NB_GROUPES_API;
+}
+
+/**
+ * @struct Struct_Reponse_Differee_API
+ * @brief Réponse différée : instantané reconstruit qu'elle envoie, pris au premier appel où il est disponible.
+ */
+struct Struct_Reponse_Differee_API {
+  String Url;                        ///< URL de la requête (document complet ou groupe).
+  unsigned long Debut = 0;           ///< Instant (millis) de la requête.
+  std::shared_ptr<Struct_Instantane_API> Instantane;  ///< Instantané envoyé, vide tant qu'il n'est pas reconstruit.
+  size_t Debut_corps = 0;            ///< Position du corps dans Instantane->Donnees.
+  size_t Taille = 0;                 ///< Taille du corps.
+};
+
+/**
+ * @fn void repond_differee_API(AsyncWebServerRequest *request)
+ * @brief Réponse à une requête reçue pendant la veille de l'instantané, envoyée dès sa reconstruction.
+ *
+ * Un instantané en veille peut être périmé : il n'est pas servi, ni comparé à If-None-Match. La réponse est
+ * découpée (chunked) : tant que la boucle n'a pas reconstruit l'instantané, la fonction de remplissage rend
+ * RESPONSE_TRY_AGAIN et le serveur web la rappelle à la scrutation suivante de la connexion, sans bloquer sa
+ * tâche. Le corps n'étant pas connu à l'envoi des en-têtes, la réponse n'a pas d'ETag. Si l'instantané n'est
+ * pas reconstruit en ATTENTE_INSTANTANE_API_MS, la réponse se termine sans corps.
+ */
+void repond_differee_API(AsyncWebServerRequest *request) {
+  Stat_API.Differees++;
+  std::shared_ptr<Struct_Reponse_Differee_API> differee = std::make_shared<Struct_Reponse_Differee_API>();
+  differee->Url = request->url();
+  differee->Debut = millis();
+  AsyncWebServerResponse *reponse = request->beginChunkedResponse("application/json",
+    [differee](uint8_t *tampon, size_t taille_max, size_t index) -> size_t {
+      if (!differee->Instantane) {
+        std::shared_ptr<Struct_Instantane_API> instantane = prend_instantane_API();
+        if (!instantane || Veille_API.En_veille) {
+          if (millis() - differee->Debut < ATTENTE_INSTANTANE_API_MS) {return RESPONSE_TRY_AGAIN;}
+          Stat_API.Abandonnees++;
+          return 0;
+        }
+        int groupe = groupe_API(instantane.get(), differee->Url);
+        if (groupe == NB_GROUPES_API) {return 0;}
+        differee->Debut_corps = (groupe < 0) ? 0 : instantane->Groupes[groupe].Debut;
+        differee->Taille = (groupe < 0) ? instantane->Taille_document : instantane->Groupes[groupe].Taille;
+        differee->Instantane = instantane;
+      }
+      if (index >= differee->Taille) {return 0;}
+      size_t n = differee->Taille - index;
+      if (n > taille_max) {n = taille_max;}
+      memcpy(tampon, differee->Instantane->Donnees + differee->Debut_corps + index, n);
+      return n;
+    });
+  reponse->addHeader("Cache-Control", "no-cache");
+  request->send(reponse);
+}
+
+/**
+ * @fn void requete_etat_API(AsyncWebServerRequest *request)
+ * @brief Gestionnaire de /api/state et /api/state/<groupe> (tâche du serveur web).
+ *
+ * Le corps est recopié par morceaux depuis l'instantané directement dans le tampon TCP.
+ */
+void requete_etat_API(AsyncWebServerRequest *request) {
+  uint32_t tas = ESP.getFreeHeap();
+  if (tas < Stat_API.Tas_libre_min) {Stat_API.Tas_libre_min = tas;}
+
+  Veille_API.Derniere_requete = millis();
+  std::shared_ptr<Struct_Instantane_API> instantane = prend_instantane_API();
+  // Les groupes ne dépendent que de la configuration : un instantané en veille suffit à refuser un groupe inconnu
+  int groupe = instantane ? groupe_API(instantane.get(), request->url()) : -1;
+  if (groupe == NB_GROUPES_API) {
+    Stat_API.Inconnues++;
+    request->send(404, "application/json", "{\"erreur\":\"groupe inconnu\"}");
+    return;
+  }
+  if (!instantane || Veille_API.En_veille) {
+    Veille_API.Demande = true;
+    Energie_reveille();
+    repond_differee_API(request);
+    return;
+  }
+
+  size_t debut = (groupe < 0) ? 0 : instantane->Groupes[groupe].Debut;
+  size_t taille = (groupe < 0) ? instantane->Taille_document : instantane->Groupes[groupe].Taille;
+  const char *etag = (groupe < 0) ? instantane->ETag : instantane->Groupes[groupe].ETag;
+
+  Stat_API.Requetes++;
+  if (request->hasHeader("If-None-Match") && etag_correspond(request->getHeader("If-None-Match")->value(), etag)) {
+    Stat_API.Non_modifiees++;
+    AsyncWebServerResponse *reponse = request->beginResponse(304);
+    reponse->addHeader("ETag", etag);
+    request->send(reponse);
+    return;
+  }
+
+  AsyncWebServerResponse *reponse = request->beginResponse("application/json", taille,
+    [instantane, debut, taille](uint8_t *tampon, size_t taille_max, size_t index) -> size_t {
+      size_t n = taille - index;
+      if (n > taille_max) {n = taille_max;}
+      memcpy(tampon, instantane->Donnees + debut + index, n);
+      return n;
+    });
+  reponse->addHeader("ETag", etag);
+  reponse->addHeader("Cache-Control", "no-cache");
+  // Références : l'instantané courant, cette fonction, et chaque réponse en cours d'envoi
+  long en_cours = instantane.use_count() - 2;
+  if (en_cours > Stat_API.En_cours_max) {Stat_API.En_cours_max = en_cours;}
+  request->send(reponse);
+}
+
+/**
+ * @fn void requete_diagnostic_API(AsyncWebServerRequest *request)
+ * @brief Gestionnaire de /api/diagnostic : compteurs de l'API et tas libre, pour le banc tools/banc_api.py.
+ */
+void requete_diagnostic_API(AsyncWebServerRequest *request) {
+  StaticJsonDocument<512> doc;
+  doc["requetes"] = Stat_API.Requetes;
+  doc["non_modifiees"] = Stat_API.Non_modifiees;
+  doc["inconnues"] = Stat_API.Inconnues;
+  doc["versions"] = Stat_API.Versions;
+  doc["serialisation_us"] = Stat_API.Serialisation_us;
+  doc["serialisation_max_us"] = Stat_API.Serialisation_max_us;
+  doc["taille"] = Stat_API.Taille;
+  doc["en_cours_max"] = Stat_API.En_cours_max;
+  doc["tas_libre"] = ESP.getFreeHeap();
+  doc["tas_libre_min"] = Stat_API.Tas_libre_min;
+  doc["veilles"] = Stat_API.Veilles;
+  doc["differees"] = Stat_API.Differees;
+  doc["abandonnees"] = Stat_API.Abandonnees;
+  JsonObject ws = doc.createNestedObject("ws");
+  ws["clients"] = Flux.Clients;
+  ws["clients_max"] = Flux.Clients_simultanes_max;
+  ws["refus"] = Flux.Refus;
+  ws["lents"] = Flux.Lents;
+  ws["messages"] = Flux.Messages;
+  ws["octets"] = Flux.Octets;
+  ws["regroupements"] = Flux.Regroupements;
+  ws["latence_max_us"] = Flux.Latence_max_us;
+  char tampon[512];
+  serializeJson(doc, tampon);
+  request->send(200, "application/json", tampon);
+}
+
+/**
+ * @fn void ConfigAPI()
+ * @brief Lecture de la configuration et enregistrement des routes de l'API sur le serveur web.
+ *
+ * À appeler avant server.begin().
+ */
+void ConfigAPI(void) {
+  if (getStringValueFromJsonFile("/config.json", "RESEAU", "WEB", "API") == "false") {EnableAPI = false;}
+  Serial.print("   API REST = ");
+  Serial.println(EnableAPI);
+  if (!EnableAPI) {return;}
+  unsigned long veille = getIntValueFromJsonFile("/config.json", "RESEAU", "WEB", "API_veille_ms");
+  if (veille > 0) {Veille_API.Veille_ms = veille;}
+  // La route couvre aussi /api/state/<groupe>
+  server.on(URL_ETAT_API, HTTP_GET, requete_etat_API);
+  server.on("/api/diagnostic", HTTP_GET, requete_diagnostic_API);
+
+  if (getStringValueFromJsonFile("/config.json", "RESEAU", "WEB", "WS") == "false") {EnableWS = false;}
+  Serial.print("   Flux WebSocket = ");
+  Serial.println(EnableWS);
+  if (!EnableWS) {return;}
+  int clients = getIntValueFromJsonFile("/config.json", "RESEAU", "WEB", "WS_clients");
+  if (clients > 0) {Flux.Clients_max = min(clients, NB_CLIENTS_WS);}
+  unsigned long retard = getIntValueFromJsonFile("/config.json", "RESEAU", "WEB", "WS_retard_max_ms");
+  if (retard > 0) {Flux.Retard_max_ms = retard;}
+  Flux_WS.onEvent(evenement_WS);
+  server.addHandler(&Flux_WS);
+}
+
+/**
+ * @fn void affiche_diagnostic_API()
+ * @brief Affiche les compteurs de l'API REST.
+ */
+void affiche_diagnostic_API(void) {
+  if (!EnableWEB || !EnableAPI) {return;}
+  Serial.println("API REST :");
+  Serial.printf("   Requetes : %lu (304 : %lu, 404 : %lu), réponses simultanées max : %ld\n", Stat_API.Requetes, Stat_API.Non_modifiees, Stat_API.Inconnues, Stat_API.En_cours_max);
+  Serial.printf("   Instantanés : %lu, %u octets, sérialisation %lu us (max %lu us)\n", Stat_API.Versions, (unsigned)Stat_API.Taille, Stat_API.Serialisation_us, Stat_API.Serialisation_max_us);
+  Serial.printf("   Tas libre min à la réception d'une requête : %lu octets\n", (unsigned long)Stat_API.Tas_libre_min);
+  Serial.printf("   Veille : %s, périodes sans reconstruction : %lu, réponses différées : %lu (sans corps : %lu)\n", Veille_API.En_veille ? "oui" : "non", Stat_API.Veilles, Stat_API.Differees, Stat_API.Abandonnees);
+  if (!EnableWS) {return;}
+  Serial.println("Flux WebSocket :");
+  Serial.printf("   Clients : %d (max %d/%d), acceptés : %lu, refusés : %lu, déconnectés pour retard : %lu\n", Flux.Clients, Flux.Clients_simultanes_max, Flux.Clients_max, Flux.Connexions, Flux.Refus, Flux.Lents);
+  Serial.printf("   Messages : %lu (%lu octets), envois regroupés : %lu\n", Flux.Messages, Flux.Octets, Flux.Regroupements);
+  Serial.printf("   Latence changement -> file : dernière %lu us, max %lu us\n", Flux.Latence_us, Flux.Latence_max_us);
+}
@@ -0,0 +1,814 @@
+/**
+ * @file client_mqtt.cpp
+ * @brief Fonction de client MQTT 3.1.1 / 5.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite le codage et le décodage des paquets MQTT sur une liaison déjà connectée par la machine
+ * de connexion (Fonctions_MQTT.cpp) : aucune fonction n'attend une réponse du serveur. Le CONNECT est émis
+ * par demarre_session(), le CONNACK est lu par poursuit_session() ; les paquets reçus sont assemblés au fil
+ * des octets disponibles à chaque loop().
+ * En MQTT 5, un alias (Topic Alias) est attribué à chaque topic publié, dans la limite du Topic Alias Maximum
+ * annoncé par le serveur dans le CONNACK : la première publication émet le topic et son alias, les suivantes
+ * un topic vide et l'alias. La table des alias est propre à la connexion et remise à zéro à chaque session.
+ * Les propriétés Response Topic et Correlation Data des messages reçus sont remises au rappel, et peuvent
+ * être jointes à une publication (réponse à une requête).
+ *
+ */
+
+#include <Arduino.h>
+#include "client_mqtt.h"
+
+/// @brief Types de paquets MQTT (quartet de poids fort du premier octet)
+#define PAQUET_CONNECT 0x10
+#define PAQUET_CONNACK 0x20
+#define PAQUET_PUBLISH 0x30
+#define PAQUET_PUBACK 0x40
+#define PAQUET_SUBSCRIBE 0x82
+#define PAQUET_PINGREQ 0xC0
+#define PAQUET_PINGRESP 0xD0
+#define PAQUET_DISCONNECT 0xE0
+
+/// @brief Identifiants des propriétés MQTT 5 utilisées
+#define PROPRIETE_TOPIC_REPONSE 0x08
+#define PROPRIETE_CORRELATION 0x09
+#define PROPRIETE_EXPIRATION_SESSION 0x11
+#define PROPRIETE_MAINTIEN_SERVEUR 0x13
+#define PROPRIETE_ALIAS_MAX 0x22
+#define PROPRIETE_ALIAS 0x23
+#define PROPRIETE_PAQUET_MAX 0x27
+
+/// @brief Taille du tampon de réception si setBufferSize() n'a pas été appelé
+#define TAILLE_RECEPTION_DEFAUT 256
+
+/**
+ * @fn size_t mqtt_taille_longueur(uint32_t longueur)
+ * @brief Nombre d'octets du codage d'une longueur (entier variable de 1 à 4 octets).
+ */
+size_t mqtt_taille_longueur(uint32_t longueur) {
+  if (longueur < 128) {return 1;}
+  if (longueur < 16384) {return 2;}
+  if (longueur < 2097152) {return 3;}
+  return 4;
+}
+
+/**
+ * @fn bool mqtt_lit_longueur(const uint8_t **p, const uint8_t *fin, uint32_t *longueur)
+ * @brief Décodage d'un entier variable (longueur des propriétés), en avançant le pointeur.
+ *
+ * @return false si l'entier dépasse la fin du paquet ou 4 octets.
+ */
+bool mqtt_lit_longueur(const uint8_t **p, const uint8_t *fin, uint32_t *longueur) {
+  *longueur = 0;
+  for (int n = 0; n < 4; n++) {
+    if (*p >= fin) {return false;}
+    uint8_t octet = *(*p)++;
+    *longueur |= (uint32_t)(octet & 0x7F) << (7 * n);
+    if ((octet & 0x80) == 0) {return true;}
+  }
+  return false;
+}
+
+/**
+ * @fn int mqtt_taille_propriete(uint8_t id, const uint8_t *p, const uint8_t *fin)
+ * @brief Taille de la valeur d'une propriété MQTT 5, pour lire ou sauter toute propriété.
+ *
+ * @param id Identifiant de la propriété.
+ * @param p Début de la valeur.
+ * @param fin Fin du bloc de propriétés.
+ * @return Taille de la valeur, -1 si la propriété est inconnue ou dépasse le bloc.
+ */
+int mqtt_taille_propriete(uint8_t id, const uint8_t *p, const uint8_t *fin) {
+  int taille;
+  switch (id) {
+    case 0x01: case 0x17: case 0x19: case 0x24: case 0x25: case 0x28: case 0x29: case 0x2A:
+      taille = 1;
+      break;
+    case 0x13: case 0x21: case 0x22: case 0x23:
+      taille = 2;
+      break;
+    case 0x02: case 0x11: case 0x18: case 0x27:
+      taille = 4;
+      break;
+    case 0x0B: {
+      const uint8_t *q = p;
+      uint32_t valeur;
+      if (!mqtt_lit_longueur(&q, fin, &valeur)) {return -1;}
+      taille = q - p;
+      break;
+    }
+    case 0x03: case 0x08: case 0x09: case 0x12: case 0x15: case 0x16: case 0x1A: case 0x1C: case 0x1F:
+      if (fin - p < 2) {return -1;}
+      taille = 2 + ((p[0] << 8) | p[1]);
+      break;
+    case 0x26: {
+      if (fin - p < 2) {return -1;}
+      int cle = 2 + ((p[0] << 8) | p[1]);
+      if (fin - p < cle + 2) {return -1;}
+      taille = cle + 2 + ((p[cle] << 8) | p[cle + 1]);
+      break;
+    }
+    default:
+      return -1;
+  }
+  return (taille <= fin - p) ? taille : -1;
+}
+
+/**
+ * @fn uint32_t mqtt_empreinte(const char *topic)
+ * @brief Empreinte FNV-1a d'un topic, comparée avant les topics de la table des alias.
+ */
+uint32_t mqtt_empreinte(const char *topic) {
+  uint32_t empreinte = 2166136261UL;
+  while (*topic) {
+    empreinte ^= (uint8_t)*topic++;
+    empreinte *= 16777619UL;
+  }
+  return empreinte;
+}
+
+/**
+ * @fn ClientMQTT::ClientMQTT(Client &liaison)
+ * @brief Client MQTT sur une liaison (WiFiClient ou ClientTLS).
+ */
+ClientMQTT::ClientMQTT(Client &liaison) : Liaison(&liaison) {}
+
+/**
+ * @fn void ClientMQTT::setClient(Client &liaison)
+ * @brief Changement de liaison (WiFiClient ou ClientTLS), avant l'ouverture d'une session.
+ */
+void ClientMQTT::setClient(Client &liaison) {
+  Liaison = &liaison;
+}
+
+/**
+ * @fn void ClientMQTT::setCallback(Rappel_MQTT rappel)
+ * @brief Rappel appelé à chaque message reçu, depuis loop().
+ */
+void ClientMQTT::setCallback(Rappel_MQTT rappel) {
+  Rappel = rappel;
+}
+
+/**
+ * @fn bool ClientMQTT::setBufferSize(uint16_t taille)
+ * @brief Allocation, une fois à la configuration, du tampon de réception d'un paquet.
+ *
+ * En MQTT 5, la taille est annoncée au serveur (Maximum Packet Size) : il n'envoie pas de paquet plus grand.
+ * En MQTT 3.1.1, un paquet plus grand est lu jusqu'au bout sans être conservé, acquitté et écarté sans rappel.
+ *
+ * @return false si l'allocation a échoué.
+ */
+bool ClientMQTT::setBufferSize(uint16_t taille) {
+  if (taille == 0) {return false;}
+  uint8_t *tampon = (uint8_t *)realloc(Reception, taille);
+  if (tampon == NULL) {return false;}
+  Reception = tampon;
+  Taille_reception = taille;
+  return true;
+}
+
+/**
+ * @fn void ClientMQTT::setKeepAlive(uint16_t secondes)
+ * @brief Intervalle de maintien demandé au serveur (le serveur MQTT 5 peut en imposer un autre).
+ */
+void ClientMQTT::setKeepAlive(uint16_t secondes) {
+  Maintien_demande_s = secondes;
+}
+
+/**
+ * @fn void ClientMQTT::setVersion(uint8_t version)
+ * @brief Niveau de protocole des sessions suivantes (MQTT_VERSION_3_1_1 ou MQTT_VERSION_5).
+ */
+void ClientMQTT::setVersion(uint8_t version) {
+  Version = (version == MQTT_VERSION_3_1_1) ? MQTT_VERSION_3_1_1 : MQTT_VERSION_5;
+}
+
+/**
+ * @fn uint8_t ClientMQTT::version(void)
+ * @brief Niveau de protocole de la session.
+ */
+uint8_t ClientMQTT::version(void) {
+  return Version;
+}
+
+/**
+ * @fn void ClientMQTT::ajoute(const uint8_t *octets, size_t taille)
+ * @brief Ajout d'octets au paquet en cours d'émission ; le tampon d'émission est envoyé quand il est plein.
+ */
+void ClientMQTT::ajoute(const uint8_t *octets, size_t taille) {
+  while (taille > 0) {
+    size_t place = TAILLE_ENTETE_CLIENT_MQTT - Nb_entete;
+    size_t n = (taille < place) ? taille : place;
+    memcpy(Entete + Nb_entete, octets, n);
+    Nb_entete += n;
+    octets += n;
+    taille -= n;
+    if (Nb_entete == TAILLE_ENTETE_CLIENT_MQTT) {emet_entete();}
+  }
+}
+
+void ClientMQTT::ajoute_octet(uint8_t octet) {
+  ajoute(&octet, 1);
+}
+
+void ClientMQTT::ajoute_16(uint16_t valeur) {
+  uint8_t octets[2] = {(uint8_t)(valeur >> 8), (uint8_t)valeur};
+  ajoute(octets, 2);
+}
+
+void ClientMQTT::ajoute_32(uint32_t valeur) {
+  uint8_t octets[4] = {(uint8_t)(valeur >> 24), (uint8_t)(valeur >> 16), (uint8_t)(valeur >> 8), (uint8_t)valeur};
+  ajoute(octets, 4);
+}
+
+/**
+ * @fn void ClientMQTT::ajoute_longueur(uint32_t longueur)
+ * @brief Ajout d'une longueur codée en entier variable.
+ */
+void ClientMQTT::ajoute_longueur(uint32_t longueur) {
+  do {
+    uint8_t octet = longueur & 0x7F;
+    longueur >>= 7;
+    if (longueur > 0) {octet |= 0x80;}
+    ajoute_octet(octet);
+  } while (longueur > 0);
+}
+
+/**
+ * @fn void ClientMQTT::ajoute_chaine(const char *chaine, size_t taille)
+ * @brief Ajout d'une chaîne (ou donnée binaire) précédée de sa longueur sur 2 octets.
+ */
+void ClientMQTT::ajoute_chaine(const char *chaine, size_t taille) {
+  ajoute_16((uint16_t)taille);
+  ajoute((const uint8_t *)chaine, taille);
+}
+
+/**
+ * @fn bool ClientMQTT::emet_entete(void)
+ * @brief Envoi des octets en attente du paquet en cours d'émission.
+ *
+ * @return false si la liaison a refusé une partie du paquet depuis son début.
+ */
+bool ClientMQTT::emet_entete(void) {
+  if (Nb_entete > 0) {
+    size_t ecrit = Liaison->write(Entete, Nb_entete);
+    Octets_emis += ecrit;
+    if (ecrit != Nb_entete) {Erreur_emission = true;}
+    Nb_entete = 0;
+    Derniere_emission = millis();
+  }
+  return !Erreur_emission;
+}
+
+/**
+ * @fn void ClientMQTT::coupe(int etat)
+ * @brief Fermeture de la liaison après une erreur, avec le code d'état correspondant.
+ */
+void ClientMQTT::coupe(int etat) {
+  Liaison->stop();
+  Etat = etat;
+  Etape = 0;
+}
+
+/**
+ * @fn bool ClientMQTT::demarre_session(const char *id, const char *utilisateur, const char *mot_de_passe, const char *topic_testament, uint8_t qos_testament, bool testament_retenu, const char *message_testament, bool session_propre, uint32_t expiration_session_s)
+ * @brief Émission du CONNECT sur la liaison connectée ; le CONNACK est attendu par poursuit_session().
+ *
+ * En MQTT 5, une session persistante (session_propre à false) n'est conservée par le serveur après la
+ * déconnexion que pendant expiration_session_s (Session Expiry Interval) ; en MQTT 3.1.1, la durée est
+ * celle de la configuration du serveur.
+ *
+ * @param id Identifiant du client.
+ * @param utilisateur Nom d'utilisateur, NULL si absent.
+ * @param mot_de_passe Mot de passe, NULL si absent.
+ * @param topic_testament Topic du testament, NULL si absent.
+ * @param qos_testament QoS du testament.
+ * @param testament_retenu Testament retenu par le serveur.
+ * @param message_testament Message du testament.
+ * @param session_propre Nouvelle session (clean start) plutôt que reprise de la session conservée.
+ * @param expiration_session_s Durée de conservation de la session après la déconnexion (MQTT 5).
+ * @return false si le CONNECT n'a pas pu être émis.
+ */
+bool ClientMQTT::demarre_session(const char *id, const char *utilisateur, const char *mot_de_passe, const char *topic_testament, uint8_t qos_testament, bool testament_retenu, const char *message_testament, bool session_propre, uint32_t expiration_session_s) {
+  if (Reception == NULL && !setBufferSize(TAILLE_RECEPTION_DEFAUT)) {return false;}
+  bool v5 = (Version == MQTT_VERSION_5);
+  Etape = 0;
+  Nb_alias = 0;
+  Alias_max = 0;
+  Paquet_max_serveur = 0;
+  Maintien_s = Maintien_demande_s;
+  Ping_en_cours = false;
+  Nb_entete = 0;
+  Erreur_emission = false;
+
+  uint32_t proprietes = 0;
+  if (v5) {
+    if (expiration_session_s > 0) {proprietes += 5;}
+    proprietes += 5;
+  }
+  uint8_t drapeaux = session_propre ? 0x02 : 0x00;
+  uint32_t restant = 10 + 2 + strlen(id);
+  if (v5) {restant += mqtt_taille_longueur(proprietes) + proprietes;}
+  if (topic_testament != NULL) {
+    drapeaux |= 0x04 | ((qos_testament & 0x03) << 3) | (testament_retenu ? 0x20 : 0x00);
+    restant += (v5 ? 1 : 0) + 2 + strlen(topic_testament) + 2 + strlen(message_testament);
+  }
+  if (utilisateur != NULL) {
+    drapeaux |= 0x80;
+    restant += 2 + strlen(utilisateur);
+  }
+  if (mot_de_passe != NULL) {
+    drapeaux |= 0x40;
+    restant += 2 + strlen(mot_de_passe);
+  }
+
+  ajoute_octet(PAQUET_CONNECT);
+  ajoute_longueur(restant);
+  ajoute_chaine("MQTT", 4);
+  ajoute_octet(Version);
+  ajoute_octet(drapeaux);
+  ajoute_16(Maintien_s);
+  if (v5) {
+    ajoute_longueur(proprietes);
+    if (expiration_session_s > 0) {
+      ajoute_octet(PROPRIETE_EXPIRATION_SESSION);
+      ajoute_32(expiration_session_s);
+    }
+    ajoute_octet(PROPRIETE_PAQUET_MAX);
+    ajoute_32(Taille_reception);
+  }
+  ajoute_chaine(id, strlen(id));
+  if (topic_testament != NULL) {
+    if (v5) {ajoute_octet(0);}
+    ajoute_chaine(topic_testament, strlen(topic_testament));
+    ajoute_chaine(message_testament, strlen(message_testament));
+  }
+  if (utilisateur != NULL) {ajoute_chaine(utilisateur, strlen(utilisateur));}
+  if (mot_de_passe != NULL) {ajoute_chaine(mot_de_passe, strlen(mot_de_passe));}
+  if (!emet_entete()) {
+    coupe(CLIENT_MQTT_LIAISON_PERDUE);
+    return false;
+  }
+  Etat = CLIENT_MQTT_EN_COURS;
+  Derniere_reception = millis();
+  return true;
+}
+
+/**
+ * @fn int ClientMQTT::poursuit_session(void)
+ * @brief Lecture sans attente du CONNACK. Le délai d'attente est borné par l'appelant.
+ *
+ * @return 1 si la session est ouverte, 0 si le CONNACK est attendu, -1 si la session est refusée ou la liaison perdue (voir state()).
+ */
+int ClientMQTT::poursuit_session(void) {
+  if (Etat == CLIENT_MQTT_CONNECTE) {return 1;}
+  if (Etat != CLIENT_MQTT_EN_COURS) {return -1;}
+  if (!Liaison->connected()) {
+    coupe(CLIENT_MQTT_LIAISON_PERDUE);
+    return -1;
+  }
+  recoit();
+  if (Etat == CLIENT_MQTT_CONNECTE) {return 1;}
+  return (Etat == CLIENT_MQTT_EN_COURS) ? 0 : -1;
+}
+
+/**
+ * @fn bool ClientMQTT::connected(void)
+ * @brief Session ouverte sur une liaison toujours connectée.
+ */
+bool ClientMQTT::connected(void) {
+  if (Etat != CLIENT_MQTT_CONNECTE) {return false;}
+  if (!Liaison->connected()) {
+    coupe(CLIENT_MQTT_LIAISON_PERDUE);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @fn void ClientMQTT::disconnect(void)
+ * @brief Fermeture volontaire de la session (DISCONNECT) puis de la liaison : le testament n'est pas publié.
+ */
+void ClientMQTT::disconnect(void) {
+  if (Etat == CLIENT_MQTT_CONNECTE || Etat == CLIENT_MQTT_EN_COURS) {
+    uint8_t paquet[2] = {PAQUET_DISCONNECT, 0};
+    Liaison->write(paquet, 2);
+  }
+  coupe(CLIENT_MQTT_DECONNECTE);
+}
+
+/**
+ * @fn int ClientMQTT::state(void)
+ * @brief État du client (Etat_Client_MQTT), ou code de refus du CONNACK.
+ */
+int ClientMQTT::state(void) {
+  return Etat;
+}
+
+/**
+ * @fn bool ClientMQTT::subscribe(const char *topic, uint8_t qos)
+ * @brief Souscription à un topic. Le SUBACK n'est pas attendu.
+ */
+bool ClientMQTT::subscribe(const char *topic, uint8_t qos) {
+  if (!connected()) {return false;}
+  size_t taille = strlen(topic);
+  if (++Id_paquet == 0) {Id_paquet = 1;}
+  Erreur_emission = false;
+  ajoute_octet(PAQUET_SUBSCRIBE);
+  ajoute_longueur(2 + (Version == MQTT_VERSION_5 ? 1 : 0) + 2 + taille + 1);
+  ajoute_16(Id_paquet);
+  if (Version == MQTT_VERSION_5) {ajoute_octet(0);}
+  ajoute_chaine(topic, taille);
+  ajoute_octet(qos & 0x03);
+  return emet_entete();
+}
+
+/**
+ * @fn int ClientMQTT::alias_publish(const char *topic, bool *nouvel)
+ * @brief Alias à utiliser pour publier sur un topic, sans modifier la table.
+ *
+ * @param topic Topic de publication.
+ * @param nouvel Renseigné à true si l'alias est à attribuer par cette publication (topic émis avec l'alias).
+ * @return Alias (1 à Alias_max), 0 pour publier sans alias.
+ */
+int ClientMQTT::alias_publish(const char *topic, bool *nouvel) {
+  *nouvel = false;
+  if (Version != MQTT_VERSION_5 || Alias_max == 0) {return 0;}
+  uint32_t empreinte = mqtt_empreinte(topic);
+  for (int i = 0; i < Nb_alias; i++) {
+    if (Empreintes_alias[i] == empreinte && strcmp(Topics_alias[i], topic) == 0) {return i + 1;}
+  }
+  if (Nb_alias >= Alias_max || strlen(topic) >= TAILLE_TOPIC_CLIENT_MQTT) {return 0;}
+  *nouvel = true;
+  return Nb_alias + 1;
+}
+
+/**
+ * @fn size_t ClientMQTT::taille_proprietes_publish(int alias, const Struct_Proprietes_MQTT *proprietes)
+ * @brief Taille du bloc de propriétés MQTT 5 d'un paquet PUBLISH (sans sa longueur).
+ */
+size_t ClientMQTT::taille_proprietes_publish(int alias, const Struct_Proprietes_MQTT *proprietes) {
+  size_t taille = (alias > 0) ? 3 : 0;
+  if (proprietes != NULL) {
+    if (proprietes->Topic_reponse != NULL) {taille += 3 + strlen(proprietes->Topic_reponse);}
+    if (proprietes->Correlation != NULL && proprietes->Taille_correlation > 0) {taille += 3 + proprietes->Taille_correlation;}
+  }
+  return taille;
+}
+
+/**
+ * @fn size_t ClientMQTT::taille_publish(const char *topic, size_t taille, const Struct_Proprietes_MQTT *proprietes, size_t *taille_topic)
+ * @brief Taille exacte sur la liaison du paquet PUBLISH QoS 0 qu'émettrait beginPublish() : en-tête fixe,
+ * topic (vide si son alias est déjà attribué), propriétés et message.
+ *
+ * @param topic Topic de publication.
+ * @param taille Taille du message.
+ * @param proprietes Propriétés jointes, NULL si aucune.
+ * @param taille_topic Renseigné avec le nombre d'octets de topic émis, si non NULL.
+ * @return Taille du paquet en octets.
+ */
+size_t ClientMQTT::taille_publish(const char *topic, size_t taille, const Struct_Proprietes_MQTT *proprietes, size_t *taille_topic) {
+  bool nouvel;
+  int alias = alias_publish(topic, &nouvel);
+  size_t octets_topic = (alias > 0 && !nouvel) ? 0 : strlen(topic);
+  size_t restant = 2 + octets_topic + taille;
+  if (Version == MQTT_VERSION_5) {
+    size_t octets_proprietes = taille_proprietes_publish(alias, proprietes);
+    restant += mqtt_taille_longueur(octets_proprietes) + octets_proprietes;
+  }
+  if (taille_topic != NULL) {*taille_topic = octets_topic;}
+  return 1 + mqtt_taille_longueur(restant) + restant;
+}
+
+/**
+ * @fn bool ClientMQTT::beginPublish(const char *topic, size_t taille, bool retenu, const Struct_Proprietes_MQTT *proprietes)
+ * @brief Émission de l'en-tête d'un paquet PUBLISH QoS 0 ; le message suit par write(), puis endPublish().
+ *
+ * En MQTT 5, le topic est remplacé par son alias s'il en a déjà un, ou reçoit un nouvel alias s'il en reste.
+ *
+ * @param topic Topic de publication.
+ * @param taille Taille du message qui suivra.
+ * @param retenu Message retenu par le serveur.
+ * @param proprietes Propriétés Response Topic / Correlation Data, NULL si aucune (ignorées en MQTT 3.1.1).
+ * @return false si la session est fermée, si le paquet dépasse la taille acceptée par le serveur, ou si l'en-tête n'a pas été émis en entier.
+ */
+bool ClientMQTT::beginPublish(const char *topic, size_t taille, bool retenu, const Struct_Proprietes_MQTT *proprietes) {
+  if (!connected()) {return false;}
+  bool v5 = (Version == MQTT_VERSION_5);
+  bool nouvel;
+  int alias = alias_publish(topic, &nouvel);
+  size_t octets_topic = (alias > 0 && !nouvel) ? 0 : strlen(topic);
+  size_t octets_proprietes = v5 ? taille_proprietes_publish(alias, proprietes) : 0;
+  uint32_t restant = 2 + octets_topic + taille;
+  if (v5) {restant += mqtt_taille_longueur(octets_proprietes) + octets_proprietes;}
+  if (Paquet_max_serveur > 0 && 1 + mqtt_taille_longueur(restant) + restant > Paquet_max_serveur) {return false;}
+
+  Erreur_emission = false;
+  ajoute_octet(PAQUET_PUBLISH | (retenu ? 0x01 : 0x00));
+  ajoute_longueur(restant);
+  ajoute_chaine(topic, octets_topic);
+  if (v5) {
+    ajoute_longueur(octets_proprietes);
+    if (alias > 0) {
+      ajoute_octet(PROPRIETE_ALIAS);
+      ajoute_16((uint16_t)alias);
+    }
+    if (proprietes != NULL && proprietes->Topic_reponse != NULL) {
+      ajoute_octet(PROPRIETE_TOPIC_REPONSE);
+      ajoute_chaine(proprietes->Topic_reponse, strlen(proprietes->Topic_reponse));
+    }
+    if (proprietes != NULL && proprietes->Correlation != NULL && proprietes->Taille_correlation > 0) {
+      ajoute_octet(PROPRIETE_CORRELATION);
+      ajoute_chaine((const char *)proprietes->Correlation, proprietes->Taille_correlation);
+    }
+  }
+  if (!emet_entete()) {return false;}
+
+  if (nouvel) {
+    strcpy(Topics_alias[Nb_alias], topic);
+    Empreintes_alias[Nb_alias] = mqtt_empreinte(topic);
+    Nb_alias++;
+  }
+  else if (alias > 0) {
+    Publications_alias++;
+    Octets_topics_evites += strlen(topic);
+  }
+  return true;
+}
+
+/**
+ * @fn size_t ClientMQTT::write(const uint8_t *tampon, size_t taille)
+ * @brief Écriture d'une partie du message du paquet PUBLISH en cours.
+ */
+size_t ClientMQTT::write(const uint8_t *tampon, size_t taille) {
+  size_t ecrit = Liaison->write(tampon, taille);
+  Octets_emis += ecrit;
+  Derniere_emission = millis();
+  return ecrit;
+}
+
+/**
+ * @fn int ClientMQTT::endPublish(void)
+ * @brief Fin d'un paquet PUBLISH QoS 0 : rien n'est attendu du serveur.
+ *
+ * @return 1 si la session est toujours ouverte.
+ */
+int ClientMQTT::endPublish(void) {
+  return (Etat == CLIENT_MQTT_CONNECTE) ? 1 : 0;
+}
+
+/**
+ * @fn bool ClientMQTT::publish(const char *topic, const char *message, bool retenu, const Struct_Proprietes_MQTT *proprietes)
+ * @brief Publication QoS 0 d'un message texte.
+ */
+bool ClientMQTT::publish(const char *topic, const char *message, bool retenu, const Struct_Proprietes_MQTT *proprietes) {
+  size_t taille = strlen(message);
+  if (!beginPublish(topic, taille, retenu, proprietes)) {return false;}
+  bool complet = (write((const uint8_t *)message, taille) == taille);
+  return endPublish() == 1 && complet;
+}
+
+/**
+ * @fn bool ClientMQTT::loop(void)
+ * @brief Réception sans attente des paquets disponibles et maintien de la session (PINGREQ).
+ *
+ * @return false si la session est fermée.
+ */
+bool ClientMQTT::loop(void) {
+  if (!connected()) {return false;}
+  recoit();
+  if (Etat != CLIENT_MQTT_CONNECTE) {return false;}
+
+  unsigned long maintenant = millis();
+  unsigned long maintien = Maintien_s * 1000UL;
+  if (maintien > 0 && (maintenant - Derniere_emission >= maintien || maintenant - Derniere_reception >= maintien)) {
+    if (Ping_en_cours) {
+      coupe(CLIENT_MQTT_DELAI_DEPASSE);
+      return false;
+    }
+    uint8_t paquet[2] = {PAQUET_PINGREQ, 0};
+    Erreur_emission = false;
+    ajoute(paquet, 2);
+    if (!emet_entete()) {
+      coupe(CLIENT_MQTT_LIAISON_PERDUE);
+      return false;
+    }
+    Derniere_reception = maintenant;
+    Ping_en_cours = true;
+  }
+  return true;
+}
+
+/**
+ * @fn void ClientMQTT::recoit(void)
+ * @brief Assemblage du paquet en cours de réception avec les octets disponibles, sans attendre.
+ *
+ * Un paquet complet au plus est traité par appel : les commandes suivantes restent dans la pile TCP.
+ * Le contenu au-delà de la taille du tampon est lu sans être conservé.
+ */
+void ClientMQTT::recoit(void) {
+  while (Liaison->available() > 0) {
+    if (Etape == 0) {
+      int octet = Liaison->read();
+      if (octet < 0) {return;}
+      Type_recu = (uint8_t)octet;
+      Restant = 0;
+      Multiplicateur = 1;
+      Etape = 1;
+      continue;
+    }
+    if (Etape == 1) {
+      int octet = Liaison->read();
+      if (octet < 0) {return;}
+      Restant += (uint32_t)(octet & 0x7F) * Multiplicateur;
+      if (octet & 0x80) {
+        if (Multiplicateur == 128UL * 128 * 128) {
+          coupe(CLIENT_MQTT_PROTOCOLE);
+          return;
+        }
+        Multiplicateur *= 128;
+        continue;
+      }
+      Lu = 0;
+      Etape = 2;
+    }
+    if (Lu < Restant) {
+      int lu;
+      if (Lu < Taille_reception) {
+        size_t n = Restant - Lu;
+        if (n > (size_t)(Taille_reception - Lu)) {n = Taille_reception - Lu;}
+        lu = Liaison->read(Reception + Lu, n);
+      }
+      else {
+        uint8_t ecarte[64];
+        size_t n = Restant - Lu;
+        if (n > sizeof(ecarte)) {n = sizeof(ecarte);}
+        lu = Liaison->read(ecarte, n);
+      }
+      if (lu <= 0) {return;}
+      Lu += lu;
+      if (Lu < Restant) {continue;}
+    }
+    Etape = 0;
+    Derniere_reception = millis();
+    Ping_en_cours = false;
+    traite_paquet();
+    return;
+  }
+}
+
+/**
+ * @fn void ClientMQTT::traite_paquet(void)
+ * @brief Traitement d'un paquet reçu en entier.
+ */
+void ClientMQTT::traite_paquet(void) {
+  if (Restant > Taille_reception) {Paquets_ecartes++;}
+  switch (Type_recu & 0xF0) {
+    case PAQUET_CONNACK:
+      if (Etat == CLIENT_MQTT_EN_COURS) {traite_connack();}
+      break;
+    case PAQUET_PUBLISH:
+      if (Etat == CLIENT_MQTT_CONNECTE) {traite_publish();}
+      break;
+    case PAQUET_DISCONNECT:
+      coupe(CLIENT_MQTT_LIAISON_PERDUE);
+      break;
+    default:
+      // SUBACK, PINGRESP : rien à faire
+      break;
+  }
+}
+
+/**
+ * @fn void ClientMQTT::traite_connack(void)
+ * @brief Lecture du CONNACK : code de retour et, en MQTT 5, limites annoncées par le serveur.
+ */
+void ClientMQTT::traite_connack(void) {
+  if (Restant < 2 || Restant > Taille_reception) {
+    coupe(CLIENT_MQTT_PROTOCOLE);
+    return;
+  }
+  if (Reception[1] != 0) {
+    coupe(Reception[1]);
+    return;
+  }
+  if (Version == MQTT_VERSION_5 && Restant > 2) {
+    const uint8_t *p = Reception + 2;
+    const uint8_t *fin_paquet = Reception + Restant;
+    uint32_t longueur;
+    if (!mqtt_lit_longueur(&p, fin_paquet, &longueur) || longueur > (uint32_t)(fin_paquet - p)) {
+      coupe(CLIENT_MQTT_PROTOCOLE);
+      return;
+    }
+    const uint8_t *fin = p + longueur;
+    while (p < fin) {
+      uint8_t id = *p++;
+      int taille = mqtt_taille_propriete(id, p, fin);
+      if (taille < 0) {
+        coupe(CLIENT_MQTT_PROTOCOLE);
+        return;
+      }
+      if (id == PROPRIETE_ALIAS_MAX) {
+        uint16_t valeur = (p[0] << 8) | p[1];
+        Alias_max = (valeur < NB_ALIAS_MQTT) ? valeur : NB_ALIAS_MQTT;
+      }
+      else if (id == PROPRIETE_MAINTIEN_SERVEUR) {Maintien_s = (p[0] << 8) | p[1];}
+      else if (id == PROPRIETE_PAQUET_MAX) {Paquet_max_serveur = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];}
+      p += taille;
+    }
+  }
+  Etat = CLIENT_MQTT_CONNECTE;
+}
+
+/**
+ * @fn void ClientMQTT::traite_publish(void)
+ * @brief Remise d'un message reçu au rappel, avec ses propriétés Response Topic / Correlation Data, puis
+ * acquittement (PUBACK) s'il est en QoS 1.
+ *
+ * Un message plus grand que le tampon de réception est acquitté sans rappel : le serveur ne le redélivre pas.
+ * Un Response Topic ou une Correlation Data plus grands que leur tampon ne sont pas transmis.
+ */
+void ClientMQTT::traite_publish(void) {
+  uint8_t qos = (Type_recu >> 1) & 0x03;
+  uint32_t disponible = (Restant < Taille_reception) ? Restant : Taille_reception;
+  if (disponible < 2) {
+    coupe(CLIENT_MQTT_PROTOCOLE);
+    return;
+  }
+  uint16_t taille_topic = (Reception[0] << 8) | Reception[1];
+  uint32_t position = 2 + taille_topic;
+  uint16_t id = 0;
+  if (qos > 0) {
+    if (position + 2 > disponible) {return;}
+    id = (Reception[position] << 8) | Reception[position + 1];
+    position += 2;
+  }
+
+  Proprietes = Struct_Proprietes_MQTT();
+  bool complet = (Restant <= Taille_reception) && taille_topic > 0;
+  if (Version == MQTT_VERSION_5) {
+    const uint8_t *p = Reception + position;
+    const uint8_t *fin_paquet = Reception + disponible;
+    uint32_t longueur;
+    if (!mqtt_lit_longueur(&p, fin_paquet, &longueur) || longueur > (uint32_t)(fin_paquet - p)) {complet = false;}
+    else {
+      const uint8_t *fin = p + longueur;
+      while (p < fin) {
+        uint8_t propriete = *p++;
+        int taille = mqtt_taille_propriete(propriete, p, fin);
+        if (taille < 0) {
+          complet = false;
+          break;
+        }
+        if (propriete == PROPRIETE_TOPIC_REPONSE && taille - 2 < TAILLE_TOPIC_CLIENT_MQTT) {
+          memcpy(Topic_reponse, p + 2, taille - 2);
+          Topic_reponse[taille - 2] = '\0';
+          Proprietes.Topic_reponse = Topic_reponse;
+        }
+        else if (propriete == PROPRIETE_CORRELATION && taille - 2 <= TAILLE_CORRELATION_MQTT) {
+          memcpy(Correlation, p + 2, taille - 2);
+          Proprietes.Correlation = Correlation;
+          Proprietes.Taille_correlation = taille - 2;
+        }
+        p += taille;
+      }
+      position = p - Reception;
+    }
+  }
+
+  if (complet && position <= Restant && Rappel != NULL) {
+    memmove(Reception, Reception + 2, taille_topic);
+    Reception[taille_topic] = '\0';
+    Rappel((char *)Reception, Reception + position, Restant - position);
+  }
+  Proprietes = Struct_Proprietes_MQTT();
+
+  if (qos == 1) {
+    uint8_t paquet[4] = {PAQUET_PUBACK, 2, (uint8_t)(id >> 8), (uint8_t)id};
+    Erreur_emission = false;
+    ajoute(paquet, 4);
+    if (!emet_entete()) {coupe(CLIENT_MQTT_LIAISON_PERDUE);}
+  }
+}
+
+/**
+ * @fn const Struct_Proprietes_MQTT *ClientMQTT::proprietes_recues(void)
+ * @brief Propriétés Response Topic / Correlation Data du message en cours de rappel (valides pendant le rappel).
+ */
+const Struct_Proprietes_MQTT *ClientMQTT::proprietes_recues(void) {
+  return &Proprietes;
+}
+
+/**
+ * @fn void ClientMQTT::affiche_diagnostic(void)
+ * @brief Affiche la version du protocole et l'usage des alias de topic.
+ */
+void ClientMQTT::affiche_diagnostic(void) {
+  Serial.printf("   Protocole : MQTT %s, maintien %u s\n", Version == MQTT_VERSION_5 ? "5" : "3.1.1", Maintien_s);
+  if (Version == MQTT_VERSION_5) {
+    Serial.printf("   Alias de topic : %u attribues sur %u autorises par le serveur, %lu publications par alias, %lu octets de topic evites\n", Nb_alias, Alias_max, Publications_alias, Octets_topics_evites);
+  }
+  Serial.printf("   Octets emis : %lu, paquets recus ecartes (trop grands) : %lu\n", Octets_emis, Paquets_ecartes);
+}
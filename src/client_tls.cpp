@@ -0,0 +1,456 @@
+/**
+ * @file client_tls.cpp
+ * @brief Fonction de client TLS avec reprise de session.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la connexion chiffrée au serveur MQTT.
+ * La poignée de main complète (échange de clé ECDHE, vérification du certificat) coûte plusieurs secondes
+ * de CPU et plusieurs dizaines de ko de tas sur l'ESP32. La session négociée (identifiant ou ticket de
+ * session) est donc conservée en RAM, et optionnellement en mémoire RTC pour survivre à un sommeil profond :
+ * les reconnexions suivantes reprennent la session sans nouvel échange de clé.
+ * Chaque appel à mbedtls_ssl_write produit un enregistrement TLS (en-tête, MAC, bourrage) : les octets écrits
+ * un à un sont regroupés dans un tampon d'émission, vidé avant toute lecture, à la fermeture ou sur flush().
+ *
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "lwip/sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/error.h"
+#include "client_tls.h"
+#include "global.h"
+
+/// @brief Taille maximale de la session sérialisée conservée en mémoire RTC
+#define TAILLE_SESSION_RTC 2048
+
+/// @brief Durée maximale d'attente de la socket pendant une écriture
+#define TIMEOUT_ECRITURE_TLS_MS 5000
+
+/// @brief Taille du tampon d'émission des octets écrits un à un
+#define TAILLE_EMISSION_TLS 256
+
+/**
+ * @struct Struct_TLS
+ * @brief Contextes mbedTLS, session conservée et mesures de la connexion TLS.
+ */
+struct Struct_TLS {
+  mbedtls_ssl_context Ssl;
+  mbedtls_ssl_config Conf;
+  mbedtls_entropy_context Entropie;
+  mbedtls_ctr_drbg_context Drbg;
+  mbedtls_x509_crt Ca;
+  mbedtls_x509_crt Certificat;
+  mbedtls_pk_context Cle;
+  mbedtls_ssl_session Session;       ///< Dernière session négociée, proposée à la reconnexion.
+  bool Session_valide = false;       ///< Une session peut être reprise.
+  bool Session_rtc = false;          ///< Copie de la session en mémoire RTC.
+  String Nom_serveur;                ///< Nom attendu dans le certificat du serveur (SNI), vide pour le nom du serveur joint.
+  String Hote;                       ///< Serveur de la connexion en cours.
+  String Hote_session;               ///< Serveur ayant négocié la session conservée.
+  bool Configure = false;            ///< Configuration chargée.
+  bool Ssl_actif = false;            ///< Contexte Ssl initialisé.
+  bool Connecte = false;             ///< Poignée de main terminée, liaison utilisable.
+  int Fd = -1;                       ///< Socket TCP.
+  int Lu = -1;                       ///< Octet lu d'avance par available() / peek().
+  uint8_t Emission[TAILLE_EMISSION_TLS];  ///< Octets écrits un à un, en attente d'émission.
+  size_t Nb_emission = 0;            ///< Octets en attente dans Emission.
+  unsigned long Enregistrements = 0; ///< Enregistrements TLS émis.
+  unsigned long Octets_emis = 0;     ///< Octets applicatifs émis.
+  int64_t Debut_us = 0;              ///< Début de la poignée de main en cours.
+  uint32_t Tas_avant = 0;            ///< Tas libre avant la poignée de main.
+  uint32_t Tas_min = 0;              ///< Tas libre minimal pendant la poignée de main.
+  bool Echange_cle = false;          ///< La poignée de main en cours a fait un échange de clé complet.
+  unsigned long Handshakes = 0;      ///< Poignées de main réussies.
+  unsigned long Reprises = 0;        ///< Poignées de main avec reprise de session.
+  unsigned long Echecs = 0;          ///< Poignées de main échouées.
+  long Duree_complete_ms = 0;        ///< Durée de la dernière poignée de main complète.
+  long Duree_reprise_ms = 0;         ///< Durée de la dernière reprise de session.
+  uint32_t Tas_pic = 0;              ///< Consommation de tas de la dernière poignée de main.
+  uint32_t Tas_pic_max = 0;          ///< Consommation de tas maximale d'une poignée de main.
+  int Derniere_erreur = 0;           ///< Dernier code d'erreur mbedTLS.
+};
+
+Struct_TLS TLS;
+
+RTC_DATA_ATTR uint8_t Session_RTC[TAILLE_SESSION_RTC];
+RTC_DATA_ATTR size_t Taille_session_RTC = 0;
+RTC_DATA_ATTR char Hote_session_RTC[64];
+
+/**
+ * @fn int tls_envoi(void *ctx, const unsigned char *buf, size_t len)
+ * @brief Émission sur la socket non bloquante pour mbedTLS.
+ */
+int tls_envoi(void *ctx, const unsigned char *buf, size_t len){
+  int r=send(*(int*)ctx, buf, len, 0);
+  if(r<0){
+    if(errno==EAGAIN || errno==EWOULDBLOCK){return MBEDTLS_ERR_SSL_WANT_WRITE;}
+    return MBEDTLS_ERR_NET_SEND_FAILED;
+  }
+  return r;
+}
+
+/**
+ * @fn int tls_reception(void *ctx, unsigned char *buf, size_t len)
+ * @brief Réception sur la socket non bloquante pour mbedTLS.
+ */
+int tls_reception(void *ctx, unsigned char *buf, size_t len){
+  int r=recv(*(int*)ctx, buf, len, 0);
+  if(r<0){
+    if(errno==EAGAIN || errno==EWOULDBLOCK){return MBEDTLS_ERR_SSL_WANT_READ;}
+    return MBEDTLS_ERR_NET_RECV_FAILED;
+  }
+  if(r==0){return MBEDTLS_ERR_NET_CONN_RESET;}
+  return r;
+}
+
+/**
+ * @fn void tls_erreur(const char *etape, int code)
+ * @brief Affichage d'une erreur mbedTLS.
+ */
+void tls_erreur(const char *etape, int code){
+  char texte[100];
+  mbedtls_strerror(code, texte, sizeof(texte));
+  TLS.Derniere_erreur=code;
+  Serial.printf("TLS %s : -0x%04X %s\n", etape, -code, texte);
+}
+
+/**
+ * @fn bool ClientTLS::configure(const char *ca, const char *certificat, const char *cle, const char *nom_serveur, bool session_rtc)
+ * @brief Chargement des certificats et de la configuration TLS.
+ *
+ * @param ca Certificat de l'autorité (PEM), vide pour ne pas vérifier le serveur (déconseillé)
+ * @param certificat Certificat client (PEM), vide si le serveur n'authentifie pas les clients
+ * @param cle Clé privée du certificat client (PEM)
+ * @param nom_serveur Nom attendu dans le certificat du serveur
+ * @param session_rtc Conserver la session en mémoire RTC (reprise après sommeil profond)
+ * @return false si un certificat ou la clé est invalide
+ */
+bool ClientTLS::configure(const char *ca, const char *certificat, const char *cle, const char *nom_serveur, bool session_rtc){
+  int r;
+  mbedtls_ssl_config_init(&TLS.Conf);
+  mbedtls_entropy_init(&TLS.Entropie);
+  mbedtls_ctr_drbg_init(&TLS.Drbg);
+  mbedtls_x509_crt_init(&TLS.Ca);
+  mbedtls_x509_crt_init(&TLS.Certificat);
+  mbedtls_pk_init(&TLS.Cle);
+  mbedtls_ssl_session_init(&TLS.Session);
+  TLS.Nom_serveur=nom_serveur;
+  TLS.Session_rtc=session_rtc;
+
+  r=mbedtls_ctr_drbg_seed(&TLS.Drbg, mbedtls_entropy_func, &TLS.Entropie, NULL, 0);
+  if(r!=0){tls_erreur("graine", r); return false;}
+  r=mbedtls_ssl_config_defaults(&TLS.Conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM, MBEDTLS_SSL_PRESET_DEFAULT);
+  if(r!=0){tls_erreur("configuration", r); return false;}
+  mbedtls_ssl_conf_rng(&TLS.Conf, mbedtls_ctr_drbg_random, &TLS.Drbg);
+  mbedtls_ssl_conf_session_tickets(&TLS.Conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+
+  if(ca[0]!='\0'){
+    r=mbedtls_x509_crt_parse(&TLS.Ca, (const unsigned char*)ca, strlen(ca)+1);
+    if(r!=0){tls_erreur("certificat CA", r); return false;}
+    mbedtls_ssl_conf_ca_chain(&TLS.Conf, &TLS.Ca, NULL);
+    mbedtls_ssl_conf_authmode(&TLS.Conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+  }
+  else{
+    Serial.println("   TLS sans certificat CA : le serveur n'est pas authentifié");
+    mbedtls_ssl_conf_authmode(&TLS.Conf, MBEDTLS_SSL_VERIFY_NONE);
+  }
+
+  if(certificat[0]!='\0'){
+    r=mbedtls_x509_crt_parse(&TLS.Certificat, (const unsigned char*)certificat, strlen(certificat)+1);
+    if(r!=0){tls_erreur("certificat client", r); return false;}
+    r=mbedtls_pk_parse_key(&TLS.Cle, (const unsigned char*)cle, strlen(cle)+1, NULL, 0);
+    if(r!=0){tls_erreur("cle client", r); return false;}
+    r=mbedtls_ssl_conf_own_cert(&TLS.Conf, &TLS.Certificat, &TLS.Cle);
+    if(r!=0){tls_erreur("certificat client", r); return false;}
+  }
+
+  /// @brief Reprise d'une session conservée en mémoire RTC avant un sommeil profond
+  if(TLS.Session_rtc && Taille_session_RTC>0 && Taille_session_RTC<=TAILLE_SESSION_RTC){
+    TLS.Session_valide=(mbedtls_ssl_session_load(&TLS.Session, Session_RTC, Taille_session_RTC)==0);
+    Hote_session_RTC[sizeof(Hote_session_RTC)-1]='\0';
+    TLS.Hote_session=Hote_session_RTC;
+    Serial.printf("   Session TLS en memoire RTC : %s\n", TLS.Session_valide ? "reprise" : "invalide");
+  }
+
+  TLS.Configure=true;
+  return true;
+}
+
+/**
+ * @fn int ClientTLS::demarre(int fd, const char *hote)
+ * @brief Démarre la poignée de main TLS sur une socket TCP connectée et non bloquante.
+ *
+ * La dernière session négociée est proposée au serveur pour éviter l'échange de clé,
+ * si elle a été négociée avec ce même serveur (plusieurs serveurs peuvent être configurés).
+ *
+ * @param fd Socket TCP connectée
+ * @param hote Serveur joint
+ * @return 1 si la poignée de main est lancée, 0 sinon
+ */
+int ClientTLS::demarre(int fd, const char *hote){
+  if(!TLS.Configure){close(fd); return 0;}
+  stop();
+  TLS.Fd=fd;
+  TLS.Hote=hote;
+  TLS.Debut_us=esp_timer_get_time();
+  TLS.Tas_avant=ESP.getFreeHeap();
+  TLS.Tas_min=TLS.Tas_avant;
+  TLS.Echange_cle=false;
+
+  mbedtls_ssl_init(&TLS.Ssl);
+  TLS.Ssl_actif=true;
+  int r=mbedtls_ssl_setup(&TLS.Ssl, &TLS.Conf);
+  if(r==0){r=mbedtls_ssl_set_hostname(&TLS.Ssl, TLS.Nom_serveur.length()>0 ? TLS.Nom_serveur.c_str() : hote);}
+  if(r!=0){
+    tls_erreur("initialisation", r);
+    TLS.Echecs++;
+    stop();
+    return 0;
+  }
+  mbedtls_ssl_set_bio(&TLS.Ssl, &TLS.Fd, tls_envoi, tls_reception, NULL);
+  if(TLS.Session_valide && TLS.Hote_session==TLS.Hote){mbedtls_ssl_set_session(&TLS.Ssl, &TLS.Session);}
+  return 1;
+}
+
+/**
+ * @fn int ClientTLS::poursuit_handshake(void)
+ * @brief Avance la poignée de main tant que la socket ne fait pas attendre.
+ *
+ * Une reprise de session est reconnue à l'absence d'étape d'échange de clé client.
+ *
+ * @return 1 si la poignée de main est terminée, 0 si elle est en cours, -1 si elle a échoué
+ */
+int ClientTLS::poursuit_handshake(void){
+  if(!TLS.Ssl_actif){return -1;}
+  while(TLS.Ssl.state!=MBEDTLS_SSL_HANDSHAKE_OVER){
+    if(TLS.Ssl.state==MBEDTLS_SSL_CLIENT_KEY_EXCHANGE){TLS.Echange_cle=true;}
+    int r=mbedtls_ssl_handshake_step(&TLS.Ssl);
+    uint32_t tas=ESP.getFreeHeap();
+    if(tas<TLS.Tas_min){TLS.Tas_min=tas;}
+    if(r==MBEDTLS_ERR_SSL_WANT_READ || r==MBEDTLS_ERR_SSL_WANT_WRITE){return 0;}
+    if(r!=0){
+      tls_erreur("poignee de main", r);
+      TLS.Echecs++;
+      stop();
+      return -1;
+    }
+  }
+
+  /// @brief Mesures de la poignée de main
+  long duree=(long)((esp_timer_get_time()-TLS.Debut_us)/1000);
+  bool reprise=!TLS.Echange_cle;
+  TLS.Handshakes++;
+  if(reprise){TLS.Reprises++; TLS.Duree_reprise_ms=duree;}
+  else{TLS.Duree_complete_ms=duree;}
+  TLS.Tas_pic=TLS.Tas_avant-TLS.Tas_min;
+  if(TLS.Tas_pic>TLS.Tas_pic_max){TLS.Tas_pic_max=TLS.Tas_pic;}
+  Serial.printf("TLS etabli en %ld ms (%s), %s, tas consomme %u octets\n", duree, reprise ? "reprise de session" : "echange complet", mbedtls_ssl_get_ciphersuite(&TLS.Ssl), TLS.Tas_pic);
+
+  /// @brief Mémorisation de la session pour la prochaine reconnexion
+  mbedtls_ssl_session_free(&TLS.Session);
+  mbedtls_ssl_session_init(&TLS.Session);
+  TLS.Session_valide=(mbedtls_ssl_get_session(&TLS.Ssl, &TLS.Session)==0);
+  TLS.Hote_session=TLS.Hote;
+  if(TLS.Session_valide && TLS.Session_rtc){
+    size_t taille=0;
+    strncpy(Hote_session_RTC, TLS.Hote.c_str(), sizeof(Hote_session_RTC)-1);
+    Hote_session_RTC[sizeof(Hote_session_RTC)-1]='\0';
+    if(mbedtls_ssl_session_save(&TLS.Session, Session_RTC, TAILLE_SESSION_RTC, &taille)==0){Taille_session_RTC=taille;}
+    else{Taille_session_RTC=0;}
+  }
+
+  TLS.Connecte=true;
+  return 1;
+}
+
+/**
+ * @fn void ClientTLS::affiche_diagnostic(void)
+ * @brief Affiche les mesures des poignées de main TLS.
+ */
+void ClientTLS::affiche_diagnostic(void){
+  unsigned long taux=0;
+  if(TLS.Handshakes>0){taux=100*TLS.Reprises/TLS.Handshakes;}
+  Serial.println("TLS :");
+  Serial.printf("   Poignees de main : %lu (%lu reprises, %lu %%), %lu echecs, derniere erreur -0x%04X\n", TLS.Handshakes, TLS.Reprises, taux, TLS.Echecs, -TLS.Derniere_erreur);
+  Serial.printf("   Duree : complete %ld ms, reprise %ld ms\n", TLS.Duree_complete_ms, TLS.Duree_reprise_ms);
+  Serial.printf("   Tas consomme : dernier %u octets, max %u octets, session RTC %u octets\n", TLS.Tas_pic, TLS.Tas_pic_max, (unsigned)Taille_session_RTC);
+  Serial.printf("   Emission : %lu enregistrements, %lu octets\n", TLS.Enregistrements, TLS.Octets_emis);
+}
+
+/**
+ * @fn int ClientTLS::connect(IPAddress ip, uint16_t port)
+ * @brief La connexion est établie par la machine d'état MQTT (voir demarre) : indique seulement si elle est active.
+ */
+int ClientTLS::connect(IPAddress ip, uint16_t port){
+  return TLS.Connecte ? 1 : 0;
+}
+
+int ClientTLS::connect(const char *host, uint16_t port){
+  return TLS.Connecte ? 1 : 0;
+}
+
+/**
+ * @fn size_t tls_ecrit(const uint8_t *buf, size_t size)
+ * @brief Émission chiffrée, en attendant la socket si son tampon est plein.
+ */
+size_t tls_ecrit(const uint8_t *buf, size_t size){
+  size_t ecrit=0;
+  unsigned long debut=millis();
+  while(ecrit<size){
+    int r=mbedtls_ssl_write(&TLS.Ssl, buf+ecrit, size-ecrit);
+    if(r>0){
+      ecrit+=r;
+      TLS.Enregistrements++;
+      TLS.Octets_emis+=r;
+      continue;
+    }
+    if((r!=MBEDTLS_ERR_SSL_WANT_WRITE && r!=MBEDTLS_ERR_SSL_WANT_READ) || millis()-debut>TIMEOUT_ECRITURE_TLS_MS){
+      TLS.Connecte=false;
+      break;
+    }
+    fd_set ecriture;
+    struct timeval attente = {0, 10000};
+    FD_ZERO(&ecriture);
+    FD_SET(TLS.Fd, &ecriture);
+    select(TLS.Fd+1, NULL, &ecriture, NULL, &attente);
+  }
+  return ecrit;
+}
+
+/**
+ * @fn bool tls_vide_emission(void)
+ * @brief Émission des octets en attente dans le tampon d'émission, en un seul enregistrement.
+ *
+ * @return false si la liaison a été perdue pendant l'émission
+ */
+bool tls_vide_emission(void){
+  if(TLS.Nb_emission==0){return true;}
+  size_t taille=TLS.Nb_emission;
+  TLS.Nb_emission=0;
+  if(!TLS.Connecte){return false;}
+  return tls_ecrit(TLS.Emission, taille)==taille;
+}
+
+/**
+ * @fn size_t ClientTLS::write(const uint8_t *buf, size_t size)
+ * @brief Émission d'un bloc, précédé des octets en attente dans le même enregistrement s'il y a la place.
+ *
+ * Le bloc est émis immédiatement : ClientMQTT n'appelle pas flush() après un paquet.
+ */
+size_t ClientTLS::write(const uint8_t *buf, size_t size){
+  if(!TLS.Connecte){return 0;}
+  if(TLS.Nb_emission>0 && TLS.Nb_emission+size<=TAILLE_EMISSION_TLS){
+    memcpy(TLS.Emission+TLS.Nb_emission, buf, size);
+    TLS.Nb_emission+=size;
+    return tls_vide_emission() ? size : 0;
+  }
+  if(!tls_vide_emission()){return 0;}
+  return tls_ecrit(buf, size);
+}
+
+/**
+ * @fn size_t ClientTLS::write(uint8_t octet)
+ * @brief Écriture d'un octet dans le tampon d'émission, émis quand il est plein ou avant la prochaine lecture.
+ */
+size_t ClientTLS::write(uint8_t octet){
+  if(!TLS.Connecte){return 0;}
+  TLS.Emission[TLS.Nb_emission++]=octet;
+  if(TLS.Nb_emission==TAILLE_EMISSION_TLS && !tls_vide_emission()){return 0;}
+  return 1;
+}
+
+/**
+ * @fn int ClientTLS::available()
+ * @brief Nombre d'octets déchiffrés disponibles, sans attendre.
+ */
+int ClientTLS::available(){
+  if(!TLS.Connecte){return 0;}
+  // Une réponse ne peut arriver qu'après l'émission de la requête
+  tls_vide_emission();
+  if(TLS.Lu<0){
+    unsigned char octet;
+    int r=mbedtls_ssl_read(&TLS.Ssl, &octet, 1);
+    if(r==1){TLS.Lu=octet;}
+    else if(r!=MBEDTLS_ERR_SSL_WANT_READ && r!=MBEDTLS_ERR_SSL_WANT_WRITE){TLS.Connecte=false;}
+  }
+  if(TLS.Lu<0){return 0;}
+  return 1+mbedtls_ssl_get_bytes_avail(&TLS.Ssl);
+}
+
+int ClientTLS::read(){
+  if(TLS.Lu<0 && available()==0){return -1;}
+  int octet=TLS.Lu;
+  TLS.Lu=-1;
+  return octet;
+}
+
+int ClientTLS::read(uint8_t *buf, size_t size){
+  if(size==0 || available()==0){return 0;}
+  buf[0]=(uint8_t)TLS.Lu;
+  TLS.Lu=-1;
+  int lu=1;
+  size_t disponible=mbedtls_ssl_get_bytes_avail(&TLS.Ssl);
+  if(disponible>size-1){disponible=size-1;}
+  if(disponible>0){
+    int r=mbedtls_ssl_read(&TLS.Ssl, buf+1, disponible);
+    if(r>0){lu+=r;}
+  }
+  return lu;
+}
+
+int ClientTLS::peek(){
+  if(TLS.Lu<0){available();}
+  return TLS.Lu;
+}
+
+/**
+ * @fn void ClientTLS::flush()
+ * @brief Émission des octets en attente.
+ */
+void ClientTLS::flush(){
+  tls_vide_emission();
+}
+
+/**
+ * @fn void ClientTLS::stop()
+ * @brief Fermeture de la liaison TLS et de la socket. La session reste mémorisée pour la reconnexion.
+ */
+void ClientTLS::stop(){
+  tls_vide_emission();
+  if(TLS.Ssl_actif){
+    if(TLS.Connecte){mbedtls_ssl_close_notify(&TLS.Ssl);}
+    mbedtls_ssl_free(&TLS.Ssl);
+    TLS.Ssl_actif=false;
+  }
+  if(TLS.Fd>=0){
+    close(TLS.Fd);
+    TLS.Fd=-1;
+  }
+  TLS.Connecte=false;
+  TLS.Lu=-1;
+}
+
+/**
+ * @fn int ClientTLS::fd()
+ * @brief Socket TCP de la liaison, -1 si elle est fermée.
+ */
+int ClientTLS::fd(){
+  return TLS.Fd;
+}
+
+uint8_t ClientTLS::connected(){
+  return TLS.Connecte ? 1 : 0;
+}
+
+ClientTLS::operator bool(){
+  return TLS.Connecte;
+}
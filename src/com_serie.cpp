@@ -11,7 +11,6 @@
  */
 
 #include <Wire.h>
-#include <PubSubClient.h>
 #include <PCF8574.h>
 #include "capteurs.h"
 #include "Fonctions_MQTT.h"
@@ -20,6 +19,15 @@
 #include "File_System.h"
 #include "global.h"
 #include "GPIO.h"
+#include "energie.h"
+#include "planificateur.h"
+#include "regulation.h"
+#include "routeur.h"
+#include "file_attente.h"
+#include "debit.h"
+#include "pool_commandes.h"
+#include "api_rest.h"
+#include "historique.h"
 
 
 
@@ -136,6 +144,46 @@ void print_ack_f(String rep, int devicenumber, float value){
   Serial.println(value);  
 }
 
+/**
+ * @fn bool lit_lot_serie(const String &champs, Struct_Lot_Sorties *lot)
+ * @brief Lecture d'un lot de sorties sur la liaison série.
+ *
+ * Champs séparés par des espaces : E:mm:vv (PCF8574_OUT_1, masque et valeurs en hexadécimal),
+ * O:mm:vv (GPIO_OUT, bit i : sortie i+1), Sn:angle (servo n), Wn:pourcent (PWM n).
+ * Exemple : #L00 E:0F:05 O:03:01 S0:90 W1:50!
+ *
+ * @return false si un champ est mal formé
+ */
+bool lit_lot_serie(const String &champs, Struct_Lot_Sorties *lot){
+  int debut=0;
+  while(debut<(int)champs.length()){
+    int fin=champs.indexOf(' ', debut);
+    if(fin<0){fin=champs.length();}
+    String champ=champs.substring(debut, fin);
+    debut=fin+1;
+    if(champ.length()==0 || champ=="!"){continue;}
+    unsigned int m, v;
+    int n, val;
+    if(sscanf(champ.c_str(), "E:%x:%x", &m, &v)==2){lot->Masque_PCF8574_1=m; lot->Valeurs_PCF8574_1=v;}
+    else if(sscanf(champ.c_str(), "O:%x:%x", &m, &v)==2){lot->Masque_GPIO_OUT=m; lot->Valeurs_GPIO_OUT=v;}
+    else if(sscanf(champ.c_str(), "S%d:%d", &n, &val)==2 && n>=0 && n<4){lot->Masque_Servo|=(1<<n); lot->Servo[n]=val;}
+    else if(sscanf(champ.c_str(), "W%d:%d", &n, &val)==2 && n>=0 && n<4){lot->Masque_PWM|=(1<<n); lot->PWM[n]=val;}
+    else{return false;}
+  }
+  return true;
+}
+
+/**
+ * @fn void print_etat_sorties(String rep, int devicenumber)
+ * @brief Réponse à un lot de sorties : état combiné de toutes les sorties après application.
+ */
+void print_etat_sorties(String rep, int devicenumber){
+  Struct_Lot_Sorties etat;
+  Sorties_etat(&etat);
+  Serial.printf("%s%02d E:%02X O:%02X S:%d,%d,%d,%d W:%d,%d,%d,%d\n", rep.c_str(), devicenumber, etat.Valeurs_PCF8574_1, etat.Valeurs_GPIO_OUT,
+    etat.Servo[0], etat.Servo[1], etat.Servo[2], etat.Servo[3], etat.PWM[0], etat.PWM[1], etat.PWM[2], etat.PWM[3]);
+}
+
 void serialEvent() {
 
   if(isMenuVisible) {
@@ -165,6 +213,7 @@ void serialEvent() {
           case 'S':
             // Commande pour un servo
             if(ServoMoteur_OUT(deviceNumber, value)==1){
+              demande_publication();
               print_ack("#ACK S",deviceNumber,value);          
               }
             else{
@@ -173,8 +222,9 @@ void serialEvent() {
             break;
 
           case 'W':
-            // Commande pour un PWM
-            if(PWM_OUT(deviceNumber, value)==1){
+            // Commande pour un PWM, refusée sur la sortie pilotée par la régulation
+            if(!Regulation_voie_reservee(deviceNumber) && PWM_OUT(deviceNumber, value)==1){
+              demande_publication();
               print_ack("#ACK W",deviceNumber,value);             
               }
             else{
@@ -185,6 +235,7 @@ void serialEvent() {
           case 'O':
             // Commande pour une sortie GPIO
             if(GPIO_OUT(deviceNumber, value)==1){
+              demande_publication();
               print_ack("#ACK O",deviceNumber,value);             
               }
             else{
@@ -195,6 +246,7 @@ void serialEvent() {
           case 'E':
             // Commande pour une sortie PCF8574_OUT_1
             if(PCF8574_OUT_1_out(deviceNumber, value)==1){
+              demande_publication();
               print_ack("#ACK E",deviceNumber,value);              
               }
             else{
@@ -202,6 +254,22 @@ void serialEvent() {
             }
             break; 
 
+          case 'L': {
+            // Commande groupée de sorties, vérifiée puis appliquée d'un seul bloc
+            Struct_Lot_Sorties lot;
+            const char *erreur=NULL;
+            if(!lit_lot_serie(incomingData.substring(5), &lot)){erreur="champ invalide";}
+            if(erreur==NULL){erreur=Sorties_lot_verifie(&lot);}
+            if(erreur!=NULL){
+              Serial.printf("#ERR L%02d %s\n", deviceNumber, erreur);
+              break;
+            }
+            Sorties_lot_applique(&lot);
+            demande_publication();
+            print_etat_sorties("#ACK L", deviceNumber);
+            break;
+          }
+
           case 'I':
             // Commande pour une entreé numérique GPIO
             print_ack("#ACK I",deviceNumber,GPIO_IN(deviceNumber,0));
@@ -235,6 +303,31 @@ void serialEvent() {
             print_ack_f("#ACK R",deviceNumber,Point_rosee());
             break;  
 
+          case 'D':
+            // Commande pour les diagnostics
+            affiche_diagnostic_wifi();
+            affiche_diagnostic_energie();
+            affiche_diagnostic_planificateur();
+            affiche_diagnostic_regulation();
+            affiche_diagnostic_MQTT();
+            affiche_diagnostic_file_attente();
+            affiche_diagnostic_debit();
+            affiche_diagnostic_pool_commandes();
+            affiche_diagnostic_API();
+            affiche_diagnostic_historique();
+            break;
+
+          case 'B':
+            // Commande pour les bancs de mesure (encodages JSON / MessagePack, routeur de commandes)
+            banc_encodage_MQTT();
+            banc_routeur(300);
+            break;
+
+          case 'K':
+            // Commande pour exporter la trace de réponse de la régulation
+            affiche_trace_regulation();
+            break;
+
           case 'F' :
             // Commande pour tout transmettre
             Serial.println("Température/Pression/Humidite/Rosee");
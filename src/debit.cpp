@@ -0,0 +1,154 @@
+/**
+ * @file debit.cpp
+ * @brief Fonction de régulation du débit MQTT sortant.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la limitation du débit des publications, pour ne pas saturer une liaison montante partagée
+ * (routeur LTE) quand beaucoup de vannes changent en même temps ou que la file d'attente est rejouée.
+ * Chaque classe de trafic a son seau à jetons (octets par seconde et rafale). Toutes les classes puisent
+ * aussi dans un seau global, où chaque classe doit laisser une réserve pour les classes plus prioritaires :
+ * les acquittements de commande passent toujours en premier.
+ *
+ */
+
+#include <Arduino.h>
+#include "File_System.h"
+#include "debit.h"
+#include "global.h"
+
+/**
+ * @struct Struct_Seau
+ * @brief Seau à jetons en octets. Un débit nul désactive la limitation.
+ */
+struct Struct_Seau {
+  float Debit = 0;                   ///< Débit de remplissage en octets par seconde (0 : illimité).
+  float Rafale = 0;                  ///< Capacité du seau en octets.
+  float Jetons = 0;                  ///< Jetons disponibles.
+  unsigned long Dernier = 0;         ///< Instant (millis) du dernier remplissage.
+};
+
+/**
+ * @struct Struct_Classe_Debit
+ * @brief Seau et compteurs d'une classe de trafic.
+ */
+struct Struct_Classe_Debit {
+  Struct_Seau Seau;                  ///< Seau de la classe.
+  bool Differe = true;               ///< Un refus diffère le message (true) ou l'abandonne (false).
+  unsigned long Octets = 0;          ///< Octets autorisés.
+  unsigned long Messages = 0;        ///< Messages autorisés.
+  unsigned long Differes = 0;        ///< Messages différés.
+  unsigned long Abandons = 0;        ///< Messages abandonnés.
+};
+
+const char *Nom_Classe_Debit[NB_CLASSES_DEBIT] = {"Ack", "Evenement", "Telemetrie", "Diagnostic"};
+
+Struct_Classe_Debit Tab_Classe_Debit[NB_CLASSES_DEBIT];
+Struct_Seau Seau_global;
+
+/**
+ * @var float Reserve_priorite
+ * @brief Jetons du seau global laissés par chaque niveau de priorité aux classes plus prioritaires.
+ */
+float Reserve_priorite = 512;
+
+/**
+ * @fn void seau_remplit(Struct_Seau *seau)
+ * @brief Remplissage du seau selon le temps écoulé.
+ */
+void seau_remplit(Struct_Seau *seau){
+  unsigned long maintenant=millis();
+  seau->Jetons+=seau->Debit*(maintenant-seau->Dernier)/1000.0f;
+  if(seau->Jetons>seau->Rafale){seau->Jetons=seau->Rafale;}
+  seau->Dernier=maintenant;
+}
+
+/**
+ * @fn void seau_configure(Struct_Seau *seau, const String &nom)
+ * @brief Lecture du débit et de la rafale d'un seau dans MQTT.json (MQTT/Debit/<nom>_octets_s et <nom>_rafale).
+ */
+void seau_configure(Struct_Seau *seau, const String &nom){
+  seau->Debit=getIntValueFromJsonFile("/MQTT.json", "MQTT", "Debit", nom+"_octets_s");
+  seau->Rafale=getIntValueFromJsonFile("/MQTT.json", "MQTT", "Debit", nom+"_rafale");
+  if(seau->Debit<0){seau->Debit=0;}
+  if(seau->Rafale<seau->Debit){seau->Rafale=seau->Debit;}
+  seau->Jetons=seau->Rafale;
+  seau->Dernier=millis();
+}
+
+/**
+ * @fn void ConfigDebit(void)
+ * @brief Lecture des limites de débit dans MQTT.json.
+ */
+void ConfigDebit(void){
+  seau_configure(&Seau_global, "Global");
+  int reserve=getIntValueFromJsonFile("/MQTT.json", "MQTT", "Debit", "Reserve_priorite");
+  if(reserve>0){Reserve_priorite=reserve;}
+  for(int c=0;c<NB_CLASSES_DEBIT;c++){
+    seau_configure(&Tab_Classe_Debit[c].Seau, Nom_Classe_Debit[c]);
+  }
+  // Les changements et la télémétrie sont republiés au cycle suivant, les acquittements sont mis en attente
+  // (voir differe_acquittement), les diagnostics sont abandonnés
+  Tab_Classe_Debit[CLASSE_DIAGNOSTIC].Differe=false;
+  Serial.printf("   Debit global : %d octets/s, rafale %d octets\n", (int)Seau_global.Debit, (int)Seau_global.Rafale);
+}
+
+/**
+ * @fn bool Debit_autorise(int classe, unsigned long octets, bool *differe)
+ * @brief Demande l'autorisation d'émettre un paquet.
+ *
+ * Le paquet est autorisé si le seau de sa classe contient assez de jetons et si, après émission,
+ * le seau global garde la réserve des classes plus prioritaires (classe x Reserve_priorite).
+ * Les jetons ne sont consommés que si le paquet est autorisé.
+ * Un message refusé est représenté à chaque passage jusqu'à son émission : l'indicateur differe,
+ * propre au message, fait qu'il n'est compté qu'une fois dans les messages différés.
+ *
+ * @param classe Classe de trafic (Classe_Debit)
+ * @param octets Taille du paquet MQTT
+ * @param differe Indicateur de refus du message, mis à jour (NULL : message présenté une seule fois)
+ * @return true si le paquet peut être émis
+ */
+bool Debit_autorise(int classe, unsigned long octets, bool *differe){
+  if(classe<0 || classe>=NB_CLASSES_DEBIT){classe=CLASSE_DIAGNOSTIC;}
+  Struct_Classe_Debit *c=&Tab_Classe_Debit[classe];
+  seau_remplit(&c->Seau);
+  seau_remplit(&Seau_global);
+
+  // Un paquet plus grand que la rafale passe quand le seau est plein (les jetons deviennent négatifs),
+  // sinon il ne passerait jamais. Les acquittements ne sont jamais retenus par le seau global.
+  bool ok=true;
+  if(c->Seau.Debit>0 && c->Seau.Jetons<octets && c->Seau.Jetons<c->Seau.Rafale){ok=false;}
+  if(Seau_global.Debit>0 && classe!=CLASSE_ACK && Seau_global.Jetons-octets<classe*Reserve_priorite && Seau_global.Jetons<Seau_global.Rafale){ok=false;}
+  if(!ok){
+    if(differe==NULL || !*differe){
+      if(c->Differe){c->Differes++;}
+      else{c->Abandons++;}
+    }
+    if(differe!=NULL){*differe=true;}
+    return false;
+  }
+  if(differe!=NULL){*differe=false;}
+
+  if(c->Seau.Debit>0){c->Seau.Jetons-=octets;}
+  if(Seau_global.Debit>0){Seau_global.Jetons-=octets;}
+  c->Octets+=octets;
+  c->Messages++;
+  return true;
+}
+
+/**
+ * @fn void affiche_diagnostic_debit(void)
+ * @brief Affiche les jetons et compteurs de chaque classe de trafic.
+ */
+void affiche_diagnostic_debit(void){
+  Serial.println("Debit MQTT :");
+  seau_remplit(&Seau_global);
+  Serial.printf("   Global : %d/%d jetons, %d octets/s\n", (int)Seau_global.Jetons, (int)Seau_global.Rafale, (int)Seau_global.Debit);
+  for(int c=0;c<NB_CLASSES_DEBIT;c++){
+    Struct_Classe_Debit *d=&Tab_Classe_Debit[c];
+    seau_remplit(&d->Seau);
+    Serial.printf("   %-10s : %d/%d jetons, %lu messages, %lu octets, %lu differes, %lu abandons\n", Nom_Classe_Debit[c], (int)d->Seau.Jetons, (int)d->Seau.Rafale, d->Messages, d->Octets, d->Differes, d->Abandons);
+  }
+}
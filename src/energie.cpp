@@ -0,0 +1,295 @@
+/**
+ * @file energie.cpp
+ * @brief Fonction de gestion de l'énergie.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la mise en veille légère automatique et la variation de fréquence du CPU entre deux boucles.
+ * Le temps d'attente de la boucle principale n'est plus une attente active : la tâche est bloquée dans select()
+ * jusqu'à l'échéance de la boucle, un message sur la socket MQTT ou un caractère reçu sur l'UART, ce qui permet
+ * au gestionnaire d'énergie de baisser la fréquence du CPU et d'entrer en veille légère.
+ *
+ * La veille légère automatique n'est disponible que si le framework est compilé avec CONFIG_PM_ENABLE et
+ * CONFIG_FREERTOS_USE_TICKLESS_IDLE (sdkconfig, par exemple framework = arduino, espidf) : le système n'entre en
+ * veille que si aucune tâche n'est prête pendant au moins CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP ticks. Les
+ * bibliothèques Arduino précompilées n'activent pas le tickless idle : esp_pm_configure refuse alors la veille
+ * légère et seule la variation de fréquence est appliquée.
+ *
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "lwip/sockets.h"
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "File_System.h"
+#include "energie.h"
+#include "Fonctions_MQTT.h"
+#include "global.h"
+
+/**
+ * @var bool EnableEnergie
+ * @brief Indique si la gestion d'énergie (veille légère automatique) est activée ou non.
+ */
+bool EnableEnergie=false;
+
+/**
+ * @struct Struct_Energie
+ * @brief Paramètres de la gestion d'énergie lus dans le fichier de configuration.
+ */
+struct Struct_Energie {
+  int Freq_max = 240;                ///< Fréquence maximale du CPU en MHz.
+  int Freq_min = 80;                 ///< Fréquence minimale du CPU en MHz.
+  bool Light_sleep = true;           ///< Activation de la veille légère automatique.
+  bool Modem_sleep = true;           ///< Activation du modem sleep WiFi.
+  int Courant_actif = 80;            ///< Courant moyen estimé CPU actif en mA.
+  int Courant_repos = 2;             ///< Courant moyen estimé en veille légère en mA.
+  int Niveau_repos_impulsion = 1;    ///< Niveau des broches d'impulsion au repos ; le réveil se fait sur le niveau opposé.
+  long Repos_max_ms = 1000;          ///< Durée maximale d'une attente, borne des temporisations MQTT et WiFi.
+};
+
+/**
+ * @enum Mode_Energie
+ * @brief Mode de gestion d'énergie accepté par esp_pm_configure.
+ */
+enum Mode_Energie {
+  ENERGIE_ATTENTE_ACTIVE = 0,        ///< Gestion d'énergie désactivée : attente active.
+  ENERGIE_FREQUENCE_FIXE,            ///< Gestion d'énergie refusée : attente bloquante, CPU à fréquence fixe.
+  ENERGIE_FREQUENCE_VARIABLE,        ///< Variation de fréquence seule, veille légère refusée ou désactivée.
+  ENERGIE_VEILLE_LEGERE              ///< Variation de fréquence et veille légère automatique.
+};
+
+/**
+ * @var Struct_Energie Energie
+ * @brief Configuration de la gestion d'énergie.
+ */
+Struct_Energie Energie;
+
+/**
+ * @var Mode_Energie Energie_mode
+ * @brief Mode effectivement accepté par le gestionnaire d'énergie, rapporté par le diagnostic.
+ */
+Mode_Energie Energie_mode=ENERGIE_ATTENTE_ACTIVE;
+
+/**
+ * @var int Energie_reveil
+ * @brief Socket UDP locale du réveil de l'attente de boucle (voir Energie_reveille), -1 si indisponible.
+ */
+int Energie_reveil=-1;
+
+/**
+ * @var uint64_t Energie_temps_repos_us
+ * @brief Temps cumulé rendu à FreeRTOS pendant les attentes de boucle (µs).
+ */
+uint64_t Energie_temps_repos_us=0;
+
+/**
+ * @var uint64_t Energie_debut_mesure_us
+ * @brief Instant de début des mesures de la gestion d'énergie (µs).
+ */
+uint64_t Energie_debut_mesure_us=0;
+
+/**
+ * @var unsigned long Energie_dernier_poll_us
+ * @brief Instant de la dernière scrutation MQTT/série pendant l'attente de boucle (µs).
+ */
+unsigned long Energie_dernier_poll_us=0;
+
+/**
+ * @var unsigned long Energie_latence_max_us
+ * @brief Écart maximal mesuré entre deux scrutations MQTT/série, borne de la latence commande -> sortie (µs).
+ */
+unsigned long Energie_latence_max_us=0;
+
+/**
+ * @fn void Energie_reveille(void)
+ * @brief Fin anticipée de l'attente de boucle en cours : un octet est envoyé à la socket de réveil.
+ *
+ * Appelable depuis une autre tâche (réception UART, serveur web).
+ */
+void Energie_reveille(void){
+  if(Energie_reveil<0){return;}
+  uint8_t octet=0;
+  send(Energie_reveil, &octet, 1, MSG_DONTWAIT);
+}
+
+/**
+ * @fn void ouvre_reveil_energie(void)
+ * @brief Ouverture de la socket de réveil : socket UDP connectée à elle-même sur la boucle locale.
+ */
+void ouvre_reveil_energie(void){
+  int fd=socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if(fd<0){return;}
+  struct sockaddr_in adresse;
+  memset(&adresse, 0, sizeof(adresse));
+  adresse.sin_family=AF_INET;
+  adresse.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+  adresse.sin_port=0;
+  socklen_t taille=sizeof(adresse);
+  if(bind(fd, (struct sockaddr*)&adresse, sizeof(adresse))<0 || getsockname(fd, (struct sockaddr*)&adresse, &taille)<0
+     || connect(fd, (struct sockaddr*)&adresse, sizeof(adresse))<0){
+    close(fd);
+    return;
+  }
+  Energie_reveil=fd;
+}
+
+/**
+ * @fn void ConfigEnergie(void)
+ * @brief Lecture du fichier de configuration et activation de la gestion d'énergie.
+ *
+ * Cette fonction doit être appelée après l'initialisation du WiFi et des capteurs d'impulsion :
+ * le modem sleep n'est accepté qu'une fois le WiFi démarré et les broches d'impulsion sont
+ * déclarées comme source de réveil de la veille légère.
+ */
+void ConfigEnergie(void){
+  Serial.println("");
+  Serial.println("Lecture du fichier de configuration partie ENERGIE :");
+
+  Serial.print("   Energie = ");
+  EnableEnergie=false;
+  if(getStringValueFromJsonFile("/config.json", "GENERAL", "Energie", "Enable")=="true"){EnableEnergie=true;};
+  Serial.println(EnableEnergie);
+
+  Energie_debut_mesure_us=esp_timer_get_time();
+  Energie_dernier_poll_us=micros();
+
+  if(!EnableEnergie){return;}
+
+  Energie.Freq_max=getIntValueFromJsonFile("/config.json", "GENERAL", "Energie", "Freq_max");
+  Energie.Freq_min=getIntValueFromJsonFile("/config.json", "GENERAL", "Energie", "Freq_min");
+  Energie.Light_sleep=(getStringValueFromJsonFile("/config.json", "GENERAL", "Energie", "Light_sleep")=="true");
+  Energie.Modem_sleep=(getStringValueFromJsonFile("/config.json", "GENERAL", "Energie", "Modem_sleep")=="true");
+  Energie.Courant_actif=getIntValueFromJsonFile("/config.json", "GENERAL", "Energie", "Courant_actif_mA");
+  Energie.Courant_repos=getIntValueFromJsonFile("/config.json", "GENERAL", "Energie", "Courant_repos_mA");
+  Energie.Niveau_repos_impulsion=(getStringValueFromJsonFile("/config.json", "GENERAL", "Energie", "Niveau_repos_impulsion")=="0") ? 0 : 1;
+  long valeur=getIntValueFromJsonFile("/config.json", "GENERAL", "Energie", "Repos_max_ms");
+  if(valeur>0){Energie.Repos_max_ms=valeur;}
+  Serial.printf("      Frequence CPU : %d-%d MHz, Light sleep : %d, Modem sleep : %d, attente max : %ld ms\n", Energie.Freq_min, Energie.Freq_max, Energie.Light_sleep, Energie.Modem_sleep, Energie.Repos_max_ms);
+
+  /// @brief Modem sleep : la radio ne se réveille qu'aux balises DTIM du point d'accès
+  if(EnableWIFI){WiFi.setSleep(Energie.Modem_sleep);}
+
+  /// @brief Fin de l'attente de boucle à la réception d'un caractère sur la liaison série
+  ouvre_reveil_energie();
+  Serial.onReceive(Energie_reveille);
+
+  /// @brief Sources de réveil de la veille légère : UART0 et broches de comptage d'impulsion. Le réveil sur niveau
+  /// se fait au niveau opposé au repos : une broche restée au niveau de réveil empêcherait toute veille
+  uart_set_wakeup_threshold(UART_NUM_0, 3);
+  esp_sleep_enable_uart_wakeup(0);
+  gpio_int_type_t niveau_reveil=Energie.Niveau_repos_impulsion ? GPIO_INTR_LOW_LEVEL : GPIO_INTR_HIGH_LEVEL;
+  for(int i=0;i<2;i++){
+    if(Tab_Impulsion[i].Enable){
+      gpio_wakeup_enable((gpio_num_t)Tab_Impulsion[i].PIN_compteur, niveau_reveil);
+    }
+  }
+  esp_sleep_enable_gpio_wakeup();
+
+  /// @brief Variation de fréquence et veille légère automatique par le gestionnaire d'énergie ; sans tickless idle
+  /// la veille légère est refusée (ESP_ERR_NOT_SUPPORTED) et la variation de fréquence seule est demandée
+  esp_pm_config_esp32_t pm_config;
+  pm_config.max_freq_mhz=Energie.Freq_max;
+  pm_config.min_freq_mhz=Energie.Freq_min;
+  pm_config.light_sleep_enable=Energie.Light_sleep;
+  esp_err_t err=esp_pm_configure(&pm_config);
+  if(err==ESP_ERR_NOT_SUPPORTED && pm_config.light_sleep_enable){
+    Serial.println("Veille legere refusee (CONFIG_FREERTOS_USE_TICKLESS_IDLE absent), variation de frequence seule");
+    pm_config.light_sleep_enable=false;
+    err=esp_pm_configure(&pm_config);
+  }
+  if(err==ESP_OK){
+    Energie_mode=pm_config.light_sleep_enable ? ENERGIE_VEILLE_LEGERE : ENERGIE_FREQUENCE_VARIABLE;
+    Serial.println("> Gestion d'energie initialisée");
+  }
+  else{
+    Energie_mode=ENERGIE_FREQUENCE_FIXE;
+    Serial.print("Gestion d'energie indisponible : ");
+    Serial.println(esp_err_to_name(err));
+  }
+}
+
+/**
+ * @fn void Energie_debut_boucle(void)
+ * @brief Marque le début d'une boucle de travail.
+ *
+ * La partie active de la boucle (lecture capteurs, publication) n'est pas comptée dans
+ * la latence de scrutation : elle est identique avec ou sans gestion d'énergie.
+ */
+void Energie_debut_boucle(void){
+  Energie_dernier_poll_us=micros();
+}
+
+/**
+ * @fn void Energie_repos(unsigned long echeance_us)
+ * @brief Attente entre deux scrutations de la boucle de temporisation.
+ *
+ * Sans gestion d'énergie la fonction ne fait que mesurer la latence de scrutation (attente active).
+ * Avec gestion d'énergie la tâche est bloquée dans select() jusqu'à l'échéance de la boucle, bornée par
+ * Repos_max_ms, ou jusqu'à l'arrivée d'octets sur la socket MQTT ou de la socket de réveil (UART) : les tâches
+ * restent inactives assez longtemps pour la baisse de fréquence et la veille légère automatique. La latence de
+ * scrutation mesurée est alors le temps de traitement entre deux attentes.
+ *
+ * @param echeance_us Instant (micros()) de fin de la temporisation de boucle.
+ */
+void Energie_repos(unsigned long echeance_us){
+  unsigned long debut=micros();
+  unsigned long ecart=debut-Energie_dernier_poll_us;
+  if(ecart>Energie_latence_max_us){Energie_latence_max_us=ecart;}
+
+  if(EnableEnergie){
+    long reste=(long)(echeance_us-debut);
+    if(reste>Energie.Repos_max_ms*1000L){reste=Energie.Repos_max_ms*1000L;}
+    if(reste>0 && !MQTT_a_traiter()){
+      fd_set lecture;
+      FD_ZERO(&lecture);
+      int fd_max=-1;
+      int fd=socket_MQTT();
+      if(fd>=0){FD_SET(fd, &lecture); fd_max=fd;}
+      if(Energie_reveil>=0){FD_SET(Energie_reveil, &lecture); if(Energie_reveil>fd_max){fd_max=Energie_reveil;}}
+      if(fd_max>=0){
+        struct timeval attente={reste/1000000L, reste%1000000L};
+        if(select(fd_max+1, &lecture, NULL, NULL, &attente)>0 && Energie_reveil>=0 && FD_ISSET(Energie_reveil, &lecture)){
+          uint8_t tampon[16];
+          while(recv(Energie_reveil, tampon, sizeof(tampon), MSG_DONTWAIT)>0){}
+        }
+      }
+      else{
+        vTaskDelay(pdMS_TO_TICKS(reste/1000L)+1);
+      }
+    }
+    Energie_temps_repos_us+=micros()-debut;
+    Energie_dernier_poll_us=micros();
+    return;
+  }
+  Energie_dernier_poll_us=debut;
+}
+
+/**
+ * @fn void affiche_diagnostic_energie(void)
+ * @brief Affiche le taux d'activité, le courant moyen estimé et la latence maximale de scrutation.
+ *
+ * Le courant moyen est une estimation : taux d'activité x courant actif + taux de repos x courant de repos.
+ * Il n'est affiché que si la veille légère a été acceptée, Courant_repos étant un courant de veille légère.
+ */
+void affiche_diagnostic_energie(void){
+  uint64_t total=esp_timer_get_time()-Energie_debut_mesure_us;
+  float activite=1.0;
+  if(total>0){activite=1.0-(float)Energie_temps_repos_us/(float)total;}
+  float courant=activite*Energie.Courant_actif+(1.0-activite)*Energie.Courant_repos;
+
+  const char *modes[] = {"attente active", "attente bloquante, frequence fixe", "frequence variable", "veille legere"};
+  Serial.println("Energie :");
+  Serial.printf("   Mode : %s, CPU %lu MHz\n", modes[Energie_mode], (unsigned long)getCpuFrequencyMhz());
+  if(Energie_mode==ENERGIE_VEILLE_LEGERE){
+    Serial.printf("   Taux d'activite : %.1f %%, courant moyen estime : %.1f mA\n", activite*100.0, courant);
+  }
+  else{
+    Serial.printf("   Taux d'activite : %.1f %%\n", activite*100.0);
+  }
+  Serial.printf("   Latence max de scrutation : %lu us\n", Energie_latence_max_us);
+}
@@ -0,0 +1,313 @@
+/**
+ * @file file_attente.cpp
+ * @brief Fonction de file d'attente des messages MQTT en absence de connexion.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la mise en file des publications pendant une coupure du WiFi ou du serveur MQTT.
+ * Les messages sont rangés dans un anneau en RAM. Quand l'anneau est plein, les plus anciens sont
+ * déplacés à la fin d'un fichier en flash : le fichier contient donc toujours des messages plus anciens
+ * que l'anneau, et la lecture (fichier puis anneau) restitue les messages dans l'ordre d'acquisition.
+ * Le fichier survit à un redémarrage et est rejoué à la connexion suivante. Les messages relus restent
+ * en tête du fichier jusqu'à son effacement : quand le fichier atteint sa taille maximale, les messages
+ * non relus sont recopiés dans un nouveau fichier (compactage), la limite porte sur les octets non relus.
+ *
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "File_System.h"
+#include "file_attente.h"
+#include "global.h"
+
+/// @brief Taille de l'anneau en RAM en octets
+#define TAILLE_ANNEAU_DIFFERE 8192
+
+/// @brief Fichier de débordement en flash
+#define FICHIER_DIFFERE "/file_mqtt.bin"
+
+/// @brief Fichier temporaire du compactage
+#define FICHIER_DIFFERE_COMPACT "/file_mqtt.tmp"
+
+uint8_t Anneau_differe[TAILLE_ANNEAU_DIFFERE];
+
+/**
+ * @struct Struct_File_Attente
+ * @brief État et compteurs de la file d'attente.
+ */
+struct Struct_File_Attente {
+  size_t Debut = 0;                  ///< Position du plus ancien message dans l'anneau.
+  size_t Occupe = 0;                 ///< Octets occupés dans l'anneau.
+  int Nb_RAM = 0;                    ///< Messages dans l'anneau.
+  size_t Lecture_flash = 0;          ///< Position de lecture dans le fichier.
+  size_t Taille_flash = 0;           ///< Taille du fichier (messages relus compris).
+  size_t Flash_demarrage = 0;        ///< Taille du fichier au démarrage (messages d'un démarrage précédent).
+  size_t Flash_max = 65536;          ///< Taille maximale du fichier et des messages non relus.
+  int Nb_flash = 0;                  ///< Messages non relus dans le fichier.
+  int Profondeur_max = 0;            ///< Profondeur maximale atteinte.
+  unsigned long Ajoutes = 0;         ///< Messages mis en file.
+  unsigned long Perdus = 0;          ///< Messages perdus (file pleine ou message trop grand).
+  unsigned long Octets_flash = 0;    ///< Octets écrits en flash depuis le démarrage.
+  unsigned long Compactages = 0;     ///< Compactages du fichier.
+};
+
+Struct_File_Attente File_Attente;
+
+/**
+ * @fn void anneau_ecrit(size_t position, const uint8_t *source, size_t taille)
+ * @brief Copie dans l'anneau avec repli en début de tampon.
+ */
+void anneau_ecrit(size_t position, const uint8_t *source, size_t taille){
+  for(size_t i=0;i<taille;i++){
+    Anneau_differe[(position+i)%TAILLE_ANNEAU_DIFFERE]=source[i];
+  }
+}
+
+/**
+ * @fn void anneau_lit(size_t position, uint8_t *destination, size_t taille)
+ * @brief Copie depuis l'anneau avec repli en début de tampon.
+ */
+void anneau_lit(size_t position, uint8_t *destination, size_t taille){
+  for(size_t i=0;i<taille;i++){
+    destination[i]=Anneau_differe[(position+i)%TAILLE_ANNEAU_DIFFERE];
+  }
+}
+
+/**
+ * @fn bool flash_compacte(void)
+ * @brief Recopie les messages non relus dans un nouveau fichier, qui remplace le fichier de débordement.
+ *
+ * @return false si la copie a échoué (le fichier d'origine est conservé)
+ */
+bool flash_compacte(void){
+  static uint8_t bloc[512];
+  size_t lus=File_Attente.Lecture_flash;
+  size_t reste=File_Attente.Taille_flash-lus;
+
+  File source=SPIFFS.open(FICHIER_DIFFERE, "r");
+  File copie=SPIFFS.open(FICHIER_DIFFERE_COMPACT, "w");
+  if(!source || !copie){
+    if(source){source.close();}
+    if(copie){copie.close();}
+    return false;
+  }
+  source.seek(lus);
+  while(reste>0){
+    size_t n=source.read(bloc, reste<sizeof(bloc) ? reste : sizeof(bloc));
+    if(n==0 || copie.write(bloc, n)!=n){break;}
+    File_Attente.Octets_flash+=n;
+    reste-=n;
+  }
+  source.close();
+  copie.close();
+  if(reste>0){
+    SPIFFS.remove(FICHIER_DIFFERE_COMPACT);
+    return false;
+  }
+
+  SPIFFS.remove(FICHIER_DIFFERE);
+  SPIFFS.rename(FICHIER_DIFFERE_COMPACT, FICHIER_DIFFERE);
+  File_Attente.Taille_flash-=lus;
+  File_Attente.Flash_demarrage=(File_Attente.Flash_demarrage>lus) ? File_Attente.Flash_demarrage-lus : 0;
+  File_Attente.Lecture_flash=0;
+  File_Attente.Compactages++;
+  return true;
+}
+
+/**
+ * @fn bool flash_ajoute(const Struct_Entete_Differe *entete, const uint8_t *donnees)
+ * @brief Ajoute un message à la fin du fichier de débordement, après compactage si le fichier est plein.
+ */
+bool flash_ajoute(const Struct_Entete_Differe *entete, const uint8_t *donnees){
+  size_t taille=sizeof(Struct_Entete_Differe)+entete->Taille;
+  if(File_Attente.Taille_flash-File_Attente.Lecture_flash+taille>File_Attente.Flash_max){return false;}
+  if(File_Attente.Taille_flash+taille>File_Attente.Flash_max && !flash_compacte()){return false;}
+  File file=SPIFFS.open(FICHIER_DIFFERE, "a");
+  if(!file){return false;}
+  size_t ecrit=file.write((const uint8_t*)entete, sizeof(Struct_Entete_Differe));
+  ecrit+=file.write(donnees, entete->Taille);
+  file.close();
+  File_Attente.Taille_flash+=ecrit;
+  File_Attente.Octets_flash+=ecrit;
+  if(ecrit!=taille){return false;}
+  File_Attente.Nb_flash++;
+  return true;
+}
+
+/**
+ * @fn void flash_efface(void)
+ * @brief Suppression du fichier de débordement.
+ */
+void flash_efface(void){
+  SPIFFS.remove(FICHIER_DIFFERE);
+  File_Attente.Taille_flash=0;
+  File_Attente.Lecture_flash=0;
+  File_Attente.Flash_demarrage=0;
+}
+
+/**
+ * @fn bool deborde_en_flash(void)
+ * @brief Déplace le plus ancien message de l'anneau à la fin du fichier.
+ */
+bool deborde_en_flash(void){
+  static uint8_t donnees[TAILLE_MESSAGE_DIFFERE];
+  Struct_Entete_Differe entete;
+  anneau_lit(File_Attente.Debut, (uint8_t*)&entete, sizeof(entete));
+  anneau_lit(File_Attente.Debut+sizeof(entete), donnees, entete.Taille);
+  size_t taille=sizeof(entete)+entete.Taille;
+  bool ok=flash_ajoute(&entete, donnees);
+  if(!ok){File_Attente.Perdus++;}
+  File_Attente.Debut=(File_Attente.Debut+taille)%TAILLE_ANNEAU_DIFFERE;
+  File_Attente.Occupe-=taille;
+  File_Attente.Nb_RAM--;
+  return ok;
+}
+
+/**
+ * @fn void ConfigFileAttente(void)
+ * @brief Initialisation de la file d'attente et reprise du fichier d'un démarrage précédent.
+ */
+void ConfigFileAttente(void){
+  int flash_max=getIntValueFromJsonFile("/MQTT.json", "MQTT", "General", "MQTT_file_flash_octets");
+  if(flash_max>0){File_Attente.Flash_max=flash_max;}
+
+  /// @brief Compactage interrompu par un redémarrage : le fichier d'origine fait foi
+  if(SPIFFS.exists(FICHIER_DIFFERE_COMPACT)){
+    if(SPIFFS.exists(FICHIER_DIFFERE)){SPIFFS.remove(FICHIER_DIFFERE_COMPACT);}
+    else{SPIFFS.rename(FICHIER_DIFFERE_COMPACT, FICHIER_DIFFERE);}
+  }
+
+  /// @brief Comptage des messages restés dans le fichier
+  if(SPIFFS.exists(FICHIER_DIFFERE)){
+    File file=SPIFFS.open(FICHIER_DIFFERE, "r");
+    Struct_Entete_Differe entete;
+    size_t position=0;
+    while(file.read((uint8_t*)&entete, sizeof(entete))==sizeof(entete) && position+sizeof(entete)+entete.Taille<=file.size()){
+      position+=sizeof(entete)+entete.Taille;
+      file.seek(position);
+      File_Attente.Nb_flash++;
+    }
+    file.close();
+    File_Attente.Taille_flash=position;
+    File_Attente.Flash_demarrage=position;
+  }
+  Serial.printf("   File d'attente : %d octets en RAM, %u octets en flash, %d messages repris\n", TAILLE_ANNEAU_DIFFERE, (unsigned)File_Attente.Flash_max, File_Attente.Nb_flash);
+}
+
+/**
+ * @fn bool File_attente_ajoute(const Struct_Entete_Differe *entete, const uint8_t *donnees)
+ * @brief Met un message en file.
+ *
+ * Si l'anneau est plein, les plus anciens messages sont déplacés en flash. Un message plus grand
+ * que l'anneau est écrit directement en flash, après vidage de l'anneau pour conserver l'ordre.
+ *
+ * @return false si le message est perdu (fichier plein)
+ */
+bool File_attente_ajoute(const Struct_Entete_Differe *entete, const uint8_t *donnees){
+  size_t taille=sizeof(Struct_Entete_Differe)+entete->Taille;
+  bool ok=true;
+
+  while(File_Attente.Occupe+taille>TAILLE_ANNEAU_DIFFERE && File_Attente.Nb_RAM>0){
+    deborde_en_flash();
+  }
+  if(taille>TAILLE_ANNEAU_DIFFERE){
+    ok=flash_ajoute(entete, donnees);
+  }
+  else{
+    size_t fin=(File_Attente.Debut+File_Attente.Occupe)%TAILLE_ANNEAU_DIFFERE;
+    anneau_ecrit(fin, (const uint8_t*)entete, sizeof(Struct_Entete_Differe));
+    anneau_ecrit(fin+sizeof(Struct_Entete_Differe), donnees, entete->Taille);
+    File_Attente.Occupe+=taille;
+    File_Attente.Nb_RAM++;
+  }
+
+  if(ok){File_Attente.Ajoutes++;}
+  else{File_Attente.Perdus++;}
+  int profondeur=File_attente_profondeur();
+  if(profondeur>File_Attente.Profondeur_max){File_Attente.Profondeur_max=profondeur;}
+  return ok;
+}
+
+/**
+ * @fn bool File_attente_tete(Struct_Entete_Differe *entete, uint8_t *donnees)
+ * @brief Lit le plus ancien message sans le retirer de la file.
+ *
+ * @param entete En-tête du message
+ * @param donnees Tampon de TAILLE_MESSAGE_DIFFERE octets recevant le message
+ * @return false si la file est vide
+ */
+bool File_attente_tete(Struct_Entete_Differe *entete, uint8_t *donnees){
+  if(File_Attente.Nb_flash>0){
+    File file=SPIFFS.open(FICHIER_DIFFERE, "r");
+    if(file){
+      file.seek(File_Attente.Lecture_flash);
+      bool ok=(file.read((uint8_t*)entete, sizeof(Struct_Entete_Differe))==sizeof(Struct_Entete_Differe))
+              && entete->Taille<=TAILLE_MESSAGE_DIFFERE
+              && file.read(donnees, entete->Taille)==entete->Taille;
+      file.close();
+      if(ok){
+        entete->Ancien=(File_Attente.Lecture_flash<File_Attente.Flash_demarrage);
+        return true;
+      }
+    }
+    /// @brief Fichier illisible : abandon des messages restants
+    File_Attente.Perdus+=File_Attente.Nb_flash;
+    File_Attente.Nb_flash=0;
+    flash_efface();
+  }
+  if(File_Attente.Nb_RAM>0){
+    anneau_lit(File_Attente.Debut, (uint8_t*)entete, sizeof(Struct_Entete_Differe));
+    anneau_lit(File_Attente.Debut+sizeof(Struct_Entete_Differe), donnees, entete->Taille);
+    entete->Ancien=0;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * @fn void File_attente_retire(void)
+ * @brief Retire le plus ancien message de la file, après sa publication.
+ */
+void File_attente_retire(void){
+  if(File_Attente.Nb_flash>0){
+    File file=SPIFFS.open(FICHIER_DIFFERE, "r");
+    Struct_Entete_Differe entete;
+    file.seek(File_Attente.Lecture_flash);
+    if(file.read((uint8_t*)&entete, sizeof(entete))==sizeof(entete)){
+      File_Attente.Lecture_flash+=sizeof(entete)+entete.Taille;
+    }
+    file.close();
+    File_Attente.Nb_flash--;
+  }
+  else if(File_Attente.Nb_RAM>0){
+    Struct_Entete_Differe entete;
+    anneau_lit(File_Attente.Debut, (uint8_t*)&entete, sizeof(entete));
+    size_t taille=sizeof(entete)+entete.Taille;
+    File_Attente.Debut=(File_Attente.Debut+taille)%TAILLE_ANNEAU_DIFFERE;
+    File_Attente.Occupe-=taille;
+    File_Attente.Nb_RAM--;
+  }
+
+  /// @brief Fichier entièrement relu : suppression
+  if(File_Attente.Nb_flash==0 && File_Attente.Taille_flash>0){flash_efface();}
+}
+
+/**
+ * @fn int File_attente_profondeur(void)
+ * @brief Nombre de messages en attente (RAM et flash).
+ */
+int File_attente_profondeur(void){
+  return File_Attente.Nb_RAM+File_Attente.Nb_flash;
+}
+
+/**
+ * @fn void affiche_diagnostic_file_attente(void)
+ * @brief Affiche la profondeur et les compteurs de la file d'attente.
+ */
+void affiche_diagnostic_file_attente(void){
+  Serial.println("File d'attente MQTT :");
+  Serial.printf("   Profondeur : %d messages (RAM %d, %u octets ; flash %d, %u octets), max %d\n", File_attente_profondeur(), File_Attente.Nb_RAM, (unsigned)File_Attente.Occupe, File_Attente.Nb_flash, (unsigned)(File_Attente.Taille_flash-File_Attente.Lecture_flash), File_Attente.Profondeur_max);
+  Serial.printf("   Mis en file : %lu, perdus : %lu, octets ecrits en flash : %lu, compactages : %lu\n", File_Attente.Ajoutes, File_Attente.Perdus, File_Attente.Octets_flash, File_Attente.Compactages);
+}
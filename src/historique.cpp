@@ -0,0 +1,301 @@
+/**
+ * @file historique.cpp
+ * @brief Fonction d'export de l'historique stocké par le serveur web.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'export de l'historique journalier /data.csv (voir saveDataToFile) :
+ *   /api/history?from=AAAA-MM-JJ&to=AAAA-MM-JJ&channels=Tmax,Pression&format=csv|bin
+ * Les enregistrements sont lus dans le fichier au fil de l'envoi, filtrés par date et par colonne,
+ * et écrits directement dans le tampon TCP d'une réponse fragmentée (chunked). La mémoire utilisée
+ * par un export est constante (tampons de lecture, de ligne et d'enregistrement de Struct_Export),
+ * quelle que soit la taille du fichier.
+ *
+ * Format bin : enregistrements de taille fixe, en petit-boutiste : date (uint32 AAAAMMJJ) suivie d'un
+ * float32 par colonne exportée. Les colonnes sont listées dans l'en-tête HTTP X-Colonnes.
+ *
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <ESPAsyncWebServer.h>
+#include <memory>
+#include "historique.h"
+#include "File_System.h"
+#include "global.h"
+
+extern AsyncWebServer server;
+
+/// @brief Fichier de l'historique journalier
+#define FICHIER_HISTORIQUE "/data.csv"
+
+/**
+ * @enum Format_Export
+ * @brief Format de sortie de l'export.
+ */
+enum Format_Export {
+  EXPORT_CSV = 0,                    ///< Texte CSV séparé par des points-virgules, comme le fichier.
+  EXPORT_BIN                         ///< Enregistrements binaires de taille fixe.
+};
+
+/**
+ * @struct Struct_Stat_Historique
+ * @brief Compteurs des exports de l'historique.
+ */
+struct Struct_Stat_Historique {
+  unsigned long Exports = 0;         ///< Exports terminés.
+  unsigned long Refus = 0;           ///< Exports refusés (trop d'exports simultanés, paramètre invalide).
+  int En_cours = 0;                  ///< Exports en cours.
+  unsigned long Enregistrements = 0; ///< Enregistrements du dernier export.
+  unsigned long Octets = 0;          ///< Octets du dernier export.
+  unsigned long Duree_ms = 0;        ///< Durée du dernier export.
+  unsigned long Debit_max = 0;       ///< Débit maximal d'un export (octets/s).
+};
+
+Struct_Stat_Historique Stat_Historique;
+
+/**
+ * @struct Struct_Export
+ * @brief État d'un export en cours : fichier, filtres et tampons de taille fixe.
+ *
+ * L'export est détruit avec la réponse qui le référence, ce qui ferme le fichier.
+ */
+struct Struct_Export {
+  File Fichier;                      ///< Fichier de l'historique.
+  int Format = EXPORT_CSV;           ///< Format de sortie (Format_Export).
+  uint32_t Du = 0;                   ///< Première date exportée (AAAAMMJJ).
+  uint32_t Au = UINT32_MAX;          ///< Dernière date exportée (AAAAMMJJ).
+  int Colonnes[NB_COLONNES_HISTORIQUE];  ///< Index des colonnes exportées dans le fichier (hors date).
+  int Nb_colonnes = 0;               ///< Nombre de colonnes exportées.
+  char Lecture[512];                 ///< Bloc lu dans le fichier.
+  size_t Lecture_pos = 0;            ///< Position dans le bloc lu.
+  size_t Lecture_taille = 0;         ///< Taille du bloc lu.
+  char Ligne[128];                   ///< Ligne courante (tronquée si plus longue).
+  char Sortie[160];                  ///< Enregistrement formaté en attente d'envoi.
+  size_t Sortie_pos = 0;             ///< Octets de Sortie déjà envoyés.
+  size_t Sortie_taille = 0;          ///< Taille de l'enregistrement formaté.
+  unsigned long Enregistrements = 0; ///< Enregistrements exportés.
+  unsigned long Octets = 0;          ///< Octets envoyés.
+  unsigned long Debut = 0;           ///< Instant (millis) du début de l'export.
+  bool Envoye = false;               ///< Réponse fragmentée lancée (sinon export refusé).
+
+  ~Struct_Export() {
+    Fichier.close();
+    Stat_Historique.En_cours--;
+    if (!Envoye) {return;}
+    unsigned long duree = millis() - Debut;
+    Stat_Historique.Exports++;
+    Stat_Historique.Enregistrements = Enregistrements;
+    Stat_Historique.Octets = Octets;
+    Stat_Historique.Duree_ms = duree;
+    unsigned long debit = (duree > 0) ? (unsigned long)((uint64_t)Octets * 1000 / duree) : 0;
+    if (debit > Stat_Historique.Debit_max) {Stat_Historique.Debit_max = debit;}
+    Serial.printf("Export historique : %lu enregistrements, %lu octets en %lu ms (%lu o/s)\n", Enregistrements, Octets, duree, debit);
+  }
+};
+
+/**
+ * @fn bool ligne_suivante(Struct_Export *e)
+ * @brief Lecture de la ligne suivante du fichier dans e->Ligne, par blocs de e->Lecture.
+ *
+ * @return false en fin de fichier.
+ */
+bool ligne_suivante(Struct_Export *e) {
+  size_t taille = 0;
+  bool lu = false;
+  for (;;) {
+    if (e->Lecture_pos >= e->Lecture_taille) {
+      e->Lecture_taille = e->Fichier.read((uint8_t*)e->Lecture, sizeof(e->Lecture));
+      e->Lecture_pos = 0;
+      if (e->Lecture_taille == 0) {break;}
+    }
+    char c = e->Lecture[e->Lecture_pos++];
+    lu = true;
+    if (c == '\n') {break;}
+    if (c != '\r' && taille < sizeof(e->Ligne) - 1) {e->Ligne[taille++] = c;}
+  }
+  e->Ligne[taille] = '\0';
+  return lu;
+}
+
+/**
+ * @fn uint32_t date_fichier(const char *texte)
+ * @brief Date J/M/AAAA du fichier convertie en AAAAMMJJ, 0 si invalide.
+ */
+uint32_t date_fichier(const char *texte) {
+  unsigned int j, m, a;
+  if (sscanf(texte, "%u/%u/%u", &j, &m, &a) != 3 || j == 0 || j > 31 || m == 0 || m > 12) {return 0;}
+  return a * 10000 + m * 100 + j;
+}
+
+/**
+ * @fn bool date_parametre(const String &texte, uint32_t *date)
+ * @brief Date AAAA-MM-JJ ou AAAAMMJJ d'un paramètre convertie en AAAAMMJJ.
+ */
+bool date_parametre(const String &texte, uint32_t *date) {
+  unsigned int j, m, a;
+  if (sscanf(texte.c_str(), "%4u-%2u-%2u", &a, &m, &j) == 3 || sscanf(texte.c_str(), "%4u%2u%2u", &a, &m, &j) == 3) {
+    if (j >= 1 && j <= 31 && m >= 1 && m <= 12) {
+      *date = a * 10000 + m * 100 + j;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @fn void formate_enregistrement(Struct_Export *e)
+ * @brief Filtrage de la ligne courante et formatage des colonnes exportées dans e->Sortie.
+ *
+ * Une ligne hors de la période, ou dont la date est illisible, ne produit rien.
+ */
+void formate_enregistrement(Struct_Export *e) {
+  e->Sortie_pos = 0;
+  e->Sortie_taille = 0;
+  char *champs[NB_COLONNES_HISTORIQUE + 1];
+  int nb = 0;
+  char *p = e->Ligne;
+  champs[nb++] = p;
+  while ((p = strchr(p, ';')) != NULL && nb <= NB_COLONNES_HISTORIQUE) {
+    *p++ = '\0';
+    champs[nb++] = p;
+  }
+  uint32_t date = date_fichier(champs[0]);
+  if (date == 0 || date < e->Du || date > e->Au) {return;}
+
+  if (e->Format == EXPORT_BIN) {
+    memcpy(e->Sortie, &date, sizeof(date));
+    size_t taille = sizeof(date);
+    for (int i = 0; i < e->Nb_colonnes; i++) {
+      int c = e->Colonnes[i];
+      float valeur = (c < nb) ? atof(champs[c]) : NAN;
+      memcpy(e->Sortie + taille, &valeur, sizeof(valeur));
+      taille += sizeof(valeur);
+    }
+    e->Sortie_taille = taille;
+  }
+  else {
+    size_t taille = snprintf(e->Sortie, sizeof(e->Sortie), "%s", champs[0]);
+    for (int i = 0; i < e->Nb_colonnes && taille < sizeof(e->Sortie); i++) {
+      int c = e->Colonnes[i];
+      taille += snprintf(e->Sortie + taille, sizeof(e->Sortie) - taille, ";%s", (c < nb) ? champs[c] : "");
+    }
+    if (taille >= sizeof(e->Sortie) - 1) {taille = sizeof(e->Sortie) - 2;}
+    e->Sortie[taille++] = '\n';
+    e->Sortie_taille = taille;
+  }
+  e->Enregistrements++;
+}
+
+/**
+ * @fn size_t remplit_export(Struct_Export *e, uint8_t *tampon, size_t taille_max)
+ * @brief Remplissage d'un fragment de la réponse (tâche du serveur web) ; 0 termine la réponse.
+ */
+size_t remplit_export(Struct_Export *e, uint8_t *tampon, size_t taille_max) {
+  size_t n = 0;
+  while (n < taille_max) {
+    if (e->Sortie_pos < e->Sortie_taille) {
+      size_t k = min(e->Sortie_taille - e->Sortie_pos, taille_max - n);
+      memcpy(tampon + n, e->Sortie + e->Sortie_pos, k);
+      e->Sortie_pos += k;
+      n += k;
+      continue;
+    }
+    if (!ligne_suivante(e)) {break;}
+    formate_enregistrement(e);
+  }
+  e->Octets += n;
+  return n;
+}
+
+/**
+ * @fn void requete_historique(AsyncWebServerRequest *request)
+ * @brief Gestionnaire de /api/history : lecture des paramètres, saut de l'en-tête du fichier, puis réponse fragmentée.
+ *
+ * Les noms des colonnes sont ceux écrits par saveDataToFile (ENTETE_HISTORIQUE) : un fichier créé
+ * sans en-tête commence directement par un enregistrement, qui est alors exporté.
+ */
+void requete_historique(AsyncWebServerRequest *request) {
+  if (Stat_Historique.En_cours >= NB_EXPORTS_HISTORIQUE) {
+    Stat_Historique.Refus++;
+    request->send(503, "application/json", "{\"erreur\":\"export deja en cours\"}");
+    return;
+  }
+  std::shared_ptr<Struct_Export> e(new Struct_Export());
+  e->Debut = millis();
+  Stat_Historique.En_cours++;
+
+  bool ok = true;
+  if (request->hasParam("from")) {ok = ok && date_parametre(request->getParam("from")->value(), &e->Du);}
+  if (request->hasParam("to")) {ok = ok && date_parametre(request->getParam("to")->value(), &e->Au);}
+  if (request->hasParam("format")) {
+    String format = request->getParam("format")->value();
+    if (format == "bin") {e->Format = EXPORT_BIN;}
+    else if (format != "csv") {ok = false;}
+  }
+  e->Fichier = SPIFFS.open(FICHIER_HISTORIQUE, "r");
+  if (!ok || !e->Fichier) {
+    Stat_Historique.Refus++;
+    request->send(ok ? 404 : 400, "application/json", ok ? "{\"erreur\":\"historique absent\"}" : "{\"erreur\":\"parametre invalide\"}");
+    return;
+  }
+
+  // Première ligne : en-tête sautée, ou premier enregistrement relu depuis le début du bloc
+  ligne_suivante(e.get());
+  if (date_fichier(e->Ligne) != 0) {e->Lecture_pos = 0;}
+
+  // Noms des colonnes, la première étant la date
+  char entete[] = ENTETE_HISTORIQUE;
+  char *noms[NB_COLONNES_HISTORIQUE];
+  int nb_noms = 0;
+  for (char *nom = strtok(entete, ";"); nom != NULL && nb_noms < NB_COLONNES_HISTORIQUE; nom = strtok(NULL, ";")) {
+    noms[nb_noms++] = nom;
+  }
+  String selection = request->hasParam("channels") ? "," + request->getParam("channels")->value() + "," : String();
+  String colonnes = (nb_noms > 0) ? String(noms[0]) : String("Date");
+  for (int i = 1; i < nb_noms; i++) {
+    if (selection.length() > 0 && selection.indexOf("," + String(noms[i]) + ",") < 0) {continue;}
+    e->Colonnes[e->Nb_colonnes++] = i;
+    colonnes += ";" + String(noms[i]);
+  }
+
+  // L'en-tête CSV est le premier enregistrement envoyé
+  if (e->Format == EXPORT_CSV) {
+    e->Sortie_taille = snprintf(e->Sortie, sizeof(e->Sortie), "%s\n", colonnes.c_str());
+    if (e->Sortie_taille >= sizeof(e->Sortie)) {e->Sortie_taille = sizeof(e->Sortie) - 1;}
+  }
+
+  AsyncWebServerResponse *reponse = request->beginChunkedResponse(
+    (e->Format == EXPORT_BIN) ? "application/octet-stream" : "text/csv",
+    [e](uint8_t *tampon, size_t taille_max, size_t index) -> size_t {
+      return remplit_export(e.get(), tampon, taille_max);
+    });
+  e->Envoye = true;
+  reponse->addHeader("X-Colonnes", colonnes);
+  reponse->addHeader("Content-Disposition", (e->Format == EXPORT_BIN) ? "attachment; filename=historique.bin" : "attachment; filename=historique.csv");
+  request->send(reponse);
+}
+
+/**
+ * @fn void ConfigHistorique()
+ * @brief Enregistrement de la route d'export de l'historique sur le serveur web.
+ *
+ * À appeler avant server.begin().
+ */
+void ConfigHistorique(void) {
+  server.on(URL_HISTORIQUE, HTTP_GET, requete_historique);
+}
+
+/**
+ * @fn void affiche_diagnostic_historique()
+ * @brief Affiche les compteurs et le débit des exports de l'historique.
+ */
+void affiche_diagnostic_historique(void) {
+  if (!EnableWEB) {return;}
+  Serial.println("Export historique :");
+  Serial.printf("   Exports : %lu, refusés : %lu, en cours : %d\n", Stat_Historique.Exports, Stat_Historique.Refus, Stat_Historique.En_cours);
+  unsigned long debit = (Stat_Historique.Duree_ms > 0) ? (unsigned long)((uint64_t)Stat_Historique.Octets * 1000 / Stat_Historique.Duree_ms) : 0;
+  Serial.printf("   Dernier : %lu enregistrements, %lu octets en %lu ms (%lu o/s), débit max %lu o/s\n", Stat_Historique.Enregistrements, Stat_Historique.Octets, Stat_Historique.Duree_ms, debit, Stat_Historique.Debit_max);
+}
@@ -10,7 +10,6 @@
  */
 
 #include <Wire.h>
-#include <PubSubClient.h>
 #include <PCF8574.h>
 #include "capteurs.h"
 #include "GPIO.h"
@@ -19,6 +18,10 @@
 #include "com_serie.h"
 #include "File_System.h"
 #include "user_function.h"
+#include "energie.h"
+#include "planificateur.h"
+#include "regulation.h"
+#include "api_rest.h"
 #include "global.h"
 
 // Variables globales
@@ -70,6 +73,8 @@ void setup() {
   ConfigTIMER();
   ConfigServoMoteur();
   ConfigurePWM();
+  ConfigPlanificateur();
+  ConfigRegulation();
 
   ConfigReseau();
 
@@ -99,6 +104,9 @@ void setup() {
 
   /// @brief  Initialisation du client WEB
   setup_web();
+
+  /// @brief  Initialisation de la gestion d'énergie (après le WiFi et les impulsions)
+  ConfigEnergie();
 }
 
 
@@ -119,6 +127,7 @@ void loop() {
   maj_temps();
 
   /// @brief MAJ des valeurs provenant des périphériques
+  int64_t lecture_us = esp_timer_get_time();
   Read_BMx280();
   GPIO_maj();
   PCF8574_OUT_1_maj();
@@ -131,6 +140,9 @@ void loop() {
   publish_s1();
   //publish_s2();
 
+  /// @brief Instantané de l'état servi par l'API REST
+  maj_instantane_API(lecture_us);
+
   /// @brief Execution des fonctions spécifiques utilisateur
   Fonction_Utilisateur();
  
@@ -158,10 +170,14 @@ void loop() {
   }
 
   /// @brief Temporisation de boucle
+  Energie_debut_boucle();
   while(micros()<(currentTime + Periode*10000)){
     /// @brief Vérification de l'arrivée d'un message MQTT
     loop_MQTT();
+    service_API();
     serialEvent();
+    /// @brief Attente bloquante jusqu'à l'échéance de la boucle, un message MQTT ou un caractère reçu, si la gestion d'énergie est active
+    Energie_repos(currentTime + Periode*10000);
   }
   
 }
@@ -0,0 +1,61 @@
+/**
+ * @file pid.cpp
+ * @brief Correcteur PID de la régulation de pression.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite le pas de calcul du correcteur PID. Il n'utilise aucune fonction matérielle :
+ * il est compilé tel quel par l'environnement de test natif (test/test_regulation) contre un modèle de pompe.
+ *
+ */
+
+#include "regulation.h"
+
+/**
+ * @fn float PID_calcul(Struct_PID *pid, float mesure, float dt)
+ * @brief Pas de calcul du correcteur PID.
+ *
+ * La dérivée est calculée sur la mesure pour éviter un à-coup de commande lors d'un changement de consigne.
+ * L'anti-emballement (anti-windup) est fait par intégration conditionnelle : le terme intégral n'évolue pas
+ * lorsque la sortie est saturée et que l'erreur pousse encore dans le sens de la saturation.
+ *
+ * @param pid Correcteur
+ * @param mesure Mesure courante
+ * @param dt Pas de temps en secondes
+ * @return Sortie bornée entre Sortie_min et Sortie_max
+ */
+float PID_calcul(Struct_PID *pid, float mesure, float dt){
+  float erreur = pid->Consigne - mesure;
+  float derivee = 0;
+  if(!pid->Premier && dt > 0){derivee = -(mesure - pid->Mesure_prec) / dt;}
+  pid->Premier = false;
+  pid->Mesure_prec = mesure;
+
+  float integrale = pid->Integrale + pid->Ki * erreur * dt;
+  float sortie = pid->Kp * erreur + integrale + pid->Kd * derivee;
+
+  if(sortie > pid->Sortie_max){
+    sortie = pid->Sortie_max;
+    if(erreur < 0){pid->Integrale = integrale;}
+  }
+  else if(sortie < pid->Sortie_min){
+    sortie = pid->Sortie_min;
+    if(erreur > 0){pid->Integrale = integrale;}
+  }
+  else{
+    pid->Integrale = integrale;
+  }
+  return sortie;
+}
+
+/**
+ * @fn void PID_raz(Struct_PID *pid)
+ * @brief Remise à zéro de l'état du correcteur (intégrale et mémoire de dérivée).
+ */
+void PID_raz(Struct_PID *pid){
+  pid->Integrale = 0;
+  pid->Mesure_prec = 0;
+  pid->Premier = true;
+}
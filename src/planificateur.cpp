@@ -0,0 +1,278 @@
+/**
+ * @file planificateur.cpp
+ * @brief Fonction de planification des commandes de sortie.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'exécution différée des commandes de sortie (PCF8574, GPIO_OUT, servo, PWM).
+ * Les commandes sont rangées dans une file de priorité (tas binaire trié sur l'échéance).
+ * Un timer matériel est armé sur l'échéance la plus proche ; son interruption réveille une tâche
+ * de priorité haute qui applique la commande, sans attendre le passage de la boucle principale.
+ *
+ */
+
+#include <Arduino.h>
+#include "esp_pm.h"
+#include "GPIO.h"
+#include "Fonctions_MQTT.h"
+#include "planificateur.h"
+#include "global.h"
+#include "regulation.h"
+
+/// @brief Nombre maximal de commandes en attente d'exécution
+#define NB_COMMANDES_PLANIFIEES 32
+
+/// @brief Numéro du timer matériel utilisé par le planificateur
+#define TIMER_PLANIFICATEUR 0
+
+/**
+ * @struct Struct_Commande_Planifiee
+ * @brief Commande de sortie en attente d'exécution.
+ */
+struct Struct_Commande_Planifiee {
+  int64_t Echeance_us = 0;           ///< Instant d'exécution (esp_timer, en µs depuis le démarrage).
+  int Type = 0;                      ///< Type de sortie (Type_Commande).
+  int Num = 0;                       ///< Numéro de la sortie.
+  int Val = 0;                       ///< Valeur à appliquer.
+};
+
+/**
+ * @var Struct_Commande_Planifiee Tas_Commandes[]
+ * @brief File de priorité des commandes, organisée en tas binaire (échéance la plus proche en tête).
+ */
+Struct_Commande_Planifiee Tas_Commandes[NB_COMMANDES_PLANIFIEES];
+
+/**
+ * @var int Nb_Commandes_Planifiees
+ * @brief Nombre de commandes présentes dans le tas.
+ */
+int Nb_Commandes_Planifiees=0;
+
+/**
+ * @var portMUX_TYPE Planif_mux
+ * @brief Verrou d'accès au tas entre la boucle principale et la tâche du planificateur.
+ */
+portMUX_TYPE Planif_mux = portMUX_INITIALIZER_UNLOCKED;
+
+hw_timer_t *Timer_Planif = NULL;
+TaskHandle_t Tache_Planif = NULL;
+esp_pm_lock_handle_t Verrou_Planif = NULL;
+bool Verrou_Planif_pris = false;
+
+// Statistiques de gigue d'exécution
+unsigned long Planif_nb_executees=0;
+unsigned long Planif_nb_rejetees=0;
+int Planif_profondeur_max=0;
+int64_t Planif_gigue_max_us=0;
+int64_t Planif_gigue_cumul_us=0;
+
+/**
+ * @fn int Execute_commande(int type, int num, int val)
+ * @brief Applique immédiatement une commande de sortie.
+ *
+ * Appelée depuis la tâche du planificateur comme depuis la boucle principale : la commande est appliquée
+ * sous le verrou des sorties (Sorties_verrouille), qui la sérialise avec les autres écritures.
+ *
+ * @param type Type de sortie (Type_Commande)
+ * @param num Numéro de la sortie
+ * @param val Valeur à appliquer
+ * @return 1 si la commande a été appliquée, 0 sinon
+ */
+int Execute_commande(int type, int num, int val){
+  int ok=0;
+  Sorties_verrouille();
+  switch(type){
+    case CMD_PCF8574_OUT_1:
+      if(num>=0 && num<=7){ok=PCF8574_OUT_1_out(num, val);}
+      break;
+    case CMD_GPIO_OUT:
+      if(num>=1 && num<=8){ok=GPIO_OUT(num, val);}
+      break;
+    case CMD_SERVO:
+      ok=ServoMoteur_OUT(num, val);
+      break;
+    case CMD_PWM:
+      ok=PWM_OUT(num, val);
+      break;
+    default:
+      break;
+  }
+  Sorties_deverrouille();
+  // Publication immédiate de l'état des sorties modifiées
+  if(ok){demande_publication();}
+  return ok;
+}
+
+/**
+ * @fn void Planif_descend(int i)
+ * @brief Rétablit la propriété de tas en descendant l'élément i.
+ */
+void Planif_descend(int i){
+  for(;;){
+    int g=2*i+1;
+    int d=g+1;
+    int min=i;
+    if(g<Nb_Commandes_Planifiees && Tas_Commandes[g].Echeance_us<Tas_Commandes[min].Echeance_us){min=g;}
+    if(d<Nb_Commandes_Planifiees && Tas_Commandes[d].Echeance_us<Tas_Commandes[min].Echeance_us){min=d;}
+    if(min==i){return;}
+    Struct_Commande_Planifiee tmp=Tas_Commandes[i];
+    Tas_Commandes[i]=Tas_Commandes[min];
+    Tas_Commandes[min]=tmp;
+    i=min;
+  }
+}
+
+/**
+ * @fn bool Planif_extrait_echue(Struct_Commande_Planifiee *cmd)
+ * @brief Retire la commande de tête si son échéance est atteinte.
+ *
+ * @param cmd Commande extraite
+ * @return true si une commande a été extraite
+ */
+bool Planif_extrait_echue(Struct_Commande_Planifiee *cmd){
+  bool extrait=false;
+  portENTER_CRITICAL(&Planif_mux);
+  if(Nb_Commandes_Planifiees>0 && Tas_Commandes[0].Echeance_us<=esp_timer_get_time()){
+    *cmd=Tas_Commandes[0];
+    Nb_Commandes_Planifiees--;
+    Tas_Commandes[0]=Tas_Commandes[Nb_Commandes_Planifiees];
+    Planif_descend(0);
+    extrait=true;
+  }
+  portEXIT_CRITICAL(&Planif_mux);
+  return extrait;
+}
+
+/**
+ * @fn void Planif_arme_timer(void)
+ * @brief Arme le timer matériel sur l'échéance de la commande de tête.
+ *
+ * Tant que la file n'est pas vide la veille légère est interdite : le timer matériel
+ * n'est pas cadencé pendant la veille et l'échéance serait manquée.
+ */
+void Planif_arme_timer(void){
+  bool vide;
+  int64_t prochaine=0;
+  portENTER_CRITICAL(&Planif_mux);
+  vide=(Nb_Commandes_Planifiees==0);
+  if(!vide){prochaine=Tas_Commandes[0].Echeance_us;}
+  portEXIT_CRITICAL(&Planif_mux);
+
+  timerAlarmDisable(Timer_Planif);
+  if(vide){
+    if(Verrou_Planif_pris){esp_pm_lock_release(Verrou_Planif);}
+    Verrou_Planif_pris=false;
+    return;
+  }
+  if(!Verrou_Planif_pris){esp_pm_lock_acquire(Verrou_Planif);}
+  Verrou_Planif_pris=true;
+
+  int64_t delai=prochaine-esp_timer_get_time();
+  if(delai<1){delai=1;}
+  timerWrite(Timer_Planif, 0);
+  timerAlarmWrite(Timer_Planif, delai, false);
+  timerAlarmEnable(Timer_Planif);
+}
+
+/**
+ * @fn void IRAM_ATTR handleInterrupt_planificateur()
+ * @brief Gestionnaire d'interruption du timer : réveille la tâche du planificateur.
+ */
+void IRAM_ATTR handleInterrupt_planificateur() {
+  BaseType_t reveil=pdFALSE;
+  vTaskNotifyGiveFromISR(Tache_Planif, &reveil);
+  if(reveil){portYIELD_FROM_ISR();}
+}
+
+/**
+ * @fn void Tache_planificateur(void *param)
+ * @brief Tâche d'exécution des commandes échues.
+ *
+ * La gigue est l'écart entre l'instant réel d'application et l'échéance demandée.
+ */
+void Tache_planificateur(void *param){
+  Struct_Commande_Planifiee cmd;
+  for(;;){
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    while(Planif_extrait_echue(&cmd)){
+      int64_t gigue=esp_timer_get_time()-cmd.Echeance_us;
+      Execute_commande(cmd.Type, cmd.Num, cmd.Val);
+      Planif_nb_executees++;
+      Planif_gigue_cumul_us+=gigue;
+      if(gigue>Planif_gigue_max_us){Planif_gigue_max_us=gigue;}
+    }
+    Planif_arme_timer();
+  }
+}
+
+/**
+ * @fn void ConfigPlanificateur(void)
+ * @brief Initialisation du timer matériel et de la tâche du planificateur.
+ */
+void ConfigPlanificateur(void){
+  Serial.println("   Planificateur de commandes :");
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "planif", &Verrou_Planif);
+
+  // Timer cadencé à 1 MHz (APB 80 MHz / 80)
+  Timer_Planif=timerBegin(TIMER_PLANIFICATEUR, 80, true);
+  timerAttachInterrupt(Timer_Planif, &handleInterrupt_planificateur, true);
+
+  // Priorité supérieure à la boucle Arduino pour préempter la boucle principale
+  xTaskCreatePinnedToCore(Tache_planificateur, "planif", 4096, NULL, configMAX_PRIORITIES-2, &Tache_Planif, 1);
+  Serial.printf("     Timer %d, file de %d commandes\n", TIMER_PLANIFICATEUR, NB_COMMANDES_PLANIFIEES);
+}
+
+/**
+ * @fn int Planifie_commande(int type, int num, int val, int64_t delai_us)
+ * @brief Ajoute une commande de sortie à exécuter après un délai.
+ *
+ * @param type Type de sortie (Type_Commande)
+ * @param num Numéro de la sortie
+ * @param val Valeur à appliquer
+ * @param delai_us Délai avant exécution en µs
+ * @return 1 si la commande a été acceptée, 0 si la file est pleine ou si la sortie PWM est pilotée par la régulation
+ */
+int Planifie_commande(int type, int num, int val, int64_t delai_us){
+  if(Tache_Planif==NULL){return 0;}
+  if(type==CMD_PWM && Regulation_voie_reservee(num)){return 0;}
+  if(delai_us<0){delai_us=0;}
+
+  portENTER_CRITICAL(&Planif_mux);
+  if(Nb_Commandes_Planifiees>=NB_COMMANDES_PLANIFIEES){
+    portEXIT_CRITICAL(&Planif_mux);
+    Planif_nb_rejetees++;
+    return 0;
+  }
+  int i=Nb_Commandes_Planifiees++;
+  Tas_Commandes[i].Echeance_us=esp_timer_get_time()+delai_us;
+  Tas_Commandes[i].Type=type;
+  Tas_Commandes[i].Num=num;
+  Tas_Commandes[i].Val=val;
+  // Remontée du nouvel élément dans le tas
+  while(i>0 && Tas_Commandes[(i-1)/2].Echeance_us>Tas_Commandes[i].Echeance_us){
+    Struct_Commande_Planifiee tmp=Tas_Commandes[i];
+    Tas_Commandes[i]=Tas_Commandes[(i-1)/2];
+    Tas_Commandes[(i-1)/2]=tmp;
+    i=(i-1)/2;
+  }
+  if(Nb_Commandes_Planifiees>Planif_profondeur_max){Planif_profondeur_max=Nb_Commandes_Planifiees;}
+  portEXIT_CRITICAL(&Planif_mux);
+
+  // La tâche réarme le timer sur la nouvelle tête de file
+  xTaskNotifyGive(Tache_Planif);
+  return 1;
+}
+
+/**
+ * @fn void affiche_diagnostic_planificateur(void)
+ * @brief Affiche les statistiques de gigue d'exécution des commandes planifiées.
+ */
+void affiche_diagnostic_planificateur(void){
+  long moyenne=0;
+  if(Planif_nb_executees>0){moyenne=(long)(Planif_gigue_cumul_us/Planif_nb_executees);}
+  Serial.println("Planificateur :");
+  Serial.printf("   Commandes executees : %lu, rejetees : %lu, en attente : %d (max %d)\n", Planif_nb_executees, Planif_nb_rejetees, Nb_Commandes_Planifiees, Planif_profondeur_max);
+  Serial.printf("   Gigue moyenne : %ld us, gigue max : %ld us\n", moyenne, (long)Planif_gigue_max_us);
+}
@@ -0,0 +1,131 @@
+/**
+ * @file pool_commandes.cpp
+ * @brief Fonction de réception des commandes MQTT dans un pool d'emplacements préalloués.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la réception des commandes MQTT. Le rappel du client MQTT copie chaque message une
+ * seule fois dans un emplacement libre d'un pool alloué statiquement, puis rend la main : aucun tableau
+ * de taille variable n'est créé sur la pile de la boucle, et la taille d'un message est bornée.
+ * Les emplacements pleins sont transmis par index, dans l'ordre de réception, au traitement des commandes
+ * (loop_MQTT), qui libère chaque emplacement après exécution.
+ *
+ */
+
+#include <Arduino.h>
+#include "pool_commandes.h"
+#include "global.h"
+
+Struct_Emplacement_Commande Pool_Commandes[NB_EMPLACEMENTS_COMMANDE];
+
+/**
+ * @struct Struct_Pool_Commandes
+ * @brief File des emplacements pleins et compteurs du pool.
+ */
+struct Struct_Pool_Commandes {
+  uint32_t Libres = (1UL << NB_EMPLACEMENTS_COMMANDE) - 1;   ///< Masque des emplacements libres.
+  uint8_t File[NB_EMPLACEMENTS_COMMANDE];                      ///< Index des emplacements pleins, par ordre de réception.
+  int Tete = 0;                      ///< Position du plus ancien emplacement plein dans File.
+  int Nb = 0;                        ///< Emplacements pleins.
+  int Occupation_max = 0;            ///< Plus grand nombre d'emplacements occupés simultanément.
+  unsigned long Recues = 0;          ///< Commandes acceptées.
+  unsigned long Rejets_plein = 0;    ///< Commandes rejetées faute d'emplacement libre.
+  unsigned long Rejets_taille = 0;   ///< Commandes rejetées car trop grandes (message, topic ou propriétés de réponse).
+  unsigned int Taille_max = 0;       ///< Plus grand message accepté.
+};
+
+Struct_Pool_Commandes Pool;
+
+/**
+ * @fn int Pool_commande_depose(const char *topic, const uint8_t *message, unsigned int taille, int64_t reception_us, const char *topic_reponse, const uint8_t *correlation, size_t taille_correlation)
+ * @brief Copie un message reçu et ses propriétés de réponse dans un emplacement libre et le met en file de traitement.
+ *
+ * @param topic Topic du message
+ * @param message Message
+ * @param taille Taille du message
+ * @param reception_us Instant de réception (esp_timer)
+ * @param topic_reponse Response Topic (MQTT 5), NULL si absent
+ * @param correlation Correlation Data (MQTT 5), NULL si absente
+ * @param taille_correlation Taille de la Correlation Data
+ * @return DEPOT_ACCEPTE, ou le motif du rejet (DEPOT_TROP_GRAND, DEPOT_POOL_PLEIN)
+ */
+int Pool_commande_depose(const char *topic, const uint8_t *message, unsigned int taille, int64_t reception_us, const char *topic_reponse, const uint8_t *correlation, size_t taille_correlation){
+  size_t taille_topic=strlen(topic);
+  size_t taille_topic_reponse=(topic_reponse!=NULL) ? strlen(topic_reponse) : 0;
+  if(correlation==NULL){taille_correlation=0;}
+  if(taille>TAILLE_COMMANDE_MAX || taille_topic>=TAILLE_TOPIC_COMMANDE || taille_topic_reponse>=TAILLE_TOPIC_COMMANDE || taille_correlation>TAILLE_CORRELATION_COMMANDE){
+    Pool.Rejets_taille++;
+    return DEPOT_TROP_GRAND;
+  }
+  if(Pool.Libres==0){
+    Pool.Rejets_plein++;
+    return DEPOT_POOL_PLEIN;
+  }
+
+  int index=__builtin_ctz(Pool.Libres);
+  Pool.Libres&=~(1UL<<index);
+  Struct_Emplacement_Commande *emplacement=&Pool_Commandes[index];
+  memcpy(emplacement->Topic, topic, taille_topic+1);
+  memcpy(emplacement->Message, message, taille);
+  emplacement->Message[taille]='\0';
+  emplacement->Taille=taille;
+  emplacement->Reception_us=reception_us;
+  if(taille_topic_reponse>0){memcpy(emplacement->Topic_reponse, topic_reponse, taille_topic_reponse);}
+  emplacement->Topic_reponse[taille_topic_reponse]='\0';
+  if(taille_correlation>0){memcpy(emplacement->Correlation, correlation, taille_correlation);}
+  emplacement->Taille_correlation=taille_correlation;
+
+  Pool.File[(Pool.Tete+Pool.Nb)%NB_EMPLACEMENTS_COMMANDE]=index;
+  Pool.Nb++;
+  Pool.Recues++;
+  if(taille>Pool.Taille_max){Pool.Taille_max=taille;}
+  int occupes=NB_EMPLACEMENTS_COMMANDE-__builtin_popcount(Pool.Libres);
+  if(occupes>Pool.Occupation_max){Pool.Occupation_max=occupes;}
+  return DEPOT_ACCEPTE;
+}
+
+/**
+ * @fn int Pool_commande_suivante(void)
+ * @brief Retire de la file le plus ancien emplacement plein.
+ *
+ * L'emplacement reste réservé jusqu'à Pool_commande_libere.
+ *
+ * @return Index de l'emplacement, -1 si aucune commande n'est en attente
+ */
+int Pool_commande_suivante(void){
+  if(Pool.Nb==0){return -1;}
+  int index=Pool.File[Pool.Tete];
+  Pool.Tete=(Pool.Tete+1)%NB_EMPLACEMENTS_COMMANDE;
+  Pool.Nb--;
+  return index;
+}
+
+/**
+ * @fn Struct_Emplacement_Commande *Pool_commande(int index)
+ * @brief Accès à un emplacement par son index.
+ */
+Struct_Emplacement_Commande *Pool_commande(int index){
+  return &Pool_Commandes[index];
+}
+
+/**
+ * @fn void Pool_commande_libere(int index)
+ * @brief Rend un emplacement au pool après le traitement de sa commande.
+ */
+void Pool_commande_libere(int index){
+  if(index<0 || index>=NB_EMPLACEMENTS_COMMANDE){return;}
+  Pool.Libres|=(1UL<<index);
+}
+
+/**
+ * @fn void affiche_diagnostic_pool_commandes(void)
+ * @brief Affiche l'occupation et les rejets du pool de réception des commandes.
+ */
+void affiche_diagnostic_pool_commandes(void){
+  Serial.println("Pool de commandes :");
+  Serial.printf("   %d emplacements de %d octets, occupes : %d (max %d)\n", NB_EMPLACEMENTS_COMMANDE, TAILLE_COMMANDE_MAX, NB_EMPLACEMENTS_COMMANDE-__builtin_popcount(Pool.Libres), Pool.Occupation_max);
+  Serial.printf("   Recues : %lu, plus grand message %u octets\n", Pool.Recues, Pool.Taille_max);
+  Serial.printf("   Rejetees : %lu pool plein, %lu trop grandes (message, topic ou proprietes)\n", Pool.Rejets_plein, Pool.Rejets_taille);
+}
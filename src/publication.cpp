@@ -0,0 +1,222 @@
+/**
+ * @file publication.cpp
+ * @brief Fonction de la table des canaux de publication MQTT.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la partie du chemin de publication qui ne dépend ni du matériel ni du client MQTT :
+ * table des topics, détection de changement des canaux, taille des paquets et écrivain de flux. Il est compilé tel quel
+ * par les environnements de test natifs : test/test_publication, et test/test_mqtt avec Fonctions_MQTT.cpp,
+ * qui vérifie l'absence d'allocation pendant publish_s1.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "publication.h"
+
+/**
+ * @var Struct_Canal_MQTT Tab_Canal_MQTT[]
+ * @brief Tableau des dernières valeurs publiées par canal, pour la détection de changement.
+ */
+Struct_Canal_MQTT Tab_Canal_MQTT[NB_CANAUX_MQTT];
+
+/**
+ * @var Struct_Bande_Morte Tab_Bande_Morte[]
+ * @brief Tableau des bandes mortes par famille de canaux, lues dans MQTT.json.
+ */
+Struct_Bande_Morte Tab_Bande_Morte[NB_FAMILLES];
+
+/**
+ * @var char Tab_Topics_MQTT[][]
+ * @brief Table contiguë des topics de publication, indexée par canal (CANAL_xxx + voie).
+ *
+ * Les topics sont construits une seule fois dans mqtt_service_setup() : le chemin de publication
+ * n'effectue plus aucune concaténation de String ni allocation sur le tas.
+ */
+char Tab_Topics_MQTT[NB_TOPICS_MQTT][TAILLE_TOPIC_MQTT];
+
+/**
+ * @var uint32_t Version_Topics_MQTT
+ * @brief Empreinte de la table des topics (voir Topics_MQTT_construit).
+ *
+ * Les messages mis en file désignent leur topic par son index : un message persisté en flash
+ * avant un changement de préfixe ou de table n'est rejoué que si l'empreinte est inchangée.
+ */
+uint32_t Version_Topics_MQTT = 0;
+
+/**
+ * @fn bool construit_topic(int index, const char *prefixe, const char *format, int voie)
+ * @brief Construit un topic de publication dans la table des topics.
+ *
+ * @param index Index du topic dans Tab_Topics_MQTT.
+ * @param prefixe Préfixe des topics (mqttSubscribe1).
+ * @param format Suffixe du topic après le préfixe (format printf, %d = voie).
+ * @param voie Numéro de voie (1 à n).
+ * @return true si le topic a été tronqué.
+ */
+bool construit_topic(int index, const char *prefixe, const char *format, int voie) {
+  char suffixe[TAILLE_TOPIC_MQTT];
+  snprintf(suffixe, sizeof(suffixe), format, voie);
+  int n = snprintf(Tab_Topics_MQTT[index], TAILLE_TOPIC_MQTT, "%s%s", prefixe, suffixe);
+  return n >= TAILLE_TOPIC_MQTT;
+}
+
+/**
+ * @fn int Topics_MQTT_construit(const char *prefixe)
+ * @brief Construit une fois pour toutes la table des topics de publication de publish_s1, et son empreinte.
+ *
+ * @param prefixe Préfixe des topics (mqttSubscribe1).
+ * @return Nombre de topics tronqués à TAILLE_TOPIC_MQTT.
+ */
+int Topics_MQTT_construit(const char *prefixe) {
+  int tronques = 0;
+  for (int i = 0; i < 8; i++) {
+    tronques += construit_topic(CANAL_PCF8574_OUT_1+i, prefixe, "_out/PCF8574_OUT_1_%d", i+1);
+    tronques += construit_topic(CANAL_GPIO_OUT+i, prefixe, "_out/GPIO_OUT_%d", i+1);
+    tronques += construit_topic(CANAL_GPIO_IN+i, prefixe, "_out/GPIO_IN_%d", i+1);
+    tronques += construit_topic(CANAL_GPIO_ANA+i, prefixe, "_out/GPIO_ANA_%d", i+1);
+  }
+  for (int i = 0; i < 4; i++) {
+    tronques += construit_topic(CANAL_PT100+i, prefixe, "_out/PT100_%d", i+1);
+    tronques += construit_topic(CANAL_SONDE+i, prefixe, "_out/Sonde_%d", i+1);
+  }
+  for (int i = 0; i < 2; i++) {
+    tronques += construit_topic(CANAL_IMPULSION+i, prefixe, "_out/Impulsion_%d", i+1);
+  }
+  tronques += construit_topic(CANAL_TELEMETRE, prefixe, "_out/Telemetre", 0);
+  tronques += construit_topic(CANAL_METEO, prefixe, "_out/Meteo", 0);
+  for (int i = 0; i < 16; i++) {
+    tronques += construit_topic(CANAL_USER+i, prefixe, "_out/User_%d", i+1);
+  }
+  tronques += construit_topic(TOPIC_ETAT, prefixe, "_out/Etat", 0);
+  tronques += construit_topic(TOPIC_ACK, prefixe, "_out/Ack", 0);
+  tronques += construit_topic(TOPIC_STATUT, prefixe, "_out/Statut", 0);
+  tronques += construit_topic(TOPIC_REPONSE, prefixe, "_out/Reponse", 0);
+
+  /// @brief Empreinte FNV-1a des topics, caractère nul compris pour séparer les entrées
+  uint32_t h = 2166136261UL;
+  for (int i = 0; i < NB_TOPICS_MQTT; i++) {
+    const char *c = Tab_Topics_MQTT[i];
+    do {
+      h ^= (uint8_t)*c;
+      h *= 16777619UL;
+    } while (*c++);
+  }
+  Version_Topics_MQTT = h;
+  return tronques;
+}
+
+/**
+ * @fn bool canal_modifie(int canal, const float *val, int nb, int famille)
+ * @brief Une valeur du canal s'écarte de la dernière valeur publiée de plus que la bande morte (voir canal_a_publier).
+ */
+bool canal_modifie(int canal, const float *val, int nb, int famille) {
+  if (!Tab_Canal_MQTT[canal].Publie) {
+    return true;
+  }
+  for (int j = 0; j < nb; j++) {
+    float dernier = Tab_Canal_MQTT[canal].Valeur[j];
+    float seuil = Tab_Bande_Morte[famille].Rel * fabs(dernier);
+    if (Tab_Bande_Morte[famille].Abs > seuil) {seuil = Tab_Bande_Morte[famille].Abs;}
+    if (fabs(val[j] - dernier) > seuil) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @fn void memorise_canal(int canal, const float *val, int nb)
+ * @brief Mémorise les valeurs publiées d'un canal, référence de la détection de changement.
+ */
+void memorise_canal(int canal, const float *val, int nb) {
+  for (int j = 0; j < nb; j++) {
+    Tab_Canal_MQTT[canal].Valeur[j] = val[j];
+  }
+  Tab_Canal_MQTT[canal].Publie = true;
+}
+
+/**
+ * @fn unsigned long taille_paquet_publish(size_t taille_topic, size_t taille_message)
+ * @brief Taille d'un paquet MQTT PUBLISH QoS 0 : en-tête fixe, longueur restante, topic et message.
+ */
+unsigned long taille_paquet_publish(size_t taille_topic, size_t taille_message) {
+  unsigned long restant = 2 + taille_topic + taille_message;
+  unsigned long entete = 2;
+  if (restant > 127) {entete++;}
+  if (restant > 16383) {entete++;}
+  if (restant > 2097151) {entete++;}
+  return entete + restant;
+}
+
+/**
+ * @fn Ecrivain_Flux::Ecrivain_Flux(Sortie_Flux sortie, void *contexte)
+ * @brief Écrivain de flux vers une sortie.
+ */
+Ecrivain_Flux::Ecrivain_Flux(Sortie_Flux sortie, void *contexte) : Sortie(sortie), Contexte(contexte) {}
+
+/**
+ * @fn bool Ecrivain_Flux::envoie(const uint8_t *tampon, size_t taille)
+ * @brief Écriture d'un bloc dans la sortie.
+ * @return false si la sortie n'a pas accepté tout le bloc.
+ */
+bool Ecrivain_Flux::envoie(const uint8_t *tampon, size_t taille) {
+  if (Erreur) {return false;}
+  size_t ecrit = Sortie(Contexte, tampon, taille);
+  Transmis += ecrit;
+  if (ecrit != taille) {Erreur = true;}
+  return !Erreur;
+}
+
+/**
+ * @fn size_t Ecrivain_Flux::write(uint8_t octet)
+ * @brief Ajout d'un octet au tampon, écrit dans la sortie quand le tampon est plein.
+ */
+size_t Ecrivain_Flux::write(uint8_t octet) {
+  if (Erreur) {return 0;}
+  Tampon[Nb++] = octet;
+  if (Nb == TAILLE_TAMPON_FLUX) {
+    Nb = 0;
+    if (!envoie(Tampon, TAILLE_TAMPON_FLUX)) {return 0;}
+  }
+  return 1;
+}
+
+/**
+ * @fn size_t Ecrivain_Flux::write(const uint8_t *tampon, size_t taille)
+ * @brief Ajout d'un bloc : recopié dans le tampon s'il y tient, sinon écrit directement après le tampon.
+ *
+ * Un tampon rempli exactement par le bloc est écrit aussitôt : write(uint8_t) ne teste le tampon plein
+ * qu'après y avoir ajouté son octet.
+ */
+size_t Ecrivain_Flux::write(const uint8_t *tampon, size_t taille) {
+  if (Erreur) {return 0;}
+  if (Nb + taille <= TAILLE_TAMPON_FLUX) {
+    memcpy(Tampon + Nb, tampon, taille);
+    Nb += taille;
+    if (Nb == TAILLE_TAMPON_FLUX && !vide()) {return 0;}
+    return taille;
+  }
+  if (!vide() || !envoie(tampon, taille)) {return 0;}
+  return taille;
+}
+
+/**
+ * @fn bool Ecrivain_Flux::vide()
+ * @brief Écriture des octets en attente dans la sortie.
+ * @return false si une écriture a été incomplète depuis la création de l'écrivain.
+ */
+bool Ecrivain_Flux::vide() {
+  if (Nb > 0) {
+    size_t nb = Nb;
+    Nb = 0;
+    envoie(Tampon, nb);
+  }
+  return !Erreur;
+}
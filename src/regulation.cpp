@@ -0,0 +1,235 @@
+/**
+ * @file regulation.cpp
+ * @brief Fonction de régulation de pression.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite la régulation PID de la pression de ligne.
+ * La mesure est lue sur une entrée de Tab_GPIO_ANA et la commande est écrite sur une voie de Tab_PWM (pompe à vitesse variable).
+ * Le pas de calcul est cadencé par un timer matériel (100 à 1000 Hz) qui réveille une tâche dédiée,
+ * indépendamment de la période de la boucle principale.
+ *
+ */
+
+#include <Arduino.h>
+#include "esp_pm.h"
+#include "File_System.h"
+#include "GPIO.h"
+#include "regulation.h"
+#include "global.h"
+
+/// @brief Numéro du timer matériel utilisé par la régulation
+#define TIMER_REGULATION 1
+
+/// @brief Nombre de points enregistrés dans la trace de réponse indicielle
+#define NB_POINTS_TRACE 256
+
+/**
+ * @struct Struct_Regulation
+ * @brief Configuration de la boucle de régulation.
+ */
+struct Struct_Regulation {
+  bool Enable = false;               ///< Activation de la régulation.
+  int Voie_PWM = 0;                  ///< Index de la sortie PWM pilotant la pompe (0 à 3).
+  int Voie_ANA = 0;                  ///< Index de l'entrée analogique du capteur de pression (0 à 7).
+  int Frequence = 200;               ///< Fréquence de calcul en Hz.
+  float A = 1;                       ///< Échelle du capteur : mesure = A * ADC + B.
+  float B = 0;                       ///< Décalage du capteur.
+  float Mesure = 0;                  ///< Dernière mesure de pression.
+  float Sortie = 0;                  ///< Dernière sortie PWM (%).
+};
+
+/**
+ * @struct Struct_Point_Trace
+ * @brief Point de la trace de réponse indicielle.
+ */
+struct Struct_Point_Trace {
+  uint32_t t_us;                     ///< Temps depuis le changement de consigne (µs).
+  float Consigne;                    ///< Consigne.
+  float Mesure;                      ///< Mesure.
+  float Sortie;                      ///< Sortie PWM (%).
+};
+
+Struct_Regulation Regulation;
+Struct_PID PID_1;
+
+Struct_Point_Trace Trace_PID[NB_POINTS_TRACE];
+volatile int Trace_index=NB_POINTS_TRACE;
+int64_t Trace_debut_us=0;
+
+hw_timer_t *Timer_Regul = NULL;
+TaskHandle_t Tache_Regul = NULL;
+esp_pm_lock_handle_t Verrou_Regul = NULL;
+
+// Statistiques de gigue du pas de calcul
+unsigned long Regul_nb_pas=0;
+int64_t Regul_dernier_pas_us=0;
+int64_t Regul_gigue_max_us=0;
+int64_t Regul_gigue_cumul_us=0;
+int64_t Regul_duree_max_us=0;
+
+/**
+ * @fn void IRAM_ATTR handleInterrupt_regulation()
+ * @brief Gestionnaire d'interruption du timer : réveille la tâche de régulation.
+ */
+void IRAM_ATTR handleInterrupt_regulation() {
+  BaseType_t reveil=pdFALSE;
+  vTaskNotifyGiveFromISR(Tache_Regul, &reveil);
+  if(reveil){portYIELD_FROM_ISR();}
+}
+
+/**
+ * @fn void Tache_regulation(void *param)
+ * @brief Tâche de régulation : mesure, calcul PID, écriture PWM à chaque tick du timer.
+ */
+void Tache_regulation(void *param){
+  const int64_t periode_us = 1000000 / Regulation.Frequence;
+  for(;;){
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    int64_t debut = esp_timer_get_time();
+
+    // Gigue : écart entre la période mesurée et la période nominale
+    if(Regul_dernier_pas_us != 0){
+      int64_t gigue = (debut - Regul_dernier_pas_us) - periode_us;
+      if(gigue < 0){gigue = -gigue;}
+      Regul_gigue_cumul_us += gigue;
+      if(gigue > Regul_gigue_max_us){Regul_gigue_max_us = gigue;}
+    }
+    Regul_dernier_pas_us = debut;
+    Regul_nb_pas++;
+
+    Regulation.Mesure = analogRead(Tab_GPIO_ANA[Regulation.Voie_ANA].PIN) * Regulation.A + Regulation.B;
+    Regulation.Sortie = PID_calcul(&PID_1, Regulation.Mesure, periode_us / 1000000.0);
+    PWM_OUT_F(Regulation.Voie_PWM, Regulation.Sortie);
+
+    int i = Trace_index;
+    if(i < NB_POINTS_TRACE){
+      Trace_PID[i].t_us = (uint32_t)(debut - Trace_debut_us);
+      Trace_PID[i].Consigne = PID_1.Consigne;
+      Trace_PID[i].Mesure = Regulation.Mesure;
+      Trace_PID[i].Sortie = Regulation.Sortie;
+      Trace_index = i + 1;
+    }
+
+    int64_t duree = esp_timer_get_time() - debut;
+    if(duree > Regul_duree_max_us){Regul_duree_max_us = duree;}
+  }
+}
+
+/**
+ * @fn void ConfigRegulation(void)
+ * @brief Lecture de la configuration et démarrage de la boucle de régulation.
+ *
+ * Doit être appelée après ConfigGPIO et ConfigurePWM : l'entrée analogique et la sortie PWM
+ * utilisées doivent être activées dans le fichier de configuration.
+ */
+void ConfigRegulation(void){
+  Serial.println("");
+  Serial.println("Lecture du fichier de configuration partie REGULATION :");
+
+  Serial.print("   PID_1 = ");
+  Regulation.Enable=false;
+  if(getStringValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Enable")=="true"){Regulation.Enable=true;};
+  Serial.println(Regulation.Enable);
+  if(!Regulation.Enable){return;}
+
+  Regulation.Voie_PWM=getIntValueFromJsonFile("/config.json", "REGULATION", "PID_1", "PWM")-1;
+  Regulation.Voie_ANA=getIntValueFromJsonFile("/config.json", "REGULATION", "PID_1", "GPIO_ANA")-1;
+  Regulation.Frequence=getIntValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Frequence");
+  Regulation.A=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Echelle_A");
+  Regulation.B=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Echelle_B");
+  PID_1.Kp=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Kp");
+  PID_1.Ki=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Ki");
+  PID_1.Kd=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Kd");
+  PID_1.Consigne=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Consigne");
+  PID_1.Sortie_min=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Sortie_min");
+  PID_1.Sortie_max=getFloatValueFromJsonFile("/config.json", "REGULATION", "PID_1", "Sortie_max");
+  PID_raz(&PID_1);
+
+  if(Regulation.Frequence<100){Regulation.Frequence=100;}
+  if(Regulation.Frequence>1000){Regulation.Frequence=1000;}
+
+  if(Regulation.Voie_PWM<0 || Regulation.Voie_PWM>3 || Regulation.Voie_ANA<0 || Regulation.Voie_ANA>7 || !Tab_GPIO_ANA[Regulation.Voie_ANA].Enable || !PWM_active(Regulation.Voie_PWM)){
+    Serial.println("Configuration de la régulation invalide : PWM 1 à 4 activée et GPIO_ANA 1 à 8 activée");
+    Regulation.Enable=false;
+    return;
+  }
+  Serial.printf("      PWM %d, GPIO_ANA %d, %d Hz, Kp %.3f Ki %.3f Kd %.3f, consigne %.3f\n", Regulation.Voie_PWM+1, Regulation.Voie_ANA+1, Regulation.Frequence, PID_1.Kp, PID_1.Ki, PID_1.Kd, PID_1.Consigne);
+
+  // Le timer matériel n'est pas cadencé en veille légère
+  esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "regul", &Verrou_Regul);
+  esp_pm_lock_acquire(Verrou_Regul);
+
+  xTaskCreatePinnedToCore(Tache_regulation, "regul", 4096, NULL, configMAX_PRIORITIES-3, &Tache_Regul, 1);
+
+  // Timer cadencé à 1 MHz, alarme périodique à la fréquence de régulation
+  Timer_Regul=timerBegin(TIMER_REGULATION, 80, true);
+  timerAttachInterrupt(Timer_Regul, &handleInterrupt_regulation, true);
+  timerAlarmWrite(Timer_Regul, 1000000 / Regulation.Frequence, true);
+  timerAlarmEnable(Timer_Regul);
+  Serial.println("> Régulation démarrée");
+}
+
+/**
+ * @fn void Regulation_consigne(float consigne)
+ * @brief Change la consigne et démarre l'enregistrement de la réponse indicielle.
+ * @param consigne Nouvelle consigne de pression
+ */
+void Regulation_consigne(float consigne){
+  Trace_debut_us = esp_timer_get_time();
+  Trace_index = 0;
+  PID_1.Consigne = consigne;
+}
+
+/**
+ * @fn void Regulation_gains(float kp, float ki, float kd)
+ * @brief Change les gains du correcteur.
+ *
+ * Un gain à NAN (clé absente de la commande) conserve la valeur courante.
+ */
+void Regulation_gains(float kp, float ki, float kd){
+  if(!isnan(kp)){PID_1.Kp = kp;}
+  if(!isnan(ki)){PID_1.Ki = ki;}
+  if(!isnan(kd)){PID_1.Kd = kd;}
+}
+
+/**
+ * @fn bool Regulation_voie_reservee(int voie)
+ * @brief Indique si la sortie PWM est pilotée par la régulation active.
+ *
+ * La tâche de régulation réécrit sa sortie à chaque pas : une commande extérieure sur cette voie
+ * (PWM, lot, commande planifiée, liaison série) serait écrasée aussitôt et est refusée.
+ *
+ * @param voie Index de la sortie PWM (0 à 3)
+ */
+bool Regulation_voie_reservee(int voie){
+  return Regulation.Enable && voie==Regulation.Voie_PWM;
+}
+
+/**
+ * @fn void affiche_diagnostic_regulation(void)
+ * @brief Affiche l'état de la régulation et la gigue du pas de calcul.
+ */
+void affiche_diagnostic_regulation(void){
+  if(!Regulation.Enable){return;}
+  long moyenne=0;
+  if(Regul_nb_pas>1){moyenne=(long)(Regul_gigue_cumul_us/(Regul_nb_pas-1));}
+  Serial.println("Regulation :");
+  Serial.printf("   Consigne : %.3f, mesure : %.3f, sortie : %.1f %%\n", PID_1.Consigne, Regulation.Mesure, Regulation.Sortie);
+  Serial.printf("   Pas : %lu a %d Hz, gigue moyenne : %ld us, gigue max : %ld us, duree max : %ld us\n", Regul_nb_pas, Regulation.Frequence, moyenne, (long)Regul_gigue_max_us, (long)Regul_duree_max_us);
+}
+
+/**
+ * @fn void affiche_trace_regulation(void)
+ * @brief Exporte la trace de la dernière réponse indicielle au format CSV sur la liaison série.
+ */
+void affiche_trace_regulation(void){
+  int n = Trace_index;
+  if(Trace_debut_us == 0){n = 0;}
+  Serial.println("t_ms;Consigne;Mesure;Sortie");
+  for(int i=0;i<n;i++){
+    Serial.printf("%.3f;%.4f;%.4f;%.2f\n", Trace_PID[i].t_us/1000.0, Trace_PID[i].Consigne, Trace_PID[i].Mesure, Trace_PID[i].Sortie);
+  }
+}
@@ -20,10 +20,17 @@
 #include <Arduino.h>
 #include <SPIFFS.h>
 #include <WiFi.h>
+#include "esp_netif.h"
+#include "esp_netif_net_stack.h"
+#include "lwip/dhcp.h"
+#include "esp32/rtc.h"
 #include "File_System.h"
 #include "string.h"
 #include "global.h"
 #include "user_function.h"
+#include "reseau_serveur.h"
+#include "api_rest.h"
+#include "historique.h"
 
 
 /**
@@ -132,71 +139,606 @@ void ConfigReseau (void){
 //************************************************** WIFI *****************************************************
 //*************************************************************************************************************
 
+/// @brief Nombre de réseaux WiFi de la configuration (WIFI_1 à WIFI_3 de wifi.json)
+#define NB_RESEAUX_WIFI 3
+
+/// @brief Nombre maximal de points d'accès retenus après un scan
+#define NB_CANDIDATS_WIFI 6
+
+/// @brief Marqueur de validité du cache de connexion en mémoire RTC
+#define MAGIQUE_CACHE_WIFI 0x57494632UL
+
+/**
+ * @enum Etat_Connexion_WiFi
+ * @brief État de la machine de connexion WiFi.
+ */
+enum Etat_Connexion_WiFi {
+  WIFI_ATTENTE = 0,                  ///< Déconnecté, attente de la prochaine tentative.
+  WIFI_SCAN,                         ///< Scan asynchrone des points d'accès en cours.
+  WIFI_CONNEXION,                    ///< Tentative de connexion en cours.
+  WIFI_CONNECTE                      ///< Connecté, adresse IP obtenue.
+};
+
+/**
+ * @struct Struct_Cache_WiFi
+ * @brief Paramètres de la dernière connexion réussie, conservés en mémoire RTC non initialisée.
+ *
+ * Ils permettent une connexion directe, sans scan (BSSID et canal connus) et sans DHCP (bail réutilisé
+ * tant qu'il n'a pas atteint la moitié de sa durée, voir bail_cache_valide). Comme Tab_Id_Commande, le cache
+ * survit à un redémarrage logiciel, un chien de garde ou une veille profonde ; il n'est cru que si son marqueur
+ * et son empreinte sont corrects (voir init_cache_wifi), et il est perdu à une coupure d'alimentation.
+ */
+struct Struct_Cache_WiFi {
+  uint32_t Magique;                  ///< MAGIQUE_CACHE_WIFI si le cache est valide.
+  char SSID[33];                     ///< SSID du réseau.
+  uint8_t BSSID[6];                  ///< Adresse MAC du point d'accès.
+  int32_t Canal;                     ///< Canal du point d'accès.
+  uint32_t IP;                       ///< Adresse IP obtenue (0 si adresse statique).
+  uint32_t Passerelle;               ///< Passerelle du bail.
+  uint32_t Masque;                   ///< Masque de sous-réseau du bail.
+  uint32_t DNS;                      ///< Serveur DNS du bail.
+  uint32_t Bail_s;                   ///< Durée du bail DHCP (s), 0 si inconnue.
+  uint64_t Obtention_us;             ///< Instant d'obtention du bail (horloge RTC, remise à zéro seulement à la mise sous tension).
+  uint32_t Controle;                 ///< Empreinte FNV-1a des champs précédents (voir controle_cache_wifi).
+};
+
+RTC_NOINIT_ATTR Struct_Cache_WiFi Cache_WiFi;
+
+/**
+ * @struct Struct_Candidat_WiFi
+ * @brief Point d'accès d'un réseau connu trouvé par le scan.
+ */
+struct Struct_Candidat_WiFi {
+  int Reseau;                        ///< Index du réseau dans la configuration.
+  uint8_t BSSID[6];                  ///< Adresse MAC du point d'accès.
+  int32_t Canal;                     ///< Canal du point d'accès.
+  int32_t RSSI;                      ///< Niveau de réception (dBm).
+};
+
+/**
+ * @struct Struct_WiFi
+ * @brief Réseaux, paramètres, état et compteurs de la connexion WiFi.
+ *
+ * Les évènements WiFi (Evt_*) sont positionnés par la tâche d'évènements de l'ESP32 et traités
+ * par test_connect_wifi() dans la boucle principale.
+ */
+struct Struct_WiFi {
+  String SSID[NB_RESEAUX_WIFI];           ///< SSID des réseaux configurés.
+  String Mot_de_passe[NB_RESEAUX_WIFI];   ///< Mots de passe des réseaux configurés.
+  uint32_t IP_statique[NB_RESEAUX_WIFI][4] = {};  ///< IP, passerelle, masque, DNS statiques (IP nulle : DHCP).
+  int Nb_reseaux = 0;                     ///< Nombre de réseaux configurés.
+  int Reseau = 0;                         ///< Réseau de la tentative en cours (ou de la connexion établie).
+  bool Cache_IP = true;                   ///< Réutilisation du bail DHCP du cache lors d'une connexion directe.
+  bool Bail_cache = false;                ///< Tentative ou connexion en cours avec le bail du cache, sans client DHCP.
+  unsigned long Bails_expires = 0;        ///< Passages au DHCP d'une connexion établie avec un bail du cache arrivé à mi-durée.
+  unsigned long Timeout_ms = 20000;       ///< Durée maximale d'une tentative sur un point d'accès.
+  unsigned long Timeout_direct_ms = 3000; ///< Durée maximale d'une tentative de connexion directe (cache).
+  unsigned long Timeout_scan_ms = 10000;  ///< Durée maximale d'un scan.
+  unsigned long Attente_min_ms = 1000;    ///< Attente après un tour complet des points d'accès sans succès.
+  unsigned long Attente_max_ms = 60000;   ///< Attente maximale entre deux tours.
+  unsigned long Demarrage_ms = 30000;     ///< Attente maximale de la connexion au démarrage.
+  volatile bool Evt_IP = false;           ///< Adresse IP obtenue.
+  volatile bool Evt_perte = false;        ///< Déconnexion (ou échec d'association).
+  volatile uint8_t Evt_raison = 0;        ///< Code de raison de la dernière déconnexion.
+  volatile unsigned long Evt_ignores = 0; ///< Déconnexions demandées par la passerelle (ASSOC_LEAVE), ignorées.
+  int Etat = WIFI_ATTENTE;                ///< État courant (Etat_Connexion_WiFi).
+  bool Directe = false;                   ///< Tentative en cours par le cache (sinon candidat du scan).
+  Struct_Candidat_WiFi Candidats[NB_CANDIDATS_WIFI];  ///< Points d'accès connus, du plus fort au plus faible.
+  int Nb_candidats = 0;                   ///< Nombre de candidats du dernier scan.
+  int Candidat = 0;                       ///< Candidat de la tentative en cours.
+  unsigned long Attente_ms = 1000;        ///< Attente courante (doublée à chaque tour sans succès).
+  unsigned long Prochaine_tentative = 0;  ///< Instant (millis) de la prochaine tentative.
+  unsigned long Debut_tentative = 0;      ///< Instant (millis) du début de la tentative ou du scan en cours.
+  unsigned long Debut_coupure = 0;        ///< Instant (millis) du début de la recherche de connexion.
+  unsigned long Tentatives = 0;           ///< Tentatives de connexion.
+  unsigned long Echecs = 0;               ///< Tentatives échouées (refus ou délai dépassé).
+  unsigned long Scans = 0;                ///< Scans réalisés.
+  unsigned long Connexions = 0;           ///< Connexions réussies.
+  unsigned long Directes = 0;             ///< Dont connexions directes par le cache.
+  unsigned long Coupures = 0;             ///< Pertes de connexion.
+  unsigned long Connexion_ms = 0;         ///< Durée de la dernière connexion (début de la recherche -> adresse IP).
+  unsigned long Connexion_max_ms = 0;     ///< Durée maximale d'une connexion.
+  unsigned long Connexion_cumul_ms = 0;   ///< Durée cumulée des connexions.
+  unsigned long Directe_max_ms = 0;       ///< Durée maximale d'une connexion directe.
+  unsigned long Demarrage_connexion_ms = 0;  ///< Durée de la première connexion après le redémarrage.
+};
+
+Struct_WiFi WiFi_etat;
+
+/**
+ * @fn void evenement_wifi(WiFiEvent_t evenement, WiFiEventInfo_t info)
+ * @brief Réception des évènements WiFi (tâche d'évènements de l'ESP32) : seuls des indicateurs sont positionnés.
+ *
+ * Une déconnexion de raison ASSOC_LEAVE est celle demandée par WiFi.disconnect() au lancement d'une
+ * tentative ou d'un scan : elle peut arriver après WiFi.begin() et ferait échouer la nouvelle tentative.
+ * Elle est ignorée ; la reconnexion automatique du pilote étant désactivée, la passerelle ne quitte
+ * jamais un point d'accès sans l'avoir décidé.
+ */
+void evenement_wifi(WiFiEvent_t evenement, WiFiEventInfo_t info) {
+  switch (evenement) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      WiFi_etat.Evt_IP = true;
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      if (info.wifi_sta_disconnected.reason == WIFI_REASON_ASSOC_LEAVE) {
+        WiFi_etat.Evt_ignores++;
+        break;
+      }
+      WiFi_etat.Evt_raison = info.wifi_sta_disconnected.reason;
+      WiFi_etat.Evt_perte = true;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @fn int reseau_wifi(const char *ssid)
+ * @brief Index du réseau configuré de ce SSID, -1 si inconnu.
+ */
+int reseau_wifi(const char *ssid) {
+  for (int i = 0; i < WiFi_etat.Nb_reseaux; i++) {
+    if (WiFi_etat.SSID[i] == ssid) {return i;}
+  }
+  return -1;
+}
+
+/**
+ * @fn void lit_ip_statique(int reseau, String ssid_json)
+ * @brief Lecture de l'adresse statique facultative d'un réseau : "IP", "Passerelle", "Masque", "DNS" de wifi.json.
+ */
+void lit_ip_statique(int reseau, String ssid_json) {
+  const char *cles[4] = {"IP", "Passerelle", "Masque", "DNS"};
+  for (int i = 0; i < 4; i++) {
+    IPAddress adresse;
+    String valeur = getStringValueFromJsonFile("/wifi.json", ssid_json, "Configuration", cles[i]);
+    WiFi_etat.IP_statique[reseau][i] = (valeur != "null" && adresse.fromString(valeur)) ? (uint32_t)adresse : 0;
+  }
+  if (WiFi_etat.IP_statique[reseau][3] == 0) {WiFi_etat.IP_statique[reseau][3] = WiFi_etat.IP_statique[reseau][1];}
+}
+
+/**
+ * @fn uint32_t duree_bail_wifi()
+ * @brief Durée du bail DHCP en cours sur l'interface station (s), 0 si elle n'est pas connue.
+ */
+uint32_t duree_bail_wifi(void) {
+  esp_netif_t *sta = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+  struct netif *interface = (sta != NULL) ? (struct netif*)esp_netif_get_netif_impl(sta) : NULL;
+  struct dhcp *dhcp = (interface != NULL) ? netif_dhcp_data(interface) : NULL;
+  return (dhcp != NULL) ? dhcp->offered_t0_lease : 0;
+}
+
+/**
+ * @fn uint32_t controle_cache_wifi()
+ * @brief Empreinte FNV-1a du cache de connexion, champ Controle exclu.
+ */
+uint32_t controle_cache_wifi(void) {
+  const uint8_t *octet = (const uint8_t*)&Cache_WiFi;
+  uint32_t h = 2166136261UL;
+  for (size_t i = 0; i < offsetof(Struct_Cache_WiFi, Controle); i++) {
+    h ^= octet[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+/**
+ * @fn bool cache_wifi_valide()
+ * @brief Indique si le cache de connexion est valide : marqueur et empreinte corrects.
+ */
+bool cache_wifi_valide(void) {
+  return Cache_WiFi.Magique == MAGIQUE_CACHE_WIFI && Cache_WiFi.Controle == controle_cache_wifi();
+}
+
+/**
+ * @fn void valide_cache_wifi()
+ * @brief Validation du cache de connexion après sa mise à jour : marqueur et empreinte.
+ */
+void valide_cache_wifi(void) {
+  Cache_WiFi.Magique = MAGIQUE_CACHE_WIFI;
+  Cache_WiFi.Controle = controle_cache_wifi();
+}
+
+/**
+ * @fn void init_cache_wifi()
+ * @brief Contrôle au démarrage du cache de connexion en mémoire RTC non initialisée.
+ *
+ * Après une mise sous tension, la mémoire RTC non initialisée est quelconque et l'horloge RTC repart de zéro :
+ * le cache est effacé. Après une baisse d'alimentation, la mémoire RTC est conservée mais l'horloge RTC n'est
+ * pas garantie : le point d'accès reste utilisable, le bail est abandonné. Un cache dont l'empreinte est
+ * fausse est effacé.
+ */
+void init_cache_wifi(void) {
+  esp_reset_reason_t raison = esp_reset_reason();
+  if (raison == ESP_RST_POWERON || !cache_wifi_valide()) {
+    memset(&Cache_WiFi, 0, sizeof(Cache_WiFi));
+    return;
+  }
+  if (raison == ESP_RST_BROWNOUT) {
+    Cache_WiFi.IP = 0;
+    Cache_WiFi.Bail_s = 0;
+    valide_cache_wifi();
+  }
+}
+
+/**
+ * @fn bool bail_cache_valide()
+ * @brief Indique si le bail du cache peut encore être réutilisé sans DHCP.
+ *
+ * Le bail n'est jamais renouvelé quand il est appliqué en adresse statique : il n'est réutilisé que jusqu'à
+ * la moitié de sa durée, l'instant où un client DHCP demanderait son renouvellement. Un bail de durée
+ * inconnue n'est pas réutilisé. L'âge du bail est compté sur l'horloge RTC, qui continue pendant la veille
+ * profonde et à travers les redémarrages ; une horloge antérieure à l'obtention signale qu'elle est repartie
+ * de zéro, le bail n'est alors pas réutilisé.
+ */
+bool bail_cache_valide(void) {
+  if (Cache_WiFi.IP == 0 || Cache_WiFi.Bail_s == 0) {return false;}
+  uint64_t maintenant = esp_rtc_get_time_us();
+  if (maintenant < Cache_WiFi.Obtention_us) {return false;}
+  uint64_t age_s = (maintenant - Cache_WiFi.Obtention_us) / 1000000ULL;
+  return age_s < Cache_WiFi.Bail_s / 2;
+}
+
+/**
+ * @fn void memorise_bail_wifi()
+ * @brief Mémorisation dans le cache du bail DHCP qui vient d'être obtenu.
+ */
+void memorise_bail_wifi(void) {
+  Cache_WiFi.IP = (uint32_t)WiFi.localIP();
+  Cache_WiFi.Passerelle = (uint32_t)WiFi.gatewayIP();
+  Cache_WiFi.Masque = (uint32_t)WiFi.subnetMask();
+  Cache_WiFi.DNS = (uint32_t)WiFi.dnsIP(0);
+  Cache_WiFi.Bail_s = duree_bail_wifi();
+  Cache_WiFi.Obtention_us = esp_rtc_get_time_us();
+}
+
+/**
+ * @fn void configure_ip_wifi(int reseau, bool bail)
+ * @brief Adressage de la tentative : adresse statique du réseau, bail du cache s'il est encore valide, ou DHCP.
+ */
+void configure_ip_wifi(int reseau, bool bail) {
+  const uint32_t *ip = WiFi_etat.IP_statique[reseau];
+  WiFi_etat.Bail_cache = false;
+  if (ip[0] != 0) {
+    WiFi.config(IPAddress(ip[0]), IPAddress(ip[1]), IPAddress(ip[2]), IPAddress(ip[3]));
+  }
+  else if (bail && WiFi_etat.Cache_IP && bail_cache_valide()) {
+    WiFi.config(IPAddress(Cache_WiFi.IP), IPAddress(Cache_WiFi.Passerelle), IPAddress(Cache_WiFi.Masque), IPAddress(Cache_WiFi.DNS));
+    WiFi_etat.Bail_cache = true;
+  }
+  else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+  }
+}
+
+/**
+ * @fn void lance_tentative_wifi(int reseau, const uint8_t *bssid, int32_t canal, bool directe)
+ * @brief Lance une tentative de connexion non bloquante sur un point d'accès donné (BSSID et canal : pas de scan du pilote).
+ */
+void lance_tentative_wifi(int reseau, const uint8_t *bssid, int32_t canal, bool directe) {
+  WiFi_etat.Evt_IP = false;
+  WiFi_etat.Evt_perte = false;
+  WiFi.disconnect();
+  WiFi_etat.Reseau = reseau;
+  WiFi_etat.Directe = directe;
+  configure_ip_wifi(reseau, directe);
+  WiFi.begin(WiFi_etat.SSID[reseau].c_str(), WiFi_etat.Mot_de_passe[reseau].c_str(), canal, bssid, true);
+  WiFi_etat.Etat = WIFI_CONNEXION;
+  WiFi_etat.Debut_tentative = millis();
+  WiFi_etat.Tentatives++;
+  Serial.printf("Tentative de connexion à WiFi %s (%s, canal %d)\n", WiFi_etat.SSID[reseau].c_str(), directe ? "cache" : "scan", canal);
+}
+
+/**
+ * @fn void lance_scan_wifi()
+ * @brief Lance un scan asynchrone des points d'accès.
+ */
+void lance_scan_wifi(void) {
+  WiFi.disconnect();
+  WiFi.scanNetworks(true);
+  WiFi_etat.Etat = WIFI_SCAN;
+  WiFi_etat.Debut_tentative = millis();
+  WiFi_etat.Scans++;
+}
+
+/**
+ * @fn void lance_recherche_wifi()
+ * @brief Début d'un tour de connexion : connexion directe si le cache est valide, sinon scan.
+ */
+void lance_recherche_wifi(void) {
+  int reseau = cache_wifi_valide() ? reseau_wifi(Cache_WiFi.SSID) : -1;
+  if (reseau >= 0) {
+    lance_tentative_wifi(reseau, Cache_WiFi.BSSID, Cache_WiFi.Canal, true);
+  }
+  else {
+    lance_scan_wifi();
+  }
+}
+
+/**
+ * @fn void attente_wifi()
+ * @brief Fin d'un tour sans succès : attente avant le tour suivant, doublée à chaque tour jusqu'à Attente_max_ms.
+ */
+void attente_wifi(void) {
+  WiFi.disconnect();
+  WiFi_etat.Etat = WIFI_ATTENTE;
+  WiFi_etat.Prochaine_tentative = millis() + WiFi_etat.Attente_ms;
+  WiFi_etat.Attente_ms = min(WiFi_etat.Attente_ms * 2, WiFi_etat.Attente_max_ms);
+}
+
+/**
+ * @fn void lance_candidat_wifi()
+ * @brief Tentative sur le candidat courant du scan, ou attente si tous ont échoué.
+ */
+void lance_candidat_wifi(void) {
+  if (WiFi_etat.Candidat >= WiFi_etat.Nb_candidats) {
+    attente_wifi();
+    return;
+  }
+  Struct_Candidat_WiFi *c = &WiFi_etat.Candidats[WiFi_etat.Candidat];
+  lance_tentative_wifi(c->Reseau, c->BSSID, c->Canal, false);
+}
+
+/**
+ * @fn void fin_scan_wifi(int nb)
+ * @brief Classement des points d'accès des réseaux connus par niveau de réception décroissant.
+ */
+void fin_scan_wifi(int nb) {
+  WiFi_etat.Nb_candidats = 0;
+  for (int i = 0; i < nb; i++) {
+    int reseau = reseau_wifi(WiFi.SSID(i).c_str());
+    if (reseau < 0) {continue;}
+    Struct_Candidat_WiFi c;
+    c.Reseau = reseau;
+    memcpy(c.BSSID, WiFi.BSSID(i), 6);
+    c.Canal = WiFi.channel(i);
+    c.RSSI = WiFi.RSSI(i);
+    // Insertion triée ; le plus faible est abandonné si la liste est pleine
+    int j = WiFi_etat.Nb_candidats;
+    if (j == NB_CANDIDATS_WIFI) {
+      if (c.RSSI <= WiFi_etat.Candidats[j - 1].RSSI) {continue;}
+      j--;
+    }
+    else {
+      WiFi_etat.Nb_candidats++;
+    }
+    while (j > 0 && WiFi_etat.Candidats[j - 1].RSSI < c.RSSI) {
+      WiFi_etat.Candidats[j] = WiFi_etat.Candidats[j - 1];
+      j--;
+    }
+    WiFi_etat.Candidats[j] = c;
+  }
+  WiFi.scanDelete();
+  Serial.printf("Scan WiFi : %d points d'accès, %d connus\n", nb, WiFi_etat.Nb_candidats);
+  WiFi_etat.Candidat = 0;
+  lance_candidat_wifi();
+}
+
+/**
+ * @fn void echec_tentative_wifi()
+ * @brief Échec d'une tentative : après la connexion directe, le cache est invalidé et un scan est lancé ;
+ * après un candidat du scan, le suivant est essayé.
+ */
+void echec_tentative_wifi(void) {
+  WiFi_etat.Echecs++;
+  Serial.printf("Echec de connexion à WiFi %s (raison %d)\n", WiFi_etat.SSID[WiFi_etat.Reseau].c_str(), WiFi_etat.Evt_raison);
+  if (WiFi_etat.Directe) {
+    Cache_WiFi.Magique = 0;
+    lance_scan_wifi();
+    return;
+  }
+  WiFi_etat.Candidat++;
+  lance_candidat_wifi();
+}
+
+/**
+ * @fn void connexion_etablie_wifi(unsigned long maintenant)
+ * @brief Connexion établie : compteurs et mise à jour du cache de connexion directe.
+ */
+void connexion_etablie_wifi(unsigned long maintenant) {
+  WiFi_etat.Etat = WIFI_CONNECTE;
+  WiFi_etat.Connexions++;
+  WiFi_etat.Attente_ms = WiFi_etat.Attente_min_ms;
+  WiFi_etat.Connexion_ms = maintenant - WiFi_etat.Debut_coupure;
+  WiFi_etat.Connexion_cumul_ms += WiFi_etat.Connexion_ms;
+  if (WiFi_etat.Connexion_ms > WiFi_etat.Connexion_max_ms) {WiFi_etat.Connexion_max_ms = WiFi_etat.Connexion_ms;}
+  if (WiFi_etat.Directe) {
+    WiFi_etat.Directes++;
+    if (WiFi_etat.Connexion_ms > WiFi_etat.Directe_max_ms) {WiFi_etat.Directe_max_ms = WiFi_etat.Connexion_ms;}
+  }
+  if (WiFi_etat.Connexions == 1) {WiFi_etat.Demarrage_connexion_ms = WiFi_etat.Connexion_ms;}
+
+  strncpy(Cache_WiFi.SSID, WiFi_etat.SSID[WiFi_etat.Reseau].c_str(), sizeof(Cache_WiFi.SSID) - 1);
+  Cache_WiFi.SSID[sizeof(Cache_WiFi.SSID) - 1] = '\0';
+  memcpy(Cache_WiFi.BSSID, WiFi.BSSID(), 6);
+  Cache_WiFi.Canal = WiFi.channel();
+  // Le bail n'est pas mémorisé pour une adresse statique, déjà connue de la configuration ; un bail du cache
+  // réutilisé garde son instant d'obtention, il n'a pas été renouvelé
+  if (WiFi_etat.IP_statique[WiFi_etat.Reseau][0] != 0) {
+    Cache_WiFi.IP = 0;
+    Cache_WiFi.Bail_s = 0;
+  }
+  else if (!WiFi_etat.Bail_cache) {
+    memorise_bail_wifi();
+  }
+  valide_cache_wifi();
+
+  Serial.print("> Connexion WiFi établie sur " + WiFi_etat.SSID[WiFi_etat.Reseau] + (WiFi_etat.Directe ? " (cache)" : " (scan)") + " en " + String(WiFi_etat.Connexion_ms) + " ms, adresse IP : ");
+  Serial.println(WiFi.localIP());
+}
+
 /**
  * @fn void setup_wifi()
  * @brief Configuration de la connexion WiFi.
+ *
+ * Les réseaux WIFI_1 à WIFI_3 sont lus une seule fois. La connexion est ensuite gérée par test_connect_wifi() ;
+ * au démarrage, l'attente de la première connexion est bornée par Demarrage_ms pour ne pas bloquer
+ * l'initialisation si aucun point d'accès n'est joignable.
  * @return void
  */
 void setup_wifi() {
     if(!EnableWIFI){return;}
-    delay(10);
     // Connexion au réseau WiFi
     Serial.println();
     Serial.println(F("============================================================================================"));
     Serial.println("Connexion au réseau WiFi ");
     Serial.println(F("============================================================================================"));
-    // Charger le fichier de configuration JSON
-    String ssid;
-    String password;
-    String ssid_json;
-    int i;
-    boolean connecte = false;
-    
-    while (!connecte) {
-      for(i=1;i<4&& !connecte;i++){
-        ssid_json = String(("WIFI_" + std::to_string(i)).c_str());
-        ssid=getStringValueFromJsonFile("/wifi.json", ssid_json, "Configuration", "SSID");
-        password=getStringValueFromJsonFile("/wifi.json", ssid_json, "Configuration","password");
-        
-
-        WiFi.begin(ssid.c_str(), password.c_str());
-
-        Serial.println("Tentative de connexion à WiFi " + ssid + "( " + password + ")");
-
-        for (int i = 0; i < 20 && !connecte; i++) {
-          if (WiFi.status() == WL_CONNECTED) {
-            connecte=true;
-          }
-          delay(1000);
-          Serial.print(".");
-        }
-      delay(1000);  
-      Serial.println("");
-      }
+    for (int i = 1; i <= NB_RESEAUX_WIFI; i++) {
+      String ssid_json = "WIFI_" + String(i);
+      String ssid = getStringValueFromJsonFile("/wifi.json", ssid_json, "Configuration", "SSID");
+      if (ssid == "" || ssid == "null") {continue;}
+      WiFi_etat.SSID[WiFi_etat.Nb_reseaux] = ssid;
+      WiFi_etat.Mot_de_passe[WiFi_etat.Nb_reseaux] = getStringValueFromJsonFile("/wifi.json", ssid_json, "Configuration", "password");
+      lit_ip_statique(WiFi_etat.Nb_reseaux, ssid_json);
+      WiFi_etat.Nb_reseaux++;
+    }
+    if (WiFi_etat.Nb_reseaux == 0) {
+      Serial.println("Aucun réseau WiFi configuré");
+      EnableWIFI = false;
+      return;
+    }
+    unsigned long valeur = getIntValueFromJsonFile("/config.json", "RESEAU", "WIFI", "Timeout_ms");
+    if (valeur > 0) {WiFi_etat.Timeout_ms = valeur;}
+    valeur = getIntValueFromJsonFile("/config.json", "RESEAU", "WIFI", "Timeout_direct_ms");
+    if (valeur > 0) {WiFi_etat.Timeout_direct_ms = valeur;}
+    valeur = getIntValueFromJsonFile("/config.json", "RESEAU", "WIFI", "Attente_max_ms");
+    if (valeur > 0) {WiFi_etat.Attente_max_ms = valeur;}
+    valeur = getIntValueFromJsonFile("/config.json", "RESEAU", "WIFI", "Demarrage_ms");
+    if (valeur > 0) {WiFi_etat.Demarrage_ms = valeur;}
+    if (getStringValueFromJsonFile("/config.json", "RESEAU", "WIFI", "Cache_IP") == "false") {WiFi_etat.Cache_IP = false;}
+    init_cache_wifi();
+    Serial.printf("   %d réseaux, %lu ms par tentative, cache %s\n", WiFi_etat.Nb_reseaux, WiFi_etat.Timeout_ms,
+                  cache_wifi_valide() ? Cache_WiFi.SSID : "vide");
+
+    // La reconnexion est gérée par la machine d'état : pas de reconnexion automatique du pilote
+    WiFi.mode(WIFI_STA);
+    WiFi.persistent(false);
+    WiFi.setAutoReconnect(false);
+    WiFi.onEvent(evenement_wifi, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.onEvent(evenement_wifi, ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+    WiFi_etat.Attente_ms = WiFi_etat.Attente_min_ms;
+    WiFi_etat.Debut_coupure = millis();
+    lance_recherche_wifi();
+
+    unsigned long debut = millis();
+    while (WiFi_etat.Etat != WIFI_CONNECTE && millis() - debut < WiFi_etat.Demarrage_ms) {
+      test_connect_wifi();
+      delay(10);
+    }
+    if (WiFi_etat.Etat != WIFI_CONNECTE) {
+      Serial.println("> Wifi non connecté, nouvelles tentatives en tâche de fond");
     }
-
-  Serial.println("> Wifi initialisé");
-  Serial.println("Connexion WiFi établie");
-  Serial.println("Adresse IP : ");
-  Serial.println(WiFi.localIP());
 }
 
 /**
  * @fn void test_connect_wifi()
- * @brief Teste et configure la connexion WiFi si elle n'est pas établie.
+ * @brief Machine d'état de la connexion WiFi, appelée à chaque boucle ; ne bloque jamais.
+ *
+ * Chaque tour commence par une connexion directe sur le point d'accès du cache (sans scan ni DHCP),
+ * puis, en cas d'échec, par un scan unique et des tentatives sur les points d'accès connus du plus
+ * fort au plus faible. Une tentative échoue sur déconnexion signalée par le pilote ou après son délai.
  * @return void
  */
 void test_connect_wifi(void){
   if(!EnableWIFI){return;}
-  if (WiFi.status() != WL_CONNECTED){
-    setup_wifi();
+  unsigned long maintenant = millis();
+  bool ip = WiFi_etat.Evt_IP;
+  bool perte = WiFi_etat.Evt_perte;
+  WiFi_etat.Evt_IP = false;
+  WiFi_etat.Evt_perte = false;
+
+  switch (WiFi_etat.Etat) {
+    case WIFI_ATTENTE:
+      if ((long)(maintenant - WiFi_etat.Prochaine_tentative) >= 0) {lance_recherche_wifi();}
+      break;
+
+    case WIFI_SCAN: {
+      int nb = WiFi.scanComplete();
+      if (nb >= 0) {
+        fin_scan_wifi(nb);
+      }
+      else if (nb == WIFI_SCAN_FAILED || maintenant - WiFi_etat.Debut_tentative >= WiFi_etat.Timeout_scan_ms) {
+        WiFi.scanDelete();
+        attente_wifi();
+      }
+      break;
+    }
+
+    case WIFI_CONNEXION: {
+      unsigned long timeout = WiFi_etat.Directe ? WiFi_etat.Timeout_direct_ms : WiFi_etat.Timeout_ms;
+      if (ip) {
+        connexion_etablie_wifi(maintenant);
+      }
+      else if (perte || maintenant - WiFi_etat.Debut_tentative >= timeout) {
+        echec_tentative_wifi();
+      }
+      break;
+    }
+
+    case WIFI_CONNECTE:
+      if (perte) {
+        WiFi_etat.Coupures++;
+        WiFi_etat.Debut_coupure = maintenant;
+        Serial.printf("Perte de la connexion WiFi (raison %d)\n", WiFi_etat.Evt_raison);
+        lance_recherche_wifi();
+      }
+      else if (WiFi_etat.Bail_cache && !bail_cache_valide()) {
+        // Bail du cache à mi-durée : le client DHCP est démarré sur la connexion établie pour obtenir un bail neuf
+        WiFi_etat.Bail_cache = false;
+        WiFi_etat.Bails_expires++;
+        Serial.println("Bail DHCP du cache à mi-durée : passage au DHCP");
+        WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+      }
+      else if (ip && !WiFi_etat.Bail_cache && WiFi_etat.IP_statique[WiFi_etat.Reseau][0] == 0) {
+        // Bail obtenu ou renouvelé par le client DHCP pendant la connexion
+        memorise_bail_wifi();
+        valide_cache_wifi();
+      }
+      break;
   }
 }
 
+/**
+ * @fn bool WiFi_connecte()
+ * @brief Indique si la connexion WiFi est établie (adresse IP obtenue).
+ */
+bool WiFi_connecte(void){
+  return EnableWIFI && WiFi_etat.Etat == WIFI_CONNECTE;
+}
+
+/**
+ * @fn void affiche_diagnostic_wifi()
+ * @brief Affiche l'état et les compteurs de la connexion WiFi.
+ */
+void affiche_diagnostic_wifi(void){
+  if(!EnableWIFI){return;}
+  unsigned long moyenne = (WiFi_etat.Connexions > 0) ? WiFi_etat.Connexion_cumul_ms / WiFi_etat.Connexions : 0;
+  Serial.println("WiFi :");
+  const char *etats[] = {"attente", "scan", "connexion", "connecté"};
+  Serial.printf("   Etat : %s, réseau %s, canal %d, RSSI %d dBm\n", etats[WiFi_etat.Etat], WiFi_etat.SSID[WiFi_etat.Reseau].c_str(), Cache_WiFi.Canal, WiFi_connecte() ? WiFi.RSSI() : 0);
+  Serial.printf("   Tentatives : %lu, échecs : %lu, scans : %lu, connexions : %lu (directes %lu), coupures : %lu, déconnexions volontaires ignorées : %lu\n", WiFi_etat.Tentatives, WiFi_etat.Echecs, WiFi_etat.Scans, WiFi_etat.Connexions, WiFi_etat.Directes, WiFi_etat.Coupures, WiFi_etat.Evt_ignores);
+  if (cache_wifi_valide() && Cache_WiFi.IP != 0) {
+    Serial.printf("   Bail du cache : %lu s, obtenu il y a %lu s, %s, passages au DHCP : %lu\n", (unsigned long)Cache_WiFi.Bail_s,
+                  (unsigned long)((esp_rtc_get_time_us() - Cache_WiFi.Obtention_us) / 1000000ULL), bail_cache_valide() ? "réutilisable" : "expiré", WiFi_etat.Bails_expires);
+  }
+  Serial.printf("   Durée de connexion : démarrage %lu ms, dernière %lu ms, moyenne %lu ms, max %lu ms, max directe %lu ms\n", WiFi_etat.Demarrage_connexion_ms, WiFi_etat.Connexion_ms, moyenne, WiFi_etat.Connexion_max_ms, WiFi_etat.Directe_max_ms);
+}
+
 //*************************************************************************************************************
 //************************************************** Temps NTP ************************************************
 //*************************************************************************************************************
 
+/**
+ * @fn void synchronise_temps()
+ * @brief Mise à jour NTP d'ezTime sans attente, seulement si le WiFi est connecté.
+ *
+ * waitForSync() attend indéfiniment le retour du WiFi et bloquerait la boucle principale pendant une coupure.
+ * @return void
+ */
+void synchronise_temps() {
+  if(WiFi_connecte()){events();}
+}
+
 /**
  * @fn void daylyRoutine()
  * @brief Routine quotidienne.
@@ -207,7 +749,7 @@ void daylyRoutine() {
   saveDataToFile(Temperature_max(), Temperature_min(), Pression(), val_impulsion1());
   reset_min_max();
   Fonction_Utilisateur_jour();
-  waitForSync();
+  synchronise_temps();
 }
 
 /**
@@ -219,7 +761,7 @@ void hourlyRoutine() {
   // Votre code pour la routine d'une heure
   SaveValueToFile();
   Fonction_Utilisateur_heure();
-  waitForSync();
+  synchronise_temps();
 }
 
 /**
@@ -230,7 +772,7 @@ void hourlyRoutine() {
 void minutlyRoutine() {
   // Votre code pour la routine d'une heure
   Fonction_Utilisateur_minute();
-  waitForSync();
+  synchronise_temps();
 }
 
 /**
@@ -244,9 +786,9 @@ void setup_temps(){
   Serial.println(F("============================================================================================"));
   Serial.println("Initialisation de l'horloge NTP");
   Serial.println(F("============================================================================================"));
-  // Initialisation d'eZTime
+  // Initialisation d'eZTime (attente bornée : sans WiFi, l'heure sera synchronisée plus tard par synchronise_temps)
   Serial.print(".");
-  waitForSync();
+  if(WiFi_connecte()){waitForSync(10);}
   Serial.print(".");
   // Configuration du fuseau horaire
   timeZone.setLocation("Europe/Paris"); 
@@ -292,6 +834,17 @@ void maj_temps(){
 
 
 
+/**
+ * @fn uint64_t temps_epoch_ms()
+ * @brief Heure UTC en millisecondes depuis l'époque, utilisée pour les commandes horodatées.
+ * @return Heure UTC en ms, 0 si l'heure NTP n'est pas disponible.
+ */
+uint64_t temps_epoch_ms(void){
+  if(!EnableNTP || timeStatus()==timeNotSet){return 0;}
+  time_t t = UTC.now();
+  return (uint64_t)t*1000 + UTC.ms(LAST_READ);
+}
+
 //*************************************************************************************************************
 //************************************************** WEB *****************************************************
 //*************************************************************************************************************
@@ -312,12 +865,16 @@ void setup_web(){
     String html = "<html><body>";
     html += "<h1>Données du capteur</h1>";
     html += "<p>Température: " + String(Temperature(0)) + " &deg;C</p>";
-    html += "<p>Pression: " + String(Pression() / 100.0F) + " hPa</p>";
+    html += "<p>Pression: " + String(Pression()) + " hPa</p>";
     html += "<p>Humidité: " + String(Humidite()) + " %</p>";
     html += "</body></html>";
     request->send(200, "text/html", html);
   });
 
+  // Routes de l'API REST JSON
+  ConfigAPI();
+  ConfigHistorique();
+
   // Démarrez le serveur web
   server.begin();
   Serial.println("> Serveur web initialisé");
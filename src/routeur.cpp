@@ -0,0 +1,102 @@
+/**
+ * @file routeur.cpp
+ * @brief Fonction de routage des commandes MQTT.
+ * @author Thomas GAUTIER
+ * @version 1
+ * @date 22/11/2023
+ *
+ * Fichier de fonction de passerelle MQTT IOT.
+ * Le fichier traite l'aiguillage des commandes reçues vers leur gestionnaire.
+ * Les routes sont enregistrées au démarrage dans une table de hachage indexée par le suffixe du topic :
+ * le temps d'aiguillage ne dépend pas du nombre de routes.
+ * Le module ne dépend pas du matériel : il est testé sur le PC (pio test -e native -f test_routeur).
+ *
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "routeur.h"
+
+/**
+ * @fn uint32_t Routeur_hash(const char *suffixe)
+ * @brief Empreinte FNV-1a 32 bits d'un suffixe de topic.
+ */
+uint32_t Routeur_hash(const char *suffixe){
+  uint32_t h=2166136261UL;
+  while(*suffixe){
+    h^=(uint8_t)*suffixe++;
+    h*=16777619UL;
+  }
+  return h;
+}
+
+/**
+ * @fn void Routeur_init(Struct_Routeur *routeur, Struct_Route *table, int capacite)
+ * @brief Initialisation d'un routeur sur une table fournie par l'appelant.
+ *
+ * @param routeur Routeur à initialiser
+ * @param table Table des entrées
+ * @param capacite Nombre d'entrées de la table (puissance de 2)
+ */
+void Routeur_init(Struct_Routeur *routeur, Struct_Route *table, int capacite){
+  routeur->Table=table;
+  routeur->Capacite=capacite;
+  routeur->Nb=0;
+  for(int i=0;i<capacite;i++){
+    table[i].Suffixe[0]='\0';
+    table[i].Hash=0;
+    table[i].Gestionnaire=NULL;
+    table[i].Voie=0;
+    table[i].Format=0;
+  }
+}
+
+/**
+ * @fn int Routeur_ajoute(Struct_Routeur *routeur, const char *suffixe, Gestionnaire_Commande gestionnaire, int voie, int format)
+ * @brief Enregistre une route.
+ *
+ * @param routeur Routeur
+ * @param suffixe Suffixe du topic après "<mqttSubscribe1>/"
+ * @param gestionnaire Gestionnaire de la commande
+ * @param voie Argument transmis au gestionnaire
+ * @param format Format du corps de la commande
+ * @return 1 si la route a été enregistrée, 0 si la table est pleine, le suffixe trop long ou déjà présent
+ */
+int Routeur_ajoute(Struct_Routeur *routeur, const char *suffixe, Gestionnaire_Commande gestionnaire, int voie, int format){
+  if(strlen(suffixe)>=TAILLE_SUFFIXE_ROUTE){return 0;}
+  if(4*(routeur->Nb+1)>3*routeur->Capacite){return 0;}
+
+  uint32_t h=Routeur_hash(suffixe);
+  int masque=routeur->Capacite-1;
+  int i=h&masque;
+  while(routeur->Table[i].Gestionnaire!=NULL){
+    if(routeur->Table[i].Hash==h && strcmp(routeur->Table[i].Suffixe, suffixe)==0){return 0;}
+    i=(i+1)&masque;
+  }
+  strcpy(routeur->Table[i].Suffixe, suffixe);
+  routeur->Table[i].Hash=h;
+  routeur->Table[i].Gestionnaire=gestionnaire;
+  routeur->Table[i].Voie=voie;
+  routeur->Table[i].Format=format;
+  routeur->Nb++;
+  return 1;
+}
+
+/**
+ * @fn const Struct_Route *Routeur_cherche(const Struct_Routeur *routeur, const char *suffixe)
+ * @brief Recherche la route d'un suffixe de topic.
+ *
+ * @return La route, ou NULL si aucune route ne correspond
+ */
+const Struct_Route *Routeur_cherche(const Struct_Routeur *routeur, const char *suffixe){
+  if(routeur->Capacite==0){return NULL;}
+  uint32_t h=Routeur_hash(suffixe);
+  int masque=routeur->Capacite-1;
+  int i=h&masque;
+  while(routeur->Table[i].Gestionnaire!=NULL){
+    if(routeur->Table[i].Hash==h && strcmp(routeur->Table[i].Suffixe, suffixe)==0){return &routeur->Table[i];}
+    i=(i+1)&masque;
+  }
+  return NULL;
+}
@@ -10,7 +10,6 @@
  */
 
 #include <Wire.h>
-#include <PubSubClient.h>
 #include <PCF8574.h>
 #include "capteurs.h"
 #include "Fonctions_MQTT.h"
@@ -0,0 +1,250 @@
+/**
+ * @file Arduino.h
+ * @brief Cale hôte du cœur Arduino pour les tests natifs.
+ *
+ * Remplace, pour les modules compilés sur le PC (pio test -e native, -e native_mqtt), les classes et fonctions
+ * du cœur Arduino ESP32 qu'ils utilisent : String, Print, Stream, Client, IPAddress, Serial, ESP,
+ * millis / micros / delay, ainsi que les fonctions de FreeRTOS et d'esp_timer que le cœur rend visibles.
+ * L'horloge est celle du système, décalable par les tests (Decalage_horloge_hote_ms) pour simuler
+ * l'écoulement du temps sans attendre.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define F(texte) texte
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+/// @brief Avance simulée de l'horloge, ajoutée à l'horloge monotone du système
+inline uint64_t Decalage_horloge_hote_ms = 0;
+
+inline uint64_t horloge_hote_us() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000ULL + t.tv_nsec / 1000 + Decalage_horloge_hote_ms * 1000ULL;
+}
+
+inline unsigned long millis() {return (unsigned long)(horloge_hote_us() / 1000);}
+inline unsigned long micros() {return (unsigned long)horloge_hote_us();}
+inline void delay(unsigned long ms) {usleep(ms * 1000);}
+inline long random(long max) {return (max > 0) ? rand() % max : 0;}
+inline long random(long min, long max) {return (max > min) ? min + rand() % (max - min) : min;}
+
+/**
+ * @class String
+ * @brief Chaîne de l'API Arduino, sur std::string.
+ */
+class String {
+ public:
+  String() {}
+  String(const char *texte) : Texte(texte ? texte : "") {}
+  String(const std::string &texte) : Texte(texte) {}
+  explicit String(char c) : Texte(1, c) {}
+  String(int valeur) : Texte(std::to_string(valeur)) {}
+  String(unsigned int valeur) : Texte(std::to_string(valeur)) {}
+  String(long valeur) : Texte(std::to_string(valeur)) {}
+  String(unsigned long valeur) : Texte(std::to_string(valeur)) {}
+  String(long long valeur) : Texte(std::to_string(valeur)) {}
+  String(unsigned long long valeur) : Texte(std::to_string(valeur)) {}
+  String(double valeur, unsigned int decimales = 2) {
+    char texte[48];
+    snprintf(texte, sizeof(texte), "%.*f", decimales, valeur);
+    Texte = texte;
+  }
+  const char *c_str() const {return Texte.c_str();}
+  unsigned int length() const {return Texte.size();}
+  bool isEmpty() const {return Texte.empty();}
+  bool concat(const char *texte) {Texte += texte; return true;}
+  bool concat(char c) {Texte += c; return true;}
+  void reserve(unsigned int taille) {Texte.reserve(taille);}
+  char operator[](unsigned int i) const {return (i < Texte.size()) ? Texte[i] : 0;}
+  long toInt() const {return atol(Texte.c_str());}
+  float toFloat() const {return (float)atof(Texte.c_str());}
+  int indexOf(char c) const {size_t p = Texte.find(c); return (p == std::string::npos) ? -1 : (int)p;}
+  int indexOf(const char *texte) const {size_t p = Texte.find(texte); return (p == std::string::npos) ? -1 : (int)p;}
+  String substring(unsigned int debut) const {return (debut < Texte.size()) ? String(Texte.substr(debut)) : String();}
+  String substring(unsigned int debut, unsigned int fin) const {return (debut < Texte.size() && fin > debut) ? String(Texte.substr(debut, fin - debut)) : String();}
+  bool startsWith(const String &prefixe) const {return Texte.compare(0, prefixe.Texte.size(), prefixe.Texte) == 0;}
+  String &operator+=(const String &texte) {Texte += texte.Texte; return *this;}
+  String &operator+=(const char *texte) {Texte += texte; return *this;}
+  String &operator+=(char c) {Texte += c; return *this;}
+  bool operator==(const String &texte) const {return Texte == texte.Texte;}
+  bool operator==(const char *texte) const {return texte != NULL && Texte == texte;}
+  bool operator!=(const String &texte) const {return !(*this == texte);}
+  bool operator!=(const char *texte) const {return !(*this == texte);}
+  bool operator<(const String &texte) const {return Texte < texte.Texte;}
+  friend String operator+(const String &a, const String &b) {return String(a.Texte + b.Texte);}
+  friend String operator+(const String &a, const char *b) {return String(a.Texte + b);}
+  friend String operator+(const char *a, const String &b) {return String(a + b.Texte);}
+  friend String operator+(const String &a, char b) {return String(a.Texte + b);}
+  friend String operator+(const String &a, int b) {return a + String(b);}
+  friend String operator+(const String &a, unsigned int b) {return a + String(b);}
+  friend String operator+(const String &a, long b) {return a + String(b);}
+  friend String operator+(const String &a, unsigned long b) {return a + String(b);}
+  friend String operator+(const String &a, double b) {return a + String(b);}
+
+ private:
+  std::string Texte;
+};
+
+/**
+ * @class Print
+ * @brief Sortie d'octets, avec printf.
+ */
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t octet) = 0;
+  virtual size_t write(const uint8_t *tampon, size_t taille) {
+    size_t n = 0;
+    while (n < taille && write(tampon[n])) {n++;}
+    return n;
+  }
+  size_t write(const char *texte) {return write((const uint8_t *)texte, strlen(texte));}
+  size_t print(const char *texte) {return write(texte);}
+  size_t print(const String &texte) {return write(texte.c_str());}
+  size_t print(char c) {return write((uint8_t)c);}
+  size_t print(int valeur) {return printf("%d", valeur);}
+  size_t print(unsigned int valeur) {return printf("%u", valeur);}
+  size_t print(long valeur) {return printf("%ld", valeur);}
+  size_t print(unsigned long valeur) {return printf("%lu", valeur);}
+  size_t print(double valeur) {return printf("%.2f", valeur);}
+  size_t println() {return write("\n");}
+  template <typename T> size_t println(const T &valeur) {return print(valeur) + println();}
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char texte[512];
+    va_list arguments;
+    va_start(arguments, format);
+    int n = vsnprintf(texte, sizeof(texte), format, arguments);
+    va_end(arguments);
+    if (n < 0) {return 0;}
+    return write((const uint8_t *)texte, ((size_t)n < sizeof(texte)) ? (size_t)n : sizeof(texte) - 1);
+  }
+};
+
+/**
+ * @class Stream
+ * @brief Entrée / sortie d'octets.
+ */
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+};
+
+/**
+ * @class IPAddress
+ * @brief Adresse IPv4, dans l'ordre des octets du réseau comme sur l'ESP32.
+ */
+class IPAddress {
+ public:
+  IPAddress() {}
+  IPAddress(uint32_t adresse) : Adresse(adresse) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : Adresse((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  operator uint32_t() const {return Adresse;}
+  uint8_t operator[](int i) const {return (uint8_t)(Adresse >> (8 * i));}
+  String toString() const {
+    char texte[16];
+    snprintf(texte, sizeof(texte), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+    return String(texte);
+  }
+  bool fromString(const String &texte) {return fromString(texte.c_str());}
+  bool fromString(const char *texte) {
+    unsigned a, b, c, d;
+    char fin;
+    if (sscanf(texte, "%u.%u.%u.%u%c", &a, &b, &c, &d, &fin) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {return false;}
+    *this = IPAddress(a, b, c, d);
+    return true;
+  }
+
+ private:
+  uint32_t Adresse = 0;
+};
+
+/**
+ * @class Client
+ * @brief Liaison connectée (interface de WiFiClient et ClientTLS).
+ */
+class Client : public Stream {
+ public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char *hote, uint16_t port) = 0;
+  virtual size_t write(uint8_t octet) = 0;
+  virtual size_t write(const uint8_t *tampon, size_t taille) = 0;
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int read(uint8_t *tampon, size_t taille) = 0;
+  virtual int peek() = 0;
+  virtual void flush() = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+  using Print::write;
+};
+
+/**
+ * @class HardwareSerial
+ * @brief Liaison série : les messages sont écrits sur la sortie standard, sauf si Muet.
+ */
+class HardwareSerial : public Stream {
+ public:
+  bool Muet = false;                 ///< Messages ignorés.
+  size_t write(uint8_t octet) override {
+    if (!Muet) {fputc(octet, stdout);}
+    return 1;
+  }
+  size_t write(const uint8_t *tampon, size_t taille) override {
+    if (!Muet) {fwrite(tampon, 1, taille, stdout);}
+    return taille;
+  }
+  using Print::write;
+  int available() override {return 0;}
+  int read() override {return -1;}
+  int peek() override {return -1;}
+};
+
+inline HardwareSerial Serial;
+
+/**
+ * @class EspClass
+ * @brief Informations de la puce : adresse MAC fixe, compteur de cycles à 240 MHz tiré de l'horloge,
+ * tas libre constant (la consommation de mémoire des tests est relevée par leurs propres compteurs).
+ */
+class EspClass {
+ public:
+  uint64_t getEfuseMac() {return 0x0000A1B2C3D4E5F6ULL;}
+  uint8_t getCpuFreqMHz() {return 240;}
+  uint32_t getCycleCount() {return (uint32_t)(horloge_hote_us() * 240ULL);}
+  uint32_t getFreeHeap() {return 200000;}
+  uint32_t getMinFreeHeap() {return 200000;}
+  uint32_t getMaxAllocHeap() {return 110000;}
+  void restart() {exit(0);}
+};
+
+inline EspClass ESP;
+
+/// @brief Tâche FreeRTOS : la tâche courante est la seule sur l'hôte
+typedef void *TaskHandle_t;
+
+/// @brief Marge de pile de la tâche courante (octets sur l'ESP32), fixe sur l'hôte
+inline uint32_t uxTaskGetStackHighWaterMark(TaskHandle_t tache) {return 4096;}
+
+#include <esp_timer.h>
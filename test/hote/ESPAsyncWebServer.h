@@ -0,0 +1,8 @@
+/**
+ * @file ESPAsyncWebServer.h
+ * @brief Cale hôte vide : les modules compilés sur le PC incluent ce fichier sans utiliser le serveur web.
+ */
+
+#pragma once
+
+#include <Arduino.h>
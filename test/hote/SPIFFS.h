@@ -0,0 +1,93 @@
+/**
+ * @file SPIFFS.h
+ * @brief Cale hôte du système de fichiers SPIFFS pour les tests natifs.
+ *
+ * Les fichiers sont ceux d'un répertoire du PC (SPIFFS.Racine, /tmp/spiffs_hote par défaut) : le chemin
+ * "/MQTT.json" désigne <Racine>/MQTT.json. Un File partage son fichier entre ses copies, comme sur l'ESP32.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <sys/stat.h>
+
+/**
+ * @class File
+ * @brief Fichier ouvert, sur un FILE* du PC.
+ */
+class File : public Stream {
+ public:
+  File() {}
+  explicit File(FILE *fichier) : Fichier(fichier, fclose) {}
+
+  size_t write(uint8_t octet) override {return write(&octet, 1);}
+  size_t write(const uint8_t *tampon, size_t taille) override {
+    if (!Fichier) {return 0;}
+    return fwrite(tampon, 1, taille, Fichier.get());
+  }
+  using Print::write;
+
+  size_t read(uint8_t *tampon, size_t taille) {
+    if (!Fichier) {return 0;}
+    return fread(tampon, 1, taille, Fichier.get());
+  }
+  int read() override {
+    uint8_t octet;
+    return (read(&octet, 1) == 1) ? octet : -1;
+  }
+  size_t readBytes(char *tampon, size_t taille) {return read((uint8_t *)tampon, taille);}
+  int peek() override {
+    if (!Fichier) {return -1;}
+    int c = fgetc(Fichier.get());
+    if (c != EOF) {ungetc(c, Fichier.get());}
+    return c;
+  }
+  int available() override {return (int)(size() - position());}
+
+  bool seek(uint32_t position) {return Fichier && fseek(Fichier.get(), position, SEEK_SET) == 0;}
+  size_t position() const {return Fichier ? (size_t)ftell(Fichier.get()) : 0;}
+  size_t size() const {
+    if (!Fichier) {return 0;}
+    fflush(Fichier.get());
+    struct stat etat;
+    return (fstat(fileno(Fichier.get()), &etat) == 0) ? (size_t)etat.st_size : 0;
+  }
+  void close() {Fichier.reset();}
+  operator bool() const {return (bool)Fichier;}
+
+ private:
+  std::shared_ptr<FILE> Fichier;     ///< Fichier du PC, fermé avec la dernière copie.
+};
+
+/**
+ * @class SPIFFSFS
+ * @brief Système de fichiers : répertoire Racine du PC.
+ */
+class SPIFFSFS {
+ public:
+  String Racine = "/tmp/spiffs_hote";  ///< Répertoire du PC contenant les fichiers.
+
+  bool begin(bool formate = false) {return mkdir(Racine.c_str(), 0700) == 0 || errno == EEXIST;}
+  File open(const String &chemin, const char *mode = "r") {return open(chemin.c_str(), mode);}
+  File open(const char *chemin, const char *mode = "r") {
+    begin();
+    /// @brief Fichiers binaires (file d'attente) : "r" / "w" / "a" sans conversion
+    char mode_hote[4] = {mode[0], 'b', '\0', '\0'};
+    FILE *fichier = fopen(complet(chemin).c_str(), mode_hote);
+    return fichier ? File(fichier) : File();
+  }
+  bool exists(const String &chemin) {return exists(chemin.c_str());}
+  bool exists(const char *chemin) {
+    struct stat etat;
+    return stat(complet(chemin).c_str(), &etat) == 0;
+  }
+  bool remove(const String &chemin) {return remove(chemin.c_str());}
+  bool remove(const char *chemin) {return ::remove(complet(chemin).c_str()) == 0;}
+  bool rename(const String &avant, const String &apres) {return rename(avant.c_str(), apres.c_str());}
+  bool rename(const char *avant, const char *apres) {return ::rename(complet(avant).c_str(), complet(apres).c_str()) == 0;}
+
+ private:
+  String complet(const char *chemin) {return Racine + chemin;}
+};
+
+inline SPIFFSFS SPIFFS;
@@ -0,0 +1,164 @@
+/**
+ * @file WiFi.h
+ * @brief Cale hôte de la bibliothèque WiFi pour les tests natifs.
+ *
+ * WiFiClient est une vraie liaison TCP sur une socket POSIX (connect() bloquant, ou socket déjà connectée
+ * confiée par WiFiClient(fd) comme sur l'ESP32), lue sans attendre. WiFi rapporte l'état de la station,
+ * connectée par défaut, modifiable par les tests.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+/// @brief État de la station (valeurs de la bibliothèque WiFi de l'ESP32)
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+  WL_NO_SHIELD = 255
+} wl_status_t;
+
+/**
+ * @class WiFiClass
+ * @brief Station WiFi : seul l'état est simulé.
+ */
+class WiFiClass {
+ public:
+  wl_status_t Etat = WL_CONNECTED;   ///< État rapporté par status().
+  wl_status_t status() {return Etat;}
+};
+
+inline WiFiClass WiFi;
+
+/**
+ * @class WiFiClient
+ * @brief Liaison TCP sur une socket POSIX. La socket n'est fermée que par stop().
+ */
+class WiFiClient : public Client {
+ public:
+  WiFiClient() {}
+  /// @brief Socket connectée par l'appelant ; Nagle désactivé comme dans ouvre() : le serveur de test, appelé
+  /// dans le même fil, n'acquitte pas à temps et les segments suivants resteraient dans la socket
+  explicit WiFiClient(int fd) : Fd(fd) {
+    int un = 1;
+    if (Fd >= 0) {setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &un, sizeof(un));}
+  }
+
+  int connect(IPAddress ip, uint16_t port) override {
+    struct sockaddr_in adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sin_family = AF_INET;
+    adresse.sin_addr.s_addr = (uint32_t)ip;
+    adresse.sin_port = htons(port);
+    return ouvre((struct sockaddr *)&adresse, sizeof(adresse));
+  }
+
+  int connect(const char *hote, uint16_t port) override {
+    struct addrinfo indices, *resultat;
+    memset(&indices, 0, sizeof(indices));
+    indices.ai_family = AF_INET;
+    indices.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(hote, NULL, &indices, &resultat) != 0) {return 0;}
+    struct sockaddr_in adresse = *(struct sockaddr_in *)resultat->ai_addr;
+    freeaddrinfo(resultat);
+    adresse.sin_port = htons(port);
+    return ouvre((struct sockaddr *)&adresse, sizeof(adresse));
+  }
+
+  size_t write(uint8_t octet) override {return write(&octet, 1);}
+
+  /// @brief Émission complète, en attendant la socket au plus 5 s comme WiFiClient
+  size_t write(const uint8_t *tampon, size_t taille) override {
+    size_t ecrit = 0;
+    while (Fd >= 0 && ecrit < taille) {
+      ssize_t r = send(Fd, tampon + ecrit, taille - ecrit, MSG_NOSIGNAL | MSG_DONTWAIT);
+      if (r > 0) {
+        ecrit += r;
+        continue;
+      }
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        struct pollfd attente = {Fd, POLLOUT, 0};
+        if (poll(&attente, 1, 5000) > 0) {continue;}
+      }
+      stop();
+    }
+    return ecrit;
+  }
+
+  int fd() const {return Fd;}
+
+  int available() override {
+    if (Fd < 0) {return 0;}
+    int n = 0;
+    if (ioctl(Fd, FIONREAD, &n) < 0) {return 0;}
+    return n;
+  }
+
+  int read() override {
+    uint8_t octet;
+    return (read(&octet, 1) == 1) ? octet : -1;
+  }
+
+  int read(uint8_t *tampon, size_t taille) override {
+    if (Fd < 0) {return -1;}
+    ssize_t r = recv(Fd, tampon, taille, MSG_DONTWAIT);
+    return (r > 0) ? (int)r : -1;
+  }
+
+  int peek() override {
+    uint8_t octet;
+    if (Fd < 0 || recv(Fd, &octet, 1, MSG_PEEK | MSG_DONTWAIT) != 1) {return -1;}
+    return octet;
+  }
+
+  void flush() override {}
+
+  void stop() override {
+    if (Fd >= 0) {close(Fd);}
+    Fd = -1;
+  }
+
+  /// @brief Liaison ouverte : la fermeture par le pair est détectée sans attendre
+  uint8_t connected() override {
+    if (Fd < 0) {return 0;}
+    uint8_t octet;
+    ssize_t r = recv(Fd, &octet, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (r == 0 || (r < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      stop();
+      return 0;
+    }
+    return 1;
+  }
+
+  operator bool() override {return connected();}
+  using Print::write;
+
+ private:
+  int ouvre(struct sockaddr *adresse, socklen_t taille) {
+    stop();
+    Fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (Fd < 0) {return 0;}
+    if (::connect(Fd, adresse, taille) < 0) {
+      stop();
+      return 0;
+    }
+    int un = 1;
+    setsockopt(Fd, IPPROTO_TCP, TCP_NODELAY, &un, sizeof(un));
+    return 1;
+  }
+
+  int Fd = -1;                       ///< Socket TCP, -1 si fermée.
+};
@@ -0,0 +1,11 @@
+/**
+ * @file esp_timer.h
+ * @brief Cale hôte d'esp_timer pour les tests natifs : horloge en µs de Arduino.h.
+ */
+
+#pragma once
+
+#include <Arduino.h>
+
+/// @brief Temps écoulé en µs, sur la même horloge que micros()
+inline int64_t esp_timer_get_time() {return (int64_t)horloge_hote_us();}
@@ -0,0 +1,52 @@
+/**
+ * @file dns.h
+ * @brief Cale hôte du résolveur DNS de lwIP pour les tests natifs.
+ *
+ * dns_gethostbyname résout par getaddrinfo : une adresse trouvée est rendue immédiatement (ERR_OK, comme
+ * un nom en cache sur l'ESP32) ; un nom inconnu est signalé par l'appel du rappel sans adresse,
+ * puis ERR_INPROGRESS, comme une réponse négative du serveur DNS.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+typedef struct {
+  uint32_t addr;                     ///< Adresse IPv4 (ordre réseau).
+} ip4_addr_t;
+
+typedef struct {
+  union {
+    ip4_addr_t ip4;
+  } u_addr;
+  uint8_t type;
+} ip_addr_t;
+
+#define ip_2_ip4(ipaddr) (&((ipaddr)->u_addr.ip4))
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+inline err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg) {
+  if (hostname == NULL || addr == NULL) {return ERR_ARG;}
+  struct addrinfo indices, *resultat;
+  memset(&indices, 0, sizeof(indices));
+  indices.ai_family = AF_INET;
+  if (getaddrinfo(hostname, NULL, &indices, &resultat) != 0) {
+    if (found != NULL) {found(hostname, NULL, callback_arg);}
+    return ERR_INPROGRESS;
+  }
+  addr->type = 0;
+  addr->u_addr.ip4.addr = ((struct sockaddr_in *)resultat->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(resultat);
+  return ERR_OK;
+}
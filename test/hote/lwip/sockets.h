@@ -0,0 +1,15 @@
+/**
+ * @file sockets.h
+ * @brief Cale hôte de lwip/sockets.h pour les tests natifs : l'API socket de lwIP est celle de POSIX.
+ */
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
@@ -0,0 +1,461 @@
+/**
+ * @file test_main.cpp
+ * @brief Tests natifs du client MQTT 3.1.1 / 5 (src/client_mqtt.cpp).
+ *
+ * Le client est branché sur une liaison de test qui enregistre les octets émis et délivre les octets
+ * préparés par le test, par morceaux de taille choisie : codage du CONNECT dans les deux versions,
+ * lecture du CONNACK et de ses propriétés, attribution et réemploi des alias de topic, taille exacte
+ * d'un PUBLISH annoncée par taille_publish, propriétés Response Topic / Correlation Data reçues et
+ * émises, message trop grand, maintien de session.
+ *
+ * Le dernier test vise un vrai serveur mosquitto en MQTT 5 (protocol_version 5) : il n'est exécuté que si
+ * MQTT_TEST_SERVEUR donne son adresse (hôte:port), par exemple avec tools/mosquitto_v5.conf :
+ *   mosquitto -c tools/mosquitto_v5.conf &
+ *   MQTT_TEST_SERVEUR=127.0.0.1:1883 pio test -e native -f test_client_mqtt
+ *
+ * Exécution : pio test -e native -f test_client_mqtt
+ */
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "client_mqtt.h"
+
+/**
+ * @class Liaison_Test
+ * @brief Liaison en mémoire : octets émis enregistrés, octets reçus délivrés par morceaux de Morceau octets.
+ */
+class Liaison_Test : public Client {
+ public:
+  std::vector<uint8_t> Emis;         ///< Octets émis par le client.
+  std::vector<uint8_t> Recu;         ///< Octets à délivrer au client.
+  size_t Position = 0;               ///< Prochain octet à délivrer.
+  size_t Morceau = 4096;             ///< Octets délivrés au plus par lecture.
+  bool Connecte = true;              ///< Liaison ouverte.
+
+  int connect(IPAddress, uint16_t) override {return 1;}
+  int connect(const char *, uint16_t) override {return 1;}
+  size_t write(uint8_t octet) override {return write(&octet, 1);}
+  size_t write(const uint8_t *tampon, size_t taille) override {
+    if (!Connecte) {return 0;}
+    Emis.insert(Emis.end(), tampon, tampon + taille);
+    return taille;
+  }
+  int available() override {
+    size_t reste = Recu.size() - Position;
+    return (int)((reste < Morceau) ? reste : Morceau);
+  }
+  int read() override {return (Position < Recu.size()) ? Recu[Position++] : -1;}
+  int read(uint8_t *tampon, size_t taille) override {
+    size_t n = available();
+    if (n > taille) {n = taille;}
+    if (n == 0) {return -1;}
+    memcpy(tampon, Recu.data() + Position, n);
+    Position += n;
+    return (int)n;
+  }
+  int peek() override {return (Position < Recu.size()) ? Recu[Position] : -1;}
+  void flush() override {}
+  void stop() override {Connecte = false;}
+  uint8_t connected() override {return Connecte ? 1 : 0;}
+  operator bool() override {return Connecte;}
+  using Print::write;
+
+  void recoit(const std::vector<uint8_t> &octets) {Recu.insert(Recu.end(), octets.begin(), octets.end());}
+};
+
+Liaison_Test Liaison;
+ClientMQTT Client_test(Liaison);
+
+/// @brief Dernier message remis au rappel et ses propriétés
+struct Struct_Recu {
+  int Nb = 0;
+  std::string Topic;
+  std::string Message;
+  std::string Topic_reponse;
+  std::string Correlation;
+  bool Avec_correlation = false;
+};
+
+Struct_Recu Recu;
+
+void rappel_test(char *topic, uint8_t *message, unsigned int taille) {
+  const Struct_Proprietes_MQTT *proprietes = Client_test.proprietes_recues();
+  Recu.Nb++;
+  Recu.Topic = topic;
+  Recu.Message.assign((const char *)message, taille);
+  Recu.Topic_reponse = (proprietes->Topic_reponse != NULL) ? proprietes->Topic_reponse : "";
+  Recu.Avec_correlation = (proprietes->Correlation != NULL);
+  Recu.Correlation = Recu.Avec_correlation ? std::string((const char *)proprietes->Correlation, proprietes->Taille_correlation) : "";
+}
+
+/// @brief Ajout d'une chaîne précédée de sa longueur sur 2 octets
+void ajoute_chaine(std::vector<uint8_t> &paquet, const std::string &chaine) {
+  paquet.push_back(chaine.size() >> 8);
+  paquet.push_back(chaine.size() & 0xFF);
+  paquet.insert(paquet.end(), chaine.begin(), chaine.end());
+}
+
+/// @brief Paquet complet : premier octet, longueur restante (entier variable) et contenu
+std::vector<uint8_t> paquet(uint8_t type, const std::vector<uint8_t> &contenu) {
+  std::vector<uint8_t> octets = {type};
+  size_t longueur = contenu.size();
+  do {
+    uint8_t octet = longueur & 0x7F;
+    longueur >>= 7;
+    octets.push_back(octet | (longueur ? 0x80 : 0));
+  } while (longueur);
+  octets.insert(octets.end(), contenu.begin(), contenu.end());
+  return octets;
+}
+
+/// @brief Session ouverte en MQTT 5 avec un CONNACK portant les propriétés données
+void ouvre_session_v5(const std::vector<uint8_t> &proprietes) {
+  Client_test.setVersion(MQTT_VERSION_5);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("passerelle", NULL, NULL, NULL, 0, false, NULL, false, 3600));
+  TEST_ASSERT_EQUAL_INT(0, Client_test.poursuit_session());
+  std::vector<uint8_t> contenu = {0x00, 0x00, (uint8_t)proprietes.size()};
+  contenu.insert(contenu.end(), proprietes.begin(), proprietes.end());
+  Liaison.recoit(paquet(0x20, contenu));
+  TEST_ASSERT_EQUAL_INT(1, Client_test.poursuit_session());
+  Liaison.Emis.clear();
+}
+
+/// @brief Publication d'un message texte : vérifie que taille_publish annonce exactement les octets émis
+size_t publie_et_mesure(const char *topic, const char *message, const Struct_Proprietes_MQTT *proprietes, size_t *octets_topic) {
+  size_t annonce = Client_test.taille_publish(topic, strlen(message), proprietes, octets_topic);
+  size_t avant = Liaison.Emis.size();
+  if (!Client_test.publish(topic, message, false, proprietes)) {return 0;}
+  return (Liaison.Emis.size() - avant == annonce) ? annonce : 0;
+}
+
+void setUp(void) {
+  Liaison.Emis.clear();
+  Liaison.Recu.clear();
+  Liaison.Position = 0;
+  Liaison.Morceau = 4096;
+  Liaison.Connecte = true;
+  Recu = Struct_Recu();
+  Decalage_horloge_hote_ms = 0;
+  Client_test.setCallback(rappel_test);
+  Client_test.setBufferSize(512);
+  Client_test.setKeepAlive(15);
+}
+
+void tearDown(void) {}
+
+void test_connect_v5(void) {
+  Client_test.setVersion(MQTT_VERSION_5);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("id", "u", "p", "t", 1, true, "off", false, 3600));
+  std::vector<uint8_t> contenu;
+  ajoute_chaine(contenu, "MQTT");
+  contenu.insert(contenu.end(), {0x05, 0xEC, 0x00, 0x0F});
+  // Propriétés : Session Expiry Interval 3600, Maximum Packet Size 512
+  contenu.insert(contenu.end(), {0x0A, 0x11, 0x00, 0x00, 0x0E, 0x10, 0x27, 0x00, 0x00, 0x02, 0x00});
+  ajoute_chaine(contenu, "id");
+  contenu.push_back(0x00);
+  ajoute_chaine(contenu, "t");
+  ajoute_chaine(contenu, "off");
+  ajoute_chaine(contenu, "u");
+  ajoute_chaine(contenu, "p");
+  std::vector<uint8_t> attendu = paquet(0x10, contenu);
+  TEST_ASSERT_EQUAL_size_t(attendu.size(), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(attendu.data(), Liaison.Emis.data(), attendu.size());
+  TEST_ASSERT_EQUAL_INT(CLIENT_MQTT_EN_COURS, Client_test.state());
+  TEST_ASSERT_FALSE(Client_test.connected());
+}
+
+void test_connect_3_1_1(void) {
+  Client_test.setVersion(MQTT_VERSION_3_1_1);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("id", NULL, NULL, "t", 1, true, "off", false, 3600));
+  std::vector<uint8_t> contenu;
+  ajoute_chaine(contenu, "MQTT");
+  contenu.insert(contenu.end(), {0x04, 0x2C, 0x00, 0x0F});
+  ajoute_chaine(contenu, "id");
+  ajoute_chaine(contenu, "t");
+  ajoute_chaine(contenu, "off");
+  std::vector<uint8_t> attendu = paquet(0x10, contenu);
+  TEST_ASSERT_EQUAL_size_t(attendu.size(), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(attendu.data(), Liaison.Emis.data(), attendu.size());
+
+  Liaison.recoit({0x20, 0x02, 0x00, 0x00});
+  TEST_ASSERT_EQUAL_INT(1, Client_test.poursuit_session());
+  TEST_ASSERT_TRUE(Client_test.connected());
+}
+
+void test_connack_refus(void) {
+  Client_test.setVersion(MQTT_VERSION_5);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("id", NULL, NULL, NULL, 0, false, NULL, false, 0));
+  // CONNACK reçu octet par octet : Not authorized (0x87)
+  Liaison.Morceau = 1;
+  Liaison.recoit({0x20, 0x03, 0x00, 0x87, 0x00});
+  int resultat = 0;
+  for (int i = 0; i < 10 && resultat == 0; i++) {resultat = Client_test.poursuit_session();}
+  TEST_ASSERT_EQUAL_INT(-1, resultat);
+  TEST_ASSERT_EQUAL_INT(0x87, Client_test.state());
+  TEST_ASSERT_FALSE(Liaison.Connecte);
+}
+
+void test_alias_de_topic(void) {
+  // Topic Alias Maximum 2, Server Keep Alive 30 s, propriété inconnue du client sautée (Assigned Client Identifier)
+  ouvre_session_v5({0x22, 0x00, 0x02, 0x13, 0x00, 0x1E, 0x12, 0x00, 0x01, 'x'});
+  TEST_ASSERT_EQUAL_INT(2, Client_test.Alias_max);
+
+  size_t octets_topic;
+  // Première publication : topic et nouvel alias 1
+  TEST_ASSERT_EQUAL_size_t(2 + 2 + 3 + 4 + 2, publie_et_mesure("a/b", "42", NULL, &octets_topic));
+  TEST_ASSERT_EQUAL_size_t(3, octets_topic);
+  const uint8_t premier[] = {0x30, 0x0B, 0x00, 0x03, 'a', '/', 'b', 0x03, 0x23, 0x00, 0x01, '4', '2'};
+  TEST_ASSERT_EQUAL_MEMORY(premier, Liaison.Emis.data(), sizeof(premier));
+  Liaison.Emis.clear();
+
+  // Même topic : topic vide et alias 1
+  TEST_ASSERT_EQUAL_size_t(2 + 2 + 4 + 2, publie_et_mesure("a/b", "43", NULL, &octets_topic));
+  TEST_ASSERT_EQUAL_size_t(0, octets_topic);
+  const uint8_t second[] = {0x30, 0x08, 0x00, 0x00, 0x03, 0x23, 0x00, 0x01, '4', '3'};
+  TEST_ASSERT_EQUAL_MEMORY(second, Liaison.Emis.data(), sizeof(second));
+  TEST_ASSERT_EQUAL_UINT32(1, Client_test.Publications_alias);
+  TEST_ASSERT_EQUAL_UINT32(3, Client_test.Octets_topics_evites);
+
+  // Deuxième topic : alias 2 ; troisième topic : table pleine, topic complet sans alias
+  TEST_ASSERT_NOT_EQUAL(0, publie_et_mesure("c/d", "1", NULL, &octets_topic));
+  TEST_ASSERT_EQUAL_INT(2, Client_test.Nb_alias);
+  Liaison.Emis.clear();
+  TEST_ASSERT_EQUAL_size_t(2 + 2 + 3 + 1 + 1, publie_et_mesure("e/f", "1", NULL, &octets_topic));
+  const uint8_t sans_alias[] = {0x30, 0x07, 0x00, 0x03, 'e', '/', 'f', 0x00, '1'};
+  TEST_ASSERT_EQUAL_MEMORY(sans_alias, Liaison.Emis.data(), sizeof(sans_alias));
+  TEST_ASSERT_EQUAL_INT(2, Client_test.Nb_alias);
+
+  // Nouvelle session : la table des alias repart de zéro
+  ouvre_session_v5({0x22, 0x00, 0x02});
+  TEST_ASSERT_EQUAL_INT(0, Client_test.Nb_alias);
+  TEST_ASSERT_NOT_EQUAL(0, publie_et_mesure("a/b", "42", NULL, &octets_topic));
+  TEST_ASSERT_EQUAL_size_t(3, octets_topic);
+}
+
+void test_sans_alias_autorise(void) {
+  // Pas de Topic Alias Maximum dans le CONNACK : aucun alias
+  ouvre_session_v5({});
+  size_t octets_topic;
+  publie_et_mesure("a/b", "1", NULL, &octets_topic);
+  TEST_ASSERT_EQUAL_size_t(3, publie_et_mesure("a/b", "1", NULL, &octets_topic) - 6);
+  TEST_ASSERT_EQUAL_size_t(3, octets_topic);
+  TEST_ASSERT_EQUAL_INT(0, Client_test.Nb_alias);
+}
+
+void test_correlation_emise(void) {
+  ouvre_session_v5({});
+  const uint8_t correlation[] = {0x01, 0x00, 0xFF};
+  Struct_Proprietes_MQTT proprietes;
+  proprietes.Correlation = correlation;
+  proprietes.Taille_correlation = sizeof(correlation);
+  size_t octets_topic;
+  TEST_ASSERT_NOT_EQUAL(0, publie_et_mesure("r", "ok", &proprietes, &octets_topic));
+  const uint8_t attendu[] = {0x30, 0x0C, 0x00, 0x01, 'r', 0x06, 0x09, 0x00, 0x03, 0x01, 0x00, 0xFF, 'o', 'k'};
+  TEST_ASSERT_EQUAL_size_t(sizeof(attendu), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(attendu, Liaison.Emis.data(), sizeof(attendu));
+}
+
+void test_proprietes_ignorees_en_3_1_1(void) {
+  Client_test.setVersion(MQTT_VERSION_3_1_1);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("id", NULL, NULL, NULL, 0, false, NULL, false, 0));
+  Liaison.recoit({0x20, 0x02, 0x00, 0x00});
+  TEST_ASSERT_EQUAL_INT(1, Client_test.poursuit_session());
+  Liaison.Emis.clear();
+  const uint8_t correlation[] = {'c'};
+  Struct_Proprietes_MQTT proprietes;
+  proprietes.Correlation = correlation;
+  proprietes.Taille_correlation = 1;
+  size_t octets_topic;
+  TEST_ASSERT_NOT_EQUAL(0, publie_et_mesure("r", "ok", &proprietes, &octets_topic));
+  const uint8_t attendu[] = {0x30, 0x05, 0x00, 0x01, 'r', 'o', 'k'};
+  TEST_ASSERT_EQUAL_size_t(sizeof(attendu), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(attendu, Liaison.Emis.data(), sizeof(attendu));
+}
+
+void test_reception_proprietes(void) {
+  ouvre_session_v5({});
+  // PUBLISH QoS 1, identifiant 0x1234 : Payload Format Indicator, Response Topic "rep/1", Correlation Data "c-7"
+  std::vector<uint8_t> contenu;
+  ajoute_chaine(contenu, "cmd/GPIO_OUT");
+  contenu.insert(contenu.end(), {0x12, 0x34});
+  std::vector<uint8_t> proprietes = {0x01, 0x01, 0x08};
+  ajoute_chaine(proprietes, "rep/1");
+  proprietes.push_back(0x09);
+  ajoute_chaine(proprietes, "c-7");
+  contenu.push_back((uint8_t)proprietes.size());
+  contenu.insert(contenu.end(), proprietes.begin(), proprietes.end());
+  const char *message = "{\"num_port\":1,\"val_port\":1}";
+  contenu.insert(contenu.end(), message, message + strlen(message));
+  Liaison.recoit(paquet(0x32, contenu));
+
+  // Délivré par morceaux de 3 octets : le paquet est assemblé au fil des appels
+  Liaison.Morceau = 3;
+  for (int i = 0; i < 100 && Recu.Nb == 0; i++) {TEST_ASSERT_TRUE(Client_test.loop());}
+  TEST_ASSERT_EQUAL_INT(1, Recu.Nb);
+  TEST_ASSERT_EQUAL_STRING("cmd/GPIO_OUT", Recu.Topic.c_str());
+  TEST_ASSERT_EQUAL_STRING(message, Recu.Message.c_str());
+  TEST_ASSERT_EQUAL_STRING("rep/1", Recu.Topic_reponse.c_str());
+  TEST_ASSERT_TRUE(Recu.Avec_correlation);
+  TEST_ASSERT_EQUAL_STRING("c-7", Recu.Correlation.c_str());
+  // Propriétés effacées hors du rappel
+  TEST_ASSERT_NULL(Client_test.proprietes_recues()->Topic_reponse);
+
+  const uint8_t puback[] = {0x40, 0x02, 0x12, 0x34};
+  TEST_ASSERT_EQUAL_size_t(sizeof(puback), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(puback, Liaison.Emis.data(), sizeof(puback));
+}
+
+void test_message_trop_grand(void) {
+  Client_test.setBufferSize(64);
+  Client_test.setVersion(MQTT_VERSION_3_1_1);
+  TEST_ASSERT_TRUE(Client_test.demarre_session("id", NULL, NULL, NULL, 0, false, NULL, false, 0));
+  Liaison.recoit({0x20, 0x02, 0x00, 0x00});
+  TEST_ASSERT_EQUAL_INT(1, Client_test.poursuit_session());
+  Liaison.Emis.clear();
+
+  std::vector<uint8_t> contenu;
+  ajoute_chaine(contenu, "cmd/Lot");
+  contenu.insert(contenu.end(), {0x00, 0x07});
+  contenu.insert(contenu.end(), 200, 'x');
+  Liaison.recoit(paquet(0x32, contenu));
+  // Suivi d'un message valide, remis normalement
+  std::vector<uint8_t> suivant;
+  ajoute_chaine(suivant, "cmd/a");
+  suivant.push_back('1');
+  Liaison.recoit(paquet(0x30, suivant));
+
+  for (int i = 0; i < 100 && Recu.Nb == 0; i++) {Client_test.loop();}
+  TEST_ASSERT_EQUAL_UINT32(1, Client_test.Paquets_ecartes);
+  TEST_ASSERT_EQUAL_INT(1, Recu.Nb);
+  TEST_ASSERT_EQUAL_STRING("cmd/a", Recu.Topic.c_str());
+  const uint8_t puback[] = {0x40, 0x02, 0x00, 0x07};
+  TEST_ASSERT_EQUAL_size_t(sizeof(puback), Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(puback, Liaison.Emis.data(), sizeof(puback));
+}
+
+void test_maintien_de_session(void) {
+  Client_test.setKeepAlive(1);
+  ouvre_session_v5({});
+  TEST_ASSERT_TRUE(Client_test.loop());
+  TEST_ASSERT_EQUAL_size_t(0, Liaison.Emis.size());
+
+  Decalage_horloge_hote_ms += 1000;
+  TEST_ASSERT_TRUE(Client_test.loop());
+  const uint8_t ping[] = {0xC0, 0x00};
+  TEST_ASSERT_EQUAL_size_t(2, Liaison.Emis.size());
+  TEST_ASSERT_EQUAL_MEMORY(ping, Liaison.Emis.data(), 2);
+
+  // PINGRESP reçu : la session reste ouverte
+  Liaison.recoit({0xD0, 0x00});
+  TEST_ASSERT_TRUE(Client_test.loop());
+  Decalage_horloge_hote_ms += 1000;
+  TEST_ASSERT_TRUE(Client_test.loop());
+  TEST_ASSERT_EQUAL_size_t(4, Liaison.Emis.size());
+
+  // Pas de réponse pendant un intervalle de maintien : session fermée
+  Decalage_horloge_hote_ms += 1000;
+  TEST_ASSERT_FALSE(Client_test.loop());
+  TEST_ASSERT_EQUAL_INT(CLIENT_MQTT_DELAI_DEPASSE, Client_test.state());
+}
+
+/// @brief Messages reçus par l'abonné du test mosquitto
+std::vector<Struct_Recu> Recus_serveur;
+ClientMQTT *Abonne_serveur = NULL;
+
+void rappel_serveur(char *topic, uint8_t *message, unsigned int taille) {
+  const Struct_Proprietes_MQTT *proprietes = Abonne_serveur->proprietes_recues();
+  Struct_Recu recu;
+  recu.Topic = topic;
+  recu.Message.assign((const char *)message, taille);
+  recu.Topic_reponse = (proprietes->Topic_reponse != NULL) ? proprietes->Topic_reponse : "";
+  recu.Avec_correlation = (proprietes->Correlation != NULL);
+  if (recu.Avec_correlation) {recu.Correlation.assign((const char *)proprietes->Correlation, proprietes->Taille_correlation);}
+  Recus_serveur.push_back(recu);
+}
+
+/// @brief Ouverture d'une session MQTT 5 sur le serveur de test
+bool ouvre_session_serveur(ClientMQTT &client, const char *id) {
+  if (!client.demarre_session(id, NULL, NULL, NULL, 0, false, NULL, true, 0)) {return false;}
+  unsigned long debut = millis();
+  int resultat;
+  while ((resultat = client.poursuit_session()) == 0 && millis() - debut < 2000) {delay(1);}
+  return resultat == 1;
+}
+
+void test_serveur_mosquitto_v5(void) {
+  const char *serveur = getenv("MQTT_TEST_SERVEUR");
+  if (serveur == NULL) {TEST_IGNORE_MESSAGE("MQTT_TEST_SERVEUR non défini (hote:port d'un mosquitto en MQTT 5)");}
+  char hote[64];
+  int port = 1883;
+  if (sscanf(serveur, "%63[^:]:%d", hote, &port) < 1) {TEST_FAIL_MESSAGE("MQTT_TEST_SERVEUR invalide");}
+
+  WiFiClient liaison_abonne, liaison_editeur;
+  ClientMQTT abonne(liaison_abonne), editeur(liaison_editeur);
+  Abonne_serveur = &abonne;
+  Recus_serveur.clear();
+  abonne.setCallback(rappel_serveur);
+  abonne.setBufferSize(512);
+  editeur.setBufferSize(512);
+  TEST_ASSERT_TRUE(liaison_abonne.connect(hote, port));
+  TEST_ASSERT_TRUE(liaison_editeur.connect(hote, port));
+  TEST_ASSERT_TRUE(ouvre_session_serveur(abonne, "test_client_mqtt_abonne"));
+  TEST_ASSERT_TRUE(ouvre_session_serveur(editeur, "test_client_mqtt_editeur"));
+  TEST_ASSERT_TRUE(abonne.subscribe("test_client_mqtt/#", 1));
+  // Laisse le serveur traiter la souscription (SUBACK)
+  for (int i = 0; i < 100; i++) {
+    abonne.loop();
+    delay(2);
+  }
+
+  const uint8_t correlation[] = {'c', 0x00, 0x01};
+  Struct_Proprietes_MQTT proprietes;
+  proprietes.Topic_reponse = "test_client_mqtt_reponse";
+  proprietes.Correlation = correlation;
+  proprietes.Taille_correlation = sizeof(correlation);
+  TEST_ASSERT_TRUE(editeur.publish("test_client_mqtt/etat", "1", false, &proprietes));
+  TEST_ASSERT_TRUE(editeur.publish("test_client_mqtt/etat", "2", false, &proprietes));
+  TEST_ASSERT_TRUE(editeur.publish("test_client_mqtt/etat", "3", false, NULL));
+
+  unsigned long debut = millis();
+  while (Recus_serveur.size() < 3 && millis() - debut < 2000) {
+    abonne.loop();
+    editeur.loop();
+    delay(1);
+  }
+  TEST_ASSERT_EQUAL_size_t(3, Recus_serveur.size());
+  // Le serveur a résolu l'alias : l'abonné reçoit le topic complet à chaque message
+  for (size_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL_STRING("test_client_mqtt/etat", Recus_serveur[i].Topic.c_str());
+    TEST_ASSERT_EQUAL_INT((int)('1' + i), Recus_serveur[i].Message[0]);
+  }
+  TEST_ASSERT_EQUAL_STRING("test_client_mqtt_reponse", Recus_serveur[1].Topic_reponse.c_str());
+  TEST_ASSERT_TRUE(Recus_serveur[1].Avec_correlation);
+  TEST_ASSERT_EQUAL_size_t(sizeof(correlation), Recus_serveur[1].Correlation.size());
+  TEST_ASSERT_EQUAL_MEMORY(correlation, Recus_serveur[1].Correlation.data(), sizeof(correlation));
+  TEST_ASSERT_FALSE(Recus_serveur[2].Avec_correlation);
+  // mosquitto annonce un Topic Alias Maximum (max_topic_alias, 10 par défaut) : les publications 2 et 3 partent par alias
+  TEST_ASSERT_GREATER_THAN(0, editeur.Alias_max);
+  TEST_ASSERT_EQUAL_UINT32(2, editeur.Publications_alias);
+
+  editeur.disconnect();
+  abonne.disconnect();
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_v5);
+  RUN_TEST(test_connect_3_1_1);
+  RUN_TEST(test_connack_refus);
+  RUN_TEST(test_alias_de_topic);
+  RUN_TEST(test_sans_alias_autorise);
+  RUN_TEST(test_correlation_emise);
+  RUN_TEST(test_proprietes_ignorees_en_3_1_1);
+  RUN_TEST(test_reception_proprietes);
+  RUN_TEST(test_message_trop_grand);
+  RUN_TEST(test_maintien_de_session);
+  RUN_TEST(test_serveur_mosquitto_v5);
+  return UNITY_END();
+}
@@ -0,0 +1,293 @@
+/**
+ * @file courtier_hote.cpp
+ * @brief Serveur MQTT minimal du banc natif (voir courtier_hote.h).
+ */
+
+#include <Arduino.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "courtier_hote.h"
+
+/// @brief Ajout d'une chaîne précédée de sa longueur sur 2 octets
+static void ajoute_chaine(std::vector<uint8_t> &paquet, const std::string &chaine) {
+  paquet.push_back(chaine.size() >> 8);
+  paquet.push_back(chaine.size() & 0xFF);
+  paquet.insert(paquet.end(), chaine.begin(), chaine.end());
+}
+
+/// @brief Paquet complet : premier octet, longueur restante (entier variable) et contenu
+static std::vector<uint8_t> paquet(uint8_t type, const std::vector<uint8_t> &contenu) {
+  std::vector<uint8_t> octets = {type};
+  size_t longueur = contenu.size();
+  do {
+    uint8_t octet = longueur & 0x7F;
+    longueur >>= 7;
+    octets.push_back(octet | (longueur ? 0x80 : 0));
+  } while (longueur);
+  octets.insert(octets.end(), contenu.begin(), contenu.end());
+  return octets;
+}
+
+/// @brief Lecture d'un entier variable ; false s'il dépasse la fin du tampon
+static bool lit_longueur(const uint8_t *p, size_t n, size_t *position, size_t *valeur) {
+  *valeur = 0;
+  for (int i = 0; i < 4; i++) {
+    if (*position >= n) {return false;}
+    uint8_t octet = p[(*position)++];
+    *valeur |= (size_t)(octet & 0x7F) << (7 * i);
+    if (!(octet & 0x80)) {return true;}
+  }
+  return false;
+}
+
+/// @brief Lecture d'une chaîne précédée de sa longueur ; false si elle dépasse la fin du tampon
+static bool lit_chaine(const uint8_t *p, size_t n, size_t *position, std::string *chaine) {
+  if (*position + 2 > n) {return false;}
+  size_t taille = ((size_t)p[*position] << 8) | p[*position + 1];
+  *position += 2;
+  if (*position + taille > n) {return false;}
+  chaine->assign((const char *)p + *position, taille);
+  *position += taille;
+  return true;
+}
+
+bool Courtier_Hote::demarre() {
+  Ecoute = socket(AF_INET, SOCK_STREAM, 0);
+  if (Ecoute < 0) {return false;}
+  int un = 1;
+  setsockopt(Ecoute, SOL_SOCKET, SO_REUSEADDR, &un, sizeof(un));
+  struct sockaddr_in adresse;
+  memset(&adresse, 0, sizeof(adresse));
+  adresse.sin_family = AF_INET;
+  adresse.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  adresse.sin_port = htons(Port);
+  socklen_t taille = sizeof(adresse);
+  if (bind(Ecoute, (struct sockaddr *)&adresse, taille) < 0 || listen(Ecoute, 1) < 0
+      || getsockname(Ecoute, (struct sockaddr *)&adresse, &taille) < 0) {
+    close(Ecoute);
+    Ecoute = -1;
+    return false;
+  }
+  Port = ntohs(adresse.sin_port);
+  fcntl(Ecoute, F_SETFL, fcntl(Ecoute, F_GETFL, 0) | O_NONBLOCK);
+  return true;
+}
+
+void Courtier_Hote::arrete() {
+  ferme_client();
+  if (Ecoute >= 0) {close(Ecoute);}
+  Ecoute = -1;
+}
+
+void Courtier_Hote::ferme_client() {
+  if (Client >= 0) {close(Client);}
+  Client = -1;
+  Session = false;
+  Entree.clear();
+  Alias.clear();
+}
+
+void Courtier_Hote::remet_compteurs() {
+  Publications = 0;
+  Octets = 0;
+  Octets_topics = 0;
+  Invalides = 0;
+  Messages.clear();
+}
+
+void Courtier_Hote::envoie(const std::vector<uint8_t> &octets) {
+  if (Client < 0) {return;}
+  if (send(Client, octets.data(), octets.size(), MSG_NOSIGNAL) != (ssize_t)octets.size()) {ferme_client();}
+}
+
+/**
+ * @brief Acceptation du client, lecture de tout ce qu'il a émis et traitement des paquets complets.
+ */
+void Courtier_Hote::service() {
+  if (Ecoute >= 0 && Client < 0) {
+    Client = accept(Ecoute, NULL, NULL);
+    if (Client < 0) {return;}
+    fcntl(Client, F_SETFL, fcntl(Client, F_GETFL, 0) | O_NONBLOCK);
+  }
+  if (Client < 0) {return;}
+
+  uint8_t tampon[4096];
+  for (;;) {
+    ssize_t r = recv(Client, tampon, sizeof(tampon), 0);
+    if (r > 0) {
+      Entree.append((const char *)tampon, r);
+      continue;
+    }
+    if (r == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+      ferme_client();
+      return;
+    }
+    break;
+  }
+
+  for (;;) {
+    const uint8_t *p = (const uint8_t *)Entree.data();
+    size_t position = 1;
+    size_t restant;
+    if (Entree.size() < 2 || !lit_longueur(p, Entree.size(), &position, &restant)) {return;}
+    if (position + restant > Entree.size()) {return;}
+    size_t octets = position + restant;
+    traite(p[0], p + position, restant, octets);
+    if (Client < 0) {return;}
+    Entree.erase(0, octets);
+  }
+}
+
+/**
+ * @brief Traitement d'un paquet complet du client.
+ *
+ * @param type Premier octet (type et drapeaux).
+ * @param p Contenu après la longueur restante.
+ * @param n Longueur restante.
+ * @param octets Taille du paquet complet sur la liaison.
+ */
+void Courtier_Hote::traite(uint8_t type, const uint8_t *p, size_t n, size_t octets) {
+  size_t position = 0;
+  switch (type & 0xF0) {
+    case 0x10: {
+      // CONNECT : nom du protocole, version, drapeaux, maintien, propriétés (MQTT 5) ; la charge n'est pas lue
+      std::string protocole;
+      if (!lit_chaine(p, n, &position, &protocole) || position + 4 > n) {Invalides++; ferme_client(); return;}
+      Version = p[position];
+      Alias.clear();
+      Session = true;
+      Connexions++;
+      if (Version == 5) {
+        envoie(paquet(0x20, {0x00, 0x00, 0x03, 0x22, (uint8_t)(Alias_max >> 8), (uint8_t)Alias_max}));
+      }
+      else {
+        envoie(paquet(0x20, {0x00, 0x00}));
+      }
+      return;
+    }
+
+    case 0x30: {
+      Struct_Message_Hote message;
+      uint8_t qos = (type >> 1) & 0x03;
+      message.Retenu = (type & 0x01) != 0;
+      message.Octets = octets;
+      message.Reception_us = horloge_hote_us();
+      if (!lit_chaine(p, n, &position, &message.Topic)) {Invalides++; return;}
+      Octets_topics += message.Topic.size();
+      if (qos > 0) {position += 2;}
+      if (Version == 5) {
+        size_t taille_proprietes;
+        if (!lit_longueur(p, n, &position, &taille_proprietes) || position + taille_proprietes > n) {Invalides++; return;}
+        size_t fin = position + taille_proprietes;
+        int alias = 0;
+        while (position < fin) {
+          uint8_t id = p[position++];
+          std::string chaine;
+          size_t valeur;
+          switch (id) {
+            case 0x01: position += 1; break;
+            case 0x02: position += 4; break;
+            case 0x23: alias = (p[position] << 8) | p[position + 1]; position += 2; break;
+            case 0x08: case 0x03: lit_chaine(p, fin, &position, &chaine); break;
+            case 0x09: lit_chaine(p, fin, &position, &message.Correlation); break;
+            case 0x0B: lit_longueur(p, fin, &position, &valeur); break;
+            case 0x26: lit_chaine(p, fin, &position, &chaine); lit_chaine(p, fin, &position, &chaine); break;
+            default: Invalides++; return;
+          }
+        }
+        position = fin;
+        if (alias > 0) {
+          if (message.Topic.empty()) {
+            auto connu = Alias.find(alias);
+            if (connu == Alias.end()) {Invalides++; return;}
+            message.Topic = connu->second;
+            message.Par_alias = true;
+          }
+          else {
+            Alias[alias] = message.Topic;
+          }
+        }
+      }
+      if (message.Topic.empty() || position > n) {Invalides++; return;}
+      message.Charge.assign((const char *)p + position, n - position);
+      Publications++;
+      Octets += octets;
+      Messages.push_back(message);
+      return;
+    }
+
+    case 0x80: {
+      // SUBSCRIBE : identifiant, propriétés (MQTT 5), puis filtres et options ; QoS accordée = QoS demandée
+      if (n < 2) {Invalides++; return;}
+      std::vector<uint8_t> suback = {p[0], p[1]};
+      position = 2;
+      if (Version == 5) {
+        size_t taille_proprietes;
+        if (!lit_longueur(p, n, &position, &taille_proprietes)) {Invalides++; return;}
+        position += taille_proprietes;
+        suback.push_back(0x00);
+      }
+      std::string filtre;
+      while (position < n && lit_chaine(p, n, &position, &filtre) && position < n) {
+        Abonnements.push_back(filtre);
+        suback.push_back(p[position++] & 0x03);
+      }
+      envoie(paquet(0x90, suback));
+      return;
+    }
+
+    case 0x40:
+      // PUBACK d'une commande injectée en QoS 1
+      return;
+
+    case 0xC0:
+      envoie({0xD0, 0x00});
+      return;
+
+    case 0xE0:
+      ferme_client();
+      return;
+
+    default:
+      Invalides++;
+      return;
+  }
+}
+
+/**
+ * @brief Envoi au client d'une commande en QoS 1, avec Response Topic et Correlation Data en MQTT 5.
+ *
+ * @param topic Topic de la commande.
+ * @param charge Message.
+ * @param topic_reponse Topic de réponse, NULL si aucun.
+ * @param correlation Correlation Data, vide si aucune.
+ * @return false si aucun client n'est connecté.
+ */
+bool Courtier_Hote::injecte(const char *topic, const std::string &charge, const char *topic_reponse, const std::string &correlation) {
+  if (!connecte()) {return false;}
+  std::vector<uint8_t> contenu;
+  ajoute_chaine(contenu, topic);
+  Id_paquet = (Id_paquet == 0xFFFF) ? 1 : Id_paquet + 1;
+  contenu.push_back(Id_paquet >> 8);
+  contenu.push_back(Id_paquet & 0xFF);
+  if (Version == 5) {
+    std::vector<uint8_t> proprietes;
+    if (topic_reponse != NULL) {
+      proprietes.push_back(0x08);
+      ajoute_chaine(proprietes, topic_reponse);
+    }
+    if (!correlation.empty()) {
+      proprietes.push_back(0x09);
+      ajoute_chaine(proprietes, correlation);
+    }
+    contenu.push_back((uint8_t)proprietes.size());
+    contenu.insert(contenu.end(), proprietes.begin(), proprietes.end());
+  }
+  contenu.insert(contenu.end(), charge.begin(), charge.end());
+  envoie(paquet(0x32, contenu));
+  return Client >= 0;
+}
@@ -0,0 +1,70 @@
+/**
+ * @file courtier_hote.h
+ * @brief Serveur MQTT 3.1.1 / 5 minimal, dans le processus de test, sur une vraie socket TCP locale.
+ *
+ * Le serveur écoute sur 127.0.0.1 et sert un seul client, sans thread : le test appelle service() entre
+ * deux passages dans loop_MQTT(). Il répond au CONNECT (Topic Alias Maximum annoncé en MQTT 5), au
+ * SUBSCRIBE et au PINGREQ, résout les alias de topic des PUBLISH reçus et compte les paquets et octets
+ * tels qu'ils ont traversé la liaison. Il peut envoyer une commande au client (injecte) et être arrêté
+ * puis relancé sur le même port pour simuler un redémarrage.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * @struct Struct_Message_Hote
+ * @brief Message PUBLISH reçu du client, topic résolu.
+ */
+struct Struct_Message_Hote {
+  std::string Topic;                 ///< Topic (résolu depuis l'alias s'il était vide).
+  std::string Charge;                ///< Message.
+  std::string Correlation;           ///< Correlation Data (MQTT 5), vide si absente.
+  bool Retenu = false;               ///< Drapeau retain.
+  bool Par_alias = false;            ///< Topic vide remplacé par un alias déjà attribué.
+  size_t Octets = 0;                 ///< Taille du paquet sur la liaison.
+  uint64_t Reception_us = 0;         ///< Instant de réception (horloge de l'hôte).
+};
+
+/**
+ * @class Courtier_Hote
+ * @brief Serveur MQTT de test : un client, sans QoS 2 ni rétention.
+ */
+class Courtier_Hote {
+ public:
+  uint16_t Port = 0;                 ///< Port d'écoute (choisi par le système au premier démarrage).
+  uint16_t Alias_max = 64;           ///< Topic Alias Maximum annoncé dans le CONNACK MQTT 5.
+  uint8_t Version = 0;               ///< Version du protocole du client connecté (4 : 3.1.1, 5).
+
+  unsigned long Connexions = 0;      ///< CONNECT acceptés.
+  unsigned long Publications = 0;    ///< PUBLISH reçus.
+  unsigned long Octets = 0;          ///< Octets de ces PUBLISH.
+  unsigned long Octets_topics = 0;   ///< Dont octets de topics.
+  unsigned long Invalides = 0;       ///< Paquets mal formés, alias inconnus.
+  std::vector<std::string> Abonnements;  ///< Filtres souscrits.
+  std::vector<Struct_Message_Hote> Messages;  ///< PUBLISH reçus, dans l'ordre.
+
+  bool demarre();
+  void arrete();
+  void service();
+  bool connecte() const {return Client >= 0 && Session;}
+  bool injecte(const char *topic, const std::string &charge, const char *topic_reponse, const std::string &correlation);
+  void remet_compteurs();
+
+ private:
+  void traite(uint8_t type, const uint8_t *p, size_t n, size_t octets);
+  void envoie(const std::vector<uint8_t> &paquet);
+  void ferme_client();
+
+  int Ecoute = -1;                   ///< Socket d'écoute.
+  int Client = -1;                   ///< Socket du client, -1 si aucun.
+  bool Session = false;              ///< CONNECT reçu et accepté.
+  uint16_t Id_paquet = 0;            ///< Dernier identifiant de paquet émis.
+  std::string Entree;                ///< Octets reçus non encore décodés.
+  std::map<uint16_t, std::string> Alias;  ///< Alias de topic du client (par connexion).
+};
@@ -0,0 +1,145 @@
+/**
+ * @file doubles_hote.cpp
+ * @brief Doublures des modules matériels utilisés par Fonctions_MQTT.cpp dans le banc natif (voir doubles_hote.h).
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include "ArduinoJson.h"
+#include "capteurs.h"
+#include "reseau_serveur.h"
+#include "File_System.h"
+#include "GPIO.h"
+#include "planificateur.h"
+#include "regulation.h"
+#include "client_tls.h"
+#include "api_rest.h"
+#include "global.h"
+#include "doubles_hote.h"
+
+bool EnableMQTT = true;
+bool EnableBME280 = false;
+bool EnableBMP280 = false;
+bool EnableTelemetre = false;
+bool EnablePFC8574_1 = false;
+
+Struct_GPIO Tab_GPIO_OUT[8];
+Struct_GPIO Tab_GPIO_IN[8];
+Struct_GPIO Tab_GPIO_ANA[8];
+Struct_GPIO Telemetre;
+Struct_GPIO Tab_PT100[4];
+Struct_GPIO Tab_Sonde[4];
+Struct_IMP Tab_Impulsion[2];
+Struct_USER Tab_Info_USER[16];
+bool Tab_PCF8574_OUT_1[8];
+
+Struct_Commande_Hote Commandes_hote;
+float Meteo_hote[6];
+uint64_t Epoch_hote_ms = 0;
+
+float Temperature(int indice) {return Meteo_hote[indice == 0 ? 0 : 1];}
+float Temperature_max(void) {return Meteo_hote[2];}
+float Temperature_min(void) {return Meteo_hote[3];}
+float Pression(void) {return Meteo_hote[4];}
+float Humidite(void) {return Meteo_hote[5];}
+
+uint64_t temps_epoch_ms(void) {return Epoch_hote_ms;}
+void demande_instantane_API(void) {}
+
+void Regulation_consigne(float consigne) {}
+void Regulation_gains(float kp, float ki, float kd) {}
+bool Regulation_voie_reservee(int voie) {return false;}
+
+/**
+ * @brief Sortie commandée : GPIO_OUT (num 1 à 8) et PCF8574_OUT_1 (num 0 à 7) sont reportées dans leurs tableaux.
+ */
+int Execute_commande(int type, int num, int val) {
+  Commandes_hote.Executees++;
+  Commandes_hote.Type = type;
+  Commandes_hote.Num = num;
+  Commandes_hote.Val = val;
+  if (type == CMD_GPIO_OUT && num >= 1 && num <= 8) {Tab_GPIO_OUT[num - 1].Valeur = val;}
+  if (type == CMD_PCF8574_OUT_1 && num >= 0 && num < 8) {Tab_PCF8574_OUT_1[num] = (val != 0);}
+  return 1;
+}
+
+int Planifie_commande(int type, int num, int val, int64_t delai_us) {
+  Commandes_hote.Planifiees++;
+  return 1;
+}
+
+void Sorties_etat(Struct_Lot_Sorties *etat) {
+  *etat = Struct_Lot_Sorties();
+  for (int i = 0; i < 8; i++) {
+    if (EnablePFC8574_1) {
+      etat->Masque_PCF8574_1 |= 1 << i;
+      if (Tab_PCF8574_OUT_1[i]) {etat->Valeurs_PCF8574_1 |= 1 << i;}
+    }
+    if (Tab_GPIO_OUT[i].Enable) {
+      etat->Masque_GPIO_OUT |= 1 << i;
+      if (Tab_GPIO_OUT[i].Valeur) {etat->Valeurs_GPIO_OUT |= 1 << i;}
+    }
+  }
+}
+
+const char *Sorties_lot_verifie(const Struct_Lot_Sorties *lot) {return NULL;}
+
+int Sorties_lot_applique(const Struct_Lot_Sorties *lot) {
+  for (int i = 0; i < 8; i++) {
+    if (lot->Masque_GPIO_OUT & (1 << i)) {Execute_commande(CMD_GPIO_OUT, i + 1, (lot->Valeurs_GPIO_OUT >> i) & 1);}
+  }
+  return 1;
+}
+
+/**
+ * @brief Valeur tag1/tag2/tag3 du fichier JSON, sous la forme que rend as<String>() dans File_System.cpp.
+ */
+static String valeur_json(const String &chemin, const String &tag1, const String &tag2, const String &tag3) {
+  File fichier = SPIFFS.open(chemin, "r");
+  if (!fichier) {return "Null";}
+  size_t taille = fichier.size();
+  std::unique_ptr<char[]> tampon(new char[taille + 1]);
+  fichier.readBytes(tampon.get(), taille);
+  tampon[taille] = '\0';
+  DynamicJsonDocument doc(8192);
+  if (deserializeJson(doc, tampon.get())) {return "Null";}
+  JsonVariantConst valeur = doc[tag1.c_str()][tag2.c_str()][tag3.c_str()];
+  if (valeur.isNull()) {return "null";}
+  if (valeur.is<const char *>()) {return valeur.as<const char *>();}
+  char texte[64];
+  serializeJson(valeur, texte, sizeof(texte));
+  return texte;
+}
+
+String getStringValueFromJsonFile(String filePath, String tag1, String tag2, String tag3) {
+  return valeur_json(filePath, tag1, tag2, tag3);
+}
+
+int getIntValueFromJsonFile(String filePath, String tag1, String tag2, String tag3) {
+  return atoi(valeur_json(filePath, tag1, tag2, tag3).c_str());
+}
+
+float getFloatValueFromJsonFile(String filePath, String tag1, String tag2, String tag3) {
+  return atof(valeur_json(filePath, tag1, tag2, tag3).c_str());
+}
+
+String readFileToString(String filepath) {return String();}
+
+/// @brief TLS non disponible sur l'hôte : la configuration échoue, le banc reste en TCP
+bool ClientTLS::configure(const char *ca, const char *certificat, const char *cle, const char *nom_serveur, bool session_rtc) {return false;}
+int ClientTLS::demarre(int fd, const char *hote) {return 0;}
+int ClientTLS::poursuit_handshake(void) {return -1;}
+void ClientTLS::affiche_diagnostic(void) {}
+int ClientTLS::fd(void) {return -1;}
+int ClientTLS::connect(IPAddress ip, uint16_t port) {return 0;}
+int ClientTLS::connect(const char *host, uint16_t port) {return 0;}
+size_t ClientTLS::write(uint8_t octet) {return 0;}
+size_t ClientTLS::write(const uint8_t *buf, size_t size) {return 0;}
+int ClientTLS::available() {return 0;}
+int ClientTLS::read() {return -1;}
+int ClientTLS::read(uint8_t *buf, size_t size) {return -1;}
+int ClientTLS::peek() {return -1;}
+void ClientTLS::flush() {}
+void ClientTLS::stop() {}
+uint8_t ClientTLS::connected() {return 0;}
+ClientTLS::operator bool() {return false;}
@@ -0,0 +1,30 @@
+/**
+ * @file doubles_hote.h
+ * @brief Doublures des modules matériels utilisés par Fonctions_MQTT.cpp dans le banc natif.
+ *
+ * Les capteurs rendent les valeurs posées par le test, les sorties enregistrent les commandes sans
+ * piloter de broche, la configuration est lue dans le MQTT.json que le test écrit sous SPIFFS.Racine
+ * (mêmes règles que File_System.cpp : valeur absente lue "null", entier / réel par atoi / atof).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * @struct Struct_Commande_Hote
+ * @brief Commandes de sortie reçues par la doublure du planificateur.
+ */
+struct Struct_Commande_Hote {
+  unsigned long Executees = 0;       ///< Appels de Execute_commande.
+  unsigned long Planifiees = 0;      ///< Appels de Planifie_commande.
+  int Type = -1;                     ///< Type de la dernière commande (Type_Commande).
+  int Num = -1;                      ///< Numéro de la dernière sortie commandée.
+  int Val = -1;                      ///< Dernière valeur commandée.
+};
+
+extern Struct_Commande_Hote Commandes_hote;
+/// @brief Valeurs météo rendues par les capteurs : temperature_1, temperature_2, max, min, pression, humidité
+extern float Meteo_hote[6];
+/// @brief Heure UTC (ms) rendue par temps_epoch_ms, 0 : heure non synchronisée
+extern uint64_t Epoch_hote_ms;
@@ -0,0 +1,44 @@
+/**
+ * @file reference_mesuree.h
+ * @brief Référence mesurée par le banc natif test_mqtt (Fonctions_MQTT.cpp contre le serveur de courtier_hote.cpp).
+ *
+ * Messages et octets : relevés par le serveur sur la liaison TCP, paquets PUBLISH complets (en-tête, topic ou
+ * alias, propriétés MQTT 5, message), pour le scénario de test_main.cpp. Ils ne dépendent que du code et du
+ * scénario et sont comparés exactement : un écart signale un changement du trafic émis.
+ *
+ * Durées : mesurées sur un PC Linux x86-64, g++ 12, cinq exécutions (valeur typique). Elles servent de borne
+ * large (FACTEUR_TOLERANCE_DUREES) et ne préjugent pas des durées sur l'ESP32. La reprise après redémarrage
+ * est comptée sur l'horloge simulée du banc : elle suit l'attente exponentielle de reconnexion (srand(1)).
+ *
+ * Après une modification qui change volontairement le trafic, relancer le banc et reporter ici les valeurs affichées.
+ */
+
+#pragma once
+
+/// @brief Messages d'un rafraîchissement complet : 8 GPIO_OUT, 8 GPIO_ANA, 2 impulsions, météo et 16 variables utilisateur
+#define REFERENCE_MESSAGES_CYCLE_COMPLET    35
+/// @brief Octets de la présence "online" et de la republication retenue qui suivent la connexion (topics émis, alias attribués)
+#define REFERENCE_OCTETS_REPUBLICATION      2070
+/// @brief Octets d'un rafraîchissement complet, topics remplacés par leurs alias
+#define REFERENCE_OCTETS_CYCLE_COMPLET      1219
+/// @brief Messages de 100 cycles où seuls les canaux sortis de leur bande morte sont publiés
+#define REFERENCE_MESSAGES_CYCLES_MODIFIES  736
+/// @brief Octets de ces 100 cycles
+#define REFERENCE_OCTETS_CYCLES_MODIFIES    26146
+/// @brief Octets de 100 documents agrégés _out/Etat en JSON
+#define REFERENCE_OCTETS_DOCUMENTS_JSON     69062
+/// @brief Octets des mêmes 100 documents en MessagePack
+#define REFERENCE_OCTETS_DOCUMENTS_MSGPACK  51794
+/// @brief Messages mis en file pendant 5 cycles sans serveur
+#define REFERENCE_MESSAGES_EN_FILE          32
+/// @brief Octets republiés (retenus) et rejoués (horodatés) après le redémarrage du serveur, présence exclue
+#define REFERENCE_OCTETS_REPRISE            3921
+
+/// @brief Messages par seconde sur l'hôte, rafraîchissements complets enchaînés, serveur compris
+#define REFERENCE_MESSAGES_S_HOTE           160000
+/// @brief Latence commande -> acquittement sur la boucle locale : médiane (µs)
+#define REFERENCE_LATENCE_MEDIANE_US        30
+/// @brief Latence commande -> acquittement : 95e centile (µs)
+#define REFERENCE_LATENCE_P95_US            40
+/// @brief Redémarrage du serveur -> présence "online" reçue (ms d'horloge simulée)
+#define REFERENCE_REPRISE_MS                1831
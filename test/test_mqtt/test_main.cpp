@@ -0,0 +1,485 @@
+/**
+ * @file test_main.cpp
+ * @brief Banc natif du service MQTT : le vrai Fonctions_MQTT.cpp contre un serveur MQTT 5 local.
+ *
+ * Fonctions_MQTT.cpp est compilé sur le PC avec le client MQTT, le routeur, le pool de commandes, la
+ * régulation de débit et la file d'attente, sur les cales de test/hote (WiFiClient sur socket POSIX,
+ * SPIFFS dans un répertoire temporaire, lwIP, esp_timer) et les doublures matérielles de doubles_hote.cpp.
+ * mqtt_service_setup() lit le MQTT.json écrit par le banc, se connecte par la machine d'état non bloquante
+ * de reconnect() au serveur de courtier_hote.cpp, et le banc appelle publish_s1() et loop_MQTT() comme la
+ * boucle principale. Les commandes arrivent par la socket et passent par callback() et update_Subscribe1().
+ *
+ * Grandeurs relevées côté serveur, sur la liaison : messages et octets d'un cycle complet (topics émis puis
+ * alias), de 100 cycles de changements et de 100 documents agrégés JSON et MessagePack, messages mis en file
+ * pendant un arrêt du serveur puis rejoués. Ces valeurs ne dépendent que du code et du scénario : elles sont
+ * comparées exactement à la référence mesurée (reference_mesuree.h). Les durées (messages/s sur l'hôte,
+ * latence commande / acquittement, reprise après redémarrage) dépendent de la machine : elles sont
+ * affichées et ne doivent pas dépasser FACTEUR_TOLERANCE_DUREES fois la référence.
+ *
+ * Après une modification qui change volontairement le trafic, relancer le banc et reporter les valeurs
+ * affichées dans reference_mesuree.h.
+ *
+ * operator new et malloc sont remplacés par des versions qui comptent les allocations. Le compte n'est relevé
+ * qu'autour de publish_s1() : le serveur de test, qui alloue, reste hors de la mesure. Après les premiers cycles
+ * (table des topics, alias, documents), publish_s1() ne doit plus allouer, en topics comme en document agrégé.
+ *
+ * Exécution : pio test -e native_mqtt -f test_mqtt
+ */
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <unity.h>
+#include <stdlib.h>
+#include <new>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "ArduinoJson.h"
+#include "Fonctions_MQTT.h"
+#include "client_mqtt.h"
+#include "publication.h"
+#include "file_attente.h"
+#include "planificateur.h"
+#include "global.h"
+#include "courtier_hote.h"
+#include "doubles_hote.h"
+#include "reference_mesuree.h"
+
+/// @brief Écart toléré sur les durées : la référence a été mesurée sur une autre machine
+#define FACTEUR_TOLERANCE_DUREES 10
+/// @brief Cycles de changements et documents agrégés mesurés
+#define NB_CYCLES_MESURE 100
+/// @brief Commandes de la mesure de latence
+#define NB_COMMANDES_MESURE 50
+
+extern ClientMQTT client;
+extern bool modeDocument;
+extern int Encodage_Etat;
+extern bool Republication_complete;
+extern uint32_t sequenceDocument;
+extern char Tab_Topics_MQTT[NB_TOPICS_MQTT][TAILLE_TOPIC_MQTT];
+
+/// @brief Nombre d'allocations sur le tas depuis le lancement
+static volatile unsigned long Nb_allocations = 0;
+
+void *operator new(size_t taille) {
+  Nb_allocations++;
+  void *p = malloc(taille);
+  if (p == NULL) {throw std::bad_alloc();}
+  return p;
+}
+void *operator new[](size_t taille) {return operator new(taille);}
+void operator delete(void *p) noexcept {free(p);}
+void operator delete[](void *p) noexcept {free(p);}
+void operator delete(void *p, size_t) noexcept {free(p);}
+void operator delete[](void *p, size_t) noexcept {free(p);}
+
+#ifdef __GLIBC__
+// Les allocations C (malloc, calloc, realloc) sont aussi comptées avec la glibc
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void *malloc(size_t taille) {Nb_allocations++; return __libc_malloc(taille);}
+extern "C" void *calloc(size_t nb, size_t taille) {Nb_allocations++; return __libc_calloc(nb, taille);}
+extern "C" void *realloc(void *p, size_t taille) {Nb_allocations++; return __libc_realloc(p, taille);}
+#endif
+
+Courtier_Hote Courtier;
+/// @brief Allocations faites dans publish_s1() par les cycles depuis la dernière remise à zéro
+unsigned long Allocations_publication = 0;
+/// @brief Messages reçus du client entre sa connexion et le premier test
+std::vector<Struct_Message_Hote> Messages_republication;
+
+/// @brief MQTT.json du banc : valeurs de data/MQTT.json, serveur local, régulation de débit désactivée (0)
+static const char *Config_MQTT = R"({"MQTT": {
+  "General": {
+    "MQTT_serveur": "127.0.0.1", "MQTT_port": %u, "MQTT_user": "", "MQTT_password": "", "MQTT_client": "banc_hote",
+    "MQTT_subscribe_1": "irrigation", "MQTT_subscribe_2": "serre/irrigation2/pompe",
+    "MQTT_publish_1": "serre/meteo", "MQTT_publish_2": "serre/meteo2",
+    "MQTT_periode_rafraichissement": 300, "MQTT_mode_publication": "topic",
+    "MQTT_reconnexion_min_ms": 1000, "MQTT_reconnexion_max_ms": 60000,
+    "MQTT_timeout_connexion_ms": 3000, "MQTT_timeout_session_ms": 5000,
+    "MQTT_version": "5", "MQTT_expiration_session_s": 86400,
+    "MQTT_file_flash_octets": 65536, "MQTT_rejeu_par_seconde": 10, "MQTT_TLS": "false"
+  },
+  "Serveurs": {"Serveur_1": "", "Serveur_2": "", "Serveur_3": ""},
+  "Bande_morte": {
+    "GPIO_ANA_abs": 20, "GPIO_ANA_rel": 0, "PT100_abs": 0.2, "PT100_rel": 0, "Sonde_abs": 0.2, "Sonde_rel": 0,
+    "Impulsion_abs": 0, "Impulsion_rel": 0.02, "Telemetre_abs": 1, "Telemetre_rel": 0,
+    "Meteo_abs": 0.2, "Meteo_rel": 0, "User_abs": 0, "User_rel": 0
+  },
+  "Debit": {
+    "Global_octets_s": 0, "Global_rafale": 0, "Reserve_priorite": 0, "Ack_octets_s": 0, "Ack_rafale": 0,
+    "Evenement_octets_s": 0, "Evenement_rafale": 0, "Telemetrie_octets_s": 0, "Telemetrie_rafale": 0,
+    "Diagnostic_octets_s": 0, "Diagnostic_rafale": 0
+  },
+  "Encodage": {
+    "TOR": "json", "GPIO_ANA": "json", "PT100": "json", "Sonde": "json", "Impulsion": "json",
+    "Telemetre": "json", "Meteo": "json", "User": "json", "Etat": "json", "Publish_1": "json"
+  }
+}})";
+
+/**
+ * @fn void pose_capteurs(int t)
+ * @brief Valeurs des canaux au cycle t : 8 GPIO_OUT (compteur binaire), 8 GPIO_ANA (+10 par cycle, bande morte 20),
+ * 2 impulsions, météo (+0,25 tous les 4 cycles) et 16 variables utilisateur (une modifiée par cycle).
+ *
+ * Les réels sont des multiples de 0,25 : leur écriture JSON est exacte et ne dépend pas de la bibliothèque.
+ */
+void pose_capteurs(int t) {
+  for (int i = 0; i < 8; i++) {
+    Tab_GPIO_OUT[i].Valeur = (t >> i) & 1;
+    Tab_GPIO_ANA[i].Valeur = 1000 + 10 * t + i;
+  }
+  for (int i = 0; i < 2; i++) {
+    Tab_Impulsion[i].Valeur_Cumul = 100L * t;
+    Tab_Impulsion[i].Valeur_ps = 0.25f * t;
+    Tab_Impulsion[i].Valeur_pmin = 15.0f * t;
+  }
+  for (int j = 0; j < 4; j++) {Meteo_hote[j] = 20 + j + 0.25f * (t / 4);}
+  Meteo_hote[4] = 1013.25f;
+  Meteo_hote[5] = 55.5f;
+  for (int i = 0; i < 16; i++) {
+    Tab_Info_USER[i].Val_INT = i + (t + i) / 16;
+    Tab_Info_USER[i].Val_LONG = 1000L * i;
+    Tab_Info_USER[i].Val_FLOAT = 0.5f * i;
+  }
+}
+
+/**
+ * @fn void pompe(int passages, unsigned long pas_ms)
+ * @brief Passages dans loop_MQTT() puis dans le serveur, l'horloge avançant de pas_ms à chaque passage.
+ */
+void pompe(int passages, unsigned long pas_ms) {
+  for (int i = 0; i < passages; i++) {
+    Decalage_horloge_hote_ms += pas_ms;
+    loop_MQTT();
+    Courtier.service();
+  }
+}
+
+/**
+ * @fn bool attend(Condition condition, unsigned long max_ms)
+ * @brief Pompe par pas de 10 ms d'horloge simulée jusqu'à la condition, au plus max_ms.
+ */
+template <typename Condition>
+bool attend(Condition condition, unsigned long max_ms) {
+  for (unsigned long ecoule = 0; ecoule <= max_ms; ecoule += 10) {
+    if (condition()) {return true;}
+    pompe(1, 10);
+  }
+  return condition();
+}
+
+/**
+ * @fn void cycle(int t)
+ * @brief Cycle de la boucle principale, une seconde après le précédent : publish_s1() puis loop_MQTT().
+ *
+ * Les allocations de publish_s1() sont ajoutées à Allocations_publication.
+ */
+void cycle(int t) {
+  pose_capteurs(t);
+  Decalage_horloge_hote_ms += 1000;
+  unsigned long avant = Nb_allocations;
+  publish_s1();
+  Allocations_publication += Nb_allocations - avant;
+  Courtier.service();
+  pompe(1, 0);
+}
+
+/// @brief Messages reçus sur un topic
+unsigned long compte_topic(const char *topic) {
+  unsigned long n = 0;
+  for (const Struct_Message_Hote &m : Courtier.Messages) {n += (m.Topic == topic);}
+  return n;
+}
+
+/// @brief Octets des PUBLISH reçus hors message de présence (_out/Statut)
+unsigned long octets_publications() {
+  unsigned long octets = 0;
+  for (const Struct_Message_Hote &m : Courtier.Messages) {
+    if (m.Topic != Tab_Topics_MQTT[TOPIC_STATUT]) {octets += m.Octets;}
+  }
+  return octets;
+}
+
+/// @brief Durée mesurée (affichée) et bornée à FACTEUR_TOLERANCE_DUREES fois sa référence
+#define VERIFIE_DUREE(reference, mesure) TEST_ASSERT_LESS_OR_EQUAL((double)(reference) * FACTEUR_TOLERANCE_DUREES, (mesure))
+
+void setUp(void) {
+  Courtier.remet_compteurs();
+  Allocations_publication = 0;
+}
+
+void tearDown(void) {}
+
+void test_connexion_republication(void) {
+  // Connexion établie dans main() : republication complète retenue, derrière la présence "online"
+  TEST_ASSERT_TRUE(client.connected());
+  TEST_ASSERT_EQUAL(1, Courtier.Connexions);
+  TEST_ASSERT_EQUAL(5, Courtier.Version);
+  TEST_ASSERT_EQUAL(2, Courtier.Abonnements.size());
+  TEST_ASSERT_EQUAL_STRING("irrigation/#", Courtier.Abonnements[0].c_str());
+
+  TEST_ASSERT_EQUAL(1 + REFERENCE_MESSAGES_CYCLE_COMPLET, Messages_republication.size());
+  TEST_ASSERT_EQUAL_STRING(Tab_Topics_MQTT[TOPIC_STATUT], Messages_republication[0].Topic.c_str());
+  TEST_ASSERT_EQUAL_STRING("online", Messages_republication[0].Charge.c_str());
+  unsigned long octets = 0;
+  for (const Struct_Message_Hote &m : Messages_republication) {
+    TEST_ASSERT_TRUE(m.Retenu);
+    TEST_ASSERT_FALSE(m.Par_alias);
+    octets += m.Octets;
+  }
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_REPUBLICATION, octets);
+
+  char message[96];
+  snprintf(message, sizeof(message), "Connexion : presence et republication, %lu octets (topics et alias emis)", octets);
+  TEST_MESSAGE(message);
+}
+
+void test_cycle_complet(void) {
+  // Rafraîchissement périodique : tous les canaux, topics remplacés par leurs alias
+  Decalage_horloge_hote_ms += 300000;
+  cycle(0);
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+  TEST_ASSERT_EQUAL(REFERENCE_MESSAGES_CYCLE_COMPLET, Courtier.Publications);
+  TEST_ASSERT_EQUAL(0, Courtier.Octets_topics);
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_CYCLE_COMPLET, Courtier.Octets);
+  for (const Struct_Message_Hote &m : Courtier.Messages) {TEST_ASSERT_TRUE(m.Par_alias);}
+
+  char message[96];
+  snprintf(message, sizeof(message), "Cycle complet : %lu messages, %lu octets", Courtier.Publications, Courtier.Octets);
+  TEST_MESSAGE(message);
+}
+
+void test_cycles_modifies(void) {
+  // Cycles ordinaires : seuls les canaux sortis de leur bande morte sont publiés
+  for (int t = 1; t <= NB_CYCLES_MESURE; t++) {cycle(t);}
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+  TEST_ASSERT_EQUAL(REFERENCE_MESSAGES_CYCLES_MODIFIES, Courtier.Publications);
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_CYCLES_MODIFIES, Courtier.Octets);
+
+  char message[128];
+  snprintf(message, sizeof(message), "%d cycles de changements : %lu messages, %lu octets",
+           NB_CYCLES_MESURE, Courtier.Publications, Courtier.Octets);
+  TEST_MESSAGE(message);
+}
+
+void test_debit_hote(void) {
+  // Cycles complets enchaînés : messages par seconde sur l'hôte, serveur compris
+  const int nb_cycles = 200;
+  auto debut = std::chrono::steady_clock::now();
+  for (int c = 0; c < nb_cycles; c++) {
+    Decalage_horloge_hote_ms += 300000;
+    cycle(c & 1);
+  }
+  double duree_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - debut).count();
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+  TEST_ASSERT_EQUAL(REFERENCE_MESSAGES_CYCLE_COMPLET * nb_cycles, Courtier.Publications);
+  double messages_s = Courtier.Publications / duree_s;
+  TEST_ASSERT_GREATER_OR_EQUAL(REFERENCE_MESSAGES_S_HOTE / FACTEUR_TOLERANCE_DUREES, messages_s);
+
+  char message[96];
+  snprintf(message, sizeof(message), "%.0f messages/s sur l'hote", messages_s);
+  TEST_MESSAGE(message);
+}
+
+/// @brief 100 documents agrégés publiés sur _out/Etat dans l'encodage donné ; retourne leurs octets
+unsigned long cycles_document(int encodage) {
+  modeDocument = true;
+  Encodage_Etat = encodage;
+  sequenceDocument = 0;
+  for (int t = 1; t <= NB_CYCLES_MESURE; t++) {cycle(t);}
+  modeDocument = false;
+  Encodage_Etat = 0;
+  return Courtier.Octets;
+}
+
+void test_document_json(void) {
+  unsigned long octets = cycles_document(0);
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+  TEST_ASSERT_EQUAL(NB_CYCLES_MESURE, compte_topic(Tab_Topics_MQTT[TOPIC_ETAT]));
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_DOCUMENTS_JSON, octets);
+
+  // Dernier document complet et numéroté
+  StaticJsonDocument<4096> doc;
+  TEST_ASSERT_FALSE(deserializeJson(doc, Courtier.Messages.back().Charge.c_str()));
+  TEST_ASSERT_EQUAL(NB_CYCLES_MESURE, doc["seq"].as<int>());
+  TEST_ASSERT_EQUAL(1000 + 10 * NB_CYCLES_MESURE + 7, doc["GPIO_ANA"]["8"].as<int>());
+  TEST_ASSERT_EQUAL(16, doc["User"].size());
+
+  char message[96];
+  snprintf(message, sizeof(message), "%d documents JSON : %lu octets", NB_CYCLES_MESURE, octets);
+  TEST_MESSAGE(message);
+}
+
+void test_document_msgpack(void) {
+  // Encodage_Etat = ENCODAGE_MSGPACK
+  unsigned long octets = cycles_document(1);
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+  TEST_ASSERT_EQUAL(NB_CYCLES_MESURE, compte_topic(Tab_Topics_MQTT[TOPIC_ETAT]));
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_DOCUMENTS_MSGPACK, octets);
+
+  char message[96];
+  snprintf(message, sizeof(message), "%d documents MessagePack : %lu octets", NB_CYCLES_MESURE, octets);
+  TEST_MESSAGE(message);
+}
+
+void test_commande_latence(void) {
+  // Commandes MQTT 5 (Response Topic, Correlation Data) : aller-retour serveur -> callback -> update_Subscribe1 -> acquittement
+  std::vector<uint64_t> latences;
+  for (int k = 0; k < NB_COMMANDES_MESURE; k++) {
+    char corps[64], correlation[16];
+    snprintf(corps, sizeof(corps), "{\"id\":\"c%d\",\"num_port\":3,\"val_port\":%d}", k, k & 1);
+    snprintf(correlation, sizeof(correlation), "corr-%d", k);
+    size_t avant = Courtier.Messages.size();
+    uint64_t debut = horloge_hote_us();
+    TEST_ASSERT_TRUE(Courtier.injecte("irrigation/GPIO_OUT", corps, "banc/reponse", correlation));
+    for (int i = 0; i < 1000 && Courtier.Messages.size() == avant; i++) {pompe(1, 0);}
+    TEST_ASSERT_EQUAL(avant + 1, Courtier.Messages.size());
+
+    const Struct_Message_Hote &ack = Courtier.Messages.back();
+    TEST_ASSERT_EQUAL_STRING("banc/reponse", ack.Topic.c_str());
+    TEST_ASSERT_EQUAL_STRING(correlation, ack.Correlation.c_str());
+    StaticJsonDocument<512> doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, ack.Charge.c_str()));
+    TEST_ASSERT_EQUAL(1, doc["ok"].as<int>());
+    TEST_ASSERT_EQUAL_STRING("GPIO_OUT", doc["cmd"].as<const char *>());
+    TEST_ASSERT_EQUAL(k & 1, doc["val"].as<int>());
+    TEST_ASSERT_EQUAL(CMD_GPIO_OUT, Commandes_hote.Type);
+    TEST_ASSERT_EQUAL(3, Commandes_hote.Num);
+    latences.push_back(ack.Reception_us - debut);
+  }
+  std::sort(latences.begin(), latences.end());
+  uint64_t mediane = latences[latences.size() / 2];
+  uint64_t p95 = latences[latences.size() * 95 / 100];
+  VERIFIE_DUREE(REFERENCE_LATENCE_MEDIANE_US, mediane);
+  VERIFIE_DUREE(REFERENCE_LATENCE_P95_US, p95);
+
+  char message[96];
+  snprintf(message, sizeof(message), "Commande -> acquittement : mediane %llu us, p95 %llu us", (unsigned long long)mediane, (unsigned long long)p95);
+  TEST_MESSAGE(message);
+}
+
+void test_compteur_allocations(void) {
+  // Le compteur voit bien les allocations : sinon les tests d'absence d'allocation ne prouveraient rien
+  unsigned long avant = Nb_allocations;
+  int *volatile p = new int(1);
+  delete p;
+  TEST_ASSERT_GREATER_THAN(avant, Nb_allocations);
+  avant = Nb_allocations;
+  void *volatile q = malloc(16);
+  free(q);
+  TEST_ASSERT_GREATER_THAN(avant, Nb_allocations);
+}
+
+void test_aucune_allocation_topics(void) {
+  // Rafraîchissement complet puis changements : les cycles précédents ont attribué les alias
+  Decalage_horloge_hote_ms += 300000;
+  for (int t = 0; t <= NB_CYCLES_MESURE; t++) {cycle(t);}
+  TEST_ASSERT_GREATER_THAN(REFERENCE_MESSAGES_CYCLE_COMPLET, Courtier.Publications);
+  TEST_ASSERT_EQUAL(0, Allocations_publication);
+}
+
+void test_aucune_allocation_document(void) {
+  // Un premier document par encodage, puis 100 documents JSON et 100 MessagePack mesurés
+  cycles_document(0);
+  cycles_document(1);
+  Allocations_publication = 0;
+  cycles_document(0);
+  cycles_document(1);
+  TEST_ASSERT_EQUAL(4 * NB_CYCLES_MESURE, compte_topic(Tab_Topics_MQTT[TOPIC_ETAT]));
+  TEST_ASSERT_EQUAL(0, Allocations_publication);
+}
+
+void test_redemarrage_courtier(void) {
+  // Arrêt du serveur : la coupure est détectée, les changements des cycles suivants sont mis en file
+  pose_capteurs(0);
+  Republication_complete = true;
+  pompe(1, 0);
+  Courtier.remet_compteurs();
+  Courtier.arrete();
+  TEST_ASSERT_TRUE(attend([] {return !client.connected();}, 1000));
+  for (int t = 1; t <= 5; t++) {cycle(t);}
+  int en_file = File_attente_profondeur();
+  TEST_ASSERT_EQUAL(REFERENCE_MESSAGES_EN_FILE, en_file);
+
+  // Relance sur le même port : reconnexion à l'échéance de l'attente exponentielle, présence, republication, rejeu
+  TEST_ASSERT_TRUE(Courtier.demarre());
+  unsigned long debut = millis();
+  TEST_ASSERT_TRUE(attend([] {return compte_topic(Tab_Topics_MQTT[TOPIC_STATUT]) > 0;}, 60000));
+  unsigned long reprise_ms = millis() - debut;
+  TEST_ASSERT_TRUE(attend([] {return File_attente_profondeur() == 0;}, 60000));
+  TEST_ASSERT_EQUAL(2, Courtier.Connexions);
+  TEST_ASSERT_EQUAL(0, Courtier.Invalides);
+
+  // Messages rejoués : non retenus, horodatés à l'acquisition
+  unsigned long rejoues = 0, retenus = 0;
+  for (const Struct_Message_Hote &m : Courtier.Messages) {
+    if (m.Topic == Tab_Topics_MQTT[TOPIC_STATUT]) {continue;}
+    if (m.Retenu) {
+      retenus++;
+      continue;
+    }
+    TEST_ASSERT_TRUE(m.Charge.find("\"ts\":") != std::string::npos);
+    rejoues++;
+  }
+  TEST_ASSERT_EQUAL(en_file, rejoues);
+  TEST_ASSERT_EQUAL(REFERENCE_MESSAGES_CYCLE_COMPLET, retenus);
+  TEST_ASSERT_EQUAL(REFERENCE_OCTETS_REPRISE, octets_publications());
+  VERIFIE_DUREE(REFERENCE_REPRISE_MS, reprise_ms);
+
+  char message[128];
+  snprintf(message, sizeof(message), "Redemarrage : %d messages en file, reprise en %lu ms, %lu octets republies et rejoues",
+           en_file, reprise_ms, octets_publications());
+  TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv) {
+  // Fichiers du banc dans un répertoire temporaire : configuration et file d'attente
+  char racine[] = "/tmp/banc_mqtt_XXXXXX";
+  if (mkdtemp(racine) == NULL || !Courtier.demarre()) {return 1;}
+  SPIFFS.Racine = racine;
+  static char texte[4096];
+  File config = SPIFFS.open("/MQTT.json", "w");
+  config.write((const uint8_t *)texte, snprintf(texte, sizeof(texte), Config_MQTT, Courtier.Port));
+  config.close();
+
+  for (int i = 0; i < 8; i++) {
+    Tab_GPIO_OUT[i].Enable = true;
+    Tab_GPIO_ANA[i].Enable = true;
+  }
+  Tab_Impulsion[0].Enable = true;
+  Tab_Impulsion[1].Enable = true;
+  EnableBME280 = true;
+  Epoch_hote_ms = 1760000000000ULL;
+  pose_capteurs(0);
+  srand(1);
+  Serial.Muet = true;
+
+  mqtt_service_setup();
+  // Connexion, souscriptions, présence "online" puis republication retenue au passage suivant
+  attend([] {return compte_topic(Tab_Topics_MQTT[TOPIC_STATUT]) > 0 && !Republication_complete;}, 5000);
+  Messages_republication = Courtier.Messages;
+
+  UNITY_BEGIN();
+  RUN_TEST(test_connexion_republication);
+  RUN_TEST(test_cycle_complet);
+  RUN_TEST(test_cycles_modifies);
+  RUN_TEST(test_debit_hote);
+  RUN_TEST(test_document_json);
+  RUN_TEST(test_document_msgpack);
+  RUN_TEST(test_commande_latence);
+  RUN_TEST(test_compteur_allocations);
+  RUN_TEST(test_aucune_allocation_topics);
+  RUN_TEST(test_aucune_allocation_document);
+  RUN_TEST(test_redemarrage_courtier);
+  int resultat = UNITY_END();
+
+  Courtier.arrete();
+  SPIFFS.remove("/MQTT.json");
+  SPIFFS.remove("/file_mqtt.bin");
+  rmdir(racine);
+  return resultat;
+}
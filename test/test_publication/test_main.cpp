@@ -0,0 +1,168 @@
+/**
+ * @file test_main.cpp
+ * @brief Tests natifs des fonctions de src/publication.cpp : table des topics, taille de paquet, bande morte, écrivain de flux.
+ *
+ * L'écrivain de flux écrit dans une socket simulée. Le trafic émis par publish_s1 (messages, octets, débit,
+ * redémarrage du serveur) et l'absence d'allocation pendant la publication sont vérifiés par le banc test_mqtt,
+ * qui exécute Fonctions_MQTT.cpp contre un serveur MQTT local.
+ *
+ * Exécution : pio test -e native -f test_publication
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unity.h>
+#include "publication.h"
+
+extern Struct_Canal_MQTT Tab_Canal_MQTT[NB_CANAUX_MQTT];
+extern Struct_Bande_Morte Tab_Bande_Morte[NB_FAMILLES];
+extern char Tab_Topics_MQTT[NB_TOPICS_MQTT][TAILLE_TOPIC_MQTT];
+extern uint32_t Version_Topics_MQTT;
+
+/**
+ * @class Socket_Test
+ * @brief Socket simulée : écrivain ArduinoJson qui recopie les octets dans un tableau fixe.
+ */
+class Socket_Test {
+ public:
+  uint8_t Donnees[4096];
+  size_t Taille = 0;
+  unsigned long Ecritures = 0;       ///< Nombre d'appels d'écriture (un appel = un segment envoyé).
+  size_t Limite = (size_t)-1;        ///< Octets acceptés avant une écriture incomplète (coupure simulée).
+
+  size_t write(uint8_t octet) {return write(&octet, 1);}
+  size_t write(const uint8_t *tampon, size_t taille) {
+    Ecritures++;
+    if (taille > Limite) {taille = Limite;}
+    Limite -= taille;
+    if (Taille + taille > sizeof(Donnees)) {Taille = 0;}
+    memcpy(Donnees + Taille, tampon, taille);
+    Taille += taille;
+    return taille;
+  }
+};
+
+Socket_Test Socket;
+
+/**
+ * @fn size_t ecrit_socket(void *contexte, const uint8_t *tampon, size_t taille)
+ * @brief Sortie de l'écrivain de flux vers la socket simulée, comme ecrit_client_MQTT vers le client.
+ */
+size_t ecrit_socket(void *contexte, const uint8_t *tampon, size_t taille) {
+  return ((Socket_Test *)contexte)->write(tampon, taille);
+}
+
+void setUp(void) {
+  for (int i = 0; i < NB_CANAUX_MQTT; i++) {Tab_Canal_MQTT[i] = Struct_Canal_MQTT();}
+  for (int f = 0; f < NB_FAMILLES; f++) {Tab_Bande_Morte[f] = Struct_Bande_Morte();}
+  Tab_Bande_Morte[FAMILLE_GPIO_ANA].Abs = 5;
+  Socket = Socket_Test();
+  Topics_MQTT_construit("irrigation/esp32");
+}
+
+void tearDown(void) {}
+
+void test_table_topics(void) {
+  TEST_ASSERT_EQUAL_STRING("irrigation/esp32_out/GPIO_ANA_3", Tab_Topics_MQTT[CANAL_GPIO_ANA + 2]);
+  TEST_ASSERT_EQUAL_STRING("irrigation/esp32_out/User_16", Tab_Topics_MQTT[CANAL_USER + 15]);
+  TEST_ASSERT_EQUAL_STRING("irrigation/esp32_out/Etat", Tab_Topics_MQTT[TOPIC_ETAT]);
+  // L'empreinte de la table identifie le préfixe : les messages persistés avec un autre préfixe sont écartés au rejeu
+  uint32_t version = Version_Topics_MQTT;
+  TEST_ASSERT_EQUAL(0, Topics_MQTT_construit("court"));
+  TEST_ASSERT_TRUE(Version_Topics_MQTT != version);
+  Topics_MQTT_construit("irrigation/esp32");
+  TEST_ASSERT_EQUAL_UINT32(version, Version_Topics_MQTT);
+  Topics_MQTT_construit("court");
+
+  char long_prefixe[TAILLE_TOPIC_MQTT];
+  memset(long_prefixe, 'a', sizeof(long_prefixe) - 1);
+  long_prefixe[sizeof(long_prefixe) - 1] = '\0';
+  TEST_ASSERT_EQUAL(NB_TOPICS_MQTT, Topics_MQTT_construit(long_prefixe));
+  TEST_ASSERT_EQUAL(TAILLE_TOPIC_MQTT - 1, strlen(Tab_Topics_MQTT[0]));
+}
+
+void test_taille_paquet(void) {
+  // En-tête fixe + longueur restante sur 1 octet jusqu'à 127, 2 octets jusqu'à 16383
+  TEST_ASSERT_EQUAL(2 + 2 + 20 + 100, taille_paquet_publish(20, 100));
+  TEST_ASSERT_EQUAL(3 + 2 + 20 + 200, taille_paquet_publish(20, 200));
+  TEST_ASSERT_EQUAL(4 + 2 + 20 + 20000, taille_paquet_publish(20, 20000));
+}
+
+void test_bande_morte(void) {
+  float val = 1000;
+  TEST_ASSERT_TRUE(canal_modifie(CANAL_GPIO_ANA, &val, 1, FAMILLE_GPIO_ANA));
+  memorise_canal(CANAL_GPIO_ANA, &val, 1);
+  val = 1004;
+  TEST_ASSERT_FALSE(canal_modifie(CANAL_GPIO_ANA, &val, 1, FAMILLE_GPIO_ANA));
+  val = 1006;
+  TEST_ASSERT_TRUE(canal_modifie(CANAL_GPIO_ANA, &val, 1, FAMILLE_GPIO_ANA));
+
+  // Bande morte relative : 1 % de 1000
+  Tab_Bande_Morte[FAMILLE_GPIO_ANA].Rel = 0.01f;
+  TEST_ASSERT_FALSE(canal_modifie(CANAL_GPIO_ANA, &val, 1, FAMILLE_GPIO_ANA));
+}
+
+void test_ecrivain_regroupe(void) {
+  // 1000 octets écrits un par un partent en blocs de TAILLE_TAMPON_FLUX
+  Ecrivain_Flux flux(ecrit_socket, &Socket);
+  for (int i = 0; i < 1000; i++) {TEST_ASSERT_EQUAL(1, flux.write((uint8_t)i));}
+  TEST_ASSERT_TRUE(flux.vide());
+  TEST_ASSERT_EQUAL((1000 + TAILLE_TAMPON_FLUX - 1) / TAILLE_TAMPON_FLUX, Socket.Ecritures);
+  TEST_ASSERT_EQUAL(1000, flux.Transmis);
+  TEST_ASSERT_EQUAL(1000, Socket.Taille);
+  for (int i = 0; i < 1000; i++) {TEST_ASSERT_EQUAL((uint8_t)i, Socket.Donnees[i]);}
+}
+
+void test_ecrivain_bloc(void) {
+  // Un bloc plus grand que le tampon est écrit directement, après les octets en attente, dans l'ordre
+  static uint8_t bloc[1000];
+  for (int i = 0; i < 1000; i++) {bloc[i] = (uint8_t)(i * 7);}
+  Ecrivain_Flux flux(ecrit_socket, &Socket);
+  flux.write((uint8_t)0xAA);
+  TEST_ASSERT_EQUAL(1000, flux.write(bloc, sizeof(bloc)));
+  TEST_ASSERT_TRUE(flux.vide());
+  TEST_ASSERT_EQUAL(2, Socket.Ecritures);
+  TEST_ASSERT_EQUAL(0xAA, Socket.Donnees[0]);
+  TEST_ASSERT_EQUAL_MEMORY(bloc, Socket.Donnees + 1, sizeof(bloc));
+}
+
+void test_ecrivain_bloc_remplit(void) {
+  // Un bloc qui remplit exactement le tampon l'écrit : l'octet suivant repart dans un tampon vide
+  static uint8_t bloc[TAILLE_TAMPON_FLUX - 1];
+  memset(bloc, 0x55, sizeof(bloc));
+  Ecrivain_Flux flux(ecrit_socket, &Socket);
+  flux.write((uint8_t)0xAA);
+  TEST_ASSERT_EQUAL(sizeof(bloc), flux.write(bloc, sizeof(bloc)));
+  TEST_ASSERT_EQUAL(1, Socket.Ecritures);
+  TEST_ASSERT_EQUAL(TAILLE_TAMPON_FLUX, flux.Transmis);
+  for (int i = 0; i < 10; i++) {TEST_ASSERT_EQUAL(1, flux.write((uint8_t)i));}
+  TEST_ASSERT_TRUE(flux.vide());
+  TEST_ASSERT_EQUAL(2, Socket.Ecritures);
+  TEST_ASSERT_EQUAL(TAILLE_TAMPON_FLUX + 10, flux.Transmis);
+  TEST_ASSERT_EQUAL(TAILLE_TAMPON_FLUX + 10, Socket.Taille);
+  TEST_ASSERT_EQUAL(9, Socket.Donnees[TAILLE_TAMPON_FLUX + 9]);
+}
+
+void test_ecrivain_coupure(void) {
+  // Après une écriture incomplète, plus rien n'est accepté : le paquet est déclaré incomplet
+  Socket.Limite = 300;
+  Ecrivain_Flux flux(ecrit_socket, &Socket);
+  size_t ecrit = 0;
+  for (int i = 0; i < 1000; i++) {ecrit += flux.write((uint8_t)i);}
+  TEST_ASSERT_FALSE(flux.vide());
+  TEST_ASSERT_TRUE(flux.Erreur);
+  TEST_ASSERT_EQUAL(300, flux.Transmis);
+  TEST_ASSERT_LESS_THAN(1000, ecrit);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_topics);
+  RUN_TEST(test_taille_paquet);
+  RUN_TEST(test_bande_morte);
+  RUN_TEST(test_ecrivain_regroupe);
+  RUN_TEST(test_ecrivain_bloc);
+  RUN_TEST(test_ecrivain_bloc_remplit);
+  RUN_TEST(test_ecrivain_coupure);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+/**
+ * @file test_main.cpp
+ * @brief Tests natifs du correcteur PID de la régulation de pression.
+ *
+ * Le correcteur (src/pid.cpp) est bouclé sur un modèle de pompe du premier ordre :
+ * tau * dP/dt = K * u - P, avec u la sortie PWM en %. Les tests vérifient le temps d'établissement,
+ * le dépassement et l'anti-emballement de l'intégrale sur une consigne inatteignable.
+ *
+ * Exécution : pio test -e native -f test_regulation
+ */
+
+#include <math.h>
+#include <unity.h>
+#include "regulation.h"
+
+/// @brief Gain statique de la pompe : pression en bar pour 1 % de PWM (5 bar à 100 %).
+#define POMPE_K 0.05f
+/// @brief Constante de temps de la pompe et de la ligne (s).
+#define POMPE_TAU 0.5f
+/// @brief Pas de calcul : régulation à 200 Hz, la fréquence par défaut.
+#define PAS_S 0.005f
+
+/**
+ * @struct Struct_Simulation
+ * @brief Boucle fermée correcteur + pompe simulée.
+ */
+struct Struct_Simulation {
+  Struct_PID Pid;
+  float Pression = 0;                ///< Pression simulée (bar).
+  float Sortie = 0;                  ///< Dernière sortie du correcteur (%).
+  float Pression_max = 0;            ///< Pression maximale atteinte depuis le dernier changement de consigne.
+  float Sortie_min = 0;              ///< Sortie minimale observée.
+  float Sortie_max_obs = 0;          ///< Sortie maximale observée.
+};
+
+Struct_Simulation Sim;
+
+void setUp(void) {
+  Sim = Struct_Simulation();
+  Sim.Pid.Kp = 20;
+  Sim.Pid.Ki = 40;
+  Sim.Pid.Kd = 0.5f;
+  Sim.Pid.Sortie_min = 0;
+  Sim.Pid.Sortie_max = 100;
+  Sim.Sortie_min = 100;
+  PID_raz(&Sim.Pid);
+}
+
+void tearDown(void) {}
+
+/**
+ * @fn void simule(float duree_s)
+ * @brief Avance la boucle fermée de duree_s secondes (intégration d'Euler au pas de calcul).
+ */
+void simule(float duree_s) {
+  int n = (int)(duree_s / PAS_S + 0.5f);
+  for (int i = 0; i < n; i++) {
+    Sim.Sortie = PID_calcul(&Sim.Pid, Sim.Pression, PAS_S);
+    Sim.Pression += (POMPE_K * Sim.Sortie - Sim.Pression) * PAS_S / POMPE_TAU;
+    if (Sim.Pression > Sim.Pression_max) {Sim.Pression_max = Sim.Pression;}
+    if (Sim.Sortie < Sim.Sortie_min) {Sim.Sortie_min = Sim.Sortie;}
+    if (Sim.Sortie > Sim.Sortie_max_obs) {Sim.Sortie_max_obs = Sim.Sortie;}
+  }
+}
+
+/**
+ * @fn float temps_etablissement(float consigne, float bande, float duree_s)
+ * @brief Instant à partir duquel la pression reste dans ±bande autour de la consigne.
+ * @return Temps d'établissement en s, ou duree_s si la pression n'est pas établie
+ */
+float temps_etablissement(float consigne, float bande, float duree_s) {
+  float etabli = duree_s;
+  bool dans_bande = false;
+  int n = (int)(duree_s / PAS_S + 0.5f);
+  for (int i = 0; i < n; i++) {
+    simule(PAS_S);
+    bool dedans = fabsf(Sim.Pression - consigne) <= bande;
+    if (dedans && !dans_bande) {etabli = i * PAS_S;}
+    if (!dedans) {etabli = duree_s;}
+    dans_bande = dedans;
+  }
+  return etabli;
+}
+
+void test_echelon_etablissement(void) {
+  Sim.Pid.Consigne = 3;
+  float t = temps_etablissement(3, 0.03f, 10);
+  TEST_ASSERT_LESS_THAN_FLOAT(3.0f, t);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 3, Sim.Pression);
+}
+
+void test_echelon_depassement(void) {
+  Sim.Pid.Consigne = 3;
+  simule(10);
+  // Dépassement inférieur à 5 % de l'échelon
+  TEST_ASSERT_LESS_THAN_FLOAT(3 * 1.05f, Sim.Pression_max);
+}
+
+void test_sortie_bornee(void) {
+  Sim.Pid.Consigne = 4;
+  simule(5);
+  Sim.Pid.Consigne = 0.5f;
+  simule(5);
+  TEST_ASSERT_GREATER_OR_EQUAL_FLOAT(Sim.Pid.Sortie_min, Sim.Sortie_min);
+  TEST_ASSERT_LESS_OR_EQUAL_FLOAT(Sim.Pid.Sortie_max, Sim.Sortie_max_obs);
+}
+
+void test_anti_emballement(void) {
+  // Consigne inatteignable (la pompe plafonne à 5 bar) : la sortie reste saturée longtemps
+  Sim.Pid.Consigne = 6;
+  simule(30);
+  TEST_ASSERT_FLOAT_WITHIN(0.001f, 100, Sim.Sortie);
+  // L'intégrale n'a pas accumulé l'erreur de 30 s de saturation
+  TEST_ASSERT_LESS_OR_EQUAL_FLOAT(Sim.Pid.Sortie_max, Sim.Pid.Integrale);
+
+  // Retour à une consigne atteignable : la sortie quitte la saturation sans attendre la décharge
+  // d'une intégrale emballée, puis la pression se rétablit
+  Sim.Pid.Consigne = 3;
+  Sim.Pression_max = 0;
+  simule(0.2f);
+  TEST_ASSERT_LESS_THAN_FLOAT(100.0f, Sim.Sortie);
+  float t = temps_etablissement(3, 0.03f, 10);
+  TEST_ASSERT_LESS_THAN_FLOAT(2.5f, t);
+}
+
+void test_derivee_sur_mesure(void) {
+  Sim.Pid.Consigne = 2;
+  simule(5);
+  float integrale = Sim.Pid.Integrale;
+  // Un changement de consigne ne produit pas d'à-coup dérivé : seul le terme proportionnel saute
+  Sim.Pid.Consigne = 2.5f;
+  float sortie = PID_calcul(&Sim.Pid, Sim.Pression, PAS_S);
+  float attendu = Sim.Pid.Kp * (2.5f - Sim.Pression) + integrale + Sim.Pid.Ki * (2.5f - Sim.Pression) * PAS_S;
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, attendu, sortie);
+}
+
+void test_raz(void) {
+  Sim.Pid.Consigne = 3;
+  simule(1);
+  PID_raz(&Sim.Pid);
+  TEST_ASSERT_EQUAL_FLOAT(0, Sim.Pid.Integrale);
+  TEST_ASSERT_TRUE(Sim.Pid.Premier);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_echelon_etablissement);
+  RUN_TEST(test_echelon_depassement);
+  RUN_TEST(test_sortie_bornee);
+  RUN_TEST(test_anti_emballement);
+  RUN_TEST(test_derivee_sur_mesure);
+  RUN_TEST(test_raz);
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+/**
+ * @file test_main.cpp
+ * @brief Tests natifs de la table de routage des commandes MQTT.
+ *
+ * Le routeur (src/routeur.cpp) est vérifié sur une table de capacité réduite : enregistrement,
+ * recherche, refus des doublons et des suffixes trop longs, limite de remplissage aux 3/4 et
+ * sondage linéaire lorsque plusieurs suffixes tombent sur la même entrée.
+ *
+ * Exécution : pio test -e native -f test_routeur
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unity.h>
+#include "routeur.h"
+
+/// @brief Commande transmise aux gestionnaires de test
+struct Struct_Commande {
+  int Appels = 0;                    ///< Nombre d'appels du gestionnaire.
+};
+
+void gestionnaire_a(Struct_Commande &cmd) {cmd.Appels += 1;}
+void gestionnaire_b(Struct_Commande &cmd) {cmd.Appels += 10;}
+
+/// @brief Capacité de la table de test (puissance de 2)
+#define CAPACITE 16
+
+Struct_Route Table[CAPACITE];
+Struct_Routeur Routeur;
+
+void setUp(void) {
+  Routeur_init(&Routeur, Table, CAPACITE);
+}
+
+void tearDown(void) {}
+
+void test_ajoute_cherche(void) {
+  TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, "GPIO_OUT", gestionnaire_a, 0, 2));
+  TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, "PCF8574_OUT_1_3", gestionnaire_b, 2, 1));
+  TEST_ASSERT_EQUAL_INT(2, Routeur.Nb);
+
+  const Struct_Route *route = Routeur_cherche(&Routeur, "PCF8574_OUT_1_3");
+  TEST_ASSERT_NOT_NULL(route);
+  TEST_ASSERT_EQUAL_STRING("PCF8574_OUT_1_3", route->Suffixe);
+  TEST_ASSERT_EQUAL_INT(2, route->Voie);
+  TEST_ASSERT_EQUAL_INT(1, route->Format);
+
+  Struct_Commande cmd;
+  route->Gestionnaire(cmd);
+  Routeur_cherche(&Routeur, "GPIO_OUT")->Gestionnaire(cmd);
+  TEST_ASSERT_EQUAL_INT(11, cmd.Appels);
+}
+
+void test_route_inconnue(void) {
+  Routeur_ajoute(&Routeur, "GPIO_OUT", gestionnaire_a, 0, 0);
+  TEST_ASSERT_NULL(Routeur_cherche(&Routeur, "GPIO_OUT/"));
+  TEST_ASSERT_NULL(Routeur_cherche(&Routeur, "GPIO_OU"));
+  TEST_ASSERT_NULL(Routeur_cherche(&Routeur, ""));
+
+  // Routeur non initialisé : aucune route, aucun accès à la table
+  Struct_Routeur vide;
+  TEST_ASSERT_NULL(Routeur_cherche(&vide, "GPIO_OUT"));
+}
+
+void test_doublon_refuse(void) {
+  TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, "PWM", gestionnaire_a, 0, 0));
+  TEST_ASSERT_EQUAL_INT(0, Routeur_ajoute(&Routeur, "PWM", gestionnaire_b, 1, 0));
+  TEST_ASSERT_EQUAL_INT(1, Routeur.Nb);
+  TEST_ASSERT_TRUE(Routeur_cherche(&Routeur, "PWM")->Gestionnaire == gestionnaire_a);
+}
+
+void test_suffixe_trop_long(void) {
+  char suffixe[TAILLE_SUFFIXE_ROUTE + 1];
+  memset(suffixe, 'a', TAILLE_SUFFIXE_ROUTE);
+  suffixe[TAILLE_SUFFIXE_ROUTE] = '\0';
+  TEST_ASSERT_EQUAL_INT(0, Routeur_ajoute(&Routeur, suffixe, gestionnaire_a, 0, 0));
+  // Le plus long suffixe accepté laisse la place du caractère nul
+  suffixe[TAILLE_SUFFIXE_ROUTE - 1] = '\0';
+  TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, suffixe, gestionnaire_a, 0, 0));
+  TEST_ASSERT_NOT_NULL(Routeur_cherche(&Routeur, suffixe));
+}
+
+void test_remplissage_limite(void) {
+  char suffixe[TAILLE_SUFFIXE_ROUTE];
+  int ajoutees = 0;
+  for (int i = 0; i < CAPACITE; i++) {
+    snprintf(suffixe, sizeof(suffixe), "Canal_%d", i);
+    ajoutees += Routeur_ajoute(&Routeur, suffixe, gestionnaire_a, i, 0);
+  }
+  // Taux de remplissage limité aux 3/4 : il reste toujours une entrée libre pour arrêter le sondage
+  TEST_ASSERT_EQUAL_INT(3 * CAPACITE / 4, ajoutees);
+  TEST_ASSERT_EQUAL_INT(3 * CAPACITE / 4, Routeur.Nb);
+  for (int i = 0; i < ajoutees; i++) {
+    snprintf(suffixe, sizeof(suffixe), "Canal_%d", i);
+    const Struct_Route *route = Routeur_cherche(&Routeur, suffixe);
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_INT(i, route->Voie);
+  }
+  TEST_ASSERT_NULL(Routeur_cherche(&Routeur, "Canal_absent"));
+}
+
+void test_collisions(void) {
+  // Suffixes tombant sur la même entrée de la table : ils sont rangés par sondage linéaire
+  char suffixes[3][TAILLE_SUFFIXE_ROUTE];
+  int nb = 0;
+  uint32_t cible = Routeur_hash("Lot") & (CAPACITE - 1);
+  TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, "Lot", gestionnaire_a, 100, 0));
+  for (int i = 0; nb < 3 && i < 100000; i++) {
+    snprintf(suffixes[nb], TAILLE_SUFFIXE_ROUTE, "Route_%d", i);
+    if ((Routeur_hash(suffixes[nb]) & (CAPACITE - 1)) == cible) {nb++;}
+  }
+  TEST_ASSERT_EQUAL_INT(3, nb);
+  for (int i = 0; i < nb; i++) {
+    TEST_ASSERT_EQUAL_INT(1, Routeur_ajoute(&Routeur, suffixes[i], gestionnaire_b, i, 0));
+  }
+  TEST_ASSERT_EQUAL_INT(100, Routeur_cherche(&Routeur, "Lot")->Voie);
+  for (int i = 0; i < nb; i++) {
+    const Struct_Route *route = Routeur_cherche(&Routeur, suffixes[i]);
+    TEST_ASSERT_NOT_NULL(route);
+    TEST_ASSERT_EQUAL_INT(i, route->Voie);
+    TEST_ASSERT_EQUAL_STRING(suffixes[i], route->Suffixe);
+  }
+}
+
+void test_hash_fnv1a(void) {
+  // Valeurs de référence FNV-1a 32 bits
+  TEST_ASSERT_EQUAL_UINT32(2166136261UL, Routeur_hash(""));
+  TEST_ASSERT_EQUAL_UINT32(0xe40c292cUL, Routeur_hash("a"));
+  TEST_ASSERT_EQUAL_UINT32(0xbf9cf968UL, Routeur_hash("foobar"));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ajoute_cherche);
+  RUN_TEST(test_route_inconnue);
+  RUN_TEST(test_doublon_refuse);
+  RUN_TEST(test_suffixe_trop_long);
+  RUN_TEST(test_remplissage_limite);
+  RUN_TEST(test_collisions);
+  RUN_TEST(test_hash_fnv1a);
+  return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""
+Banc de charge de l'API REST de la passerelle ESP32_Irrigation.
+
+N clients simultanés interrogent /api/state (ou /api/state/<groupe>) pendant --duree secondes.
+Avec --etag, chaque client renvoie l'ETag reçu dans If-None-Match : tant que l'état ne change pas,
+l'ESP répond 304 sans corps. Le banc relève /api/diagnostic avant et après la charge pour le tas
+libre de l'ESP : la baisse du tas libre, divisée par le nombre de réponses simultanées, donne
+l'ordre de grandeur du tas consommé par requête.
+
+Sans dépendance externe (http.client de la bibliothèque standard).
+
+Exemple :
+    python3 banc_api.py --hote 192.168.1.50 --clients 1,2,4,8 --duree 20
+    python3 banc_api.py --hote 192.168.1.50 --clients 4 --etag --chemin /api/state/GPIO_OUT
+"""
+
+import argparse
+import http.client
+import json
+import statistics
+import sys
+import threading
+import time
+
+
+def diagnostic(args):
+    connexion = http.client.HTTPConnection(args.hote, args.port, timeout=args.timeout)
+    connexion.request("GET", "/api/diagnostic")
+    reponse = connexion.getresponse()
+    valeur = json.loads(reponse.read())
+    connexion.close()
+    return valeur
+
+
+def client(args, fin, resultats, verrou):
+    """Boucle de requêtes d'un client ; une connexion par requête (le serveur ferme après chaque réponse)."""
+    etag = None
+    latences, codes, octets = [], {}, 0
+    while time.monotonic() < fin:
+        entetes = {"If-None-Match": etag} if args.etag and etag else {}
+        debut = time.monotonic()
+        try:
+            connexion = http.client.HTTPConnection(args.hote, args.port, timeout=args.timeout)
+            connexion.request("GET", args.chemin, headers=entetes)
+            reponse = connexion.getresponse()
+            corps = reponse.read()
+            connexion.close()
+        except (OSError, http.client.HTTPException):
+            codes["erreur"] = codes.get("erreur", 0) + 1
+            continue
+        latences.append((time.monotonic() - debut) * 1000)
+        codes[reponse.status] = codes.get(reponse.status, 0) + 1
+        octets += len(corps)
+        etag = reponse.getheader("ETag") or etag
+    with verrou:
+        resultats["latences"].extend(latences)
+        resultats["octets"] += octets
+        for code, nb in codes.items():
+            resultats["codes"][str(code)] = resultats["codes"].get(str(code), 0) + nb
+
+
+def charge(args, nb_clients):
+    avant = diagnostic(args)
+    resultats = {"latences": [], "octets": 0, "codes": {}}
+    verrou = threading.Lock()
+    fin = time.monotonic() + args.duree
+    clients = [threading.Thread(target=client, args=(args, fin, resultats, verrou)) for _ in range(nb_clients)]
+    debut = time.monotonic()
+    for c in clients:
+        c.start()
+    for c in clients:
+        c.join()
+    duree = time.monotonic() - debut
+    time.sleep(0.5)
+    apres = diagnostic(args)
+
+    latences = sorted(resultats["latences"])
+    mesure = {
+        "clients": nb_clients,
+        "requetes_s": round(len(latences) / duree, 1),
+        "octets_s": round(resultats["octets"] / duree),
+        "codes": resultats["codes"],
+    }
+    if latences:
+        mesure["latence_ms"] = {
+            "mediane": round(statistics.median(latences), 1),
+            "p95": round(latences[min(len(latences) - 1, int(0.95 * len(latences)))], 1),
+            "max": round(latences[-1], 1),
+        }
+    baisse = avant["tas_libre"] - apres["tas_libre_min"]
+    mesure["tas"] = {
+        "libre_avant": avant["tas_libre"],
+        "libre_min": apres["tas_libre_min"],
+        "en_cours_max": apres["en_cours_max"],
+        "par_requete": round(baisse / max(1, apres["en_cours_max"])) if baisse > 0 else 0,
+    }
+    mesure["instantanes"] = apres["versions"] - avant["versions"]
+    return mesure
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Banc de charge de l'API REST")
+    parser.add_argument("--hote", required=True, help="adresse IP de l'ESP")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--chemin", default="/api/state")
+    parser.add_argument("--clients", default="1,2,4,8", help="nombres de clients simultanés, séparés par des virgules")
+    parser.add_argument("--duree", type=float, default=20.0, help="durée de chaque palier (s)")
+    parser.add_argument("--etag", action="store_true", help="requêtes conditionnelles If-None-Match")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    parser.add_argument("--enregistre", metavar="FICHIER", help="enregistre les résultats en JSON")
+    args = parser.parse_args()
+
+    paliers = []
+    for nb in [int(n) for n in args.clients.split(",")]:
+        mesure = charge(args, nb)
+        paliers.append(mesure)
+        print("%2d clients : %7.1f req/s, médiane %s ms, codes %s, tas/requête ~%d octets" % (
+            nb, mesure["requetes_s"], mesure.get("latence_ms", {}).get("mediane"), mesure["codes"], mesure["tas"]["par_requete"]))
+
+    resultats = {"date": time.strftime("%Y-%m-%d %H:%M:%S"), "chemin": args.chemin, "etag": args.etag, "paliers": paliers}
+    print(json.dumps(resultats, indent=2))
+    if args.enregistre:
+        with open(args.enregistre, "w") as f:
+            json.dump(resultats, f, indent=2)
+            f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,364 @@
+#!/usr/bin/env python3
+"""
+Banc d'intégration MQTT de la passerelle ESP32_Irrigation contre un serveur local.
+
+Le banc mesure le chemin de publication et de commande de l'ESP réel (mqtt_service_setup,
+publish_s1, callback / update_Subscribe1) à travers un serveur MQTT local, en quatre phases :
+
+  1. débit : messages/s et octets/s reçus sous <base>_out/#, octets par cycle côté ESP
+     (différence des compteurs de la route Statistiques entre le début et la fin de la mesure) ;
+  2. latence : commandes MQTT 5 portant les propriétés Response Topic et Correlation Data ;
+     aller-retour mesuré par le banc et latence réception / application ("latence_us") relevée
+     dans l'acquittement, apparié par sa Correlation Data ;
+  3. redémarrages du serveur : durée jusqu'au retour de la présence "online" et jusqu'au premier
+     message d'état, messages rejoués depuis la file d'attente ;
+  4. comparaison à une référence : chaque grandeur est comparée à celle du fichier de référence
+     avec une tolérance, et le banc sort en erreur en cas de régression.
+
+Une référence mesurée sur un banc donné s'enregistre avec --enregistre et se compare avec la
+tolérance --tolerance : elle dépend de l'ESP, du WiFi et du serveur et n'est pas suivie dans le dépôt.
+La référence suivie dans le dépôt est celle du banc natif (pio test -e native_mqtt -f test_mqtt), qui
+exécute le même code sur le PC contre un serveur local : test/test_mqtt/reference_mesuree.h.
+
+Avec --lance-courtier, le banc démarre lui-même mosquitto sur --port et le relance pendant la
+phase 3. Sinon, --redemarrage donne la commande shell de relance (par exemple
+"docker restart mosquitto"). L'ESP doit être configuré sur ce serveur (MQTT.json).
+
+La phase de latence envoie par défaut des requêtes d'état (route Requete), sans effet sur les
+sorties. Avec --sortie N, elle bascule la sortie GPIO_OUT N : à réserver à un banc sans vanne.
+L'ESP doit être en MQTT 5 ("MQTT_version": "5") : en 3.1.1, ses réponses partent sur <base>_out/Ack
+sans corrélation et la phase de latence les compte toutes perdues.
+
+Dépendances : pip install paho-mqtt msgpack
+
+Exemple :
+    python3 banc_mqtt.py --lance-courtier --base irrigation --enregistre reference_mqtt.json
+    python3 banc_mqtt.py --lance-courtier --base irrigation --reference reference_mqtt.json
+"""
+
+import argparse
+import json
+import os
+import shlex
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import uuid
+
+from pont_msgpack import decode
+
+
+# Grandeurs comparées à la référence : (chemin, sens). "+" : plus grand est meilleur.
+GRANDEURS = [
+    ("debit.messages_s", "+"),
+    ("debit.octets_cycle", "-"),
+    ("debit.echecs", "-"),
+    ("latence.aller_retour_ms.mediane", "-"),
+    ("latence.aller_retour_ms.p95", "-"),
+    ("latence.application_us.mediane", "-"),
+    ("latence.pertes", "-"),
+    ("redemarrage.online_ms.max", "-"),
+    ("redemarrage.premier_etat_ms.max", "-"),
+]
+
+
+class Banc:
+    """Client MQTT du banc : compte le trafic de l'ESP et attend les réponses corrélées."""
+
+    def __init__(self, mqtt, args):
+        self.args = args
+        self.entree = args.base + "_out/"
+        self.reponse = args.base + "_banc/" + uuid.uuid4().hex[:8]
+        self.verrou = threading.Condition()
+        self.messages = 0
+        self.octets = 0
+        self.statut = None
+        self.instant_statut = 0.0
+        self.instant_etat = 0.0
+        self.reponses = {}
+
+        self.client = mqtt.Client(client_id="banc_" + uuid.uuid4().hex[:8], protocol=mqtt.MQTTv5)
+        if args.user:
+            self.client.username_pw_set(args.user, args.password)
+        self.client.on_connect = self.on_connect
+        self.client.on_message = self.on_message
+        self.client.reconnect_delay_set(min_delay=1, max_delay=1)
+
+    def on_connect(self, client, userdata, flags, rc, *extra):
+        client.subscribe(self.entree + "#")
+        client.subscribe(self.reponse)
+
+    def on_message(self, client, userdata, msg):
+        maintenant = time.monotonic()
+        with self.verrou:
+            if msg.topic == self.reponse:
+                correlation = getattr(msg.properties, "CorrelationData", None)
+                if correlation is not None:
+                    self.reponses[bytes(correlation)] = (maintenant, decode(msg.payload))
+                self.verrou.notify_all()
+                return
+            # Les messages retenus rejoués par le serveur à la souscription ne sont pas du trafic de l'ESP,
+            # mais datent quand même la reprise si le banc se réabonne après la reconnexion de l'ESP
+            if not msg.retain:
+                self.messages += 1
+                self.octets += len(msg.topic) + len(msg.payload)
+            if msg.topic == self.entree + "Statut":
+                self.statut = msg.payload.decode("utf-8", "replace")
+                self.instant_statut = maintenant
+            elif msg.topic != self.entree + "Ack":
+                self.instant_etat = maintenant
+            self.verrou.notify_all()
+
+    def demarre(self):
+        self.client.connect(self.args.serveur, self.args.port)
+        self.client.loop_start()
+
+    def arrete(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+    def commande(self, route, corps, timeout):
+        """Publie une commande avec topic de réponse et corrélation ; retourne (aller-retour s, réponse) ou None."""
+        from paho.mqtt.packettypes import PacketTypes
+        from paho.mqtt.properties import Properties
+
+        correlation = uuid.uuid4().bytes[:8]
+        proprietes = Properties(PacketTypes.PUBLISH)
+        proprietes.ResponseTopic = self.reponse
+        proprietes.CorrelationData = correlation
+        debut = time.monotonic()
+        self.client.publish(self.args.base + "/" + route, json.dumps(corps), qos=1, properties=proprietes)
+        with self.verrou:
+            if not self.verrou.wait_for(lambda: correlation in self.reponses, timeout):
+                return None
+            instant, valeur = self.reponses.pop(correlation)
+        return instant - debut, valeur
+
+    def attend(self, condition, timeout):
+        with self.verrou:
+            return self.verrou.wait_for(condition, timeout)
+
+
+class Courtier:
+    """Serveur mosquitto local lancé par le banc, ou commande de relance d'un serveur existant."""
+
+    def __init__(self, args):
+        self.args = args
+        self.processus = None
+        self.configuration = os.path.join(tempfile.gettempdir(), "banc_mqtt_%d.conf" % args.port)
+
+    def demarre(self):
+        if not self.args.lance_courtier:
+            return
+        # mosquitto 2 n'écoute que sur localhost sans listener explicite : l'ESP doit pouvoir se connecter.
+        # max_topic_alias : autant d'alias de topic que la table de l'ESP (NB_ALIAS_MQTT), 10 par défaut
+        with open(self.configuration, "w") as f:
+            f.write("listener %d\nallow_anonymous true\nmax_topic_alias 64\n" % self.args.port)
+        self.processus = subprocess.Popen(["mosquitto", "-c", self.configuration],
+                                          stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        time.sleep(0.5)
+
+    def arrete(self):
+        if self.processus is not None:
+            self.processus.terminate()
+            self.processus.wait()
+            self.processus = None
+
+    def redemarre(self):
+        if self.args.lance_courtier:
+            self.arrete()
+            time.sleep(self.args.coupure)
+            self.demarre()
+        elif self.args.redemarrage:
+            subprocess.run(shlex.split(self.args.redemarrage), check=True)
+        else:
+            return False
+        return True
+
+
+def centiles(valeurs):
+    if not valeurs:
+        return None
+    valeurs = sorted(valeurs)
+    return {
+        "mediane": round(statistics.median(valeurs), 3),
+        "p95": round(valeurs[min(len(valeurs) - 1, int(0.95 * len(valeurs)))], 3),
+        "max": round(valeurs[-1], 3),
+    }
+
+
+def statistiques(banc):
+    resultat = banc.commande("Statistiques", {}, banc.args.timeout)
+    return None if resultat is None else resultat[1]
+
+
+def phase_debit(banc):
+    """Trafic reçu pendant --duree secondes et compteurs de publication de l'ESP."""
+    avant = statistiques(banc)
+    with banc.verrou:
+        messages, octets = banc.messages, banc.octets
+    debut = time.monotonic()
+    time.sleep(banc.args.duree)
+    duree = time.monotonic() - debut
+    with banc.verrou:
+        messages, octets = banc.messages - messages, banc.octets - octets
+    apres = statistiques(banc)
+
+    debit = {
+        "duree_s": round(duree, 1),
+        "messages_s": round(messages / duree, 2),
+        "octets_s": round(octets / duree, 1),
+    }
+    if avant and apres:
+        a, b = avant["publication"], apres["publication"]
+        cycles = b["cycles"] - a["cycles"]
+        debit["cycles"] = cycles
+        debit["octets_cycle"] = round((b["octets"] - a["octets"]) / cycles, 1) if cycles else None
+        debit["messages_cycle"] = round((b["messages"] - a["messages"]) / cycles, 2) if cycles else None
+        debit["octets_max"] = b["octets_max"]
+        debit["echecs"] = b["echecs"] - a["echecs"]
+        debit["tas_publication_max"] = b["tas_publication_max"]
+    return debit
+
+
+def phase_latence(banc):
+    """Aller-retour des commandes corrélées et latence réception / application relevée par l'ESP."""
+    aller_retour, application, pertes = [], [], 0
+    for i in range(banc.args.commandes):
+        if banc.args.sortie is not None:
+            resultat = banc.commande("GPIO_OUT", {"num_port": banc.args.sortie, "val_port": i % 2}, banc.args.timeout)
+        else:
+            resultat = banc.commande("Requete", {"groupe": "GPIO_OUT"}, banc.args.timeout)
+        if resultat is None:
+            pertes += 1
+            continue
+        duree, valeur = resultat
+        aller_retour.append(duree * 1000)
+        if "latence_us" in valeur:
+            application.append(valeur["latence_us"])
+        time.sleep(banc.args.intervalle)
+    latence = {"commandes": banc.args.commandes, "pertes": pertes, "aller_retour_ms": centiles(aller_retour)}
+    if application:
+        latence["application_us"] = centiles(application)
+    return latence
+
+
+def phase_redemarrage(banc, courtier):
+    """Relance du serveur : retour de la présence "online" et du premier message d'état."""
+    online, premier_etat, echecs = [], [], 0
+    avant = statistiques(banc)
+    for _ in range(banc.args.redemarrages):
+        debut = time.monotonic()
+        if not courtier.redemarre():
+            return None
+        ok = banc.attend(lambda: banc.instant_statut > debut and banc.statut == "online", banc.args.timeout_reprise)
+        ok = ok and banc.attend(lambda: banc.instant_etat > banc.instant_statut, banc.args.timeout_reprise)
+        if not ok:
+            echecs += 1
+            continue
+        online.append((banc.instant_statut - debut) * 1000)
+        premier_etat.append((banc.instant_etat - debut) * 1000)
+        time.sleep(banc.args.intervalle)
+    apres = statistiques(banc)
+
+    redemarrage = {
+        "redemarrages": banc.args.redemarrages,
+        "echecs": echecs,
+        "online_ms": centiles(online),
+        "premier_etat_ms": centiles(premier_etat),
+    }
+    if avant and apres:
+        a, b = avant["connexion"], apres["connexion"]
+        redemarrage["coupures"] = b["coupures"] - a["coupures"]
+        redemarrage["coupure_max_ms"] = b["coupure_max_ms"]
+        redemarrage["rejoues"] = b["rejoues"] - a["rejoues"]
+    return redemarrage
+
+
+def valeur(resultats, chemin):
+    for cle in chemin.split("."):
+        if not isinstance(resultats, dict) or cle not in resultats:
+            return None
+        resultats = resultats[cle]
+    return resultats
+
+
+def compare(resultats, reference, tolerance):
+    """Compare les grandeurs suivies à la référence ; retourne le nombre de régressions."""
+    regressions = 0
+    for chemin, sens in GRANDEURS:
+        mesure, ref = valeur(resultats, chemin), valeur(reference, chemin)
+        if mesure is None or ref is None:
+            continue
+        if sens == "+":
+            regression = mesure < ref * (1 - tolerance)
+        else:
+            regression = mesure > ref * (1 + tolerance) and mesure > ref
+        regressions += regression
+        print("%-36s %12s  reference %12s  %s" % (chemin, mesure, ref, "REGRESSION" if regression else "ok"))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Banc d'intégration MQTT de la passerelle")
+    parser.add_argument("--serveur", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    parser.add_argument("--base", default="irrigation", help="MQTT_subscribe_1 de l'ESP")
+    parser.add_argument("--lance-courtier", action="store_true", help="démarre et relance mosquitto localement")
+    parser.add_argument("--redemarrage", metavar="COMMANDE", help="commande shell de relance du serveur")
+    parser.add_argument("--coupure", type=float, default=2.0, help="durée d'arrêt du serveur lancé par le banc (s)")
+    parser.add_argument("--duree", type=float, default=60.0, help="durée de la mesure de débit (s)")
+    parser.add_argument("--commandes", type=int, default=50, help="nombre de commandes de la mesure de latence")
+    parser.add_argument("--sortie", type=int, help="bascule la sortie GPIO_OUT N au lieu d'envoyer des requêtes")
+    parser.add_argument("--intervalle", type=float, default=0.2, help="pause entre deux commandes (s)")
+    parser.add_argument("--redemarrages", type=int, default=3)
+    parser.add_argument("--timeout", type=float, default=5.0, help="attente d'une réponse (s)")
+    parser.add_argument("--timeout-reprise", type=float, default=120.0, help="attente de reconnexion de l'ESP (s)")
+    parser.add_argument("--reference", metavar="FICHIER", help="compare les résultats à cette référence")
+    parser.add_argument("--tolerance", type=float, default=0.10, help="écart relatif toléré sur la référence")
+    parser.add_argument("--enregistre", metavar="FICHIER", help="enregistre les résultats comme référence")
+    args = parser.parse_args()
+
+    import paho.mqtt.client as mqtt
+
+    courtier = Courtier(args)
+    courtier.demarre()
+    banc = Banc(mqtt, args)
+    try:
+        banc.demarre()
+        if statistiques(banc) is None and not banc.attend(lambda: banc.statut == "online", args.timeout_reprise):
+            print("ESP absent du serveur %s:%d" % (args.serveur, args.port), file=sys.stderr)
+            return 2
+
+        resultats = {"date": time.strftime("%Y-%m-%d %H:%M:%S")}
+        print("Débit sur %.0f s..." % args.duree)
+        resultats["debit"] = phase_debit(banc)
+        print("Latence sur %d commandes..." % args.commandes)
+        resultats["latence"] = phase_latence(banc)
+        if args.redemarrages > 0 and (args.lance_courtier or args.redemarrage):
+            print("%d redémarrages du serveur..." % args.redemarrages)
+            resultats["redemarrage"] = phase_redemarrage(banc, courtier)
+    finally:
+        banc.arrete()
+        courtier.arrete()
+
+    print(json.dumps(resultats, indent=2))
+    if args.enregistre:
+        with open(args.enregistre, "w") as f:
+            json.dump(resultats, f, indent=2)
+            f.write("\n")
+    if args.reference:
+        with open(args.reference) as f:
+            reference = json.load(f)
+        if compare(resultats, reference, args.tolerance) > 0:
+            return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
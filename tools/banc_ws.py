@@ -0,0 +1,167 @@
+#!/usr/bin/env python3
+"""
+Banc du flux WebSocket /ws de la passerelle ESP32_Irrigation.
+
+N clients se connectent au flux et reçoivent les groupes de canaux modifiés. Chaque client envoie
+périodiquement un "ping" numérique que l'ESP renvoie avec son horodatage : l'échange d'aller-retour
+le plus court donne l'écart d'horloge entre le PC et l'ESP (à la manière de NTP). La latence d'un
+message est l'écart entre sa réception et son horodatage "ts" (construction de l'état, juste après
+la lecture des capteurs), ramené à l'horloge du PC.
+
+Avec --lents K, K clients supplémentaires se connectent puis ne lisent plus rien : l'ESP doit regrouper
+leurs envois puis les déconnecter, sans dégrader la latence des clients normaux.
+
+Dépendances : pip install websocket-client
+
+Exemple :
+    python3 banc_ws.py --hote 192.168.1.50 --clients 4 --duree 60
+    python3 banc_ws.py --hote 192.168.1.50 --clients 2 --lents 2 --duree 60
+"""
+
+import argparse
+import http.client
+import json
+import socket
+import statistics
+import sys
+import threading
+import time
+
+
+def diagnostic(args):
+    connexion = http.client.HTTPConnection(args.hote, args.port, timeout=5)
+    connexion.request("GET", "/api/diagnostic")
+    valeur = json.loads(connexion.getresponse().read())
+    connexion.close()
+    return valeur.get("ws", {})
+
+
+class Client(threading.Thread):
+    """Client du flux : messages reçus, latences et écart d'horloge estimé."""
+
+    def __init__(self, websocket, args, numero, lent=False):
+        super().__init__(daemon=True)
+        self.websocket = websocket
+        self.args = args
+        self.numero = numero
+        self.lent = lent
+        self.messages = 0
+        self.latences = []
+        self.ecart = None          # ts ESP - horloge PC (ms), mesuré sur le plus court aller-retour
+        self.rtt_min = None
+        self.ping_envoye = {}
+        self.ferme = False
+        self.connecte = False
+
+    def run(self):
+        url = "ws://%s:%d/ws" % (self.args.hote, self.args.port)
+        try:
+            # Tampon de réception réduit pour un client lent : la contre-pression TCP atteint vite l'ESP
+            options = ((socket.SOL_SOCKET, socket.SO_RCVBUF, 1024),) if self.lent else ()
+            ws = self.websocket.create_connection(url, timeout=self.args.timeout, sockopt=options)
+        except (OSError, self.websocket.WebSocketException):
+            return
+        self.connecte = True
+        fin = time.monotonic() + self.args.duree
+        prochain_ping = 0
+        numero_ping = 0
+        try:
+            while time.monotonic() < fin:
+                if self.lent:
+                    # Client bloqué : ne lit plus, sa fenêtre TCP se remplit côté ESP
+                    time.sleep(0.5)
+                    ws.ping()
+                    continue
+                if time.monotonic() >= prochain_ping:
+                    numero_ping += 1
+                    self.ping_envoye[numero_ping] = time.time() * 1000
+                    ws.send(str(numero_ping))
+                    prochain_ping = time.monotonic() + self.args.periode_ping
+                try:
+                    texte = ws.recv()
+                except self.websocket.WebSocketTimeoutException:
+                    continue
+                self.traite(texte, time.time() * 1000)
+        except (OSError, self.websocket.WebSocketException):
+            self.ferme = True
+        finally:
+            try:
+                ws.close()
+            except (OSError, self.websocket.WebSocketException):
+                pass
+
+    def traite(self, texte, reception):
+        message = json.loads(texte)
+        if "pong" in message:
+            envoi = self.ping_envoye.pop(message["pong"], None)
+            if envoi is None:
+                return
+            rtt = reception - envoi
+            if self.rtt_min is None or rtt < self.rtt_min:
+                self.rtt_min = rtt
+                self.ecart = message["ts"] - (envoi + reception) / 2
+            return
+        self.messages += 1
+        if self.ecart is not None and "ts" in message:
+            self.latences.append(reception - (message["ts"] - self.ecart))
+
+
+def centiles(valeurs):
+    if not valeurs:
+        return None
+    valeurs = sorted(valeurs)
+    return {
+        "mediane": round(statistics.median(valeurs), 1),
+        "p95": round(valeurs[min(len(valeurs) - 1, int(0.95 * len(valeurs)))], 1),
+        "max": round(valeurs[-1], 1),
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Banc du flux WebSocket")
+    parser.add_argument("--hote", required=True, help="adresse IP de l'ESP")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=4, help="clients normaux")
+    parser.add_argument("--lents", type=int, default=0, help="clients qui cessent de lire")
+    parser.add_argument("--duree", type=float, default=60.0, help="durée de la mesure (s)")
+    parser.add_argument("--periode-ping", type=float, default=2.0, help="période des pings d'horloge (s)")
+    parser.add_argument("--timeout", type=float, default=1.0)
+    parser.add_argument("--enregistre", metavar="FICHIER", help="enregistre les résultats en JSON")
+    args = parser.parse_args()
+
+    import websocket
+
+    avant = diagnostic(args)
+    clients = [Client(websocket, args, i) for i in range(args.clients)]
+    clients += [Client(websocket, args, args.clients + i, lent=True) for i in range(args.lents)]
+    for c in clients:
+        c.start()
+        time.sleep(0.1)
+    for c in clients:
+        c.join()
+    apres = diagnostic(args)
+
+    normaux = [c for c in clients if not c.lent]
+    latences = [l for c in normaux for l in c.latences]
+    resultats = {
+        "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+        "clients": args.clients,
+        "lents": args.lents,
+        "connectes": sum(c.connecte for c in clients),
+        "messages_par_client": [c.messages for c in normaux],
+        "rtt_min_ms": [round(c.rtt_min, 1) if c.rtt_min is not None else None for c in normaux],
+        "latence_ms": centiles(latences),
+        "esp": {cle: apres.get(cle, 0) - avant.get(cle, 0) for cle in ("messages", "octets", "regroupements", "lents", "refus")},
+        "esp_clients_max": apres.get("clients_max"),
+        "esp_latence_max_us": apres.get("latence_max_us"),
+    }
+    print(json.dumps(resultats, indent=2))
+    if args.enregistre:
+        with open(args.enregistre, "w") as f:
+            json.dump(resultats, f, indent=2)
+            f.write("\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Banc de test TLS local pour la passerelle ESP32_Irrigation.
+#
+# Génère une autorité de certification auto-signée, un certificat serveur pour mosquitto
+# (et optionnellement un certificat client), puis une configuration mosquitto écoutant en TLS sur 8883.
+#
+# Le fichier ca.crt est à copier dans data/ (chargé sur le SPIFFS) et MQTT.json à renseigner :
+#   "MQTT_port": "8883", "MQTT_TLS": "true", "MQTT_TLS_CA": "/ca.crt",
+#   "MQTT_TLS_nom_serveur": "<nom du serveur>"
+# Pour l'authentification client, copier aussi client.crt / client.key et renseigner
+# "MQTT_TLS_certificat": "/client.crt", "MQTT_TLS_cle": "/client.key".
+#
+# La reprise de session se vérifie avec la commande #D de la liaison série après quelques reconnexions
+# (arrêt / redémarrage de mosquitto) : le nombre de reprises augmente et leur durée est bien plus courte.
+#
+# Exemple :
+#   ./mosquitto_tls.sh tls_test mon-serveur.local
+#   mosquitto -c tls_test/mosquitto.conf -v
+
+set -e
+
+REP=${1:-tls_test}
+NOM=${2:-$(hostname)}
+
+mkdir -p "$REP"
+cd "$REP"
+
+# Autorité de certification (courbe P-256 : poignée de main bien plus rapide qu'en RSA sur l'ESP32)
+openssl ecparam -name prime256v1 -genkey -noout -out ca.key
+openssl req -x509 -new -key ca.key -sha256 -days 3650 -subj "/CN=Irrigation CA" -out ca.crt
+
+# Certificat serveur, valable pour le nom et l'adresse indiqués
+openssl ecparam -name prime256v1 -genkey -noout -out serveur.key
+openssl req -new -key serveur.key -subj "/CN=$NOM" -out serveur.csr
+printf "subjectAltName=DNS:%s,IP:127.0.0.1\n" "$NOM" > serveur.ext
+openssl x509 -req -in serveur.csr -CA ca.crt -CAkey ca.key -CAcreateserial -days 825 -sha256 -extfile serveur.ext -out serveur.crt
+
+# Certificat client (optionnel)
+openssl ecparam -name prime256v1 -genkey -noout -out client.key
+openssl req -new -key client.key -subj "/CN=ESP32_irrigation" -out client.csr
+openssl x509 -req -in client.csr -CA ca.crt -CAkey ca.key -CAcreateserial -days 825 -sha256 -out client.crt
+
+cat > mosquitto.conf <<FIN
+listener 8883
+allow_anonymous true
+cafile $(pwd)/ca.crt
+certfile $(pwd)/serveur.crt
+keyfile $(pwd)/serveur.key
+tls_version tlsv1.2
+# Passer à true pour exiger le certificat client
+require_certificate false
+FIN
+
+rm -f serveur.csr client.csr serveur.ext
+echo "Fichiers générés dans $(pwd), serveur : $NOM"
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Pont MQTT MessagePack <-> JSON pour la passerelle ESP32_Irrigation.
+
+Les messages publiés par l'ESP sous <base>_out/# en MessagePack (MQTT/Encodage dans MQTT.json)
+sont décodés et republiés en JSON sous <base>_json/#. Les messages JSON déjà en texte sont
+republiés tels quels, le backend n'a donc qu'un seul format à lire.
+
+Avec --commandes, les commandes JSON publiées sous <base>_cmd/# sont encodées en MessagePack
+et transmises à l'ESP sous <base>/#.
+
+--requete interroge l'ESP (route Requete) en MQTT 5 avec les propriétés Response Topic et
+Correlation Data, affiche la réponse et quitte : c'est aussi le test du schéma requête / réponse
+(l'ESP doit être configuré en MQTT 5, "MQTT_version": "5").
+
+Dépendances : pip install paho-mqtt msgpack
+
+Exemple :
+    python3 pont_msgpack.py --serveur 192.168.1.200 --base irrigation --commandes
+    python3 pont_msgpack.py --decode fichier.bin
+    python3 pont_msgpack.py --serveur 192.168.1.200 --base irrigation --requete GPIO_OUT
+"""
+
+import argparse
+import json
+import sys
+import uuid
+
+import msgpack
+
+
+def est_msgpack(payload):
+    """Les messages de l'ESP sont des objets : '{' en JSON, map (octet >= 0x80) en MessagePack."""
+    return len(payload) > 0 and payload[0] >= 0x80
+
+
+def decode(payload):
+    """Décode une charge utile JSON ou MessagePack en objet Python."""
+    if est_msgpack(payload):
+        return msgpack.unpackb(payload, raw=False)
+    try:
+        return json.loads(payload)
+    except ValueError:
+        # Messages texte (présence "online" / "offline" sur _out/Statut)
+        return payload.decode("utf-8")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Pont MQTT MessagePack <-> JSON")
+    parser.add_argument("--serveur", default="localhost")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--user")
+    parser.add_argument("--password")
+    parser.add_argument("--base", default="irrigation", help="MQTT_subscribe_1 de l'ESP")
+    parser.add_argument("--commandes", action="store_true", help="encode les commandes <base>_cmd/# en MessagePack")
+    parser.add_argument("--decode", metavar="FICHIER", help="décode un fichier binaire et quitte")
+    parser.add_argument("--requete", metavar="GROUPE", nargs="?", const="",
+                        help="interroge l'état de l'ESP (tout l'état, ou un groupe comme GPIO_OUT) et quitte")
+    args = parser.parse_args()
+
+    if args.decode:
+        with open(args.decode, "rb") as f:
+            print(json.dumps(decode(f.read()), indent=2))
+        return 0
+
+    import paho.mqtt.client as mqtt
+
+    entree = args.base + "_out/"
+    sortie = args.base + "_json/"
+    commande = args.base + "_cmd/"
+
+    if args.requete is not None:
+        return requete(mqtt, args)
+
+    def on_connect(client, userdata, flags, rc, *extra):
+        client.subscribe(entree + "#")
+        if args.commandes:
+            client.subscribe(commande + "#")
+
+    def on_message(client, userdata, msg):
+        try:
+            topic = msg.topic
+            if topic.startswith(entree):
+                valeur = decode(msg.payload)
+                client.publish(sortie + topic[len(entree):], json.dumps(valeur), retain=msg.retain)
+            elif msg.topic.startswith(commande):
+                valeur = json.loads(msg.payload)
+                # Response Topic / Correlation Data de la commande transmis tels quels à l'ESP
+                client.publish(args.base + "/" + msg.topic[len(commande):], msgpack.packb(valeur), properties=msg.properties)
+        except (ValueError, msgpack.exceptions.ExtraData) as erreur:
+            print("Message ignoré sur %s : %s" % (msg.topic, erreur), file=sys.stderr)
+
+    client = mqtt.Client(protocol=mqtt.MQTTv5)
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.serveur, args.port)
+    client.loop_forever()
+    return 0
+
+
+def requete(mqtt, args):
+    """Envoie une requête d'état avec topic de réponse et corrélation, attend la réponse correspondante."""
+    from paho.mqtt.packettypes import PacketTypes
+    from paho.mqtt.properties import Properties
+
+    reponse = args.base + "_reponse/" + uuid.uuid4().hex[:8]
+    correlation = uuid.uuid4().bytes[:8]
+    proprietes = Properties(PacketTypes.PUBLISH)
+    proprietes.ResponseTopic = reponse
+    proprietes.CorrelationData = correlation
+    corps = {}
+    if args.requete:
+        corps["groupe"] = args.requete
+
+    def on_connect(client, userdata, flags, rc, *extra):
+        client.subscribe(reponse)
+        client.publish(args.base + "/Requete", json.dumps(corps), qos=1, properties=proprietes)
+
+    def on_message(client, userdata, msg):
+        if bytes(getattr(msg.properties, "CorrelationData", b"")) == correlation:
+            print(json.dumps(decode(msg.payload), indent=2))
+            client.disconnect()
+
+    client = mqtt.Client(protocol=mqtt.MQTTv5)
+    if args.user:
+        client.username_pw_set(args.user, args.password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+    client.connect(args.serveur, args.port)
+    client.loop_forever()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())